@@ -1,5 +1,8 @@
 #include "ImGuiRenderer.h"
 
+// STD.
+#include <algorithm>
+
 
 namespace Jettison::Renderer
 {
@@ -33,7 +36,7 @@ void InitImGui()
 	init_info.Device = m_logicalDevice;
 	init_info.QueueFamily = m_indicies.graphicsFamily.value();
 	init_info.Queue = m_graphicsQueue;
-	init_info.PipelineCache = VK_NULL_HANDLE;
+	init_info.PipelineCache = m_pDeviceContext->GetPipelineCache().GetVkPipelineCache();
 	init_info.DescriptorPool = m_descriptorPool;
 	init_info.Allocator = nullptr;
 	init_info.MinImageCount = m_swapchainImageCount;
@@ -105,6 +108,38 @@ void MainLoopAfterDrawcall()
 }
 
 
+void DrawGpuProfilerWindow(const GpuProfiler& profiler, bool* pIsOpen)
+{
+	if (!ImGui::Begin("GPU Profiler", pIsOpen))
+	{
+		ImGui::End();
+		return;
+	}
+
+	if (!profiler.IsSupported())
+	{
+		ImGui::TextUnformatted("Timestamps are not supported on the graphics queue.");
+		ImGui::End();
+		return;
+	}
+
+	for (const auto& scope : profiler.GetScopeStats())
+	{
+		ImGui::Text("%s: %.3f ms (min %.3f, avg %.3f, max %.3f)", scope.name.c_str(),
+			scope.lastTime, scope.minTime, scope.avgTime, scope.maxTime);
+
+		// Leave some headroom above the worst frame so the graph doesn't jump about.
+		float scaleMax = std::max(scope.maxTime * 1.25f, 0.001f);
+		ImGui::PushID(scope.name.c_str());
+		ImGui::PlotLines("", scope.history.data(), static_cast<int>(scope.history.size()), static_cast<int>(scope.historyOffset),
+			nullptr, 0.0f, scaleMax, ImVec2(0.0f, 60.0f));
+		ImGui::PopID();
+	}
+
+	ImGui::End();
+}
+
+
 void Destroy()
 {
 	// ImGui.
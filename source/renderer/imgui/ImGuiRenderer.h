@@ -4,8 +4,11 @@
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_vulkan.h"
 
+#include "../vulkan/GpuProfiler.h"
+
 
 namespace Jettison::Renderer
 {
-
+// A window with a live graph of each GPU profiler scope, along with its rolling min / avg / max.
+void DrawGpuProfilerWindow(const GpuProfiler& profiler, bool* pIsOpen = nullptr);
 }
\ No newline at end of file
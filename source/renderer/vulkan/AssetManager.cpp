@@ -0,0 +1,636 @@
+#include "AssetManager.h"
+
+// STD.
+#include <algorithm>
+#include <stdexcept>
+
+#include "MeshCache.h"
+#include "Pipeline.h"
+
+
+namespace Jettison::Renderer
+{
+void AssetManager::Init(uint32_t threadCount)
+{
+	if (threadCount == 0)
+	{
+		uint32_t coreCount = std::max(std::thread::hardware_concurrency(), 1u);
+		threadCount = std::clamp(coreCount - 1, 1u, kMaxAssetThreads);
+	}
+
+	if (threadCount > kMaxAssetThreads)
+	{
+		throw std::runtime_error("invalid asset thread count");
+	}
+
+	m_isQuitting = false;
+	m_stats = {};
+
+	for (uint32_t i = 0; i < threadCount; ++i)
+	{
+		m_workers.emplace_back(&AssetManager::WorkerMain, this);
+	}
+}
+
+
+void AssetManager::Destroy()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_isQuitting = true;
+		m_decodeQueue.clear();
+	}
+
+	m_decodeReady.notify_all();
+
+	for (auto& worker : m_workers)
+	{
+		worker.join();
+	}
+
+	m_workers.clear();
+	m_completionQueue.clear();
+
+	// Nothing is drawing, so there's no need to retire anything. The textures go back to the streamer, which is
+	// destroyed after the asset manager.
+	for (auto& pAsset : m_assets)
+	{
+		if (!pAsset)
+		{
+			continue;
+		}
+
+		if (pAsset->pModel)
+		{
+			pAsset->pModel->Destroy();
+		}
+
+		if (pAsset->texture != kInvalidStreamedTexture)
+		{
+			m_pTextureStreamer->ReleaseTexture(pAsset->texture);
+		}
+	}
+
+	for (auto& pModel : m_orphanedModels)
+	{
+		pModel->Destroy();
+	}
+
+	m_assets.clear();
+	m_freeHandles.clear();
+	m_handlesByKey.clear();
+	m_decodedAssets.clear();
+	m_orphanedModels.clear();
+}
+
+
+AssetHandle AssetManager::LoadShader(const std::string& path)
+{
+	std::string key = "shader:" + path;
+	AssetHandle handle = FindAsset(key);
+	if (handle != kInvalidAssetHandle)
+	{
+		return handle;
+	}
+
+	auto pAsset = std::make_unique<Asset>();
+	pAsset->type = AssetType::Shader;
+	pAsset->path = path;
+	pAsset->key = key;
+
+	handle = AddAsset(std::move(pAsset));
+	QueueDecode(handle);
+
+	return handle;
+}
+
+
+AssetHandle AssetManager::LoadModel(const std::string& path, const VertexLayout& layout)
+{
+	// Each layout has a cache file of its own, so the path to it tells the loads apart.
+	std::string key = "model:" + GetMeshCachePath(path, layout);
+	AssetHandle handle = FindAsset(key);
+	if (handle != kInvalidAssetHandle)
+	{
+		return handle;
+	}
+
+	auto pAsset = std::make_unique<Asset>();
+	pAsset->type = AssetType::Model;
+	pAsset->path = path;
+	pAsset->key = key;
+	pAsset->layout = layout;
+	pAsset->pModel = std::make_shared<Model>(m_pDeviceContext, layout);
+
+	handle = AddAsset(std::move(pAsset));
+	QueueDecode(handle);
+
+	return handle;
+}
+
+
+AssetHandle AssetManager::LoadTexture(const std::string& path, const TextureCookSettings& settings)
+{
+	std::string key = "texture:" + GetTextureCachePath(path, settings);
+	AssetHandle handle = FindAsset(key);
+	if (handle != kInvalidAssetHandle)
+	{
+		return handle;
+	}
+
+	auto pAsset = std::make_unique<Asset>();
+	pAsset->type = AssetType::Texture;
+	pAsset->path = path;
+	pAsset->key = key;
+	pAsset->textureSettings = settings;
+
+	handle = AddAsset(std::move(pAsset));
+	QueueDecode(handle);
+
+	return handle;
+}
+
+
+AssetHandle AssetManager::LoadMaterial(const MaterialDesc& desc)
+{
+	std::string key = "material:" + GetTextureCachePath(desc.baseColourPath, desc.baseColourSettings);
+	AssetHandle handle = FindAsset(key);
+	if (handle != kInvalidAssetHandle)
+	{
+		return handle;
+	}
+
+	// There's nothing to decode, only the textures to wait for.
+	auto pAsset = std::make_unique<Asset>();
+	pAsset->type = AssetType::Material;
+	pAsset->path = desc.baseColourPath;
+	pAsset->key = key;
+	pAsset->state = AssetState::Decoded;
+	pAsset->dependencies.push_back(LoadTexture(desc.baseColourPath, desc.baseColourSettings));
+
+	handle = AddAsset(std::move(pAsset));
+	m_decodedAssets.push_back(handle);
+
+	return handle;
+}
+
+
+void AssetManager::Release(AssetHandle handle)
+{
+	Asset& asset = GetAsset(handle);
+	if (asset.referenceCount == 0)
+	{
+		throw std::runtime_error("asset released more times than it was loaded");
+	}
+
+	if (--asset.referenceCount > 0)
+	{
+		return;
+	}
+
+	// A worker still has it. It is freed once it comes back, unless it is loaded again before then.
+	if (asset.state == AssetState::Decoding)
+	{
+		return;
+	}
+
+	if (asset.state == AssetState::Decoded)
+	{
+		m_decodedAssets.erase(std::find(m_decodedAssets.begin(), m_decodedAssets.end(), handle));
+	}
+
+	FreeAsset(handle);
+}
+
+
+uint32_t AssetManager::Update()
+{
+	// A released model is only retired once its buffers have finished uploading, then the frames in flight have a
+	// chance to finish with it.
+	for (size_t i = 0; i < m_orphanedModels.size();)
+	{
+		if (m_orphanedModels[i]->IsReady())
+		{
+			std::shared_ptr<Model> pModel = m_orphanedModels[i];
+			m_pDeviceContext->RetireResource([pModel]()
+				{
+					pModel->Destroy();
+				});
+
+			m_orphanedModels[i] = m_orphanedModels.back();
+			m_orphanedModels.pop_back();
+		}
+		else
+		{
+			++i;
+		}
+	}
+
+	DrainCompletions();
+
+	// In the order they were loaded, so a material's textures come before it.
+	auto startTime = std::chrono::high_resolution_clock::now();
+	VkDeviceSize uploadSize = 0;
+	uint32_t readyCount = 0;
+
+	std::vector<AssetHandle> waitingAssets;
+	for (AssetHandle handle : m_decodedAssets)
+	{
+		if ((readyCount > 0 && uploadSize >= m_uploadLimit) || !Create(handle, uploadSize))
+		{
+			waitingAssets.push_back(handle);
+		}
+		else if (GetAsset(handle).state == AssetState::Ready)
+		{
+			readyCount++;
+		}
+	}
+
+	m_decodedAssets = std::move(waitingAssets);
+
+	m_stats.createTime += std::chrono::high_resolution_clock::now() - startTime;
+	m_stats.uploadedSize += uploadSize;
+
+	m_stats.decodingCount = 0;
+	m_stats.decodedCount = 0;
+	m_stats.readyCount = 0;
+	m_stats.failedCount = 0;
+
+	for (const auto& pAsset : m_assets)
+	{
+		if (!pAsset || pAsset->referenceCount == 0)
+		{
+			continue;
+		}
+
+		switch (pAsset->state)
+		{
+			case AssetState::Decoding: m_stats.decodingCount++; break;
+			case AssetState::Decoded: m_stats.decodedCount++; break;
+			case AssetState::Ready: m_stats.readyCount++; break;
+			case AssetState::Failed: m_stats.failedCount++; break;
+		}
+	}
+
+	return readyCount;
+}
+
+
+void AssetManager::Wait(AssetHandle handle)
+{
+	while (true)
+	{
+		DrainCompletions();
+
+		Asset& asset = GetAsset(handle);
+		if (asset.state == AssetState::Ready || asset.state == AssetState::Failed)
+		{
+			return;
+		}
+
+		if (asset.state == AssetState::Decoded)
+		{
+			for (AssetHandle dependency : asset.dependencies)
+			{
+				Wait(dependency);
+			}
+
+			VkDeviceSize uploadSize = 0;
+			Create(handle, uploadSize);
+			m_stats.uploadedSize += uploadSize;
+
+			m_decodedAssets.erase(std::find(m_decodedAssets.begin(), m_decodedAssets.end(), handle));
+			continue;
+		}
+
+		// Still decoding. Rather than sit idle, take the next asset off the queue, which may well be this one.
+		std::unique_lock<std::mutex> lock(m_mutex);
+		if (!m_decodeQueue.empty())
+		{
+			auto job = m_decodeQueue.front();
+			m_decodeQueue.pop_front();
+			uint32_t threadCount = GetDecodeThreadCount(m_decodeQueue.empty());
+			lock.unlock();
+
+			Decode(*job.second, job.first, threadCount);
+		}
+		else
+		{
+			m_decodeDone.wait(lock, [this]() { return !m_completionQueue.empty(); });
+		}
+	}
+}
+
+
+void AssetManager::WaitAll()
+{
+	for (AssetHandle handle = 0; handle < m_assets.size(); ++handle)
+	{
+		if (m_assets[handle] && m_assets[handle]->referenceCount > 0)
+		{
+			Wait(handle);
+		}
+	}
+}
+
+
+AssetState AssetManager::GetState(AssetHandle handle) const
+{
+	return GetAsset(handle).state;
+}
+
+
+const std::string& AssetManager::GetError(AssetHandle handle) const
+{
+	return GetAsset(handle).error;
+}
+
+
+const std::vector<char>& AssetManager::GetShaderCode(AssetHandle handle) const
+{
+	return GetReadyAsset(handle, AssetType::Shader).shaderCode;
+}
+
+
+Model& AssetManager::GetModel(AssetHandle handle) const
+{
+	return *GetReadyAsset(handle, AssetType::Model).pModel;
+}
+
+
+StreamedTextureId AssetManager::GetTexture(AssetHandle handle) const
+{
+	return GetReadyAsset(handle, AssetType::Texture).texture;
+}
+
+
+const Material& AssetManager::GetMaterial(AssetHandle handle) const
+{
+	return GetReadyAsset(handle, AssetType::Material).material;
+}
+
+
+AssetHandle AssetManager::FindAsset(const std::string& key)
+{
+	auto it = m_handlesByKey.find(key);
+	if (it == m_handlesByKey.end())
+	{
+		return kInvalidAssetHandle;
+	}
+
+	// This may bring back an asset which was released while it was decoding.
+	m_assets[it->second]->referenceCount++;
+
+	return it->second;
+}
+
+
+AssetHandle AssetManager::AddAsset(std::unique_ptr<Asset> pAsset)
+{
+	AssetHandle handle;
+	if (!m_freeHandles.empty())
+	{
+		handle = m_freeHandles.back();
+		m_freeHandles.pop_back();
+	}
+	else
+	{
+		handle = static_cast<AssetHandle>(m_assets.size());
+		m_assets.emplace_back();
+	}
+
+	m_handlesByKey[pAsset->key] = handle;
+	m_assets[handle] = std::move(pAsset);
+	m_stats.loadCount++;
+
+	return handle;
+}
+
+
+void AssetManager::QueueDecode(AssetHandle handle)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_decodeQueue.emplace_back(handle, m_assets[handle].get());
+	}
+
+	m_decodeReady.notify_one();
+}
+
+
+void AssetManager::WorkerMain()
+{
+	while (true)
+	{
+		std::pair<AssetHandle, Asset*> job;
+		uint32_t threadCount;
+
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_decodeReady.wait(lock, [this]() { return m_isQuitting || !m_decodeQueue.empty(); });
+
+			if (m_isQuitting)
+			{
+				return;
+			}
+
+			job = m_decodeQueue.front();
+			m_decodeQueue.pop_front();
+			threadCount = GetDecodeThreadCount(m_decodeQueue.empty());
+		}
+
+		Decode(*job.second, job.first, threadCount);
+	}
+}
+
+
+void AssetManager::Decode(Asset& asset, AssetHandle handle, uint32_t threadCount)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	try
+	{
+		switch (asset.type)
+		{
+			case AssetType::Shader:
+				asset.shaderCode = Pipeline::ReadFile(asset.path);
+				break;
+
+			case AssetType::Model:
+				asset.pModel->Decode(asset.path, threadCount);
+				break;
+
+			case AssetType::Texture:
+				asset.decodedTexture = m_pTextureStreamer->DecodeTexture(asset.path, asset.textureSettings, threadCount);
+				break;
+
+			case AssetType::Material:
+				break;
+		}
+	}
+	catch (const std::exception& e)
+	{
+		asset.error = asset.path + ": " + e.what();
+	}
+
+	asset.decodeTime = std::chrono::high_resolution_clock::now() - startTime;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_completionQueue.push_back(handle);
+	}
+
+	m_decodeDone.notify_all();
+}
+
+
+void AssetManager::DrainCompletions()
+{
+	std::vector<AssetHandle> completed;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		completed.swap(m_completionQueue);
+	}
+
+	for (AssetHandle handle : completed)
+	{
+		Asset& asset = GetAsset(handle);
+		asset.state = asset.error.empty() ? AssetState::Decoded : AssetState::Failed;
+		m_stats.decodeTime += asset.decodeTime;
+
+		if (asset.referenceCount == 0)
+		{
+			FreeAsset(handle);
+		}
+		else if (asset.state == AssetState::Decoded)
+		{
+			m_decodedAssets.push_back(handle);
+		}
+	}
+}
+
+
+bool AssetManager::Create(AssetHandle handle, VkDeviceSize& uploadSize)
+{
+	Asset& asset = GetAsset(handle);
+
+	for (AssetHandle dependency : asset.dependencies)
+	{
+		const Asset& dependencyAsset = GetAsset(dependency);
+		if (dependencyAsset.state == AssetState::Failed)
+		{
+			asset.state = AssetState::Failed;
+			asset.error = asset.path + ": a dependency failed, " + dependencyAsset.error;
+			return true;
+		}
+
+		if (dependencyAsset.state != AssetState::Ready)
+		{
+			return false;
+		}
+	}
+
+	try
+	{
+		switch (asset.type)
+		{
+			case AssetType::Shader:
+				break;
+
+			case AssetType::Model:
+				asset.pModel->CreateBuffers();
+				uploadSize += asset.pModel->GetVertexBufferSize() + sizeof(uint32_t) * asset.pModel->m_indices.size();
+				break;
+
+			case AssetType::Texture:
+				asset.texture = m_pTextureStreamer->AddTexture(std::move(asset.decodedTexture));
+				asset.decodedTexture = {};
+				uploadSize += m_pTextureStreamer->GetResidencyStats(asset.texture).residentSize;
+				break;
+
+			case AssetType::Material:
+				asset.material.baseColour = GetAsset(asset.dependencies[0]).texture;
+				break;
+		}
+	}
+	catch (const std::exception& e)
+	{
+		asset.state = AssetState::Failed;
+		asset.error = asset.path + ": " + e.what();
+		return true;
+	}
+
+	asset.state = AssetState::Ready;
+	return true;
+}
+
+
+void AssetManager::FreeAsset(AssetHandle handle)
+{
+	std::unique_ptr<Asset> pAsset = std::move(m_assets[handle]);
+	m_handlesByKey.erase(pAsset->key);
+	m_freeHandles.push_back(handle);
+
+	// The streamer retires the texture's images itself, once they have finished uploading and the frames in flight
+	// are done with them.
+	if (pAsset->pModel)
+	{
+		m_orphanedModels.push_back(pAsset->pModel);
+	}
+
+	if (pAsset->texture != kInvalidStreamedTexture)
+	{
+		m_pTextureStreamer->ReleaseTexture(pAsset->texture);
+	}
+
+	for (AssetHandle dependency : pAsset->dependencies)
+	{
+		Release(dependency);
+	}
+}
+
+
+AssetManager::Asset& AssetManager::GetAsset(AssetHandle handle)
+{
+	if (handle >= m_assets.size() || !m_assets[handle])
+	{
+		throw std::runtime_error("unknown asset");
+	}
+
+	return *m_assets[handle];
+}
+
+
+const AssetManager::Asset& AssetManager::GetAsset(AssetHandle handle) const
+{
+	if (handle >= m_assets.size() || !m_assets[handle])
+	{
+		throw std::runtime_error("unknown asset");
+	}
+
+	return *m_assets[handle];
+}
+
+
+const AssetManager::Asset& AssetManager::GetReadyAsset(AssetHandle handle, AssetType type) const
+{
+	const Asset& asset = GetAsset(handle);
+	if (asset.type != type)
+	{
+		throw std::runtime_error("asset is of the wrong type");
+	}
+
+	if (asset.state == AssetState::Failed)
+	{
+		throw std::runtime_error(asset.error);
+	}
+
+	if (asset.state != AssetState::Ready)
+	{
+		throw std::runtime_error("asset is still loading");
+	}
+
+	return asset;
+}
+}
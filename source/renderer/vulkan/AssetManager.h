@@ -0,0 +1,283 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// STD.
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "DeviceContext.h"
+#include "TextureStreamer.h"
+#include "VertexLayout.h"
+
+
+namespace Jettison::Renderer
+{
+class Model;
+
+
+// Identifies an asset loaded through the asset manager. Loading the same asset again gives the same handle.
+using AssetHandle = uint32_t;
+
+constexpr AssetHandle kInvalidAssetHandle = UINT32_MAX;
+
+// Upper limit on loading threads, no matter how many cores there are.
+constexpr uint32_t kMaxAssetThreads = 16;
+
+// How much the assets which become ready in one update may upload, unless told otherwise. An asset which needs more
+// than this still goes ahead if it is the only one that update, so none can be starved.
+constexpr VkDeviceSize kDefaultAssetUploadLimit = 32 * 1024 * 1024;
+
+
+enum class AssetType : uint32_t
+{
+	// SPIR-V, read into memory. The pipelines create their own modules from it.
+	Shader,
+
+	// An OBJ file, through the mesh cache.
+	Model,
+
+	// An image file, through the texture cache, streamed by the texture streamer.
+	Texture,
+
+	// A set of textures, ready once they all are.
+	Material,
+};
+
+
+enum class AssetState : uint32_t
+{
+	// Waiting for a worker, or being read and decoded by one.
+	Decoding,
+
+	// Decoded, and waiting for its dependencies or for an update to create its device resources.
+	Decoded,
+
+	Ready,
+
+	// Its error is kept, and thrown by anything which asks for what it holds.
+	Failed,
+};
+
+
+// Everything a draw needs besides its mesh. The shaders only sample a base colour, so that's all there is for now.
+struct MaterialDesc
+{
+	std::string baseColourPath {};
+	TextureCookSettings baseColourSettings {};
+};
+
+
+struct Material
+{
+	StreamedTextureId baseColour {kInvalidStreamedTexture};
+};
+
+
+struct AssetStats
+{
+	// The assets loaded now, by state.
+	uint32_t decodingCount {0};
+	uint32_t decodedCount {0};
+	uint32_t readyCount {0};
+	uint32_t failedCount {0};
+
+	// Since the asset manager was initialised. The decode time is added up across every thread, so against the time
+	// it took to load a batch of assets it shows how well the decoding spread across the cores.
+	uint32_t loadCount {0};
+	std::chrono::duration<double, std::milli> decodeTime {0};
+
+	// Creating device resources for the decoded assets, on the thread which owns the device context.
+	std::chrono::duration<double, std::milli> createTime {0};
+	VkDeviceSize uploadedSize {0};
+};
+
+
+// Loads assets in the background, so the render loop keeps running while they arrive.
+//
+// Each load returns a handle straight away and queues the asset for a pool of workers, which read and decode it. That
+// is everything which doesn't touch the device: hashing, parsing, cooking and mapping caches. The decoded assets come
+// back through a completion queue, which the render loop drains once per frame, creating their device resources there.
+// An asset which depends on others, such as a material on its textures, waits until they are ready.
+//
+// Assets are shared. Loading one which is already loaded, with the same settings, adds a reference to it, and it is
+// released once every reference has been.
+//
+// Other than the workers, only to be used from the thread which owns the device context.
+class AssetManager
+{
+public:
+	// The texture streamer is owned by the pipeline, along with the asset manager, so it is held by a plain pointer.
+	AssetManager(std::shared_ptr<DeviceContext> pDeviceContext, TextureStreamer* pTextureStreamer)
+		:m_pDeviceContext {pDeviceContext}, m_pTextureStreamer {pTextureStreamer} {}
+
+	// Disable copying.
+	AssetManager() = default;
+	AssetManager(const AssetManager&) = delete;
+	AssetManager& operator=(const AssetManager&) = delete;
+
+	// Zero threads leaves one core for the render loop and uses the rest, but always at least one.
+	void Init(uint32_t threadCount = 0);
+
+	// Lets the workers finish what they are decoding, then destroys every asset. The device must be idle.
+	void Destroy();
+
+	// Queue an asset to load. A missing or broken file doesn't throw here, the asset fails instead.
+	AssetHandle LoadShader(const std::string& path);
+
+	AssetHandle LoadModel(const std::string& path, const VertexLayout& layout = {});
+
+	AssetHandle LoadTexture(const std::string& path, const TextureCookSettings& settings = {});
+
+	// Loads the material's textures too, and fails if any of them do.
+	AssetHandle LoadMaterial(const MaterialDesc& desc);
+
+	// Drop a reference. Once there are none, whatever the asset holds is released once the frames in flight are done
+	// with it, even if it is still loading.
+	void Release(AssetHandle asset);
+
+	// Called once per frame, before the frame's command buffers are recorded. Creates the device resources for the
+	// decoded assets, as far as the upload limit allows. Returns how many assets became ready.
+	uint32_t Update();
+
+	// Block until the asset is ready or has failed, creating its device resources, and its dependencies', whatever
+	// the upload limit. The calling thread decodes queued assets itself while it waits. Only for start up or tear
+	// down, never during a frame.
+	void Wait(AssetHandle asset);
+
+	// As above, for every asset loaded.
+	void WaitAll();
+
+	AssetState GetState(AssetHandle asset) const;
+
+	inline bool IsReady(AssetHandle asset) const { return GetState(asset) == AssetState::Ready; }
+
+	// Empty unless the asset failed.
+	const std::string& GetError(AssetHandle asset) const;
+
+	// These throw if the asset isn't ready, with its error if it failed.
+	const std::vector<char>& GetShaderCode(AssetHandle asset) const;
+
+	Model& GetModel(AssetHandle asset) const;
+
+	StreamedTextureId GetTexture(AssetHandle asset) const;
+
+	const Material& GetMaterial(AssetHandle asset) const;
+
+	void SetUploadLimit(VkDeviceSize uploadLimit) { m_uploadLimit = uploadLimit; }
+
+	inline VkDeviceSize GetUploadLimit() const { return m_uploadLimit; }
+
+	inline uint32_t GetThreadCount() const { return static_cast<uint32_t>(m_workers.size()); }
+
+	// As of the last update.
+	inline const AssetStats& GetStats() const { return m_stats; }
+
+private:
+	struct Asset
+	{
+		AssetType type {AssetType::Shader};
+		std::string path {};
+
+		// What it is found by, when it is loaded again. Includes the settings it was loaded with.
+		std::string key {};
+
+		uint32_t referenceCount {1};
+
+		// Only changed by the owning thread, as the asset comes back through the completion queue.
+		AssetState state {AssetState::Decoding};
+
+		// Must all be ready before this asset can be.
+		std::vector<AssetHandle> dependencies {};
+
+		VertexLayout layout {};
+		TextureCookSettings textureSettings {};
+
+		// Written by the worker which decodes the asset, and only read once it is back through the completion queue.
+		std::vector<char> shaderCode {};
+		std::shared_ptr<Model> pModel {nullptr};
+		DecodedTexture decodedTexture {};
+		std::string error {};
+		std::chrono::duration<double, std::milli> decodeTime {0};
+
+		// What the device resources turned out to be.
+		StreamedTextureId texture {kInvalidStreamedTexture};
+		Material material {};
+	};
+
+	// Find a loaded asset by its key, adding a reference to it.
+	AssetHandle FindAsset(const std::string& key);
+
+	AssetHandle AddAsset(std::unique_ptr<Asset> pAsset);
+
+	// Hand a new asset to the workers.
+	void QueueDecode(AssetHandle handle);
+
+	void WorkerMain();
+
+	// Read and decode an asset on the calling thread, catching its error, then put it on the completion queue. The
+	// thread count is for the decoding itself, for an asset large enough to split up.
+	void Decode(Asset& asset, AssetHandle handle, uint32_t threadCount);
+
+	// While other assets are queued, each is decoded on a single thread, since the other workers are busy. The last
+	// one may use every core.
+	static uint32_t GetDecodeThreadCount(bool isQueueEmpty) { return isQueueEmpty ? 0 : 1; }
+
+	// Move every asset on the completion queue to the decoded state, or discard it if it was released meanwhile.
+	void DrainCompletions();
+
+	// Create the device resources, if the dependencies are ready, adding what they upload to the size. Returns false
+	// if the asset has to keep waiting.
+	bool Create(AssetHandle handle, VkDeviceSize& uploadSize);
+
+	// Release what the asset holds, and its references to its dependencies.
+	void FreeAsset(AssetHandle handle);
+
+	Asset& GetAsset(AssetHandle handle);
+
+	const Asset& GetAsset(AssetHandle handle) const;
+
+	// Throws unless the asset is ready and of the type.
+	const Asset& GetReadyAsset(AssetHandle handle, AssetType type) const;
+
+	std::shared_ptr<DeviceContext> m_pDeviceContext {nullptr};
+
+	// Not owned.
+	TextureStreamer* m_pTextureStreamer {nullptr};
+
+	// Indexed by handle. Released assets leave a null behind, which is reused by the next load.
+	std::vector<std::unique_ptr<Asset>> m_assets {};
+	std::vector<AssetHandle> m_freeHandles {};
+	std::unordered_map<std::string, AssetHandle> m_handlesByKey {};
+
+	// Decoded, in the order they were loaded, waiting to be created. An asset released while it is being decoded is
+	// freed when it comes back.
+	std::vector<AssetHandle> m_decodedAssets {};
+
+	// Released models whose buffers may still be uploading.
+	std::vector<std::shared_ptr<Model>> m_orphanedModels {};
+
+	std::vector<std::thread> m_workers {};
+
+	// Guards the two queues and the quit flag. Everything else belongs to the owning thread, apart from the assets
+	// being decoded.
+	std::mutex m_mutex {};
+	std::condition_variable m_decodeReady {};
+	std::condition_variable m_decodeDone {};
+	std::deque<std::pair<AssetHandle, Asset*>> m_decodeQueue {};
+	std::vector<AssetHandle> m_completionQueue {};
+	bool m_isQuitting {false};
+
+	VkDeviceSize m_uploadLimit {kDefaultAssetUploadLimit};
+
+	AssetStats m_stats {};
+};
+}
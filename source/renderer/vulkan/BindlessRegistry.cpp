@@ -0,0 +1,213 @@
+#include "BindlessRegistry.h"
+
+#include "DeviceContext.h"
+
+// STD.
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+
+namespace Jettison::Renderer
+{
+// The bindings within the bindless set.
+constexpr uint32_t kTextureBinding = 0;
+constexpr uint32_t kBufferBinding = 1;
+
+
+void BindlessRegistry::Init()
+{
+	VkPhysicalDeviceVulkan12Properties vulkan12Properties {};
+	vulkan12Properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+
+	VkPhysicalDeviceProperties2 properties {};
+	properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	properties.pNext = &vulkan12Properties;
+	vkGetPhysicalDeviceProperties2(m_pDeviceContext->GetPhysicalDevice(), &properties);
+
+	m_textureCapacity = std::min({kMaxBindlessTextures,
+		vulkan12Properties.maxDescriptorSetUpdateAfterBindSampledImages,
+		vulkan12Properties.maxPerStageDescriptorUpdateAfterBindSampledImages});
+	m_bufferCapacity = std::min({kMaxBindlessBuffers,
+		vulkan12Properties.maxDescriptorSetUpdateAfterBindStorageBuffers,
+		vulkan12Properties.maxPerStageDescriptorUpdateAfterBindStorageBuffers});
+
+	m_textures = {m_textureCapacity, 0, {}};
+	m_buffers = {m_bufferCapacity, 0, {}};
+
+	std::array<VkDescriptorSetLayoutBinding, 2> bindings {};
+	bindings[0].binding = kTextureBinding;
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	bindings[0].descriptorCount = m_textureCapacity;
+	bindings[0].stageFlags = VK_SHADER_STAGE_ALL;
+
+	bindings[1].binding = kBufferBinding;
+	bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	bindings[1].descriptorCount = m_bufferCapacity;
+	bindings[1].stageFlags = VK_SHADER_STAGE_ALL;
+
+	// Most of the slots are empty at any one time, and slots are written while the set is in use.
+	VkDescriptorBindingFlags bindingFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT
+		| VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT
+		| VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+	std::array<VkDescriptorBindingFlags, 2> allBindingFlags = {bindingFlags, bindingFlags};
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo {};
+	bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+	bindingFlagsInfo.bindingCount = static_cast<uint32_t>(allBindingFlags.size());
+	bindingFlagsInfo.pBindingFlags = allBindingFlags.data();
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.pNext = &bindingFlagsInfo;
+	layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutInfo.pBindings = bindings.data();
+
+	if (vkCreateDescriptorSetLayout(m_pDeviceContext->GetLogicalDevice(), &layoutInfo, nullptr, &m_descriptorSetLayout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create bindless descriptor set layout");
+	}
+
+	std::array<VkDescriptorPoolSize, 2> poolSizes {};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSizes[0].descriptorCount = m_textureCapacity;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[1].descriptorCount = m_bufferCapacity;
+
+	VkDescriptorPoolCreateInfo poolInfo {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolInfo.pPoolSizes = poolSizes.data();
+	poolInfo.maxSets = 1;
+
+	if (vkCreateDescriptorPool(m_pDeviceContext->GetLogicalDevice(), &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create bindless descriptor pool");
+	}
+
+	VkDescriptorSetAllocateInfo allocInfo {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = m_descriptorPool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &m_descriptorSetLayout;
+
+	if (vkAllocateDescriptorSets(m_pDeviceContext->GetLogicalDevice(), &allocInfo, &m_descriptorSet) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to allocate bindless descriptor set");
+	}
+}
+
+
+void BindlessRegistry::Destroy()
+{
+	// The set is freed along with the pool.
+	vkDestroyDescriptorPool(m_pDeviceContext->GetLogicalDevice(), m_descriptorPool, nullptr);
+	m_descriptorPool = VK_NULL_HANDLE;
+	m_descriptorSet = VK_NULL_HANDLE;
+
+	vkDestroyDescriptorSetLayout(m_pDeviceContext->GetLogicalDevice(), m_descriptorSetLayout, nullptr);
+	m_descriptorSetLayout = VK_NULL_HANDLE;
+}
+
+
+BindlessHandle BindlessRegistry::RegisterTexture(VkImageView imageView, VkSampler sampler)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	BindlessHandle handle = AllocateHandle(m_textures);
+
+	VkDescriptorImageInfo imageInfo {};
+	imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	imageInfo.imageView = imageView;
+	imageInfo.sampler = sampler;
+
+	VkWriteDescriptorSet descriptorWrite {};
+	descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrite.dstSet = m_descriptorSet;
+	descriptorWrite.dstBinding = kTextureBinding;
+	descriptorWrite.dstArrayElement = handle;
+	descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	descriptorWrite.descriptorCount = 1;
+	descriptorWrite.pImageInfo = &imageInfo;
+
+	vkUpdateDescriptorSets(m_pDeviceContext->GetLogicalDevice(), 1, &descriptorWrite, 0, nullptr);
+
+	return handle;
+}
+
+
+BindlessHandle BindlessRegistry::RegisterBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	BindlessHandle handle = AllocateHandle(m_buffers);
+
+	VkDescriptorBufferInfo bufferInfo {};
+	bufferInfo.buffer = buffer;
+	bufferInfo.offset = offset;
+	bufferInfo.range = range;
+
+	VkWriteDescriptorSet descriptorWrite {};
+	descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrite.dstSet = m_descriptorSet;
+	descriptorWrite.dstBinding = kBufferBinding;
+	descriptorWrite.dstArrayElement = handle;
+	descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	descriptorWrite.descriptorCount = 1;
+	descriptorWrite.pBufferInfo = &bufferInfo;
+
+	vkUpdateDescriptorSets(m_pDeviceContext->GetLogicalDevice(), 1, &descriptorWrite, 0, nullptr);
+
+	return handle;
+}
+
+
+void BindlessRegistry::ReleaseTexture(BindlessHandle handle)
+{
+	ReleaseHandle(m_textures, handle);
+}
+
+
+void BindlessRegistry::ReleaseBuffer(BindlessHandle handle)
+{
+	ReleaseHandle(m_buffers, handle);
+}
+
+
+BindlessHandle BindlessRegistry::AllocateHandle(HandleTable& table)
+{
+	if (!table.freeHandles.empty())
+	{
+		BindlessHandle handle = table.freeHandles.back();
+		table.freeHandles.pop_back();
+
+		return handle;
+	}
+
+	if (table.nextHandle >= table.capacity)
+	{
+		throw std::runtime_error("bindless table is full");
+	}
+
+	return table.nextHandle++;
+}
+
+
+void BindlessRegistry::ReleaseHandle(HandleTable& table, BindlessHandle handle)
+{
+	if (handle == kInvalidBindlessHandle)
+	{
+		return;
+	}
+
+	// Command buffers still in flight may index the slot, so it can't be rewritten until they have finished. The
+	// descriptor is left as it is, since partially bound slots which aren't used don't need to be valid.
+	m_pDeviceContext->RetireResource([this, &table, handle]()
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			table.freeHandles.push_back(handle);
+		});
+}
+}
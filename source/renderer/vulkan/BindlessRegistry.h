@@ -0,0 +1,99 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// STD.
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+
+namespace Jettison::Renderer
+{
+class DeviceContext;
+
+
+// A stable index into one of the bindless tables, for shaders to look the resource up by.
+using BindlessHandle = uint32_t;
+
+constexpr BindlessHandle kInvalidBindlessHandle = UINT32_MAX;
+
+// Upper limits on the table sizes. Both are clamped to what the device supports.
+constexpr uint32_t kMaxBindlessTextures = 16384;
+constexpr uint32_t kMaxBindlessBuffers = 4096;
+
+// The set number the tables are bound to in every pipeline layout which uses them.
+constexpr uint32_t kBindlessSet = 1;
+
+
+// A single descriptor set holding every sampled texture and storage buffer, as two large arrays. It is bound once per
+// command buffer, and shaders index into it with the handles handed out here.
+//
+// The set is created with update after bind, so registering a resource is a single descriptor write, even while
+// command buffers which bind the set are pending. A released handle is only reused once the frames in flight are
+// done with it.
+//
+// Registering is safe from any thread. Releasing goes through the device context's retirement queue, so it is only
+// safe from the thread which owns the device context.
+class BindlessRegistry
+{
+public:
+	// The device context owns the registry, so it is held by a plain pointer.
+	BindlessRegistry(DeviceContext* pDeviceContext)
+		:m_pDeviceContext {pDeviceContext} {}
+
+	// Disable copying.
+	BindlessRegistry() = default;
+	BindlessRegistry(const BindlessRegistry&) = delete;
+	BindlessRegistry& operator=(const BindlessRegistry&) = delete;
+
+	void Init();
+
+	void Destroy();
+
+	// The image view must be in SHADER_READ_ONLY_OPTIMAL by the time a shader samples it.
+	BindlessHandle RegisterTexture(VkImageView imageView, VkSampler sampler);
+
+	BindlessHandle RegisterBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range);
+
+	// The handle stays reserved until the frames in flight are done with it. The resource itself can be destroyed as
+	// soon as nothing will draw with it again.
+	void ReleaseTexture(BindlessHandle handle);
+
+	void ReleaseBuffer(BindlessHandle handle);
+
+	inline VkDescriptorSetLayout GetDescriptorSetLayout() const { return m_descriptorSetLayout; }
+
+	inline VkDescriptorSet GetDescriptorSet() const { return m_descriptorSet; }
+
+	inline uint32_t GetTextureCapacity() const { return m_textureCapacity; }
+
+	inline uint32_t GetBufferCapacity() const { return m_bufferCapacity; }
+
+private:
+	// The handles for one of the tables.
+	struct HandleTable
+	{
+		uint32_t capacity {0};
+		uint32_t nextHandle {0};
+		std::vector<BindlessHandle> freeHandles {};
+	};
+
+	BindlessHandle AllocateHandle(HandleTable& table);
+
+	void ReleaseHandle(HandleTable& table, BindlessHandle handle);
+
+	DeviceContext* m_pDeviceContext {nullptr};
+
+	VkDescriptorSetLayout m_descriptorSetLayout {VK_NULL_HANDLE};
+	VkDescriptorPool m_descriptorPool {VK_NULL_HANDLE};
+	VkDescriptorSet m_descriptorSet {VK_NULL_HANDLE};
+
+	uint32_t m_textureCapacity {0};
+	uint32_t m_bufferCapacity {0};
+
+	std::mutex m_mutex {};
+	HandleTable m_textures {};
+	HandleTable m_buffers {};
+};
+}
@@ -0,0 +1,181 @@
+#include "CommandRecorder.h"
+
+// STD.
+#include <stdexcept>
+
+
+namespace Jettison::Renderer
+{
+void CommandRecorder::Init(uint32_t threadCount)
+{
+	if (threadCount == 0 || threadCount > kMaxRecordingThreads)
+	{
+		throw std::runtime_error("invalid recording thread count");
+	}
+
+	// The recorder may be re-initialised with a different thread count. The new workers start from job zero, so a
+	// job number left over from before would wake them with nothing to record.
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_isQuitting = false;
+		m_jobNumber = 0;
+		m_workersRemaining = 0;
+		m_pError = nullptr;
+	}
+
+	m_secondaryCommandBuffers.resize(threadCount);
+
+	for (uint32_t i = 1; i < threadCount; ++i)
+	{
+		m_workers.emplace_back(&CommandRecorder::WorkerMain, this, i);
+	}
+}
+
+
+void CommandRecorder::Destroy()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_isQuitting = true;
+	}
+
+	m_jobReady.notify_all();
+
+	for (auto& worker : m_workers)
+	{
+		worker.join();
+	}
+
+	m_workers.clear();
+	m_secondaryCommandBuffers.clear();
+}
+
+
+void CommandRecorder::Record(VkCommandBuffer primaryCommandBuffer, uint32_t imageIndex, const VkCommandBufferInheritanceInfo& inheritanceInfo,
+	uint32_t drawCount, const RecordFunction& record)
+{
+	uint32_t threadCount = GetThreadCount();
+
+	for (uint32_t i = 0; i < threadCount; ++i)
+	{
+		m_secondaryCommandBuffers[i] = m_pFrameContext->GetSecondaryCommandBuffer(i, imageIndex);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_pRecord = &record;
+		m_pInheritanceInfo = &inheritanceInfo;
+		m_imageIndex = imageIndex;
+		m_drawCount = drawCount;
+		m_pError = nullptr;
+		m_workersRemaining = static_cast<uint32_t>(m_workers.size());
+		++m_jobNumber;
+	}
+
+	m_jobReady.notify_all();
+
+	// Take the first slice ourselves rather than sitting idle.
+	try
+	{
+		RecordSlice(0);
+	}
+	catch (...)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (!m_pError)
+		{
+			m_pError = std::current_exception();
+		}
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_jobDone.wait(lock, [this]() { return m_workersRemaining == 0; });
+
+		m_pRecord = nullptr;
+		m_pInheritanceInfo = nullptr;
+	}
+
+	if (m_pError)
+	{
+		std::rethrow_exception(m_pError);
+	}
+
+	// Executing them in thread order keeps the draws in their original order.
+	vkCmdExecuteCommands(primaryCommandBuffer, threadCount, m_secondaryCommandBuffers.data());
+}
+
+
+void CommandRecorder::WorkerMain(uint32_t threadIndex)
+{
+	uint64_t lastJobNumber = 0;
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_jobReady.wait(lock, [&]() { return m_isQuitting || m_jobNumber != lastJobNumber; });
+
+			if (m_isQuitting)
+			{
+				return;
+			}
+
+			lastJobNumber = m_jobNumber;
+		}
+
+		std::exception_ptr pError;
+		try
+		{
+			RecordSlice(threadIndex);
+		}
+		catch (...)
+		{
+			pError = std::current_exception();
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (pError && !m_pError)
+			{
+				m_pError = pError;
+			}
+
+			--m_workersRemaining;
+		}
+
+		m_jobDone.notify_one();
+	}
+}
+
+
+void CommandRecorder::RecordSlice(uint32_t threadIndex)
+{
+	uint32_t threadCount = GetThreadCount();
+	uint32_t firstDraw = static_cast<uint32_t>(static_cast<uint64_t>(m_drawCount) * threadIndex / threadCount);
+	uint32_t lastDraw = static_cast<uint32_t>(static_cast<uint64_t>(m_drawCount) * (threadIndex + 1) / threadCount);
+
+	VkCommandBuffer commandBuffer = m_secondaryCommandBuffers[threadIndex];
+
+	// Every secondary is recorded, even an empty one, so the primary can always execute the full set.
+	VkCommandBufferBeginInfo beginInfo {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+	beginInfo.pInheritanceInfo = m_pInheritanceInfo;
+
+	if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to begin recording secondary command buffer");
+	}
+
+	if (lastDraw > firstDraw)
+	{
+		(*m_pRecord)(commandBuffer, firstDraw, lastDraw - firstDraw);
+	}
+
+	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to record secondary command buffer");
+	}
+}
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// STD.
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "FrameContext.h"
+
+
+namespace Jettison::Renderer
+{
+// Upper limit on recording threads, no matter how many cores there are.
+constexpr uint32_t kMaxRecordingThreads = 16;
+
+
+// Records a draw list in parallel. The draws are split into one contiguous slice per thread, each slice is recorded
+// into a secondary command buffer from that thread's pool in the current frame, and the secondaries are executed from
+// the primary command buffer in draw order.
+//
+// The calling thread records the first slice itself, so a single thread records inline with no worker involved.
+class CommandRecorder
+{
+public:
+	// Records the draws [firstDraw, firstDraw + drawCount) into the command buffer. Called from several threads at once.
+	using RecordFunction = std::function<void(VkCommandBuffer commandBuffer, uint32_t firstDraw, uint32_t drawCount)>;
+
+	CommandRecorder(std::shared_ptr<FrameContext> pFrameContext)
+		:m_pFrameContext {pFrameContext} {}
+
+	// Disable copying.
+	CommandRecorder() = default;
+	CommandRecorder(const CommandRecorder&) = delete;
+	CommandRecorder& operator=(const CommandRecorder&) = delete;
+
+	// The thread count must be no more than the frame context has command pools for.
+	void Init(uint32_t threadCount);
+
+	void Destroy();
+
+	// The primary command buffer must be inside a render pass begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS,
+	// and the inheritance info must describe that render pass and framebuffer.
+	void Record(VkCommandBuffer primaryCommandBuffer, uint32_t imageIndex, const VkCommandBufferInheritanceInfo& inheritanceInfo,
+		uint32_t drawCount, const RecordFunction& record);
+
+	inline uint32_t GetThreadCount() const { return static_cast<uint32_t>(m_workers.size()) + 1; }
+
+private:
+	void WorkerMain(uint32_t threadIndex);
+
+	// Record one thread's slice of the current job into its secondary command buffer.
+	void RecordSlice(uint32_t threadIndex);
+
+	std::shared_ptr<FrameContext> m_pFrameContext {nullptr};
+
+	// Thread zero is the caller, so there is one fewer worker than recording threads.
+	std::vector<std::thread> m_workers {};
+
+	std::mutex m_mutex {};
+	std::condition_variable m_jobReady {};
+	std::condition_variable m_jobDone {};
+
+	// Bumped for every job, so the workers can tell a new job from a spurious wake up.
+	uint64_t m_jobNumber {0};
+	uint32_t m_workersRemaining {0};
+	bool m_isQuitting {false};
+
+	// The current job. Only written while the workers are idle.
+	const RecordFunction* m_pRecord {nullptr};
+	const VkCommandBufferInheritanceInfo* m_pInheritanceInfo {nullptr};
+	uint32_t m_imageIndex {0};
+	uint32_t m_drawCount {0};
+	std::vector<VkCommandBuffer> m_secondaryCommandBuffers {};
+
+	// The first error thrown by a worker, rethrown on the calling thread.
+	std::exception_ptr m_pError {nullptr};
+};
+}
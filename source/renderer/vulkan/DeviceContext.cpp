@@ -16,6 +16,9 @@ const std::vector<const char*> deviceExtensions = {
 	VK_KHR_SWAPCHAIN_EXTENSION_NAME
 };
 
+// Kept next to the executable, so each build directory has its own cache.
+const char* kPipelineCachePath = "pipeline_cache.bin";
+
 const std::vector<const char*> validationLayers = {
 	"VK_LAYER_KHRONOS_validation"
 };
@@ -34,21 +37,54 @@ void DeviceContext::Init()
 {
 	// Device initialisation.
 	CreateInstance();
-	CreateSurface();
+	if (!IsHeadless())
+	{
+		CreateSurface();
+	}
 	PickPhysicalDevice();
 	CreateLogicalDevice();
 
+	// Device memory.
+	m_pMemoryAllocator = std::make_shared<MemoryAllocator>(m_physicalDevice, m_logicalDevice);
+	m_pMemoryAllocator->Init();
+
+	// Pipeline cache.
+	m_pPipelineCache = std::make_shared<PipelineCache>(m_physicalDevice, m_logicalDevice);
+	m_pPipelineCache->Init(kPipelineCachePath);
+
+	// Bindless textures and buffers, shared by every pipeline.
+	m_pBindlessRegistry = std::make_shared<BindlessRegistry>(this);
+	m_pBindlessRegistry->Init();
+
 	// Command pool.
 	// TODO: ILH: Not recreated when swapchain recreated?
 	CreateCommandPool();
+
+	// Uploads.
+	m_pUploadManager = std::make_shared<UploadManager>(this);
+	m_pUploadManager->Init();
 }
 
 
 void DeviceContext::Destroy()
 {
+	// The caller has already waited for the device, so anything retired is safe to destroy.
+	for (auto& retiredResource : m_retiredResources)
+	{
+		retiredResource.destroy();
+	}
+	m_retiredResources.clear();
+
+	m_pUploadManager->Destroy();
+	m_pBindlessRegistry->Destroy();
+	m_pPipelineCache->Destroy();
 	vkDestroyCommandPool(m_logicalDevice, m_commandPool, nullptr);
+	m_pMemoryAllocator->Destroy();
 	vkDestroyDevice(m_logicalDevice, nullptr);
-	vkDestroySurfaceKHR(m_instance, m_surface, nullptr);
+	if (m_surface != VK_NULL_HANDLE)
+	{
+		vkDestroySurfaceKHR(m_instance, m_surface, nullptr);
+	}
 	vkDestroyInstance(m_instance, nullptr);
 }
 
@@ -97,18 +133,21 @@ void DeviceContext::CreateInstance()
 	appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
 	appInfo.pEngineName = "Jettison";
 	appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-	appInfo.apiVersion = VK_API_VERSION_1_0;
+	// Descriptor indexing, for the bindless tables, is core from 1.2.
+	appInfo.apiVersion = VK_API_VERSION_1_2;
 
 	VkInstanceCreateInfo createInfo {};
 	createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
 	createInfo.pApplicationInfo = &appInfo;
 
+	// A headless instance doesn't need any of the surface extensions, or GLFW.
 	uint32_t glfwExtensionCount = 0;
-	const char** glfwExtensions;
-
-	glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+	const char** glfwExtensions = nullptr;
 
-	std::vector<const char*> glfwExtensionsVector(glfwExtensions, glfwExtensions + glfwExtensionCount);
+	if (!IsHeadless())
+	{
+		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+	}
 
 	createInfo.enabledExtensionCount = glfwExtensionCount;
 	createInfo.ppEnabledExtensionNames = glfwExtensions;
@@ -158,6 +197,17 @@ SwapChainSupportDetails DeviceContext::QuerySwapChainSupport(VkPhysicalDevice de
 }
 
 
+std::vector<const char*> DeviceContext::GetDeviceExtensions() const
+{
+	if (IsHeadless())
+	{
+		return {};
+	}
+
+	return deviceExtensions;
+}
+
+
 bool DeviceContext::CheckDeviceExtensionSupport(VkPhysicalDevice device)
 {
 	uint32_t extensionCount = 0;
@@ -166,7 +216,8 @@ bool DeviceContext::CheckDeviceExtensionSupport(VkPhysicalDevice device)
 	std::vector<VkExtensionProperties> availableExtensions(extensionCount);
 	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
 
-	std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
+	std::vector<const char*> extensions = GetDeviceExtensions();
+	std::set<std::string> requiredExtensions(extensions.begin(), extensions.end());
 
 	for (const auto& extension : availableExtensions)
 	{
@@ -187,29 +238,47 @@ QueueFamilyIndices DeviceContext::FindQueueFamilies(VkPhysicalDevice device)
 	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
 	vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
 
-	int i = 0;
+	uint32_t i = 0;
 	for (const auto& queueFamily : queueFamilies)
 	{
-		if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
+		if (!indices.graphicsFamily.has_value() && (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT))
 		{
 			indices.graphicsFamily = i;
 		}
 
+		// Nothing is presented when headless, so the graphics family stands in for the present family.
 		VkBool32 presentSupport = false;
-		vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_surface, &presentSupport);
-		if (presentSupport)
+		if (IsHeadless())
+		{
+			presentSupport = (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
+		}
+		else
+		{
+			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_surface, &presentSupport);
+		}
+
+		if (presentSupport && !indices.presentFamily.has_value())
 		{
 			indices.presentFamily = i;
 		}
 
-		if (indices.isComplete())
+		// Prefer a pure transfer family over one which can also do compute.
+		if ((queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT))
 		{
-			break;
+			if (!indices.transferFamily.has_value() || !(queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT))
+			{
+				indices.transferFamily = i;
+			}
 		}
 
 		++i;
 	}
 
+	if (!indices.transferFamily.has_value())
+	{
+		indices.transferFamily = indices.graphicsFamily;
+	}
+
 	return indices;
 }
 
@@ -220,8 +289,8 @@ bool DeviceContext::IsDeviceSuitable(VkPhysicalDevice device)
 
 	bool extensionsSupported = CheckDeviceExtensionSupport(device);
 
-	bool swapChainAdequate = false;
-	if (extensionsSupported)
+	bool swapChainAdequate = IsHeadless();
+	if (extensionsSupported && !IsHeadless())
 	{
 		SwapChainSupportDetails swapChainSupport = QuerySwapChainSupport(device);
 		swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
@@ -230,7 +299,54 @@ bool DeviceContext::IsDeviceSuitable(VkPhysicalDevice device)
 	VkPhysicalDeviceFeatures supportedFeatures;
 	vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
 
-	return indices.isComplete() && extensionsSupported && swapChainAdequate && supportedFeatures.samplerAnisotropy;
+	return indices.isComplete() && extensionsSupported && swapChainAdequate && supportedFeatures.samplerAnisotropy
+		&& CheckBindlessSupport(device);
+}
+
+
+VkPhysicalDeviceVulkan12Features DeviceContext::GetBindlessFeatures()
+{
+	// Update after bind lets textures be added while the record-once command buffers are still pending, as long as
+	// the slots being written aren't in use.
+	VkPhysicalDeviceVulkan12Features features {};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+	features.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+	features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+	features.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+	features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+	features.descriptorBindingPartiallyBound = VK_TRUE;
+	features.runtimeDescriptorArray = VK_TRUE;
+
+	return features;
+}
+
+
+bool DeviceContext::CheckBindlessSupport(VkPhysicalDevice device)
+{
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(device, &properties);
+
+	if (properties.apiVersion < VK_API_VERSION_1_2)
+	{
+		return false;
+	}
+
+	VkPhysicalDeviceVulkan12Features supported {};
+	supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+	VkPhysicalDeviceFeatures2 features {};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features.pNext = &supported;
+	vkGetPhysicalDeviceFeatures2(device, &features);
+
+	return supported.shaderSampledImageArrayNonUniformIndexing
+		&& supported.shaderStorageBufferArrayNonUniformIndexing
+		&& supported.descriptorBindingSampledImageUpdateAfterBind
+		&& supported.descriptorBindingStorageBufferUpdateAfterBind
+		&& supported.descriptorBindingUpdateUnusedWhilePending
+		&& supported.descriptorBindingPartiallyBound
+		&& supported.runtimeDescriptorArray;
 }
 
 
@@ -271,7 +387,8 @@ void DeviceContext::CreateLogicalDevice()
 	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
 	std::set<uint32_t> uniqueQueueFamilies = {
 		familyIndicies.graphicsFamily.value(),
-		familyIndicies.presentFamily.value()};
+		familyIndicies.presentFamily.value(),
+		familyIndicies.transferFamily.value()};
 
 	float queuePriority = 1.0f;
 	for (uint32_t queueFamily : uniqueQueueFamilies)
@@ -284,18 +401,39 @@ void DeviceContext::CreateLogicalDevice()
 		queueCreateInfos.push_back(queueCreateInfo);
 	}
 
+	VkPhysicalDeviceVulkan12Features supportedVulkan12Features {};
+	supportedVulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+	VkPhysicalDeviceFeatures2 supportedFeatures {};
+	supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	supportedFeatures.pNext = &supportedVulkan12Features;
+	vkGetPhysicalDeviceFeatures2(m_physicalDevice, &supportedFeatures);
+
+	m_capabilities.isMultiDrawIndirectSupported = supportedFeatures.features.multiDrawIndirect;
+	m_capabilities.isDrawIndirectCountSupported = supportedVulkan12Features.drawIndirectCount;
+	m_capabilities.isDrawIndirectFirstInstanceSupported = supportedFeatures.features.drawIndirectFirstInstance;
+	m_capabilities.isTextureCompressionBcSupported = supportedFeatures.features.textureCompressionBC;
+
 	VkPhysicalDeviceFeatures deviceFeatures {};
 	deviceFeatures.samplerAnisotropy = VK_TRUE;
+	deviceFeatures.multiDrawIndirect = supportedFeatures.features.multiDrawIndirect;
+	deviceFeatures.drawIndirectFirstInstance = supportedFeatures.features.drawIndirectFirstInstance;
+	deviceFeatures.textureCompressionBC = supportedFeatures.features.textureCompressionBC;
+
+	VkPhysicalDeviceVulkan12Features vulkan12Features = GetBindlessFeatures();
+	vulkan12Features.drawIndirectCount = supportedVulkan12Features.drawIndirectCount;
 
 	VkDeviceCreateInfo createInfo {};
 	createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+	createInfo.pNext = &vulkan12Features;
 	createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 	createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
 	createInfo.pEnabledFeatures = &deviceFeatures;
 
-	createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-	createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+	std::vector<const char*> extensions = GetDeviceExtensions();
+	createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+	createInfo.ppEnabledExtensionNames = extensions.data();
 
 	if (kEnableValidationLayers)
 	{
@@ -314,11 +452,17 @@ void DeviceContext::CreateLogicalDevice()
 
 	vkGetDeviceQueue(m_logicalDevice, familyIndicies.graphicsFamily.value(), 0, &m_graphicsQueue);
 	vkGetDeviceQueue(m_logicalDevice, familyIndicies.presentFamily.value(), 0, &m_presentQueue);
+	vkGetDeviceQueue(m_logicalDevice, familyIndicies.transferFamily.value(), 0, &m_transferQueue);
 }
 
 
 void DeviceContext::WaitOnWindowResized() const
 {
+	if (IsHeadless())
+	{
+		return;
+	}
+
 	int width = 0;
 	int height = 0;
 
@@ -328,29 +472,30 @@ void DeviceContext::WaitOnWindowResized() const
 		glfwGetFramebufferSize(m_pWindow->GetGLFWWindow(), &width, &height);
 		glfwWaitEvents();
 	}
+}
+
 
-	vkDeviceWaitIdle(m_logicalDevice);
+void DeviceContext::RetireResource(std::function<void()> destroy)
+{
+	m_retiredResources.push_back({m_frameCounter, std::move(destroy)});
 }
 
 
-uint32_t DeviceContext::FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
+void DeviceContext::CollectRetiredResources(uint32_t framesInFlight)
 {
-	VkPhysicalDeviceMemoryProperties memProperties;
-	vkGetPhysicalDeviceMemoryProperties(m_physicalDevice, &memProperties);
+	++m_frameCounter;
 
-	for (uint32_t i = 0; i < memProperties.memoryTypeCount; ++i)
+	// The fence for a frame covers everything submitted before it, so once every frame in flight has come round again
+	// nothing recorded before the resource was retired can still be running.
+	while (!m_retiredResources.empty() && m_frameCounter - m_retiredResources.front().retiredFrame > framesInFlight)
 	{
-		if (typeFilter & (1 << i) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
-		{
-			return i;
-		}
+		m_retiredResources.front().destroy();
+		m_retiredResources.pop_front();
 	}
-
-	throw std::runtime_error("failed to find suitable memory type");
 }
 
 
-void DeviceContext::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory)
+void DeviceContext::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, Allocation& bufferAllocation)
 {
 	VkBufferCreateInfo bufferInfo {};
 	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -366,17 +511,20 @@ void DeviceContext::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, Vk
 	VkMemoryRequirements memRequirements;
 	vkGetBufferMemoryRequirements(m_logicalDevice, buffer, &memRequirements);
 
-	VkMemoryAllocateInfo allocInfo {};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = FindMemoryType(memRequirements.memoryTypeBits, properties);
+	bufferAllocation = m_pMemoryAllocator->Allocate(memRequirements, properties, ResourceKind::Linear);
 
-	if (vkAllocateMemory(m_logicalDevice, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS)
+	if (vkBindBufferMemory(m_logicalDevice, buffer, bufferAllocation.memory, bufferAllocation.offset) != VK_SUCCESS)
 	{
-		throw std::runtime_error("failed to allocate buffer memory");
+		throw std::runtime_error("failed to bind buffer memory");
 	}
+}
+
 
-	vkBindBufferMemory(m_logicalDevice, buffer, bufferMemory, 0);
+void DeviceContext::DestroyBuffer(VkBuffer& buffer, Allocation& bufferAllocation)
+{
+	vkDestroyBuffer(m_logicalDevice, buffer, nullptr);
+	buffer = VK_NULL_HANDLE;
+	m_pMemoryAllocator->Free(bufferAllocation);
 }
 
 
@@ -435,10 +583,11 @@ VkSampleCountFlagBits DeviceContext::GetMaxUsableSampleCount()
 
 void DeviceContext::CreateImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples,
 	VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties,
-	VkImage& image, VkDeviceMemory& imageMemory)
+	VkImage& image, Allocation& imageAllocation, VkImageCreateFlags flags)
 {
 	VkImageCreateInfo imageInfo {};
 	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.flags = flags;
 	imageInfo.imageType = VK_IMAGE_TYPE_2D;
 	imageInfo.extent.width = width;
 	imageInfo.extent.height = height;
@@ -459,16 +608,21 @@ void DeviceContext::CreateImage(uint32_t width, uint32_t height, uint32_t mipLev
 	VkMemoryRequirements memRequirements;
 	vkGetImageMemoryRequirements(m_logicalDevice, image, &memRequirements);
 
-	VkMemoryAllocateInfo allocInfo {};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = FindMemoryType(memRequirements.memoryTypeBits, properties);
+	// Linear and optimal images must be kept apart to respect bufferImageGranularity.
+	ResourceKind kind = tiling == VK_IMAGE_TILING_OPTIMAL ? ResourceKind::Optimal : ResourceKind::Linear;
+	imageAllocation = m_pMemoryAllocator->Allocate(memRequirements, properties, kind);
 
-	if (vkAllocateMemory(m_logicalDevice, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-		throw std::runtime_error("failed to allocate image memory!");
+	if (vkBindImageMemory(m_logicalDevice, image, imageAllocation.memory, imageAllocation.offset) != VK_SUCCESS) {
+		throw std::runtime_error("failed to bind image memory!");
 	}
+}
 
-	vkBindImageMemory(m_logicalDevice, image, imageMemory, 0);
+
+void DeviceContext::DestroyImage(VkImage& image, Allocation& imageAllocation)
+{
+	vkDestroyImage(m_logicalDevice, image, nullptr);
+	image = VK_NULL_HANDLE;
+	m_pMemoryAllocator->Free(imageAllocation);
 }
 
 
@@ -541,8 +695,20 @@ void DeviceContext::EndSingleTimeCommands(VkCommandBuffer commandBuffer)
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &commandBuffer;
 
-	vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-	vkQueueWaitIdle(m_graphicsQueue);
+	// Wait on this submission alone, rather than idling the whole queue. Anything which can wait should go through
+	// the upload manager instead.
+	VkFenceCreateInfo fenceInfo {};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+	VkFence fence;
+	if (vkCreateFence(m_logicalDevice, &fenceInfo, nullptr, &fence) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create single time command fence");
+	}
+
+	vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, fence);
+	vkWaitForFences(m_logicalDevice, 1, &fence, VK_TRUE, UINT64_MAX);
+	vkDestroyFence(m_logicalDevice, fence, nullptr);
 
 	vkFreeCommandBuffers(m_logicalDevice, m_commandPool, 1, &commandBuffer);
 }
@@ -3,10 +3,16 @@
 #include <vulkan/vulkan.h>
 
 // STD.
+#include <deque>
+#include <functional>
 #include <memory>
 #include <optional>
 #include <vector>
 
+#include "BindlessRegistry.h"
+#include "MemoryAllocator.h"
+#include "PipelineCache.h"
+#include "UploadManager.h"
 #include "Window.h"
 
 
@@ -17,10 +23,36 @@ struct QueueFamilyIndices
 	std::optional<uint32_t> graphicsFamily;
 	std::optional<uint32_t> presentFamily;
 
+	// A family with transfer support but no graphics, which usually maps onto the DMA engines. Falls back to the
+	// graphics family when there isn't one.
+	std::optional<uint32_t> transferFamily;
+
 	bool isComplete()
 	{
 		return graphicsFamily.has_value() && presentFamily.has_value();
 	}
+
+	bool hasDedicatedTransfer() const
+	{
+		return transferFamily.has_value() && transferFamily != graphicsFamily;
+	}
+};
+
+
+// Optional features, enabled when the device has them.
+struct DeviceCapabilities
+{
+	// More than one draw per indirect call.
+	bool isMultiDrawIndirectSupported {false};
+
+	// The draw count comes from a buffer, so the GPU can decide how many draws there are.
+	bool isDrawIndirectCountSupported {false};
+
+	// Indirect draws may have a non-zero first instance, which is how they find their per draw data.
+	bool isDrawIndirectFirstInstanceSupported {false};
+
+	// The BC1 to BC7 block compressed formats can be sampled.
+	bool isTextureCompressionBcSupported {false};
 };
 
 
@@ -32,6 +64,7 @@ struct SwapChainSupportDetails
 };
 
 
+// Without a window the device is headless. There is no surface, and the swapchain renders into offscreen images.
 class DeviceContext
 {
 public:
@@ -49,9 +82,17 @@ public:
 
 	void WaitIdle() { vkDeviceWaitIdle(m_logicalDevice); }
 
-	// Wait for the device to return sensible values for the window size after a resize event.
+	// Wait for the window to have a usable size after a resize event, e.g. while it is minimised. This doesn't wait
+	// for the device, anything still in use should be retired instead.
 	void WaitOnWindowResized() const;
 
+	// Destroy a resource once the frames which might still be using it have completed, rather than waiting for the
+	// device to go idle.
+	void RetireResource(std::function<void()> destroy);
+
+	// Called once per frame, after waiting on the fence of the oldest frame in flight.
+	void CollectRetiredResources(uint32_t framesInFlight);
+
 	inline VkPhysicalDevice GetPhysicalDevice() const { return m_physicalDevice; }
 
 	inline VkDevice GetLogicalDevice() const { return m_logicalDevice; }
@@ -64,13 +105,33 @@ public:
 
 	inline VkQueue GetPresentQueue() const { return m_presentQueue; }
 
+	inline VkQueue GetTransferQueue() const { return m_transferQueue; }
+
 	inline std::shared_ptr<Window> GetWindow() const { return m_pWindow; }
 
+	inline bool IsHeadless() const { return m_pWindow == nullptr; }
+
+	inline MemoryAllocator& GetMemoryAllocator() { return *m_pMemoryAllocator; }
+
+	inline UploadManager& GetUploadManager() const { return *m_pUploadManager; }
+
+	inline PipelineCache& GetPipelineCache() const { return *m_pPipelineCache; }
+
+	inline BindlessRegistry& GetBindlessRegistry() const { return *m_pBindlessRegistry; }
+
+	inline const DeviceCapabilities& GetCapabilities() const { return m_capabilities; }
+
 	// Utilities.
 
 	VkFormat FindDepthFormat();
 
-	void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
+	bool HasStencilComponent(VkFormat format);
+
+	// Buffers and images are sub-allocated from the memory allocator's blocks, rather than each having their own
+	// device memory allocation.
+	void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, Allocation& bufferAllocation);
+
+	void DestroyBuffer(VkBuffer& buffer, Allocation& bufferAllocation);
 
 	void CopyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
 
@@ -82,9 +143,12 @@ public:
 
 	void TransitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels);
 
+	// The flags are for the likes of an sRGB image which is written through a UNORM view.
 	void CreateImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples,
 		VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties,
-		VkImage& image, VkDeviceMemory& imageMemory);
+		VkImage& image, Allocation& imageAllocation, VkImageCreateFlags flags = 0);
+
+	void DestroyImage(VkImage& image, Allocation& imageAllocation);
 
 	VkImageView CreateImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels);
 
@@ -105,17 +169,21 @@ private:
 
 	void CreateSurface();
 
+	// The swapchain extension is only needed when there is a window.
+	std::vector<const char*> GetDeviceExtensions() const;
+
 	bool CheckDeviceExtensionSupport(VkPhysicalDevice device);
 
 	bool IsDeviceSuitable(VkPhysicalDevice m_device);
 
-	void PickPhysicalDevice();
+	// The descriptor indexing features the bindless registry relies on.
+	static VkPhysicalDeviceVulkan12Features GetBindlessFeatures();
 
-	void CreateLogicalDevice();
+	bool CheckBindlessSupport(VkPhysicalDevice device);
 
-	uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+	void PickPhysicalDevice();
 
-	bool HasStencilComponent(VkFormat format);
+	void CreateLogicalDevice();
 
 	VkSampleCountFlagBits GetMaxUsableSampleCount();
 
@@ -131,10 +199,35 @@ private:
 
 	VkSampleCountFlagBits m_msaaSamples {VK_SAMPLE_COUNT_1_BIT};
 
+	DeviceCapabilities m_capabilities {};
+
 	VkQueue m_graphicsQueue {VK_NULL_HANDLE};
 	VkQueue m_presentQueue {VK_NULL_HANDLE};
+	VkQueue m_transferQueue {VK_NULL_HANDLE};
 	VkSurfaceKHR m_surface {VK_NULL_HANDLE};
 
 	VkCommandPool m_commandPool {VK_NULL_HANDLE};
+
+	// Device memory for buffers and images.
+	std::shared_ptr<MemoryAllocator> m_pMemoryAllocator {nullptr};
+
+	// Asynchronous copies into buffers and images.
+	std::shared_ptr<UploadManager> m_pUploadManager {nullptr};
+
+	// Shared by every pipeline, and persisted between runs.
+	std::shared_ptr<PipelineCache> m_pPipelineCache {nullptr};
+
+	// Every texture and storage buffer shaders can see, indexed by handle.
+	std::shared_ptr<BindlessRegistry> m_pBindlessRegistry {nullptr};
+
+	struct RetiredResource
+	{
+		uint64_t retiredFrame {0};
+		std::function<void()> destroy {};
+	};
+
+	// Resources waiting for the frames in flight to finish with them, oldest first.
+	std::deque<RetiredResource> m_retiredResources {};
+	uint64_t m_frameCounter {0};
 };
 }
@@ -0,0 +1,258 @@
+#include "FrameContext.h"
+
+// STD.
+#include <algorithm>
+#include <stdexcept>
+
+
+namespace Jettison::Renderer
+{
+void FrameContext::Init(uint32_t framesInFlight, uint32_t recordingThreadCount)
+{
+	m_recordingThreadCount = recordingThreadCount;
+	m_frames.resize(framesInFlight);
+
+	for (auto& frame : m_frames)
+	{
+		CreateFrame(frame);
+	}
+
+	m_currentFrame = 0;
+}
+
+
+void FrameContext::Destroy()
+{
+	for (auto& frame : m_frames)
+	{
+		DestroyFrame(frame);
+	}
+
+	m_frames.clear();
+}
+
+
+void FrameContext::CreateFrame(Frame& frame)
+{
+	QueueFamilyIndices queueFamilyIndices = m_pDeviceContext->FindQueueFamilies(m_pDeviceContext->GetPhysicalDevice());
+
+	// The command buffers are reset along with the pool, never individually.
+	VkCommandPoolCreateInfo poolInfo {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+	poolInfo.flags = 0;
+
+	if (vkCreateCommandPool(m_pDeviceContext->GetLogicalDevice(), &poolInfo, nullptr, &frame.commandPool) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create frame command pool");
+	}
+
+	frame.threadCommandPools.resize(m_recordingThreadCount);
+	frame.secondaryCommandBuffers.resize(m_recordingThreadCount);
+
+	for (auto& threadCommandPool : frame.threadCommandPools)
+	{
+		if (vkCreateCommandPool(m_pDeviceContext->GetLogicalDevice(), &poolInfo, nullptr, &threadCommandPool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create frame thread command pool");
+		}
+	}
+
+	VkSemaphoreCreateInfo semaphoreInfo {};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+	VkFenceCreateInfo fenceInfo {};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+	if (vkCreateSemaphore(m_pDeviceContext->GetLogicalDevice(), &semaphoreInfo, nullptr, &frame.imageAvailableSemaphore) != VK_SUCCESS
+		|| vkCreateSemaphore(m_pDeviceContext->GetLogicalDevice(), &semaphoreInfo, nullptr, &frame.renderFinishedSemaphore) != VK_SUCCESS
+		|| vkCreateFence(m_pDeviceContext->GetLogicalDevice(), &fenceInfo, nullptr, &frame.inFlightFence) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create frame synchronisation objects");
+	}
+
+	AllocateCommandBuffers(frame);
+}
+
+
+void FrameContext::DestroyFrame(Frame& frame)
+{
+	// Destroying the pool frees every command buffer allocated from it.
+	vkDestroyCommandPool(m_pDeviceContext->GetLogicalDevice(), frame.commandPool, nullptr);
+	frame.commandPool = VK_NULL_HANDLE;
+	frame.commandBuffers.clear();
+	frame.isRecorded.clear();
+
+	for (auto& threadCommandPool : frame.threadCommandPools)
+	{
+		vkDestroyCommandPool(m_pDeviceContext->GetLogicalDevice(), threadCommandPool, nullptr);
+	}
+	frame.threadCommandPools.clear();
+	frame.secondaryCommandBuffers.clear();
+
+	vkDestroySemaphore(m_pDeviceContext->GetLogicalDevice(), frame.renderFinishedSemaphore, nullptr);
+	frame.renderFinishedSemaphore = VK_NULL_HANDLE;
+	vkDestroySemaphore(m_pDeviceContext->GetLogicalDevice(), frame.imageAvailableSemaphore, nullptr);
+	frame.imageAvailableSemaphore = VK_NULL_HANDLE;
+	vkDestroyFence(m_pDeviceContext->GetLogicalDevice(), frame.inFlightFence, nullptr);
+	frame.inFlightFence = VK_NULL_HANDLE;
+}
+
+
+void FrameContext::AllocateCommandBuffers(Frame& frame)
+{
+	size_t existingCount = frame.commandBuffers.size();
+	size_t requiredCount = m_pSwapchain->GetImageCount();
+
+	if (requiredCount <= existingCount)
+	{
+		return;
+	}
+
+	frame.commandBuffers.resize(requiredCount);
+	frame.isRecorded.resize(requiredCount, false);
+
+	VkCommandBufferAllocateInfo allocInfo {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.commandPool = frame.commandPool;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandBufferCount = static_cast<uint32_t>(requiredCount - existingCount);
+
+	if (vkAllocateCommandBuffers(m_pDeviceContext->GetLogicalDevice(), &allocInfo, &frame.commandBuffers[existingCount]) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to allocate frame command buffers");
+	}
+
+	m_stats.commandBuffersAllocated += allocInfo.commandBufferCount;
+	m_stats.totalCommandBuffersAllocated += allocInfo.commandBufferCount;
+
+	// Every thread gets a secondary command buffer for each swapchain image. They're allocated here, on the main
+	// thread, so the workers never touch the pools other than to record.
+	for (uint32_t thread = 0; thread < m_recordingThreadCount; ++thread)
+	{
+		auto& secondaryCommandBuffers = frame.secondaryCommandBuffers[thread];
+		size_t existingSecondaryCount = secondaryCommandBuffers.size();
+		secondaryCommandBuffers.resize(requiredCount);
+
+		VkCommandBufferAllocateInfo secondaryAllocInfo {};
+		secondaryAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		secondaryAllocInfo.commandPool = frame.threadCommandPools[thread];
+		secondaryAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+		secondaryAllocInfo.commandBufferCount = static_cast<uint32_t>(requiredCount - existingSecondaryCount);
+
+		if (vkAllocateCommandBuffers(m_pDeviceContext->GetLogicalDevice(), &secondaryAllocInfo, &secondaryCommandBuffers[existingSecondaryCount]) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to allocate frame secondary command buffers");
+		}
+
+		m_stats.commandBuffersAllocated += secondaryAllocInfo.commandBufferCount;
+		m_stats.totalCommandBuffersAllocated += secondaryAllocInfo.commandBufferCount;
+	}
+}
+
+
+Frame& FrameContext::BeginFrame(uint64_t sceneVersion)
+{
+	Frame& frame = m_frames[m_currentFrame];
+
+	m_stats.frameNumber++;
+	m_stats.commandBuffersAllocated = 0;
+	m_stats.commandBuffersRecorded = 0;
+	m_stats.commandPoolResets = 0;
+	m_stats.recordTime = {};
+	m_stats.sceneUpdateTime = {};
+	m_stats.triangleCount = 0;
+
+	vkWaitForFences(m_pDeviceContext->GetLogicalDevice(), 1, &frame.inFlightFence, VK_TRUE, UINT64_MAX);
+	UpdateLatency();
+
+	// The fence has signalled, so any latency still pending for this frame was measured just now.
+	frame.inputTime = m_isInputSampled ? m_inputTime : std::chrono::high_resolution_clock::now();
+	m_isInputSampled = false;
+
+	// Nothing recorded from this pool is still executing now the fence has signalled, so it is safe to reset.
+	if (frame.sceneVersion != sceneVersion)
+	{
+		if (vkResetCommandPool(m_pDeviceContext->GetLogicalDevice(), frame.commandPool, 0) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to reset frame command pool");
+		}
+
+		for (auto threadCommandPool : frame.threadCommandPools)
+		{
+			if (vkResetCommandPool(m_pDeviceContext->GetLogicalDevice(), threadCommandPool, 0) != VK_SUCCESS)
+			{
+				throw std::runtime_error("failed to reset frame thread command pool");
+			}
+		}
+
+		std::fill(frame.isRecorded.begin(), frame.isRecorded.end(), false);
+		frame.sceneVersion = sceneVersion;
+		m_stats.commandPoolResets++;
+	}
+
+	AllocateCommandBuffers(frame);
+
+	return frame;
+}
+
+
+void FrameContext::EndFrame()
+{
+	m_currentFrame = (m_currentFrame + 1) % static_cast<uint32_t>(m_frames.size());
+}
+
+
+void FrameContext::WaitForPreviousFrame()
+{
+	uint32_t frameCount = static_cast<uint32_t>(m_frames.size());
+	Frame& previousFrame = m_frames[(m_currentFrame + frameCount - 1) % frameCount];
+
+	vkWaitForFences(m_pDeviceContext->GetLogicalDevice(), 1, &previousFrame.inFlightFence, VK_TRUE, UINT64_MAX);
+	UpdateLatency();
+}
+
+
+void FrameContext::MarkInputSampled()
+{
+	m_inputTime = std::chrono::high_resolution_clock::now();
+	m_isInputSampled = true;
+}
+
+
+void FrameContext::MarkSubmitted()
+{
+	m_frames[m_currentFrame].isLatencyPending = true;
+}
+
+
+void FrameContext::UpdateLatency()
+{
+	auto now = std::chrono::high_resolution_clock::now();
+
+	for (auto& frame : m_frames)
+	{
+		if (!frame.isLatencyPending || vkGetFenceStatus(m_pDeviceContext->GetLogicalDevice(), frame.inFlightFence) != VK_SUCCESS)
+		{
+			continue;
+		}
+
+		frame.isLatencyPending = false;
+
+		std::chrono::duration<double, std::milli> latency = now - frame.inputTime;
+		m_latencyStats.lastLatency = latency;
+		m_latencyStats.minLatency = m_latencyStats.sampleCount == 0 ? latency : std::min(m_latencyStats.minLatency, latency);
+		m_latencyStats.maxLatency = std::max(m_latencyStats.maxLatency, latency);
+		m_latencyStats.totalLatency += latency;
+		m_latencyStats.sampleCount++;
+	}
+}
+
+
+void FrameContext::MarkRecorded(uint32_t imageIndex)
+{
+	m_frames[m_currentFrame].isRecorded[imageIndex] = true;
+	m_stats.commandBuffersRecorded++;
+}
+}
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// STD.
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "DeviceContext.h"
+#include "LatencyMode.h"
+#include "Swapchain.h"
+
+
+namespace Jettison::Renderer
+{
+// Everything needed to have a single frame in flight.
+struct Frame
+{
+	// Every command buffer for this frame is allocated from this pool, so they can all be reset with a single call.
+	VkCommandPool commandPool {VK_NULL_HANDLE};
+
+	// One primary command buffer per swapchain image, since each of them targets a different framebuffer.
+	std::vector<VkCommandBuffer> commandBuffers {};
+
+	// Has the command buffer for a given swapchain image been recorded since the pool was last reset?
+	std::vector<bool> isRecorded {};
+
+	// One pool per recording thread, since a pool may only be used by one thread at a time.
+	std::vector<VkCommandPool> threadCommandPools {};
+
+	// Secondary command buffers, indexed by recording thread and then swapchain image.
+	std::vector<std::vector<VkCommandBuffer>> secondaryCommandBuffers {};
+
+	// The scene version the command buffers were recorded against.
+	uint64_t sceneVersion {0};
+
+	VkSemaphore imageAvailableSemaphore {VK_NULL_HANDLE};
+	VkSemaphore renderFinishedSemaphore {VK_NULL_HANDLE};
+	VkFence inFlightFence {VK_NULL_HANDLE};
+
+	// When the input for this frame was sampled, and whether its latency has still to be measured.
+	std::chrono::high_resolution_clock::time_point inputTime {};
+	bool isLatencyPending {false};
+};
+
+
+// Counters for the most recent frame. The allocation counter should stay at zero once the command buffers have been
+// created, no matter how long the application runs for.
+struct FrameStats
+{
+	uint64_t frameNumber {0};
+	uint32_t commandBuffersAllocated {0};
+	uint32_t commandBuffersRecorded {0};
+	uint32_t commandPoolResets {0};
+	uint64_t totalCommandBuffersAllocated {0};
+
+	// CPU time spent recording command buffers this frame.
+	std::chrono::duration<double, std::milli> recordTime {0};
+
+	// CPU time spent writing the indirect scene's draws this frame.
+	std::chrono::duration<double, std::milli> sceneUpdateTime {0};
+
+	// Triangles in the draw list this frame, after each instance's level of detail has been picked.
+	uint64_t triangleCount {0};
+};
+
+
+// Time from sampling input to the frame's fence signalling, at which point its image has been handed over for
+// presentation. There's no way to see the image actually reach the display without VK_KHR_present_wait, so this is a
+// lower bound whenever the presentation engine queues images, as FIFO does.
+//
+// Fences are polled once a frame, so unless the frame limiter is waiting on them the times are up to a frame late.
+struct LatencyStats
+{
+	std::chrono::duration<double, std::milli> lastLatency {0};
+	std::chrono::duration<double, std::milli> minLatency {0};
+	std::chrono::duration<double, std::milli> maxLatency {0};
+	std::chrono::duration<double, std::milli> totalLatency {0};
+	uint64_t sampleCount {0};
+};
+
+
+class FrameContext
+{
+public:
+	FrameContext(std::shared_ptr<DeviceContext> pDeviceContext, std::shared_ptr<Jettison::Renderer::Swapchain> pSwapchain)
+		:m_pDeviceContext {pDeviceContext}, m_pSwapchain {pSwapchain} {}
+
+	// Disable copying.
+	FrameContext() = default;
+	FrameContext(const FrameContext&) = delete;
+	FrameContext& operator=(const FrameContext&) = delete;
+
+	// Each frame gets a command pool for every thread which may record secondary command buffers.
+	void Init(uint32_t framesInFlight, uint32_t recordingThreadCount);
+
+	void Destroy();
+
+	// Wait for the current frame's fence. If the scene has changed since its command buffers were recorded the whole
+	// command pool is reset, and the command buffers will need to be recorded again.
+	Frame& BeginFrame(uint64_t sceneVersion);
+
+	// Move on to the next frame in flight.
+	void EndFrame();
+
+	// Block until the most recently submitted frame has finished on the GPU.
+	void WaitForPreviousFrame();
+
+	// Input for the next frame is being sampled now. Without this, the input is taken to be sampled in BeginFrame.
+	void MarkInputSampled();
+
+	// The current frame has been submitted, so its latency can be measured once its fence signals.
+	void MarkSubmitted();
+
+	void ResetLatencyStats() { m_latencyStats = {}; }
+
+	VkCommandBuffer GetCommandBuffer(uint32_t imageIndex) const { return m_frames[m_currentFrame].commandBuffers[imageIndex]; }
+
+	bool IsRecorded(uint32_t imageIndex) const { return m_frames[m_currentFrame].isRecorded[imageIndex]; }
+
+	VkCommandBuffer GetSecondaryCommandBuffer(uint32_t threadIndex, uint32_t imageIndex) const
+	{
+		return m_frames[m_currentFrame].secondaryCommandBuffers[threadIndex][imageIndex];
+	}
+
+	void MarkRecorded(uint32_t imageIndex);
+
+	// Only the renderer knows how long recording took.
+	void SetRecordTime(std::chrono::duration<double, std::milli> recordTime) { m_stats.recordTime = recordTime; }
+
+	void SetSceneUpdateTime(std::chrono::duration<double, std::milli> sceneUpdateTime) { m_stats.sceneUpdateTime = sceneUpdateTime; }
+
+	void SetTriangleCount(uint64_t triangleCount) { m_stats.triangleCount = triangleCount; }
+
+	inline Frame& GetCurrentFrame() { return m_frames[m_currentFrame]; }
+
+	inline uint32_t GetCurrentFrameIndex() const { return m_currentFrame; }
+
+	inline uint32_t GetFramesInFlight() const { return static_cast<uint32_t>(m_frames.size()); }
+
+	inline const FrameStats& GetStats() const { return m_stats; }
+
+	inline const LatencyStats& GetLatencyStats() const { return m_latencyStats; }
+
+private:
+	void CreateFrame(Frame& frame);
+
+	void DestroyFrame(Frame& frame);
+
+	// Ensure there is a command buffer for every swapchain image, which can change after the swapchain is recreated.
+	void AllocateCommandBuffers(Frame& frame);
+
+	// Measure the latency of every submitted frame whose fence has since signalled.
+	void UpdateLatency();
+
+	// Vulkan device context.
+	std::shared_ptr<DeviceContext> m_pDeviceContext {nullptr};
+
+	// Swapchain.
+	std::shared_ptr<Jettison::Renderer::Swapchain> m_pSwapchain {nullptr};
+
+	std::vector<Frame> m_frames {};
+
+	uint32_t m_recordingThreadCount {1};
+
+	uint32_t m_currentFrame {0};
+
+	FrameStats m_stats {};
+
+	LatencyStats m_latencyStats {};
+
+	std::chrono::high_resolution_clock::time_point m_inputTime {};
+	bool m_isInputSampled {false};
+};
+}
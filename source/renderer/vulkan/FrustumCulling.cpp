@@ -0,0 +1,383 @@
+#include "FrustumCulling.h"
+
+// STD.
+#include <cmath>
+#include <stdexcept>
+
+#include "FrustumCullingKernels.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#include <immintrin.h>
+#define JETTISON_CPUID_MSVC
+#elif defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#define JETTISON_CPUID_GCC
+#endif
+
+
+namespace Jettison::Renderer
+{
+// AVX2 needs the CPU to have it, and the OS to save the wider registers on a context switch.
+static bool IsAvx2Available()
+{
+#if defined(JETTISON_CPUID_MSVC)
+	int registers[4];
+	__cpuid(registers, 0);
+	if (registers[0] < 7)
+	{
+		return false;
+	}
+
+	__cpuid(registers, 1);
+	bool isOsSaving = (registers[2] & (1 << 27)) != 0;
+	bool isAvx = (registers[2] & (1 << 28)) != 0;
+	if (!isOsSaving || !isAvx || (_xgetbv(0) & 0x6) != 0x6)
+	{
+		return false;
+	}
+
+	__cpuidex(registers, 7, 0);
+	return (registers[1] & (1 << 5)) != 0;
+#elif defined(JETTISON_CPUID_GCC)
+	unsigned int eax, ebx, ecx, edx;
+	if (__get_cpuid_max(0, nullptr) < 7 || !__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+	{
+		return false;
+	}
+
+	bool isOsSaving = (ecx & (1u << 27)) != 0;
+	bool isAvx = (ecx & (1u << 28)) != 0;
+	if (!isOsSaving || !isAvx)
+	{
+		return false;
+	}
+
+	unsigned int xcr0Low, xcr0High;
+	__asm__("xgetbv" : "=a"(xcr0Low), "=d"(xcr0High) : "c"(0));
+	if ((xcr0Low & 0x6) != 0x6)
+	{
+		return false;
+	}
+
+	__cpuid_count(7, 0, eax, ebx, ecx, edx);
+	return (ebx & (1u << 5)) != 0;
+#else
+	return false;
+#endif
+}
+
+
+const char* GetCullingPathName(CullingPath path)
+{
+	switch (path)
+	{
+		case CullingPath::Scalar:
+			return "scalar";
+
+		case CullingPath::Sse:
+			return "sse";
+
+		case CullingPath::Avx2:
+			return "avx2";
+	}
+
+	return "unknown";
+}
+
+
+bool IsCullingPathSupported(CullingPath path)
+{
+	switch (path)
+	{
+		case CullingPath::Scalar:
+			return true;
+
+		case CullingPath::Sse:
+			// Always there on x86-64.
+			return IsSseCullingBuilt();
+
+		case CullingPath::Avx2:
+		{
+			static const bool isAvx2Available = IsAvx2Available();
+			return IsAvx2CullingBuilt() && isAvx2Available;
+		}
+	}
+
+	return false;
+}
+
+
+CullingPath GetFastestCullingPath()
+{
+	static const CullingPath fastestPath = IsCullingPathSupported(CullingPath::Avx2) ? CullingPath::Avx2
+		: IsCullingPathSupported(CullingPath::Sse) ? CullingPath::Sse : CullingPath::Scalar;
+
+	return fastestPath;
+}
+
+
+Frustum Frustum::FromViewProjection(const glm::mat4& viewProjection)
+{
+	// GLM is column major, so the rows of the matrix are the columns of its transpose.
+	glm::mat4 rows = glm::transpose(viewProjection);
+
+	Frustum frustum;
+	frustum.planes[0] = rows[3] + rows[0];
+	frustum.planes[1] = rows[3] - rows[0];
+	frustum.planes[2] = rows[3] + rows[1];
+	frustum.planes[3] = rows[3] - rows[1];
+	frustum.planes[4] = rows[2];
+	frustum.planes[5] = rows[3] - rows[2];
+
+	for (auto& plane : frustum.planes)
+	{
+		plane /= glm::length(glm::vec3(plane));
+	}
+
+	return frustum;
+}
+
+
+// Rounds up to whole registers, with the padding left at zero.
+static void ResizeBounds(std::vector<float>& component, uint32_t count)
+{
+	size_t paddedCount = ((static_cast<size_t>(count) + kCullingLaneCount - 1) / kCullingLaneCount) * kCullingLaneCount;
+	if (component.size() < paddedCount)
+	{
+		component.resize(paddedCount, 0.0f);
+	}
+}
+
+
+void SphereBounds::Reserve(uint32_t capacity)
+{
+	size_t paddedCapacity = ((static_cast<size_t>(capacity) + kCullingLaneCount - 1) / kCullingLaneCount) * kCullingLaneCount;
+	m_centreX.reserve(paddedCapacity);
+	m_centreY.reserve(paddedCapacity);
+	m_centreZ.reserve(paddedCapacity);
+	m_radius.reserve(paddedCapacity);
+}
+
+
+void SphereBounds::Clear()
+{
+	m_centreX.clear();
+	m_centreY.clear();
+	m_centreZ.clear();
+	m_radius.clear();
+	m_count = 0;
+}
+
+
+uint32_t SphereBounds::Add(const glm::vec4& sphere)
+{
+	uint32_t index = m_count++;
+
+	ResizeBounds(m_centreX, m_count);
+	ResizeBounds(m_centreY, m_count);
+	ResizeBounds(m_centreZ, m_count);
+	ResizeBounds(m_radius, m_count);
+
+	Set(index, sphere);
+
+	return index;
+}
+
+
+void SphereBounds::Set(uint32_t index, const glm::vec4& sphere)
+{
+	if (index >= m_count)
+	{
+		throw std::runtime_error("sphere bounds index out of range");
+	}
+
+	m_centreX[index] = sphere.x;
+	m_centreY[index] = sphere.y;
+	m_centreZ[index] = sphere.z;
+	m_radius[index] = sphere.w;
+}
+
+
+void BoxBounds::Reserve(uint32_t capacity)
+{
+	size_t paddedCapacity = ((static_cast<size_t>(capacity) + kCullingLaneCount - 1) / kCullingLaneCount) * kCullingLaneCount;
+	m_centreX.reserve(paddedCapacity);
+	m_centreY.reserve(paddedCapacity);
+	m_centreZ.reserve(paddedCapacity);
+	m_extentX.reserve(paddedCapacity);
+	m_extentY.reserve(paddedCapacity);
+	m_extentZ.reserve(paddedCapacity);
+}
+
+
+void BoxBounds::Clear()
+{
+	m_centreX.clear();
+	m_centreY.clear();
+	m_centreZ.clear();
+	m_extentX.clear();
+	m_extentY.clear();
+	m_extentZ.clear();
+	m_count = 0;
+}
+
+
+uint32_t BoxBounds::Add(const glm::vec3& minimum, const glm::vec3& maximum)
+{
+	uint32_t index = m_count++;
+
+	ResizeBounds(m_centreX, m_count);
+	ResizeBounds(m_centreY, m_count);
+	ResizeBounds(m_centreZ, m_count);
+	ResizeBounds(m_extentX, m_count);
+	ResizeBounds(m_extentY, m_count);
+	ResizeBounds(m_extentZ, m_count);
+
+	Set(index, minimum, maximum);
+
+	return index;
+}
+
+
+void BoxBounds::Set(uint32_t index, const glm::vec3& minimum, const glm::vec3& maximum)
+{
+	if (index >= m_count)
+	{
+		throw std::runtime_error("box bounds index out of range");
+	}
+
+	glm::vec3 centre = (minimum + maximum) * 0.5f;
+	glm::vec3 extent = (maximum - minimum) * 0.5f;
+
+	m_centreX[index] = centre.x;
+	m_centreY[index] = centre.y;
+	m_centreZ[index] = centre.z;
+	m_extentX[index] = extent.x;
+	m_extentY[index] = extent.y;
+	m_extentZ[index] = extent.z;
+}
+
+
+// The reference the SIMD paths are checked against. The sums are in the same order as theirs.
+static uint32_t CullSpheresScalar(const Frustum& frustum, const SphereBounds& bounds, uint32_t* pVisible)
+{
+	uint32_t visibleCount = 0;
+
+	for (uint32_t index = 0; index < bounds.GetCount(); ++index)
+	{
+		float centreX = bounds.GetCentreX()[index];
+		float centreY = bounds.GetCentreY()[index];
+		float centreZ = bounds.GetCentreZ()[index];
+		float radius = bounds.GetRadius()[index];
+
+		bool isOutside = false;
+		for (const auto& plane : frustum.planes)
+		{
+			float distance = plane.x * centreX + plane.y * centreY + plane.z * centreZ + plane.w + radius;
+			isOutside = isOutside || distance < 0.0f;
+		}
+
+		pVisible[visibleCount] = index;
+		visibleCount += isOutside ? 0 : 1;
+	}
+
+	return visibleCount;
+}
+
+
+static uint32_t CullBoxesScalar(const Frustum& frustum, const BoxBounds& bounds, uint32_t* pVisible)
+{
+	uint32_t visibleCount = 0;
+
+	for (uint32_t index = 0; index < bounds.GetCount(); ++index)
+	{
+		float centreX = bounds.GetCentreX()[index];
+		float centreY = bounds.GetCentreY()[index];
+		float centreZ = bounds.GetCentreZ()[index];
+		float extentX = bounds.GetExtentX()[index];
+		float extentY = bounds.GetExtentY()[index];
+		float extentZ = bounds.GetExtentZ()[index];
+
+		bool isOutside = false;
+		for (const auto& plane : frustum.planes)
+		{
+			float reach = std::abs(plane.x) * extentX + std::abs(plane.y) * extentY + std::abs(plane.z) * extentZ;
+			float distance = plane.x * centreX + plane.y * centreY + plane.z * centreZ + plane.w + reach;
+			isOutside = isOutside || distance < 0.0f;
+		}
+
+		pVisible[visibleCount] = index;
+		visibleCount += isOutside ? 0 : 1;
+	}
+
+	return visibleCount;
+}
+
+
+uint32_t CullSpheres(const Frustum& frustum, const SphereBounds& bounds, std::vector<uint32_t>& visible, CullingPath path)
+{
+	if (!IsCullingPathSupported(path))
+	{
+		throw std::runtime_error("culling path not supported");
+	}
+
+	// Every path writes each index, visible or not, then only moves on past the visible ones.
+	size_t firstVisible = visible.size();
+	visible.resize(firstVisible + bounds.GetCount() + kCullingLaneCount);
+	uint32_t* pVisible = visible.data() + firstVisible;
+
+	uint32_t visibleCount = 0;
+	switch (path)
+	{
+		case CullingPath::Scalar:
+			visibleCount = CullSpheresScalar(frustum, bounds, pVisible);
+			break;
+
+		case CullingPath::Sse:
+			visibleCount = CullSpheresSse(frustum, bounds, pVisible);
+			break;
+
+		case CullingPath::Avx2:
+			visibleCount = CullSpheresAvx2(frustum, bounds, pVisible);
+			break;
+	}
+
+	visible.resize(firstVisible + visibleCount);
+
+	return visibleCount;
+}
+
+
+uint32_t CullBoxes(const Frustum& frustum, const BoxBounds& bounds, std::vector<uint32_t>& visible, CullingPath path)
+{
+	if (!IsCullingPathSupported(path))
+	{
+		throw std::runtime_error("culling path not supported");
+	}
+
+	size_t firstVisible = visible.size();
+	visible.resize(firstVisible + bounds.GetCount() + kCullingLaneCount);
+	uint32_t* pVisible = visible.data() + firstVisible;
+
+	uint32_t visibleCount = 0;
+	switch (path)
+	{
+		case CullingPath::Scalar:
+			visibleCount = CullBoxesScalar(frustum, bounds, pVisible);
+			break;
+
+		case CullingPath::Sse:
+			visibleCount = CullBoxesSse(frustum, bounds, pVisible);
+			break;
+
+		case CullingPath::Avx2:
+			visibleCount = CullBoxesAvx2(frustum, bounds, pVisible);
+			break;
+	}
+
+	visible.resize(firstVisible + visibleCount);
+
+	return visibleCount;
+}
+}
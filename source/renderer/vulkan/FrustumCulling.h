@@ -0,0 +1,130 @@
+#pragma once
+
+// GL Math.
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#define GLM_ENABLE_EXPERIMENTAL
+#include <../glm/glm/glm.hpp>
+
+// STD.
+#include <array>
+#include <cstdint>
+#include <vector>
+
+
+namespace Jettison::Renderer
+{
+// The bounds are padded out to a multiple of the widest SIMD path, so every path can load whole registers.
+constexpr uint32_t kCullingLaneCount = 8;
+
+
+// How the bounds are tested. Every path gives the same answer as the scalar one, apart from objects so close to a
+// plane that rounding decides.
+enum class CullingPath
+{
+	Scalar,
+
+	// Four objects at a time.
+	Sse,
+
+	// Eight objects at a time.
+	Avx2,
+};
+
+
+const char* GetCullingPathName(CullingPath path);
+
+// Is the path built in, and does this CPU run it?
+bool IsCullingPathSupported(CullingPath path);
+
+// The widest supported path, picked once.
+CullingPath GetFastestCullingPath();
+
+
+// Six inward facing, normalised planes. A point p is inside a plane when dot(plane.xyz, p) + plane.w >= 0.
+struct Frustum
+{
+	// Left, right, bottom, top, near and far.
+	std::array<glm::vec4, 6> planes {};
+
+	// Gribb and Hartmann, for the zero to one depth range the renderer's projections use.
+	static Frustum FromViewProjection(const glm::mat4& viewProjection);
+};
+
+
+// Bounding spheres, in world space, stored as an array per component.
+class SphereBounds
+{
+public:
+	void Reserve(uint32_t capacity);
+
+	void Clear();
+
+	// Returns the sphere's index. The sphere is xyz centre and w radius.
+	uint32_t Add(const glm::vec4& sphere);
+
+	void Set(uint32_t index, const glm::vec4& sphere);
+
+	inline uint32_t GetCount() const { return m_count; }
+
+	// Each array holds at least the count rounded up to the lane count.
+	inline const float* GetCentreX() const { return m_centreX.data(); }
+	inline const float* GetCentreY() const { return m_centreY.data(); }
+	inline const float* GetCentreZ() const { return m_centreZ.data(); }
+	inline const float* GetRadius() const { return m_radius.data(); }
+
+private:
+	std::vector<float> m_centreX {};
+	std::vector<float> m_centreY {};
+	std::vector<float> m_centreZ {};
+	std::vector<float> m_radius {};
+
+	uint32_t m_count {0};
+};
+
+
+// Axis aligned bounding boxes, in world space, stored as a centre and half extent per component.
+class BoxBounds
+{
+public:
+	void Reserve(uint32_t capacity);
+
+	void Clear();
+
+	// Returns the box's index.
+	uint32_t Add(const glm::vec3& minimum, const glm::vec3& maximum);
+
+	void Set(uint32_t index, const glm::vec3& minimum, const glm::vec3& maximum);
+
+	inline uint32_t GetCount() const { return m_count; }
+
+	// Each array holds at least the count rounded up to the lane count.
+	inline const float* GetCentreX() const { return m_centreX.data(); }
+	inline const float* GetCentreY() const { return m_centreY.data(); }
+	inline const float* GetCentreZ() const { return m_centreZ.data(); }
+	inline const float* GetExtentX() const { return m_extentX.data(); }
+	inline const float* GetExtentY() const { return m_extentY.data(); }
+	inline const float* GetExtentZ() const { return m_extentZ.data(); }
+
+private:
+	std::vector<float> m_centreX {};
+	std::vector<float> m_centreY {};
+	std::vector<float> m_centreZ {};
+	std::vector<float> m_extentX {};
+	std::vector<float> m_extentY {};
+	std::vector<float> m_extentZ {};
+
+	uint32_t m_count {0};
+};
+
+
+// Append the index of every sphere at least partly inside the frustum to visible, in ascending order. Returns how
+// many were appended.
+uint32_t CullSpheres(const Frustum& frustum, const SphereBounds& bounds, std::vector<uint32_t>& visible,
+	CullingPath path = GetFastestCullingPath());
+
+// As CullSpheres, for boxes.
+uint32_t CullBoxes(const Frustum& frustum, const BoxBounds& bounds, std::vector<uint32_t>& visible,
+	CullingPath path = GetFastestCullingPath());
+}
@@ -0,0 +1,171 @@
+#include "FrustumCullingKernels.h"
+
+// STD.
+#include <cmath>
+
+// Only built with AVX2 enabled on x86, see the renderer's CMakeLists.
+#ifdef __AVX2__
+#define JETTISON_CULLING_AVX2
+#include <immintrin.h>
+#endif
+
+
+namespace Jettison::Renderer
+{
+#ifdef JETTISON_CULLING_AVX2
+constexpr uint32_t kAvx2LaneCount = 8;
+
+
+// The planes, one component per register, each component repeated across the lanes.
+struct Avx2Planes
+{
+	__m256 x[6];
+	__m256 y[6];
+	__m256 z[6];
+	__m256 w[6];
+
+	// For the boxes' extents.
+	__m256 absX[6];
+	__m256 absY[6];
+	__m256 absZ[6];
+};
+
+
+static Avx2Planes LoadPlanes(const Frustum& frustum)
+{
+	Avx2Planes planes;
+
+	for (size_t i = 0; i < frustum.planes.size(); ++i)
+	{
+		const glm::vec4& plane = frustum.planes[i];
+		planes.x[i] = _mm256_set1_ps(plane.x);
+		planes.y[i] = _mm256_set1_ps(plane.y);
+		planes.z[i] = _mm256_set1_ps(plane.z);
+		planes.w[i] = _mm256_set1_ps(plane.w);
+		planes.absX[i] = _mm256_set1_ps(std::abs(plane.x));
+		planes.absY[i] = _mm256_set1_ps(std::abs(plane.y));
+		planes.absZ[i] = _mm256_set1_ps(std::abs(plane.z));
+	}
+
+	return planes;
+}
+
+
+// Write out the lanes which are visible, without branching on each one.
+static inline uint32_t WriteVisible(int visibleMask, uint32_t first, uint32_t count, uint32_t* pVisible)
+{
+	// Lanes past the end are padding.
+	uint32_t remaining = count - first;
+	if (remaining < kAvx2LaneCount)
+	{
+		visibleMask &= (1 << remaining) - 1;
+	}
+
+	uint32_t visibleCount = 0;
+	for (uint32_t lane = 0; lane < kAvx2LaneCount; ++lane)
+	{
+		pVisible[visibleCount] = first + lane;
+		visibleCount += (visibleMask >> lane) & 1;
+	}
+
+	return visibleCount;
+}
+
+
+bool IsAvx2CullingBuilt()
+{
+	return true;
+}
+
+
+uint32_t CullSpheresAvx2(const Frustum& frustum, const SphereBounds& bounds, uint32_t* pVisible)
+{
+	Avx2Planes planes = LoadPlanes(frustum);
+	__m256 zero = _mm256_setzero_ps();
+
+	uint32_t count = bounds.GetCount();
+	uint32_t visibleCount = 0;
+
+	for (uint32_t first = 0; first < count; first += kAvx2LaneCount)
+	{
+		__m256 centreX = _mm256_loadu_ps(bounds.GetCentreX() + first);
+		__m256 centreY = _mm256_loadu_ps(bounds.GetCentreY() + first);
+		__m256 centreZ = _mm256_loadu_ps(bounds.GetCentreZ() + first);
+		__m256 radius = _mm256_loadu_ps(bounds.GetRadius() + first);
+
+		__m256 isOutside = zero;
+
+		// Summed in the same order as the scalar path, so they agree.
+		for (int i = 0; i < 6; ++i)
+		{
+			__m256 distance = _mm256_add_ps(_mm256_mul_ps(planes.x[i], centreX), _mm256_mul_ps(planes.y[i], centreY));
+			distance = _mm256_add_ps(distance, _mm256_mul_ps(planes.z[i], centreZ));
+			distance = _mm256_add_ps(_mm256_add_ps(distance, planes.w[i]), radius);
+			isOutside = _mm256_or_ps(isOutside, _mm256_cmp_ps(distance, zero, _CMP_LT_OQ));
+		}
+
+		visibleCount += WriteVisible(~_mm256_movemask_ps(isOutside) & 0xff, first, count, pVisible + visibleCount);
+	}
+
+	return visibleCount;
+}
+
+
+uint32_t CullBoxesAvx2(const Frustum& frustum, const BoxBounds& bounds, uint32_t* pVisible)
+{
+	Avx2Planes planes = LoadPlanes(frustum);
+	__m256 zero = _mm256_setzero_ps();
+
+	uint32_t count = bounds.GetCount();
+	uint32_t visibleCount = 0;
+
+	for (uint32_t first = 0; first < count; first += kAvx2LaneCount)
+	{
+		__m256 centreX = _mm256_loadu_ps(bounds.GetCentreX() + first);
+		__m256 centreY = _mm256_loadu_ps(bounds.GetCentreY() + first);
+		__m256 centreZ = _mm256_loadu_ps(bounds.GetCentreZ() + first);
+		__m256 extentX = _mm256_loadu_ps(bounds.GetExtentX() + first);
+		__m256 extentY = _mm256_loadu_ps(bounds.GetExtentY() + first);
+		__m256 extentZ = _mm256_loadu_ps(bounds.GetExtentZ() + first);
+
+		__m256 isOutside = zero;
+
+		// The box's reach towards each plane is its extent projected onto the plane's normal.
+		for (int i = 0; i < 6; ++i)
+		{
+			__m256 distance = _mm256_add_ps(_mm256_mul_ps(planes.x[i], centreX), _mm256_mul_ps(planes.y[i], centreY));
+			distance = _mm256_add_ps(distance, _mm256_mul_ps(planes.z[i], centreZ));
+
+			__m256 reach = _mm256_add_ps(_mm256_mul_ps(planes.absX[i], extentX), _mm256_mul_ps(planes.absY[i], extentY));
+			reach = _mm256_add_ps(reach, _mm256_mul_ps(planes.absZ[i], extentZ));
+
+			distance = _mm256_add_ps(_mm256_add_ps(distance, planes.w[i]), reach);
+			isOutside = _mm256_or_ps(isOutside, _mm256_cmp_ps(distance, zero, _CMP_LT_OQ));
+		}
+
+		visibleCount += WriteVisible(~_mm256_movemask_ps(isOutside) & 0xff, first, count, pVisible + visibleCount);
+	}
+
+	return visibleCount;
+}
+
+#else
+
+bool IsAvx2CullingBuilt()
+{
+	return false;
+}
+
+
+uint32_t CullSpheresAvx2(const Frustum&, const SphereBounds&, uint32_t*)
+{
+	return 0;
+}
+
+
+uint32_t CullBoxesAvx2(const Frustum&, const BoxBounds&, uint32_t*)
+{
+	return 0;
+}
+#endif
+}
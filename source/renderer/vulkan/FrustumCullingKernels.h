@@ -0,0 +1,24 @@
+#pragma once
+
+// STD.
+#include <cstdint>
+
+#include "FrustumCulling.h"
+
+
+// The SIMD kernels behind CullSpheres and CullBoxes. Each instruction set has its own translation unit, built with
+// whatever flags it needs, so nothing else is compiled for a CPU it might not run on.
+namespace Jettison::Renderer
+{
+// Was the kernel built in? Checking the CPU is up to the caller.
+bool IsSseCullingBuilt();
+bool IsAvx2CullingBuilt();
+
+// Write the index of each visible object to pVisible, which must have room for the count rounded up to the lane
+// count. Returns how many were visible.
+uint32_t CullSpheresSse(const Frustum& frustum, const SphereBounds& bounds, uint32_t* pVisible);
+uint32_t CullBoxesSse(const Frustum& frustum, const BoxBounds& bounds, uint32_t* pVisible);
+
+uint32_t CullSpheresAvx2(const Frustum& frustum, const SphereBounds& bounds, uint32_t* pVisible);
+uint32_t CullBoxesAvx2(const Frustum& frustum, const BoxBounds& bounds, uint32_t* pVisible);
+}
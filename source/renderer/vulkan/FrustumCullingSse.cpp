@@ -0,0 +1,170 @@
+#include "FrustumCullingKernels.h"
+
+// STD.
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define JETTISON_CULLING_SSE
+#include <emmintrin.h>
+#endif
+
+
+namespace Jettison::Renderer
+{
+#ifdef JETTISON_CULLING_SSE
+constexpr uint32_t kSseLaneCount = 4;
+
+
+// The planes, one component per register, each component repeated across the lanes.
+struct SsePlanes
+{
+	__m128 x[6];
+	__m128 y[6];
+	__m128 z[6];
+	__m128 w[6];
+
+	// For the boxes' extents.
+	__m128 absX[6];
+	__m128 absY[6];
+	__m128 absZ[6];
+};
+
+
+static SsePlanes LoadPlanes(const Frustum& frustum)
+{
+	SsePlanes planes;
+
+	for (size_t i = 0; i < frustum.planes.size(); ++i)
+	{
+		const glm::vec4& plane = frustum.planes[i];
+		planes.x[i] = _mm_set1_ps(plane.x);
+		planes.y[i] = _mm_set1_ps(plane.y);
+		planes.z[i] = _mm_set1_ps(plane.z);
+		planes.w[i] = _mm_set1_ps(plane.w);
+		planes.absX[i] = _mm_set1_ps(std::abs(plane.x));
+		planes.absY[i] = _mm_set1_ps(std::abs(plane.y));
+		planes.absZ[i] = _mm_set1_ps(std::abs(plane.z));
+	}
+
+	return planes;
+}
+
+
+// Write out the lanes which are visible, without branching on each one.
+static inline uint32_t WriteVisible(int visibleMask, uint32_t first, uint32_t count, uint32_t* pVisible)
+{
+	// Lanes past the end are padding.
+	uint32_t remaining = count - first;
+	if (remaining < kSseLaneCount)
+	{
+		visibleMask &= (1 << remaining) - 1;
+	}
+
+	uint32_t visibleCount = 0;
+	for (uint32_t lane = 0; lane < kSseLaneCount; ++lane)
+	{
+		pVisible[visibleCount] = first + lane;
+		visibleCount += (visibleMask >> lane) & 1;
+	}
+
+	return visibleCount;
+}
+
+
+bool IsSseCullingBuilt()
+{
+	return true;
+}
+
+
+uint32_t CullSpheresSse(const Frustum& frustum, const SphereBounds& bounds, uint32_t* pVisible)
+{
+	SsePlanes planes = LoadPlanes(frustum);
+	__m128 zero = _mm_setzero_ps();
+
+	uint32_t count = bounds.GetCount();
+	uint32_t visibleCount = 0;
+
+	for (uint32_t first = 0; first < count; first += kSseLaneCount)
+	{
+		__m128 centreX = _mm_loadu_ps(bounds.GetCentreX() + first);
+		__m128 centreY = _mm_loadu_ps(bounds.GetCentreY() + first);
+		__m128 centreZ = _mm_loadu_ps(bounds.GetCentreZ() + first);
+		__m128 radius = _mm_loadu_ps(bounds.GetRadius() + first);
+
+		__m128 isOutside = zero;
+
+		// Summed in the same order as the scalar path, so they agree.
+		for (int i = 0; i < 6; ++i)
+		{
+			__m128 distance = _mm_add_ps(_mm_mul_ps(planes.x[i], centreX), _mm_mul_ps(planes.y[i], centreY));
+			distance = _mm_add_ps(distance, _mm_mul_ps(planes.z[i], centreZ));
+			distance = _mm_add_ps(_mm_add_ps(distance, planes.w[i]), radius);
+			isOutside = _mm_or_ps(isOutside, _mm_cmplt_ps(distance, zero));
+		}
+
+		visibleCount += WriteVisible(~_mm_movemask_ps(isOutside) & 0xf, first, count, pVisible + visibleCount);
+	}
+
+	return visibleCount;
+}
+
+
+uint32_t CullBoxesSse(const Frustum& frustum, const BoxBounds& bounds, uint32_t* pVisible)
+{
+	SsePlanes planes = LoadPlanes(frustum);
+	__m128 zero = _mm_setzero_ps();
+
+	uint32_t count = bounds.GetCount();
+	uint32_t visibleCount = 0;
+
+	for (uint32_t first = 0; first < count; first += kSseLaneCount)
+	{
+		__m128 centreX = _mm_loadu_ps(bounds.GetCentreX() + first);
+		__m128 centreY = _mm_loadu_ps(bounds.GetCentreY() + first);
+		__m128 centreZ = _mm_loadu_ps(bounds.GetCentreZ() + first);
+		__m128 extentX = _mm_loadu_ps(bounds.GetExtentX() + first);
+		__m128 extentY = _mm_loadu_ps(bounds.GetExtentY() + first);
+		__m128 extentZ = _mm_loadu_ps(bounds.GetExtentZ() + first);
+
+		__m128 isOutside = zero;
+
+		// The box's reach towards each plane is its extent projected onto the plane's normal.
+		for (int i = 0; i < 6; ++i)
+		{
+			__m128 distance = _mm_add_ps(_mm_mul_ps(planes.x[i], centreX), _mm_mul_ps(planes.y[i], centreY));
+			distance = _mm_add_ps(distance, _mm_mul_ps(planes.z[i], centreZ));
+
+			__m128 reach = _mm_add_ps(_mm_mul_ps(planes.absX[i], extentX), _mm_mul_ps(planes.absY[i], extentY));
+			reach = _mm_add_ps(reach, _mm_mul_ps(planes.absZ[i], extentZ));
+
+			distance = _mm_add_ps(_mm_add_ps(distance, planes.w[i]), reach);
+			isOutside = _mm_or_ps(isOutside, _mm_cmplt_ps(distance, zero));
+		}
+
+		visibleCount += WriteVisible(~_mm_movemask_ps(isOutside) & 0xf, first, count, pVisible + visibleCount);
+	}
+
+	return visibleCount;
+}
+
+#else
+
+bool IsSseCullingBuilt()
+{
+	return false;
+}
+
+
+uint32_t CullSpheresSse(const Frustum&, const SphereBounds&, uint32_t*)
+{
+	return 0;
+}
+
+
+uint32_t CullBoxesSse(const Frustum&, const BoxBounds&, uint32_t*)
+{
+	return 0;
+}
+#endif
+}
@@ -0,0 +1,395 @@
+#include "GpuCuller.h"
+
+// STD.
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+
+namespace Jettison::Renderer
+{
+// Must match the workgroup size in cull.comp.
+constexpr uint32_t kCullGroupSize = 64;
+
+// The bindings of the culling pass's descriptor set, in the order cull.comp declares them.
+constexpr uint32_t kCullBindingCount = 8;
+
+
+void GpuCuller::Init()
+{
+	CreateDescriptorSetLayout();
+	CreatePipeline();
+
+	// Texels are fetched directly, so the sampler only needs to exist.
+	VkSamplerCreateInfo samplerInfo {};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_NEAREST;
+	samplerInfo.minFilter = VK_FILTER_NEAREST;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+	if (vkCreateSampler(m_pDeviceContext->GetLogicalDevice(), &samplerInfo, nullptr, &m_sampler) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create culling sampler");
+	}
+
+	for (auto& frame : m_frames)
+	{
+		m_pDeviceContext->CreateBuffer(sizeof(CullUniforms), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, frame.uniformBuffer, frame.uniformAllocation);
+		m_pDeviceContext->CreateBuffer(sizeof(CullStats), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, frame.statsBuffer, frame.statsAllocation);
+
+		memset(frame.statsAllocation.pMapped, 0, sizeof(CullStats));
+		frame.isPending = false;
+	}
+}
+
+
+void GpuCuller::Destroy()
+{
+	DestroyViewResources(m_pDeviceContext.get(), m_viewResources);
+	m_viewResources = {};
+
+	for (auto& frame : m_frames)
+	{
+		m_pDeviceContext->DestroyBuffer(frame.statsBuffer, frame.statsAllocation);
+		m_pDeviceContext->DestroyBuffer(frame.uniformBuffer, frame.uniformAllocation);
+	}
+
+	VkDevice device = m_pDeviceContext->GetLogicalDevice();
+	vkDestroySampler(device, m_sampler, nullptr);
+	m_sampler = VK_NULL_HANDLE;
+
+	vkDestroyPipeline(device, m_cullPipeline, nullptr);
+	m_cullPipeline = VK_NULL_HANDLE;
+	vkDestroyPipelineLayout(device, m_cullPipelineLayout, nullptr);
+	m_cullPipelineLayout = VK_NULL_HANDLE;
+	vkDestroyDescriptorSetLayout(device, m_cullDescriptorSetLayout, nullptr);
+	m_cullDescriptorSetLayout = VK_NULL_HANDLE;
+}
+
+
+void GpuCuller::SetScene(const IndirectScene* pScene)
+{
+	m_pScene = pScene;
+
+	// The descriptor sets point at the scene's buffers, so they wait for the next pyramid.
+	RetireViewResources();
+}
+
+
+RenderGraphImageDesc GpuCuller::GetPyramidDesc() const
+{
+	std::vector<VkExtent2D> levelExtents = GetPyramidLevelExtents();
+
+	RenderGraphImageDesc desc;
+	desc.format = VK_FORMAT_R32_SFLOAT;
+	desc.extent = levelExtents[0];
+	desc.mipLevels = static_cast<uint32_t>(levelExtents.size());
+
+	return desc;
+}
+
+
+void GpuCuller::SetPyramid(VkImage pyramidImage)
+{
+	RetireViewResources();
+
+	if (pyramidImage != VK_NULL_HANDLE)
+	{
+		CreateViewResources(pyramidImage);
+	}
+}
+
+
+void GpuCuller::CreateDescriptorSetLayout()
+{
+	VkDevice device = m_pDeviceContext->GetLogicalDevice();
+
+	// Uniforms, draw data, input commands, input count, output commands, output count, statistics and the pyramid.
+	std::array<VkDescriptorSetLayoutBinding, kCullBindingCount> cullBindings {};
+	for (uint32_t binding = 0; binding < kCullBindingCount; ++binding)
+	{
+		cullBindings[binding].binding = binding;
+		cullBindings[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		cullBindings[binding].descriptorCount = 1;
+		cullBindings[binding].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+	cullBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	cullBindings[kCullBindingCount - 1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+
+	VkDescriptorSetLayoutCreateInfo cullLayoutInfo {};
+	cullLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	cullLayoutInfo.bindingCount = static_cast<uint32_t>(cullBindings.size());
+	cullLayoutInfo.pBindings = cullBindings.data();
+
+	if (vkCreateDescriptorSetLayout(device, &cullLayoutInfo, nullptr, &m_cullDescriptorSetLayout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create culling descriptor set layout");
+	}
+}
+
+
+void GpuCuller::CreatePipeline()
+{
+	VkDevice device = m_pDeviceContext->GetLogicalDevice();
+
+	VkPipelineLayoutCreateInfo cullLayoutInfo {};
+	cullLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	cullLayoutInfo.setLayoutCount = 1;
+	cullLayoutInfo.pSetLayouts = &m_cullDescriptorSetLayout;
+
+	if (vkCreatePipelineLayout(device, &cullLayoutInfo, nullptr, &m_cullPipelineLayout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create culling pipeline layout");
+	}
+
+	m_cullPipeline = CreateComputePipeline("assets/shaders/cull.comp.spv", m_cullPipelineLayout);
+}
+
+
+VkPipeline GpuCuller::CreateComputePipeline(const std::string& shaderPath, VkPipelineLayout pipelineLayout)
+{
+	VkShaderModule shaderModule = m_pDeviceContext->CreateShaderModule(Pipeline::ReadFile(shaderPath));
+
+	VkComputePipelineCreateInfo pipelineInfo {};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = shaderModule;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = pipelineLayout;
+
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	m_pDeviceContext->GetPipelineCache().CreateComputePipeline(pipelineInfo, pipeline);
+
+	vkDestroyShaderModule(m_pDeviceContext->GetLogicalDevice(), shaderModule, nullptr);
+
+	return pipeline;
+}
+
+
+std::vector<VkExtent2D> GpuCuller::GetPyramidLevelExtents() const
+{
+	// The first level is half the size of the depth attachment, rounding up so every texel is covered, and so on
+	// down to a single texel.
+	VkExtent2D extent = m_pSwapchain->GetExtents();
+	VkExtent2D levelExtent {std::max(1u, (extent.width + 1) / 2), std::max(1u, (extent.height + 1) / 2)};
+	std::vector<VkExtent2D> levelExtents;
+
+	while (true)
+	{
+		levelExtents.push_back(levelExtent);
+
+		if (levelExtent.width == 1 && levelExtent.height == 1)
+		{
+			break;
+		}
+
+		levelExtent = {std::max(1u, (levelExtent.width + 1) / 2), std::max(1u, (levelExtent.height + 1) / 2)};
+	}
+
+	return levelExtents;
+}
+
+
+void GpuCuller::CreateViewResources(VkImage pyramidImage)
+{
+	VkDevice device = m_pDeviceContext->GetLogicalDevice();
+	ViewResources& resources = m_viewResources;
+
+	resources.hizLevelExtents = GetPyramidLevelExtents();
+	uint32_t levelCount = static_cast<uint32_t>(resources.hizLevelExtents.size());
+
+	resources.hizImageView = m_pDeviceContext->CreateImageView(pyramidImage, VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, levelCount);
+
+	// Without the depth attachment there's nothing to build the pyramid from.
+	if (m_pPipeline->IsDepthSampled())
+	{
+		resources.hizChain = m_pPipeline->GetMipGenerator().CreatePyramid(m_pPipeline->GetDepthImageView(),
+			VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, m_pDeviceContext->GetMsaaSamples(), m_pSwapchain->GetExtents(),
+			pyramidImage, resources.hizLevelExtents);
+	}
+
+	if (!m_pScene)
+	{
+		return;
+	}
+
+	// One set per frame in flight.
+	std::array<VkDescriptorPoolSize, 3> poolSizes {};
+	poolSizes[0] = {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, kMaxFramesInFlight};
+	poolSizes[1] = {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, kMaxFramesInFlight};
+	poolSizes[2] = {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, kMaxFramesInFlight * (kCullBindingCount - 2)};
+
+	VkDescriptorPoolCreateInfo poolInfo {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolInfo.pPoolSizes = poolSizes.data();
+	poolInfo.maxSets = kMaxFramesInFlight;
+
+	if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &resources.descriptorPool) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create culling descriptor pool");
+	}
+
+	std::array<VkDescriptorSetLayout, kMaxFramesInFlight> cullLayouts;
+	cullLayouts.fill(m_cullDescriptorSetLayout);
+
+	VkDescriptorSetAllocateInfo allocInfo {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = resources.descriptorPool;
+	allocInfo.descriptorSetCount = kMaxFramesInFlight;
+	allocInfo.pSetLayouts = cullLayouts.data();
+
+	if (vkAllocateDescriptorSets(device, &allocInfo, resources.cullDescriptorSets.data()) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to allocate culling descriptor sets");
+	}
+
+	for (uint32_t frameIndex = 0; frameIndex < kMaxFramesInFlight; ++frameIndex)
+	{
+		const IndirectFrameBuffers& sceneBuffers = m_pScene->GetFrameBuffers(frameIndex);
+
+		std::array<VkDescriptorBufferInfo, kCullBindingCount - 1> bufferInfos {};
+		bufferInfos[0] = {m_frames[frameIndex].uniformBuffer, 0, VK_WHOLE_SIZE};
+		bufferInfos[1] = {sceneBuffers.drawDataBuffer, 0, VK_WHOLE_SIZE};
+		bufferInfos[2] = {sceneBuffers.commandBuffer, 0, VK_WHOLE_SIZE};
+		bufferInfos[3] = {sceneBuffers.countBuffer, 0, VK_WHOLE_SIZE};
+		bufferInfos[4] = {sceneBuffers.culledCommandBuffer, 0, VK_WHOLE_SIZE};
+		bufferInfos[5] = {sceneBuffers.culledCountBuffer, 0, VK_WHOLE_SIZE};
+		bufferInfos[6] = {m_frames[frameIndex].statsBuffer, 0, VK_WHOLE_SIZE};
+
+		VkDescriptorImageInfo hizInfo {};
+		hizInfo.sampler = m_sampler;
+		hizInfo.imageView = resources.hizImageView;
+		hizInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		std::array<VkWriteDescriptorSet, kCullBindingCount> writes {};
+		for (uint32_t binding = 0; binding < kCullBindingCount; ++binding)
+		{
+			writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[binding].dstSet = resources.cullDescriptorSets[frameIndex];
+			writes[binding].dstBinding = binding;
+			writes[binding].descriptorCount = 1;
+
+			if (binding == kCullBindingCount - 1)
+			{
+				writes[binding].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+				writes[binding].pImageInfo = &hizInfo;
+			}
+			else
+			{
+				writes[binding].descriptorType = binding == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+				writes[binding].pBufferInfo = &bufferInfos[binding];
+			}
+		}
+
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+	}
+}
+
+
+void GpuCuller::RetireViewResources()
+{
+	DeviceContext* pDeviceContext = m_pDeviceContext.get();
+	ViewResources resources = m_viewResources;
+	m_viewResources = {};
+
+	m_pDeviceContext->RetireResource([pDeviceContext, resources]() mutable
+		{
+			DestroyViewResources(pDeviceContext, resources);
+		});
+}
+
+
+void GpuCuller::DestroyViewResources(DeviceContext* pDeviceContext, ViewResources& resources)
+{
+	VkDevice device = pDeviceContext->GetLogicalDevice();
+
+	// Destroying the pool frees its sets.
+	vkDestroyDescriptorPool(device, resources.descriptorPool, nullptr);
+
+	MipGenerator::DestroyChain(pDeviceContext, resources.hizChain);
+
+	// The pyramid itself belongs to the render graph.
+	vkDestroyImageView(device, resources.hizImageView, nullptr);
+}
+
+
+void GpuCuller::Update(uint32_t frameIndex, const glm::mat4& viewProjection)
+{
+	FrameResources& frame = m_frames[frameIndex];
+
+	if (frame.isPending)
+	{
+		memcpy(&m_stats, frame.statsAllocation.pMapped, sizeof(CullStats));
+		frame.isPending = false;
+	}
+
+	if (!m_pScene)
+	{
+		return;
+	}
+
+	CullUniforms uniforms {};
+	uniforms.viewProjection = viewProjection;
+
+	Frustum frustum = Frustum::FromViewProjection(viewProjection);
+	std::copy(frustum.planes.begin(), frustum.planes.end(), uniforms.frustumPlanes);
+
+	VkExtent2D extent = m_pSwapchain->GetExtents();
+	uniforms.depthSize = glm::vec2(static_cast<float>(extent.width), static_cast<float>(extent.height));
+	uniforms.hizLevelCount = static_cast<uint32_t>(m_viewResources.hizLevelExtents.size());
+	uniforms.capacity = m_pScene->GetCapacity();
+	uniforms.isOcclusionEnabled = IsOcclusionEnabled() ? 1 : 0;
+	uniforms.isCompacted = m_pScene->IsDrawCountSupported() ? 1 : 0;
+
+	memcpy(frame.uniformAllocation.pMapped, &uniforms, sizeof(CullUniforms));
+}
+
+
+void GpuCuller::RecordCulling(VkCommandBuffer commandBuffer, uint32_t frameIndex) const
+{
+	const IndirectFrameBuffers& sceneBuffers = m_pScene->GetFrameBuffers(frameIndex);
+
+	// Start the counters from zero. The render graph has already waited for the previous draws to read the count.
+	vkCmdFillBuffer(commandBuffer, sceneBuffers.culledCountBuffer, 0, sizeof(uint32_t), 0);
+	vkCmdFillBuffer(commandBuffer, m_frames[frameIndex].statsBuffer, 0, sizeof(CullStats), 0);
+
+	VkMemoryBarrier fillBarrier {};
+	fillBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	fillBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	fillBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+		1, &fillBarrier, 0, nullptr, 0, nullptr);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_cullPipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_cullPipelineLayout, 0, 1,
+		&m_viewResources.cullDescriptorSets[frameIndex], 0, nullptr);
+
+	// Every slot is dispatched, the shader reads the real count.
+	vkCmdDispatch(commandBuffer, (m_pScene->GetCapacity() + kCullGroupSize - 1) / kCullGroupSize, 1, 1);
+
+	// The host reads the statistics once the frame's fence signals. The render graph sees to the draws.
+	VkMemoryBarrier statsBarrier {};
+	statsBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	statsBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	statsBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+		1, &statsBarrier, 0, nullptr, 0, nullptr);
+}
+
+
+void GpuCuller::RecordBuildPyramid(VkCommandBuffer commandBuffer) const
+{
+	// The pyramid stays in the general layout while it is built, since each level is written and then read.
+	m_pPipeline->GetMipGenerator().RecordGenerate(commandBuffer, m_viewResources.hizChain);
+}
+}
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// STD.
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "DeviceContext.h"
+#include "FrustumCulling.h"
+#include "IndirectScene.h"
+#include "LatencyMode.h"
+#include "MipGenerator.h"
+#include "Pipeline.h"
+#include "RenderGraph.h"
+#include "Swapchain.h"
+
+
+namespace Jettison::Renderer
+{
+// What the culling pass did with one frame's objects.
+struct CullStats
+{
+	uint32_t tested {0};
+	uint32_t frustumCulled {0};
+	uint32_t occlusionCulled {0};
+	uint32_t drawn {0};
+};
+
+
+// Read by cull.comp. Laid out to match std140.
+struct CullUniforms
+{
+	glm::mat4 viewProjection;
+
+	// Inward facing, normalised, in world space.
+	glm::vec4 frustumPlanes[6];
+
+	// Size of the depth attachment the pyramid was built from.
+	glm::vec2 depthSize;
+
+	uint32_t hizLevelCount;
+	uint32_t capacity;
+	uint32_t isOcclusionEnabled;
+	uint32_t isCompacted;
+	uint32_t padding[2];
+};
+
+static_assert(sizeof(CullUniforms) == 192, "CullUniforms must match the std140 layout in cull.comp");
+
+
+// Culls an indirect scene on the GPU, before the scene pass. Each object's bounding sphere is tested against the
+// frustum, then against a hierarchical depth pyramid built from the previous frame's depth attachment. The survivors
+// are written out as a compacted list of indirect draws, with their count, for the scene to draw from.
+//
+// The pyramid is a transient image of the render graph, which runs the pyramid and culling passes, and puts the
+// barriers between them and the scene pass.
+//
+// Testing against last frame's depth means an object which has only just come into view can be missing for a frame
+// when the camera moves quickly. Without drawIndirectCount the draws can't be compacted, so culled draws are left in
+// place with no instances instead.
+class GpuCuller
+{
+public:
+	GpuCuller(std::shared_ptr<DeviceContext> pDeviceContext, std::shared_ptr<Jettison::Renderer::Swapchain> pSwapchain,
+		std::shared_ptr<Jettison::Renderer::Pipeline> pPipeline)
+		:m_pDeviceContext {pDeviceContext}, m_pSwapchain {pSwapchain}, m_pPipeline {pPipeline} {}
+
+	// Disable copying.
+	GpuCuller() = default;
+	GpuCuller(const GpuCuller&) = delete;
+	GpuCuller& operator=(const GpuCuller&) = delete;
+
+	void Init();
+
+	void Destroy();
+
+	// The scene to cull, which may be null. The render graph needs building again afterwards, to hand back a pyramid.
+	void SetScene(const IndirectScene* pScene);
+
+	// What the render graph should create the depth pyramid as, to match the swapchain.
+	RenderGraphImageDesc GetPyramidDesc() const;
+
+	// The pyramid the render graph created, each time it is compiled, or null if the graph isn't culling.
+	void SetPyramid(VkImage pyramidImage);
+
+	void SetOcclusionEnabled(bool isOcclusionEnabled) { m_isOcclusionEnabled = isOcclusionEnabled; }
+
+	// Is the depth pyramid being used, or just the frustum?
+	inline bool IsOcclusionEnabled() const { return m_isOcclusionEnabled && m_pPipeline->IsDepthSampled(); }
+
+	// Write the camera for a frame in flight, and collect its statistics from last time round. The frame's fence must
+	// have signalled.
+	void Update(uint32_t frameIndex, const glm::mat4& viewProjection);
+
+	// Record the depth pyramid pass, with the depth attachment readable and the pyramid in the general layout.
+	void RecordBuildPyramid(VkCommandBuffer commandBuffer) const;
+
+	// Record the culling pass, with the pyramid readable. Must be outside a render pass.
+	void RecordCulling(VkCommandBuffer commandBuffer, uint32_t frameIndex) const;
+
+	// The frame's culling pass has been submitted, so its statistics can be collected once its fence signals.
+	void MarkSubmitted(uint32_t frameIndex) { m_frames[frameIndex].isPending = true; }
+
+	// Statistics for the most recently completed frame, a few frames behind the CPU.
+	inline const CullStats& GetStats() const { return m_stats; }
+
+private:
+	struct FrameResources
+	{
+		VkBuffer uniformBuffer {VK_NULL_HANDLE};
+		Allocation uniformAllocation {};
+
+		// Counters written by the culling pass, read back once the frame completes.
+		VkBuffer statsBuffer {VK_NULL_HANDLE};
+		Allocation statsAllocation {};
+
+		bool isPending {false};
+	};
+
+	// Everything which depends on the pyramid or the scene. Replaced, rather than updated, since the command buffers
+	// of the frames in flight may still be using it.
+	struct ViewResources
+	{
+		// The whole pyramid, for culling.
+		VkImageView hizImageView {VK_NULL_HANDLE};
+		std::vector<VkExtent2D> hizLevelExtents {};
+
+		// Builds every level from the depth attachment, in a dispatch or two. Empty if the attachment can't be sampled.
+		MipChain hizChain {};
+
+		// Only created when there is a scene to cull.
+		VkDescriptorPool descriptorPool {VK_NULL_HANDLE};
+		std::array<VkDescriptorSet, kMaxFramesInFlight> cullDescriptorSets {};
+	};
+
+	void CreateDescriptorSetLayout();
+
+	void CreatePipeline();
+
+	VkPipeline CreateComputePipeline(const std::string& shaderPath, VkPipelineLayout pipelineLayout);
+
+	std::vector<VkExtent2D> GetPyramidLevelExtents() const;
+
+	void CreateViewResources(VkImage pyramidImage);
+
+	// Hand the view resources to the device context, to be destroyed once the frames in flight are done with them.
+	void RetireViewResources();
+
+	static void DestroyViewResources(DeviceContext* pDeviceContext, ViewResources& resources);
+
+	// Vulkan device context.
+	std::shared_ptr<DeviceContext> m_pDeviceContext {nullptr};
+
+	// Swapchain.
+	std::shared_ptr<Jettison::Renderer::Swapchain> m_pSwapchain {nullptr};
+
+	// Pipeline, for its depth attachment.
+	std::shared_ptr<Jettison::Renderer::Pipeline> m_pPipeline {nullptr};
+
+	// Not owned.
+	const IndirectScene* m_pScene {nullptr};
+
+	VkDescriptorSetLayout m_cullDescriptorSetLayout {VK_NULL_HANDLE};
+	VkPipelineLayout m_cullPipelineLayout {VK_NULL_HANDLE};
+	VkPipeline m_cullPipeline {VK_NULL_HANDLE};
+
+	VkSampler m_sampler {VK_NULL_HANDLE};
+
+	std::array<FrameResources, kMaxFramesInFlight> m_frames {};
+
+	ViewResources m_viewResources {};
+
+	bool m_isOcclusionEnabled {true};
+
+	CullStats m_stats {};
+};
+}
@@ -0,0 +1,182 @@
+#include "GpuProfiler.h"
+
+// STD.
+#include <algorithm>
+#include <stdexcept>
+
+
+namespace Jettison::Renderer
+{
+void GpuProfiler::Init(uint32_t framesInFlight)
+{
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(m_pDeviceContext->GetPhysicalDevice(), &properties);
+
+	QueueFamilyIndices indices = m_pDeviceContext->FindQueueFamilies(m_pDeviceContext->GetPhysicalDevice());
+
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(m_pDeviceContext->GetPhysicalDevice(), &queueFamilyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(m_pDeviceContext->GetPhysicalDevice(), &queueFamilyCount, queueFamilies.data());
+
+	uint32_t validBits = queueFamilies[indices.graphicsFamily.value()].timestampValidBits;
+
+	m_isSupported = validBits > 0 && properties.limits.timestampPeriod > 0.0f;
+	m_timestampPeriod = properties.limits.timestampPeriod;
+	m_timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+	if (!m_isSupported)
+	{
+		return;
+	}
+
+	VkQueryPoolCreateInfo queryPoolInfo {};
+	queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	queryPoolInfo.queryCount = kMaxGpuScopes * 2;
+
+	m_queryPools.resize(framesInFlight, VK_NULL_HANDLE);
+	m_isPending.assign(framesInFlight, false);
+
+	for (auto& queryPool : m_queryPools)
+	{
+		if (vkCreateQueryPool(m_pDeviceContext->GetLogicalDevice(), &queryPoolInfo, nullptr, &queryPool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create timestamp query pool");
+		}
+	}
+}
+
+
+void GpuProfiler::Destroy()
+{
+	for (auto queryPool : m_queryPools)
+	{
+		vkDestroyQueryPool(m_pDeviceContext->GetLogicalDevice(), queryPool, nullptr);
+	}
+
+	m_queryPools.clear();
+	m_isPending.clear();
+}
+
+
+GpuScopeId GpuProfiler::RegisterScope(const std::string& name)
+{
+	auto it = std::find_if(m_scopeStats.begin(), m_scopeStats.end(), [&](const GpuScopeStats& stats) { return stats.name == name; });
+	if (it != m_scopeStats.end())
+	{
+		return static_cast<GpuScopeId>(it - m_scopeStats.begin());
+	}
+
+	if (m_scopeStats.size() >= kMaxGpuScopes)
+	{
+		throw std::runtime_error("too many GPU profiler scopes");
+	}
+
+	GpuScopeStats stats;
+	stats.name = name;
+	m_scopeStats.push_back(stats);
+
+	return static_cast<GpuScopeId>(m_scopeStats.size() - 1);
+}
+
+
+void GpuProfiler::ResetQueries(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+{
+	if (m_isSupported)
+	{
+		vkCmdResetQueryPool(commandBuffer, m_queryPools[frameIndex], 0, kMaxGpuScopes * 2);
+	}
+}
+
+
+void GpuProfiler::BeginScope(VkCommandBuffer commandBuffer, uint32_t frameIndex, GpuScopeId scope)
+{
+	if (m_isSupported)
+	{
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_queryPools[frameIndex], scope * 2);
+	}
+}
+
+
+void GpuProfiler::EndScope(VkCommandBuffer commandBuffer, uint32_t frameIndex, GpuScopeId scope)
+{
+	if (m_isSupported)
+	{
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_queryPools[frameIndex], scope * 2 + 1);
+	}
+}
+
+
+void GpuProfiler::MarkSubmitted(uint32_t frameIndex)
+{
+	if (m_isSupported)
+	{
+		m_isPending[frameIndex] = true;
+	}
+}
+
+
+void GpuProfiler::CollectResults(uint32_t frameIndex)
+{
+	if (!m_isSupported || !m_isPending[frameIndex] || m_scopeStats.empty())
+	{
+		return;
+	}
+
+	m_isPending[frameIndex] = false;
+
+	// Each query comes back as its value followed by its availability. A scope which wasn't written by the last
+	// submission was still reset by it, so it reads as unavailable and is skipped.
+	uint32_t queryCount = static_cast<uint32_t>(m_scopeStats.size()) * 2;
+	std::array<uint64_t, kMaxGpuScopes * 4> results {};
+
+	// The fence has signalled, so this doesn't wait.
+	VkResult result = vkGetQueryPoolResults(m_pDeviceContext->GetLogicalDevice(), m_queryPools[frameIndex], 0, queryCount,
+		sizeof(uint64_t) * queryCount * 2, results.data(), sizeof(uint64_t) * 2,
+		VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+	if (result != VK_SUCCESS && result != VK_NOT_READY)
+	{
+		throw std::runtime_error("failed to read timestamp queries");
+	}
+
+	for (size_t i = 0; i < m_scopeStats.size(); ++i)
+	{
+		uint64_t begin = results[i * 4];
+		bool isBeginAvailable = results[i * 4 + 1] != 0;
+		uint64_t end = results[i * 4 + 2];
+		bool isEndAvailable = results[i * 4 + 3] != 0;
+
+		if (isBeginAvailable && isEndAvailable)
+		{
+			uint64_t ticks = (end - begin) & m_timestampMask;
+			AddSample(m_scopeStats[i], static_cast<float>(ticks * m_timestampPeriod / 1000000.0));
+		}
+	}
+}
+
+
+void GpuProfiler::AddSample(GpuScopeStats& stats, float time)
+{
+	stats.lastTime = time;
+	stats.history[stats.historyOffset] = time;
+	stats.historyOffset = (stats.historyOffset + 1) % kGpuScopeHistorySize;
+	stats.sampleCount = std::min(stats.sampleCount + 1, kGpuScopeHistorySize);
+
+	// The history is short, so it is cheaper to rescan it than to keep running totals in step.
+	stats.minTime = time;
+	stats.maxTime = time;
+	float total = 0.0f;
+
+	for (uint32_t i = 0; i < stats.sampleCount; ++i)
+	{
+		float sample = stats.history[i];
+		stats.minTime = std::min(stats.minTime, sample);
+		stats.maxTime = std::max(stats.maxTime, sample);
+		total += sample;
+	}
+
+	stats.avgTime = total / stats.sampleCount;
+}
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// STD.
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "DeviceContext.h"
+
+
+namespace Jettison::Renderer
+{
+// The most named scopes the profiler can track. Each takes two queries in every frame's pool.
+constexpr uint32_t kMaxGpuScopes = 32;
+
+// How many frames of timings each scope keeps, for the rolling statistics and the graph.
+constexpr uint32_t kGpuScopeHistorySize = 240;
+
+
+using GpuScopeId = uint32_t;
+
+
+// Rolling GPU timings for one named scope, in milliseconds.
+struct GpuScopeStats
+{
+	std::string name {};
+
+	float lastTime {0.0f};
+	float minTime {0.0f};
+	float avgTime {0.0f};
+	float maxTime {0.0f};
+
+	// A ring of the most recent timings. The oldest is at the history offset, which is the order ImGui::PlotLines
+	// wants them in.
+	std::array<float, kGpuScopeHistorySize> history {};
+	uint32_t historyOffset {0};
+	uint32_t sampleCount {0};
+};
+
+
+// Measures GPU time for named scopes with timestamp queries.
+//
+// Every frame in flight has its own query pool, and each scope has a fixed pair of queries in it. As the command
+// buffers are recorded once and then reused, the queries are reset at the start of every command buffer, so each
+// submission writes them afresh. The results are read after waiting on the frame's fence, the next time the frame
+// comes round, so reading them never stalls the CPU.
+//
+// Scopes may only be written from primary command buffers, on the thread which records them.
+class GpuProfiler
+{
+public:
+	GpuProfiler(std::shared_ptr<DeviceContext> pDeviceContext)
+		:m_pDeviceContext {pDeviceContext} {}
+
+	// Disable copying.
+	GpuProfiler() = default;
+	GpuProfiler(const GpuProfiler&) = delete;
+	GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+	void Init(uint32_t framesInFlight);
+
+	void Destroy();
+
+	// Look up a scope by name, adding it the first time it is seen.
+	GpuScopeId RegisterScope(const std::string& name);
+
+	// Reset every query for the frame. Must be recorded at the start of each command buffer, outside a render pass.
+	void ResetQueries(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+
+	void BeginScope(VkCommandBuffer commandBuffer, uint32_t frameIndex, GpuScopeId scope);
+
+	void EndScope(VkCommandBuffer commandBuffer, uint32_t frameIndex, GpuScopeId scope);
+
+	// The frame's command buffer has been submitted, so its results can be read once its fence signals.
+	void MarkSubmitted(uint32_t frameIndex);
+
+	// Read back whatever the frame wrote last time it was submitted. Call once the frame's fence has signalled.
+	void CollectResults(uint32_t frameIndex);
+
+	// Not every device can write timestamps on the graphics queue, in which case nothing is recorded.
+	inline bool IsSupported() const { return m_isSupported; }
+
+	inline const std::vector<GpuScopeStats>& GetScopeStats() const { return m_scopeStats; }
+
+private:
+	void AddSample(GpuScopeStats& stats, float time);
+
+	// Vulkan device context.
+	std::shared_ptr<DeviceContext> m_pDeviceContext {nullptr};
+
+	std::vector<VkQueryPool> m_queryPools {};
+
+	// Has the frame been submitted since its results were last collected?
+	std::vector<bool> m_isPending {};
+
+	std::vector<GpuScopeStats> m_scopeStats {};
+
+	// Nanoseconds per timestamp tick.
+	double m_timestampPeriod {1.0};
+
+	// Timestamps only have this many valid bits, so differences need to wrap at the same point.
+	uint64_t m_timestampMask {~0ull};
+
+	bool m_isSupported {false};
+};
+}
@@ -0,0 +1,163 @@
+#include "IndirectScene.h"
+
+// STD.
+#include <cstring>
+#include <stdexcept>
+
+
+namespace Jettison::Renderer
+{
+void IndirectScene::Init(uint32_t capacity)
+{
+	const DeviceCapabilities& capabilities = m_pDeviceContext->GetCapabilities();
+
+	// Every draw finds its data through gl_InstanceIndex, which needs a non-zero first instance.
+	if (!capabilities.isMultiDrawIndirectSupported || !capabilities.isDrawIndirectFirstInstanceSupported)
+	{
+		throw std::runtime_error("indirect scene needs multiDrawIndirect and drawIndirectFirstInstance");
+	}
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(m_pDeviceContext->GetPhysicalDevice(), &properties);
+
+	if (capacity == 0 || capacity > properties.limits.maxDrawIndirectCount)
+	{
+		throw std::runtime_error("indirect scene capacity exceeds maxDrawIndirectCount");
+	}
+
+	m_capacity = capacity;
+	m_isDrawCountSupported = capabilities.isDrawIndirectCountSupported;
+	m_objects.clear();
+	m_version = 1;
+
+	BindlessRegistry& bindlessRegistry = m_pDeviceContext->GetBindlessRegistry();
+
+	for (auto& frame : m_frames)
+	{
+		VkDeviceSize drawDataSize = static_cast<VkDeviceSize>(sizeof(DrawData)) * m_capacity;
+		VkDeviceSize commandSize = static_cast<VkDeviceSize>(sizeof(VkDrawIndexedIndirectCommand)) * m_capacity;
+
+		// Written by the CPU every time the scene changes, and read once per frame, so they stay in host memory.
+		m_pDeviceContext->CreateBuffer(drawDataSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, frame.drawDataBuffer, frame.drawDataAllocation);
+		m_pDeviceContext->CreateBuffer(commandSize, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, frame.commandBuffer, frame.commandAllocation);
+		m_pDeviceContext->CreateBuffer(sizeof(uint32_t), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, frame.countBuffer, frame.countAllocation);
+
+		// Only ever touched by the GPU.
+		m_pDeviceContext->CreateBuffer(commandSize, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, frame.culledCommandBuffer, frame.culledCommandAllocation);
+		m_pDeviceContext->CreateBuffer(sizeof(uint32_t), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, frame.culledCountBuffer, frame.culledCountAllocation);
+
+		// Start with no draws, in case a frame is drawn before the first update.
+		memset(frame.commandAllocation.pMapped, 0, static_cast<size_t>(commandSize));
+		memset(frame.countAllocation.pMapped, 0, sizeof(uint32_t));
+
+		frame.drawDataHandle = bindlessRegistry.RegisterBuffer(frame.drawDataBuffer, 0, drawDataSize);
+		frame.drawCount = 0;
+		frame.version = 0;
+	}
+}
+
+
+void IndirectScene::Destroy()
+{
+	BindlessRegistry& bindlessRegistry = m_pDeviceContext->GetBindlessRegistry();
+
+	for (auto& frame : m_frames)
+	{
+		if (frame.drawDataHandle != kInvalidBindlessHandle)
+		{
+			bindlessRegistry.ReleaseBuffer(frame.drawDataHandle);
+			frame.drawDataHandle = kInvalidBindlessHandle;
+		}
+
+		m_pDeviceContext->DestroyBuffer(frame.culledCountBuffer, frame.culledCountAllocation);
+		m_pDeviceContext->DestroyBuffer(frame.culledCommandBuffer, frame.culledCommandAllocation);
+		m_pDeviceContext->DestroyBuffer(frame.countBuffer, frame.countAllocation);
+		m_pDeviceContext->DestroyBuffer(frame.commandBuffer, frame.commandAllocation);
+		m_pDeviceContext->DestroyBuffer(frame.drawDataBuffer, frame.drawDataAllocation);
+	}
+
+	m_objects.clear();
+}
+
+
+void IndirectScene::SetObjects(const std::vector<SceneObject>& objects)
+{
+	if (objects.size() > m_capacity)
+	{
+		throw std::runtime_error("too many objects for the indirect scene");
+	}
+
+	m_objects = objects;
+	m_version++;
+}
+
+
+void IndirectScene::Update(uint32_t frameIndex, BindlessHandle defaultTexture)
+{
+	IndirectFrameBuffers& frame = m_frames[frameIndex];
+
+	if (frame.version == m_version)
+	{
+		return;
+	}
+
+	auto* pDrawData = static_cast<DrawData*>(frame.drawDataAllocation.pMapped);
+	auto* pCommands = static_cast<VkDrawIndexedIndirectCommand*>(frame.commandAllocation.pMapped);
+	uint32_t drawCount = static_cast<uint32_t>(m_objects.size());
+
+	for (uint32_t i = 0; i < drawCount; ++i)
+	{
+		const SceneObject& object = m_objects[i];
+		const MeshRange& range = m_pMeshPool->GetMeshRange(object.mesh);
+
+		DrawData drawData {};
+		drawData.model = object.transform;
+		drawData.boundingSphere = range.boundingSphere;
+		drawData.textureIndex = object.texture != kInvalidBindlessHandle ? object.texture : defaultTexture;
+		pDrawData[i] = drawData;
+
+		// The first instance is only there to carry the draw's index through to the shader.
+		VkDrawIndexedIndirectCommand command;
+		command.indexCount = range.indexCount;
+		command.instanceCount = 1;
+		command.firstIndex = range.firstIndex;
+		command.vertexOffset = range.vertexOffset;
+		command.firstInstance = i;
+		pCommands[i] = command;
+	}
+
+	// Without a count buffer every slot is drawn, so any left over from a larger scene must draw nothing.
+	for (uint32_t i = drawCount; i < frame.drawCount; ++i)
+	{
+		pCommands[i].instanceCount = 0;
+	}
+
+	memcpy(frame.countAllocation.pMapped, &drawCount, sizeof(uint32_t));
+
+	frame.drawCount = drawCount;
+	frame.version = m_version;
+}
+
+
+void IndirectScene::RecordDraws(VkCommandBuffer commandBuffer, uint32_t frameIndex) const
+{
+	const IndirectFrameBuffers& frame = m_frames[frameIndex];
+	VkBuffer drawCommandBuffer = m_isCulled ? frame.culledCommandBuffer : frame.commandBuffer;
+	VkBuffer drawCountBuffer = m_isCulled ? frame.culledCountBuffer : frame.countBuffer;
+
+	if (m_isDrawCountSupported)
+	{
+		vkCmdDrawIndexedIndirectCount(commandBuffer, drawCommandBuffer, 0, drawCountBuffer, 0, m_capacity,
+			sizeof(VkDrawIndexedIndirectCommand));
+	}
+	else
+	{
+		vkCmdDrawIndexedIndirect(commandBuffer, drawCommandBuffer, 0, m_capacity, sizeof(VkDrawIndexedIndirectCommand));
+	}
+}
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// STD.
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "BindlessRegistry.h"
+#include "LatencyMode.h"
+#include "MeshPool.h"
+
+
+namespace Jettison::Renderer
+{
+// An object drawn by the indirect path.
+struct SceneObject
+{
+	MeshHandle mesh {0};
+	glm::mat4 transform {1.0f};
+
+	// A handle from the bindless registry. When invalid, the pipeline's own texture is used.
+	BindlessHandle texture {kInvalidBindlessHandle};
+};
+
+
+// Per draw data read by the vertex shader, indexed by the draw's first instance. Laid out to match std430.
+struct DrawData
+{
+	glm::mat4 model;
+
+	// The mesh's bounds in its own space, for culling.
+	glm::vec4 boundingSphere;
+
+	uint32_t textureIndex;
+	uint32_t padding[3];
+};
+
+static_assert(sizeof(DrawData) == 96, "DrawData must match the std430 layout in indirect.vert and cull.comp");
+
+
+// The buffers behind one frame in flight of an indirect scene.
+struct IndirectFrameBuffers
+{
+	VkBuffer drawDataBuffer {VK_NULL_HANDLE};
+	Allocation drawDataAllocation {};
+	BindlessHandle drawDataHandle {kInvalidBindlessHandle};
+
+	VkBuffer commandBuffer {VK_NULL_HANDLE};
+	Allocation commandAllocation {};
+
+	VkBuffer countBuffer {VK_NULL_HANDLE};
+	Allocation countAllocation {};
+
+	// Written by the GPU culling pass, and drawn from instead when the scene is culled.
+	VkBuffer culledCommandBuffer {VK_NULL_HANDLE};
+	Allocation culledCommandAllocation {};
+
+	VkBuffer culledCountBuffer {VK_NULL_HANDLE};
+	Allocation culledCountAllocation {};
+
+	// How many draws were written last time, so any left over can be cleared.
+	uint32_t drawCount {0};
+
+	// The version of the objects last written to these buffers.
+	uint64_t version {0};
+};
+
+
+// A scene drawn with a single multi draw indirect call. The draw commands and per draw data live in host visible
+// buffers, one set per frame in flight, so the objects can change every frame without recording the command buffers
+// again. The CPU cost of recording doesn't depend on the number of objects at all.
+//
+// When the device supports drawIndirectCount the number of draws is read from a buffer. Otherwise every slot up to
+// the capacity is drawn, with the unused ones having an instance count of zero.
+class IndirectScene
+{
+public:
+	IndirectScene(std::shared_ptr<DeviceContext> pDeviceContext, const MeshPool* pMeshPool)
+		:m_pDeviceContext {pDeviceContext}, m_pMeshPool {pMeshPool} {}
+
+	// Disable copying.
+	IndirectScene() = default;
+	IndirectScene(const IndirectScene&) = delete;
+	IndirectScene& operator=(const IndirectScene&) = delete;
+
+	// The capacity is fixed, since it's baked into the recorded command buffers.
+	void Init(uint32_t capacity);
+
+	void Destroy();
+
+	// Replace every object in the scene. They're written out to each frame's buffers as that frame comes around.
+	void SetObjects(const std::vector<SceneObject>& objects);
+
+	// Write the objects into the buffers for a frame in flight, if they've changed since that frame last used them.
+	// The frame's fence must have signalled.
+	void Update(uint32_t frameIndex, BindlessHandle defaultTexture);
+
+	// Record the indirect draw for a frame in flight. The mesh pool's buffers and the pipeline must already be bound.
+	// When culled, the draws come from the culling pass's output rather than straight from the CPU.
+	void RecordDraws(VkCommandBuffer commandBuffer, uint32_t frameIndex) const;
+
+	// Draw from the culling pass's output. Changing this needs the command buffers recording again.
+	void SetCulled(bool isCulled) { m_isCulled = isCulled; }
+
+	inline bool IsCulled() const { return m_isCulled; }
+
+	inline const IndirectFrameBuffers& GetFrameBuffers(uint32_t frameIndex) const { return m_frames[frameIndex]; }
+
+	// The bindless buffer holding a frame's per draw data.
+	inline BindlessHandle GetDrawDataHandle(uint32_t frameIndex) const { return m_frames[frameIndex].drawDataHandle; }
+
+	inline const MeshPool& GetMeshPool() const { return *m_pMeshPool; }
+
+	inline uint32_t GetCapacity() const { return m_capacity; }
+
+	inline uint32_t GetObjectCount() const { return static_cast<uint32_t>(m_objects.size()); }
+
+	inline bool IsDrawCountSupported() const { return m_isDrawCountSupported; }
+
+private:
+	// Vulkan device context.
+	std::shared_ptr<DeviceContext> m_pDeviceContext {nullptr};
+
+	// Not owned.
+	const MeshPool* m_pMeshPool {nullptr};
+
+	std::array<IndirectFrameBuffers, kMaxFramesInFlight> m_frames {};
+
+	std::vector<SceneObject> m_objects {};
+
+	// Starts ahead of the buffers, so each is written once before it's first used.
+	uint64_t m_version {1};
+
+	uint32_t m_capacity {0};
+
+	bool m_isDrawCountSupported {false};
+
+	bool m_isCulled {false};
+};
+}
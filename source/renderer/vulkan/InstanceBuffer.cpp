@@ -0,0 +1,196 @@
+#include "InstanceBuffer.h"
+
+// STD.
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+
+namespace Jettison::Renderer
+{
+uint32_t LodSelector::SelectLod(const std::vector<MeshLod>& lods, const glm::vec3& centre, float radius, float scale) const
+{
+	// The nearest point of the sphere stands in for the whole instance, which errs towards too much detail. Anything
+	// the camera is inside gets full detail.
+	float distance = glm::length(centre - cameraPosition) - radius;
+	if (distance <= 0.0f)
+	{
+		return 0;
+	}
+
+	// The errors only grow down the chain, so the first acceptable level from the coarse end is the coarsest.
+	for (uint32_t lod = static_cast<uint32_t>(lods.size()) - 1; lod > 0; --lod)
+	{
+		if (lods[lod].error * scale * pixelsPerUnit <= maxPixelError * distance)
+		{
+			return lod;
+		}
+	}
+
+	return 0;
+}
+
+
+float LodSelector::GetPixelsPerUnit(const glm::vec3& centre, float radius, float scale) const
+{
+	float distance = glm::length(centre - cameraPosition) - radius;
+	if (distance <= 0.0f)
+	{
+		return std::numeric_limits<float>::infinity();
+	}
+
+	return scale * pixelsPerUnit / distance;
+}
+
+
+// Take the model's bounding sphere into world space. The scale is the longest of the transformed axes, so the sphere
+// still bounds the instance when it is stretched.
+static void GetInstanceBounds(const InstanceData& instance, const glm::vec4& boundingSphere, glm::vec3& centre, float& scale)
+{
+	const glm::vec4* rows = instance.rows;
+	glm::vec4 modelCentre {glm::vec3(boundingSphere), 1.0f};
+	centre = {glm::dot(rows[0], modelCentre), glm::dot(rows[1], modelCentre), glm::dot(rows[2], modelCentre)};
+
+	glm::vec4 squaredScales = rows[0] * rows[0] + rows[1] * rows[1] + rows[2] * rows[2];
+	scale = std::sqrt(std::max({squaredScales.x, squaredScales.y, squaredScales.z}));
+}
+
+
+void InstanceBuffer::Init(uint32_t capacity)
+{
+	m_capacity = capacity;
+	m_instances.reserve(m_capacity);
+	m_drawnInstanceCount = 0;
+
+	// Rewritten every frame and read once, so they stay in host memory.
+	for (auto& frame : m_frames)
+	{
+		m_pDeviceContext->CreateBuffer(static_cast<VkDeviceSize>(sizeof(InstanceData)) * m_capacity, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, frame.buffer, frame.allocation);
+
+		m_pDeviceContext->CreateBuffer(static_cast<VkDeviceSize>(sizeof(VkDrawIndexedIndirectCommand)) * kMaxLodCount, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, frame.indirectBuffer, frame.indirectAllocation);
+	}
+}
+
+
+void InstanceBuffer::Destroy()
+{
+	for (auto& frame : m_frames)
+	{
+		m_pDeviceContext->DestroyBuffer(frame.buffer, frame.allocation);
+		m_pDeviceContext->DestroyBuffer(frame.indirectBuffer, frame.indirectAllocation);
+	}
+
+	m_instances.clear();
+}
+
+
+void InstanceBuffer::Resize(uint32_t instanceCount)
+{
+	if (instanceCount > m_capacity)
+	{
+		throw std::runtime_error("too many instances for the instance buffer");
+	}
+
+	m_instances.resize(instanceCount, InstanceData::FromTransform(glm::mat4(1.0f)));
+}
+
+
+bool InstanceBuffer::LatchInstanceCount()
+{
+	uint32_t instanceCount = GetInstanceCount();
+	bool hasChanged = instanceCount != m_drawnInstanceCount;
+	m_drawnInstanceCount = instanceCount;
+
+	return hasChanged;
+}
+
+
+void InstanceBuffer::Update(uint32_t frameIndex, const DrawItem& drawItem, const LodSelector* pLodSelector)
+{
+	FrameBuffer& frame = m_frames[frameIndex];
+	auto pCommands = static_cast<VkDrawIndexedIndirectCommand*>(frame.indirectAllocation.pMapped);
+	const auto& lods = drawItem.pModel->GetLods();
+
+	glm::vec4 boundingSphere = drawItem.pModel->GetBoundingSphere();
+
+	m_lodInstanceCounts.fill(0);
+	m_drawnTriangleCount = 0;
+	m_maxPixelsPerUnit = 0.0f;
+
+	// Each level's instances are found with the first instance of its draw, which not every device supports.
+	bool isLodSelected = pLodSelector && pLodSelector->isEnabled && lods.size() > 1 && drawItem.firstIndex == 0 && drawItem.indexCount == lods[0].indexCount
+		&& m_pDeviceContext->GetCapabilities().isDrawIndirectFirstInstanceSupported;
+
+	if (!isLodSelected)
+	{
+		memcpy(frame.allocation.pMapped, m_instances.data(), sizeof(InstanceData) * m_drawnInstanceCount);
+
+		for (uint32_t lod = 0; lod < kMaxLodCount; ++lod)
+		{
+			pCommands[lod] = {};
+		}
+
+		pCommands[0] = {drawItem.indexCount, m_drawnInstanceCount, drawItem.firstIndex, 0, 0};
+		m_lodInstanceCounts[0] = m_drawnInstanceCount;
+		m_drawnTriangleCount = static_cast<uint64_t>(drawItem.indexCount / 3) * m_drawnInstanceCount;
+
+		if (pLodSelector)
+		{
+			for (uint32_t i = 0; i < m_drawnInstanceCount; ++i)
+			{
+				glm::vec3 centre;
+				float scale;
+				GetInstanceBounds(m_instances[i], boundingSphere, centre, scale);
+
+				m_maxPixelsPerUnit = std::max(m_maxPixelsPerUnit, pLodSelector->GetPixelsPerUnit(centre, boundingSphere.w * scale, scale));
+			}
+		}
+
+		return;
+	}
+
+	m_instanceLods.resize(m_drawnInstanceCount);
+	for (uint32_t i = 0; i < m_drawnInstanceCount; ++i)
+	{
+		glm::vec3 centre;
+		float scale;
+		GetInstanceBounds(m_instances[i], boundingSphere, centre, scale);
+
+		m_maxPixelsPerUnit = std::max(m_maxPixelsPerUnit, pLodSelector->GetPixelsPerUnit(centre, boundingSphere.w * scale, scale));
+
+		uint32_t lod = pLodSelector->SelectLod(lods, centre, boundingSphere.w * scale, scale);
+		m_instanceLods[i] = static_cast<uint8_t>(lod);
+		m_lodInstanceCounts[lod]++;
+	}
+
+	// A counting sort straight into the mapped buffer, leaving each level's instances together for its draw.
+	std::array<uint32_t, kMaxLodCount> nextInstances {};
+	uint32_t firstInstance = 0;
+	for (uint32_t lod = 0; lod < kMaxLodCount; ++lod)
+	{
+		nextInstances[lod] = firstInstance;
+
+		if (lod < lods.size())
+		{
+			pCommands[lod] = {lods[lod].indexCount, m_lodInstanceCounts[lod], lods[lod].firstIndex, 0, firstInstance};
+			m_drawnTriangleCount += static_cast<uint64_t>(lods[lod].indexCount / 3) * m_lodInstanceCounts[lod];
+		}
+		else
+		{
+			pCommands[lod] = {};
+		}
+
+		firstInstance += m_lodInstanceCounts[lod];
+	}
+
+	auto pInstances = static_cast<InstanceData*>(frame.allocation.pMapped);
+	for (uint32_t i = 0; i < m_drawnInstanceCount; ++i)
+	{
+		pInstances[nextInstances[m_instanceLods[i]]++] = m_instances[i];
+	}
+}
+}
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// STD.
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "LatencyMode.h"
+#include "Pipeline.h"
+
+
+namespace Jettison::Renderer
+{
+// Per instance vertex data. The transform is packed as the top three rows of an affine matrix, since the bottom row
+// is always (0, 0, 0, 1).
+struct InstanceData
+{
+	glm::vec4 rows[3];
+
+	static InstanceData FromTransform(const glm::mat4& transform)
+	{
+		// GLM is column major, so the rows are gathered a component at a time.
+		glm::mat4 transposed = glm::transpose(transform);
+
+		return {{transposed[0], transposed[1], transposed[2]}};
+	}
+
+
+	static VkVertexInputBindingDescription getBindingDescription()
+	{
+		VkVertexInputBindingDescription bindingDescription {};
+		bindingDescription.binding = 1;
+		bindingDescription.stride = sizeof(InstanceData);
+		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+		return bindingDescription;
+	}
+
+
+	static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions()
+	{
+		// Follows on from the vertex attributes.
+		std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions {};
+
+		for (uint32_t row = 0; row < 3; ++row)
+		{
+			attributeDescriptions[row].binding = 1;
+			attributeDescriptions[row].location = kVertexLocationCount + row;
+			attributeDescriptions[row].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+			attributeDescriptions[row].offset = static_cast<uint32_t>(sizeof(glm::vec4) * row);
+		}
+
+		return attributeDescriptions;
+	}
+};
+
+static_assert(sizeof(InstanceData) == 48, "InstanceData must be tightly packed");
+
+
+// A level of detail may show this many pixels of error by default.
+constexpr float kDefaultLodPixelError = 1.0f;
+
+
+// Picks each instance's level of detail from how large its error would look on screen.
+struct LodSelector
+{
+	glm::vec3 cameraPosition {0.0f};
+
+	// How many pixels a unit covers one unit in front of the camera, i.e. the viewport's height over twice the
+	// tangent of half the field of view.
+	float pixelsPerUnit {0.0f};
+
+	// The coarsest level whose error is no more than this many pixels is picked.
+	float maxPixelError {kDefaultLodPixelError};
+
+	// When off, every instance is drawn at full detail, but how large each looks is still measured.
+	bool isEnabled {true};
+
+	// The sphere and the scale take the model's bounds and errors into world space.
+	uint32_t SelectLod(const std::vector<MeshLod>& lods, const glm::vec3& centre, float radius, float scale) const;
+
+	// How many pixels a unit of the model covers at the nearest point of its sphere. Infinite when the camera is
+	// inside it.
+	float GetPixelsPerUnit(const glm::vec3& centre, float radius, float scale) const;
+};
+
+
+// The transforms for many instances of a model, drawn with an indirect draw for each of the model's levels of detail.
+// The instances are written on the CPU, and copied into a persistently mapped buffer for the frame in flight when the
+// frame begins, grouped by the level each is drawn at. The same copy writes the indirect draws, so an instance buffer
+// can only be drawn by one draw item.
+//
+// The instances may be written from any thread, e.g. a job kicked off after the previous frame, so long as it has
+// finished before the renderer's next DrawFrame. Changing the number of instances re-records the command buffers,
+// changing just the transforms, or the levels they're drawn at, does not.
+class InstanceBuffer
+{
+public:
+	InstanceBuffer(std::shared_ptr<DeviceContext> pDeviceContext)
+		:m_pDeviceContext {pDeviceContext} {}
+
+	// Disable copying.
+	InstanceBuffer() = default;
+	InstanceBuffer(const InstanceBuffer&) = delete;
+	InstanceBuffer& operator=(const InstanceBuffer&) = delete;
+
+	void Init(uint32_t capacity);
+
+	void Destroy();
+
+	// Set the number of instances, up to the capacity. Existing instances are kept.
+	void Resize(uint32_t instanceCount);
+
+	inline InstanceData* GetInstances() { return m_instances.data(); }
+
+	inline void SetTransform(uint32_t instance, const glm::mat4& transform) { m_instances[instance] = InstanceData::FromTransform(transform); }
+
+	inline uint32_t GetInstanceCount() const { return static_cast<uint32_t>(m_instances.size()); }
+
+	inline uint32_t GetCapacity() const { return m_capacity; }
+
+	// Take the instance count the next frame will be recorded with. Returns true if it has changed, in which case the
+	// command buffers need recording again. Called before the frame begins.
+	bool LatchInstanceCount();
+
+	// The instance count baked into the command buffers.
+	inline uint32_t GetDrawnInstanceCount() const { return m_drawnInstanceCount; }
+
+	// Copy the instances into the buffer for a frame in flight, and write the draws for the item. The frame's fence
+	// must have signalled. Without a selector, with it off, or when the item draws only part of the model, every
+	// instance is drawn with the item's own indices.
+	void Update(uint32_t frameIndex, const DrawItem& drawItem, const LodSelector* pLodSelector);
+
+	inline VkBuffer GetBuffer(uint32_t frameIndex) const { return m_frames[frameIndex].buffer; }
+
+	// One VkDrawIndexedIndirectCommand for each of the model's levels of detail, some of which may draw nothing.
+	inline VkBuffer GetIndirectBuffer(uint32_t frameIndex) const { return m_frames[frameIndex].indirectBuffer; }
+
+	// How many instances the last update drew at each level of detail.
+	inline const std::array<uint32_t, kMaxLodCount>& GetLodInstanceCounts() const { return m_lodInstanceCounts; }
+
+	// How many triangles the last update drew, across every instance.
+	inline uint64_t GetDrawnTriangleCount() const { return m_drawnTriangleCount; }
+
+	// The most pixels a unit of the model covered in the last update, across every instance, for picking texture
+	// levels. Zero without a selector.
+	inline float GetMaxPixelsPerUnit() const { return m_maxPixelsPerUnit; }
+
+private:
+	struct FrameBuffer
+	{
+		VkBuffer buffer {VK_NULL_HANDLE};
+		Allocation allocation {};
+
+		VkBuffer indirectBuffer {VK_NULL_HANDLE};
+		Allocation indirectAllocation {};
+	};
+
+	// Vulkan device context.
+	std::shared_ptr<DeviceContext> m_pDeviceContext {nullptr};
+
+	std::array<FrameBuffer, kMaxFramesInFlight> m_frames {};
+
+	std::vector<InstanceData> m_instances {};
+
+	uint32_t m_capacity {0};
+
+	uint32_t m_drawnInstanceCount {0};
+
+	// The level each instance was picked for, kept to save allocating every frame.
+	std::vector<uint8_t> m_instanceLods {};
+
+	std::array<uint32_t, kMaxLodCount> m_lodInstanceCounts {};
+
+	uint64_t m_drawnTriangleCount {0};
+
+	float m_maxPixelsPerUnit {0.0f};
+};
+}
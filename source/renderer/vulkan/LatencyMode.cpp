@@ -0,0 +1,71 @@
+#include "LatencyMode.h"
+
+// STD.
+#include <stdexcept>
+
+
+namespace Jettison::Renderer
+{
+LatencySettings GetLatencySettings(LatencyMode mode)
+{
+	LatencySettings settings;
+
+	switch (mode)
+	{
+		case LatencyMode::Throughput:
+			settings.framesInFlight = 3;
+			settings.imageCount = 3;
+			settings.presentModes = {VK_PRESENT_MODE_FIFO_KHR};
+			settings.isFrameLimited = false;
+			break;
+
+		case LatencyMode::LowLatency:
+			settings.framesInFlight = 1;
+			settings.imageCount = 2;
+			settings.presentModes = {VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_FIFO_KHR};
+			settings.isFrameLimited = true;
+			break;
+
+		case LatencyMode::VsyncOff:
+			settings.framesInFlight = 2;
+			settings.imageCount = 3;
+			settings.presentModes = {VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_KHR};
+			settings.isFrameLimited = false;
+			break;
+	}
+
+	return settings;
+}
+
+
+const char* GetLatencyModeName(LatencyMode mode)
+{
+	switch (mode)
+	{
+		case LatencyMode::Throughput:
+			return "throughput";
+
+		case LatencyMode::LowLatency:
+			return "low-latency";
+
+		case LatencyMode::VsyncOff:
+			return "vsync-off";
+	}
+
+	return "unknown";
+}
+
+
+LatencyMode ParseLatencyMode(const std::string& name)
+{
+	for (LatencyMode mode : {LatencyMode::Throughput, LatencyMode::LowLatency, LatencyMode::VsyncOff})
+	{
+		if (name == GetLatencyModeName(mode))
+		{
+			return mode;
+		}
+	}
+
+	throw std::runtime_error("unknown latency mode " + name);
+}
+}
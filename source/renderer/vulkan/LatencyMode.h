@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// STD.
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+namespace Jettison::Renderer
+{
+// The most frames in flight any latency mode uses. Per frame resources, such as the uniform ring, are sized for this.
+constexpr uint32_t kMaxFramesInFlight = 3;
+
+
+// Trades latency against throughput. The frames in flight, swapchain image count and present mode only make sense
+// when chosen together.
+enum class LatencyMode
+{
+	// Vsync, with a deep queue so the GPU is never starved.
+	Throughput,
+
+	// A single frame in flight and a short queue, waiting on the previous frame before sampling input.
+	LowLatency,
+
+	// No vsync. Frames go to the display as soon as they are finished, tearing and all.
+	VsyncOff,
+};
+
+
+struct LatencySettings
+{
+	uint32_t framesInFlight {2};
+
+	// The swapchain image count asked for. It is clamped to what the surface supports.
+	uint32_t imageCount {3};
+
+	// Present modes in order of preference. FIFO is always the last resort, since it is always supported.
+	std::vector<VkPresentModeKHR> presentModes {};
+
+	// Wait on the previous frame's fence before sampling input, so the input is as fresh as possible when drawn.
+	bool isFrameLimited {false};
+};
+
+
+LatencySettings GetLatencySettings(LatencyMode mode);
+
+const char* GetLatencyModeName(LatencyMode mode);
+
+// Accepts the names returned by GetLatencyModeName.
+LatencyMode ParseLatencyMode(const std::string& name);
+}
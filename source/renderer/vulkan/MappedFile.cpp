@@ -0,0 +1,140 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+namespace Jettison::Renderer
+{
+#ifdef _WIN32
+bool MappedFile::Open(const std::string& path)
+{
+	Close();
+
+	HANDLE fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(fileHandle, &size))
+	{
+		CloseHandle(fileHandle);
+		return false;
+	}
+
+	m_fileHandle = fileHandle;
+	m_size = static_cast<size_t>(size.QuadPart);
+	m_isOpen = true;
+
+	// Windows refuses to map an empty file.
+	if (m_size == 0)
+	{
+		return true;
+	}
+
+	m_mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_mappingHandle)
+	{
+		m_pData = static_cast<const uint8_t*>(MapViewOfFile(m_mappingHandle, FILE_MAP_READ, 0, 0, 0));
+	}
+
+	if (!m_pData)
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+
+void MappedFile::Close()
+{
+	if (m_pData)
+	{
+		UnmapViewOfFile(m_pData);
+	}
+
+	if (m_mappingHandle)
+	{
+		CloseHandle(m_mappingHandle);
+	}
+
+	if (m_fileHandle)
+	{
+		CloseHandle(m_fileHandle);
+	}
+
+	m_pData = nullptr;
+	m_mappingHandle = nullptr;
+	m_fileHandle = nullptr;
+	m_size = 0;
+	m_isOpen = false;
+}
+#else
+bool MappedFile::Open(const std::string& path)
+{
+	Close();
+
+	int fileDescriptor = open(path.c_str(), O_RDONLY);
+	if (fileDescriptor < 0)
+	{
+		return false;
+	}
+
+	struct stat status;
+	if (fstat(fileDescriptor, &status) != 0)
+	{
+		close(fileDescriptor);
+		return false;
+	}
+
+	m_size = static_cast<size_t>(status.st_size);
+
+	// The mapping keeps the file alive, so the descriptor isn't needed once it exists. mmap refuses a length of zero,
+	// so empty files aren't mapped at all.
+	if (m_size > 0)
+	{
+		void* pData = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+		if (pData == MAP_FAILED)
+		{
+			close(fileDescriptor);
+			m_size = 0;
+			return false;
+		}
+
+		// Mostly read from front to back, so ask for generous read ahead.
+		madvise(pData, m_size, MADV_SEQUENTIAL);
+		m_pData = static_cast<const uint8_t*>(pData);
+	}
+
+	close(fileDescriptor);
+	m_isOpen = true;
+
+	return true;
+}
+
+
+void MappedFile::Close()
+{
+	if (m_pData)
+	{
+		munmap(const_cast<uint8_t*>(m_pData), m_size);
+	}
+
+	m_pData = nullptr;
+	m_size = 0;
+	m_isOpen = false;
+}
+#endif
+}
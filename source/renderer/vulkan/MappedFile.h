@@ -0,0 +1,44 @@
+#pragma once
+
+// STD.
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+
+namespace Jettison::Renderer
+{
+// A whole file mapped read only into memory. Nothing is read up front, the OS pages the file in as it is touched, so
+// copying out of the mapping is the only read.
+class MappedFile
+{
+public:
+	MappedFile() = default;
+
+	// Disable copying.
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// Returns false if the file can't be opened or mapped. An empty file opens, with no data.
+	bool Open(const std::string& path);
+
+	void Close();
+
+	inline bool IsOpen() const { return m_isOpen; }
+
+	inline const uint8_t* GetData() const { return m_pData; }
+
+	inline size_t GetSize() const { return m_size; }
+
+private:
+	const uint8_t* m_pData {nullptr};
+	size_t m_size {0};
+	bool m_isOpen {false};
+
+#ifdef _WIN32
+	// Windows HANDLEs, kept as pointers so windows.h stays out of the header.
+	void* m_fileHandle {nullptr};
+	void* m_mappingHandle {nullptr};
+#endif
+};
+}
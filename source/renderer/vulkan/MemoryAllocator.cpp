@@ -0,0 +1,431 @@
+#include "MemoryAllocator.h"
+
+// STD.
+#include <algorithm>
+#include <stdexcept>
+
+
+namespace Jettison::Renderer
+{
+// Blocks are capped at this size, and shrunk for small heaps so one block can't take a large share of the heap.
+constexpr VkDeviceSize kDefaultBlockSize = 64ull * 1024 * 1024;
+constexpr VkDeviceSize kMinBlockSize = 4ull * 1024 * 1024;
+
+// The smallest node the buddy allocator will hand out.
+constexpr VkDeviceSize kMinNodeSize = 256;
+
+// Blocks with less than this fraction in use are emptied out by the defragmenter.
+constexpr float kDefragmentationThreshold = 0.25f;
+
+
+static VkDeviceSize NextPowerOfTwo(VkDeviceSize value)
+{
+	VkDeviceSize result = 1;
+	while (result < value)
+	{
+		result <<= 1;
+	}
+
+	return result;
+}
+
+
+static uint32_t Log2(VkDeviceSize value)
+{
+	uint32_t result = 0;
+	while (value > 1)
+	{
+		value >>= 1;
+		++result;
+	}
+
+	return result;
+}
+
+
+MemoryBlock::MemoryBlock(VkDeviceMemory memory, VkDeviceSize size, uint32_t memoryTypeIndex, ResourceKind kind, void* pMapped, bool isDedicated)
+	:m_memory {memory}, m_size {size}, m_memoryTypeIndex {memoryTypeIndex}, m_kind {kind}, m_pMapped {pMapped}, m_isDedicated {isDedicated}
+{
+	// A dedicated block holds exactly one allocation, so it only needs the root of the tree.
+	uint32_t levelCount = m_isDedicated ? 1 : Log2(m_size / kMinNodeSize) + 1;
+
+	m_freeLists.resize(levelCount);
+	m_freeLists[0].insert(0);
+}
+
+
+bool MemoryBlock::Allocate(VkDeviceSize size, VkDeviceSize alignment, Allocation& allocation)
+{
+	uint32_t targetLevel = 0;
+
+	if (m_isDedicated)
+	{
+		if (size > m_size)
+		{
+			return false;
+		}
+	}
+	else
+	{
+		VkDeviceSize nodeSize = NextPowerOfTwo(std::max({size, alignment, kMinNodeSize}));
+		if (nodeSize > m_size)
+		{
+			return false;
+		}
+
+		targetLevel = std::min(Log2(m_size / nodeSize), static_cast<uint32_t>(m_freeLists.size() - 1));
+	}
+
+	// Find the smallest free node which is large enough.
+	int32_t level = static_cast<int32_t>(targetLevel);
+	while (level >= 0 && m_freeLists[level].empty())
+	{
+		--level;
+	}
+
+	if (level < 0)
+	{
+		return false;
+	}
+
+	VkDeviceSize offset = *m_freeLists[level].begin();
+	m_freeLists[level].erase(m_freeLists[level].begin());
+
+	// Split it down to the size we need, keeping the upper halves free.
+	while (static_cast<uint32_t>(level) < targetLevel)
+	{
+		++level;
+		m_freeLists[level].insert(offset + GetNodeSize(level));
+	}
+
+	allocation.memory = m_memory;
+	allocation.offset = offset;
+	allocation.size = size;
+	allocation.memoryTypeIndex = m_memoryTypeIndex;
+	allocation.pMapped = m_pMapped ? static_cast<uint8_t*>(m_pMapped) + offset : nullptr;
+	allocation.pBlock = this;
+	allocation.level = targetLevel;
+
+	m_usedBytes += size;
+	++m_allocationCount;
+
+	return true;
+}
+
+
+void MemoryBlock::Free(const Allocation& allocation)
+{
+	uint32_t level = allocation.level;
+	VkDeviceSize offset = allocation.offset;
+
+	// Merge with the buddy for as long as it is also free.
+	while (level > 0)
+	{
+		VkDeviceSize buddy = offset ^ GetNodeSize(level);
+		auto it = m_freeLists[level].find(buddy);
+		if (it == m_freeLists[level].end())
+		{
+			break;
+		}
+
+		m_freeLists[level].erase(it);
+		offset = std::min(offset, buddy);
+		--level;
+	}
+
+	m_freeLists[level].insert(offset);
+
+	m_usedBytes -= allocation.size;
+	--m_allocationCount;
+}
+
+
+void MemoryAllocator::Init()
+{
+	vkGetPhysicalDeviceMemoryProperties(m_physicalDevice, &m_memoryProperties);
+
+	m_blocks.resize(m_memoryProperties.memoryTypeCount * static_cast<uint32_t>(ResourceKind::Count));
+}
+
+
+void MemoryAllocator::Destroy()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	for (auto& blocks : m_blocks)
+	{
+		for (auto& pBlock : blocks)
+		{
+			if (pBlock->GetMapped())
+			{
+				vkUnmapMemory(m_logicalDevice, pBlock->GetMemory());
+			}
+
+			vkFreeMemory(m_logicalDevice, pBlock->GetMemory(), nullptr);
+		}
+
+		blocks.clear();
+	}
+
+	m_deviceMemoryAllocationCount = 0;
+}
+
+
+uint32_t MemoryAllocator::FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const
+{
+	for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; ++i)
+	{
+		if (typeFilter & (1 << i) && (m_memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+		{
+			return i;
+		}
+	}
+
+	throw std::runtime_error("failed to find suitable memory type");
+}
+
+
+std::vector<std::unique_ptr<MemoryBlock>>& MemoryAllocator::GetBlocks(uint32_t memoryTypeIndex, ResourceKind kind)
+{
+	return m_blocks[memoryTypeIndex * static_cast<uint32_t>(ResourceKind::Count) + static_cast<uint32_t>(kind)];
+}
+
+
+VkDeviceSize MemoryAllocator::GetPreferredBlockSize(uint32_t memoryTypeIndex) const
+{
+	uint32_t heapIndex = m_memoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+	VkDeviceSize heapSize = m_memoryProperties.memoryHeaps[heapIndex].size;
+
+	VkDeviceSize blockSize = kDefaultBlockSize;
+	while (blockSize > kMinBlockSize && blockSize > heapSize / 8)
+	{
+		blockSize >>= 1;
+	}
+
+	return blockSize;
+}
+
+
+MemoryBlock* MemoryAllocator::CreateBlock(uint32_t memoryTypeIndex, ResourceKind kind, VkDeviceSize size, bool isDedicated)
+{
+	VkMemoryAllocateInfo allocInfo {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = size;
+	allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+	VkDeviceMemory memory;
+	if (vkAllocateMemory(m_logicalDevice, &allocInfo, nullptr, &memory) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to allocate device memory block");
+	}
+
+	++m_deviceMemoryAllocationCount;
+
+	// Host visible blocks are mapped once for their whole lifetime.
+	void* pMapped = nullptr;
+	if (m_memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+	{
+		if (vkMapMemory(m_logicalDevice, memory, 0, VK_WHOLE_SIZE, 0, &pMapped) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to map device memory block");
+		}
+	}
+
+	auto& blocks = GetBlocks(memoryTypeIndex, kind);
+	blocks.push_back(std::make_unique<MemoryBlock>(memory, size, memoryTypeIndex, kind, pMapped, isDedicated));
+
+	return blocks.back().get();
+}
+
+
+void MemoryAllocator::DestroyBlock(MemoryBlock* pBlock)
+{
+	if (pBlock->GetMapped())
+	{
+		vkUnmapMemory(m_logicalDevice, pBlock->GetMemory());
+	}
+
+	vkFreeMemory(m_logicalDevice, pBlock->GetMemory(), nullptr);
+	--m_deviceMemoryAllocationCount;
+
+	auto& blocks = GetBlocks(pBlock->GetMemoryTypeIndex(), pBlock->GetKind());
+	blocks.erase(std::remove_if(blocks.begin(), blocks.end(),
+		[pBlock](const std::unique_ptr<MemoryBlock>& pOther) { return pOther.get() == pBlock; }), blocks.end());
+}
+
+
+Allocation MemoryAllocator::Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, ResourceKind kind)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	uint32_t memoryTypeIndex = FindMemoryType(requirements.memoryTypeBits, properties);
+	VkDeviceSize blockSize = GetPreferredBlockSize(memoryTypeIndex);
+
+	Allocation allocation;
+
+	// Really large resources get a block of their own rather than wasting most of a shared one.
+	if (requirements.size > blockSize / 2)
+	{
+		MemoryBlock* pBlock = CreateBlock(memoryTypeIndex, kind, requirements.size, true);
+		pBlock->Allocate(requirements.size, requirements.alignment, allocation);
+
+		return allocation;
+	}
+
+	for (auto& pBlock : GetBlocks(memoryTypeIndex, kind))
+	{
+		if (!pBlock->IsDedicated() && pBlock->Allocate(requirements.size, requirements.alignment, allocation))
+		{
+			return allocation;
+		}
+	}
+
+	MemoryBlock* pBlock = CreateBlock(memoryTypeIndex, kind, blockSize, false);
+	if (!pBlock->Allocate(requirements.size, requirements.alignment, allocation))
+	{
+		throw std::runtime_error("failed to sub-allocate from a new memory block");
+	}
+
+	return allocation;
+}
+
+
+void MemoryAllocator::Free(Allocation& allocation)
+{
+	if (allocation.pBlock == nullptr)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	MemoryBlock* pBlock = allocation.pBlock;
+	pBlock->Free(allocation);
+
+	// Shared blocks are kept around for reuse until ReleaseEmptyBlocks is called.
+	if (pBlock->IsDedicated())
+	{
+		DestroyBlock(pBlock);
+	}
+
+	allocation = {};
+}
+
+
+std::vector<DefragmentationMove> MemoryAllocator::BeginDefragmentation(const std::vector<Allocation*>& candidates)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	std::vector<DefragmentationMove> moves;
+
+	auto isSparse = [](const MemoryBlock* pBlock)
+	{
+		return static_cast<float>(pBlock->GetUsedBytes()) < kDefragmentationThreshold * static_cast<float>(pBlock->GetSize());
+	};
+
+	for (Allocation* pAllocation : candidates)
+	{
+		MemoryBlock* pSource = pAllocation->pBlock;
+		if (pSource == nullptr || pSource->IsDedicated() || !isSparse(pSource))
+		{
+			continue;
+		}
+
+		// Prefer the fullest blocks, so the sparse ones end up empty.
+		std::vector<MemoryBlock*> destinations;
+		for (auto& pBlock : GetBlocks(pSource->GetMemoryTypeIndex(), pSource->GetKind()))
+		{
+			if (pBlock.get() != pSource && !pBlock->IsDedicated() && !isSparse(pBlock.get()))
+			{
+				destinations.push_back(pBlock.get());
+			}
+		}
+
+		std::sort(destinations.begin(), destinations.end(),
+			[](const MemoryBlock* a, const MemoryBlock* b) { return a->GetUsedBytes() > b->GetUsedBytes(); });
+
+		for (MemoryBlock* pDestination : destinations)
+		{
+			DefragmentationMove move;
+			move.pAllocation = pAllocation;
+
+			// Buddy nodes are aligned to their size, so the original node size is a safe alignment.
+			if (pDestination->Allocate(pAllocation->size, pSource->GetSize() >> pAllocation->level, move.destination))
+			{
+				moves.push_back(move);
+				break;
+			}
+		}
+	}
+
+	return moves;
+}
+
+
+void MemoryAllocator::EndDefragmentation(std::vector<DefragmentationMove>& moves)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		for (auto& move : moves)
+		{
+			move.pAllocation->pBlock->Free(*move.pAllocation);
+			*move.pAllocation = move.destination;
+		}
+
+		moves.clear();
+	}
+
+	ReleaseEmptyBlocks();
+}
+
+
+void MemoryAllocator::ReleaseEmptyBlocks()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	std::vector<MemoryBlock*> emptyBlocks;
+	for (auto& blocks : m_blocks)
+	{
+		for (auto& pBlock : blocks)
+		{
+			if (pBlock->IsEmpty())
+			{
+				emptyBlocks.push_back(pBlock.get());
+			}
+		}
+	}
+
+	for (MemoryBlock* pBlock : emptyBlocks)
+	{
+		DestroyBlock(pBlock);
+	}
+}
+
+
+std::vector<HeapStats> MemoryAllocator::GetHeapStats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	std::vector<HeapStats> stats(m_memoryProperties.memoryHeapCount);
+	for (uint32_t i = 0; i < m_memoryProperties.memoryHeapCount; ++i)
+	{
+		stats[i].heapSize = m_memoryProperties.memoryHeaps[i].size;
+		stats[i].flags = m_memoryProperties.memoryHeaps[i].flags;
+	}
+
+	for (const auto& blocks : m_blocks)
+	{
+		for (const auto& pBlock : blocks)
+		{
+			HeapStats& heap = stats[m_memoryProperties.memoryTypes[pBlock->GetMemoryTypeIndex()].heapIndex];
+			heap.blockBytes += pBlock->GetSize();
+			heap.blockCount++;
+			heap.usedBytes += pBlock->GetUsedBytes();
+			heap.allocationCount += pBlock->GetAllocationCount();
+		}
+	}
+
+	return stats;
+}
+}
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// STD.
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
+
+
+namespace Jettison::Renderer
+{
+// Buffers and linear images must not share a page of bufferImageGranularity with optimal images. Rather than pad every
+// allocation, each kind of resource is given its own blocks.
+enum class ResourceKind : uint32_t
+{
+	Linear = 0,
+	Optimal,
+	Count
+};
+
+
+class MemoryBlock;
+
+
+// A sub-allocation from one of the allocator's device memory blocks.
+struct Allocation
+{
+	VkDeviceMemory memory {VK_NULL_HANDLE};
+	VkDeviceSize offset {0};
+	VkDeviceSize size {0};
+	uint32_t memoryTypeIndex {0};
+
+	// Pointer to the start of the allocation, if the memory is host visible.
+	void* pMapped {nullptr};
+
+	// Book keeping for the allocator.
+	MemoryBlock* pBlock {nullptr};
+	uint32_t level {0};
+};
+
+
+// Usage statistics for a single memory heap.
+struct HeapStats
+{
+	VkDeviceSize heapSize {0};
+	VkMemoryHeapFlags flags {0};
+
+	// Device memory allocated from the driver.
+	VkDeviceSize blockBytes {0};
+	uint32_t blockCount {0};
+
+	// Memory handed out to resources, excluding the padding added by the buddy allocator.
+	VkDeviceSize usedBytes {0};
+	uint32_t allocationCount {0};
+};
+
+
+// A move the defragmenter would like to make. The caller copies the contents from the source to the destination and
+// rebinds the resource before completing the defragmentation.
+struct DefragmentationMove
+{
+	Allocation* pAllocation {nullptr};
+	Allocation destination {};
+};
+
+
+// A large block of device memory carved up with a buddy allocator. The block size is a power of two, and every node
+// in the tree is aligned to its own size, so any alignment up to the node size comes for free.
+class MemoryBlock
+{
+public:
+	MemoryBlock(VkDeviceMemory memory, VkDeviceSize size, uint32_t memoryTypeIndex, ResourceKind kind, void* pMapped, bool isDedicated);
+
+	// Returns false if there is no free node large enough.
+	bool Allocate(VkDeviceSize size, VkDeviceSize alignment, Allocation& allocation);
+
+	void Free(const Allocation& allocation);
+
+	inline bool IsEmpty() const { return m_usedBytes == 0; }
+
+	inline VkDeviceMemory GetMemory() const { return m_memory; }
+
+	inline VkDeviceSize GetSize() const { return m_size; }
+
+	inline VkDeviceSize GetUsedBytes() const { return m_usedBytes; }
+
+	inline uint32_t GetAllocationCount() const { return m_allocationCount; }
+
+	inline uint32_t GetMemoryTypeIndex() const { return m_memoryTypeIndex; }
+
+	inline ResourceKind GetKind() const { return m_kind; }
+
+	inline bool IsDedicated() const { return m_isDedicated; }
+
+	inline void* GetMapped() const { return m_pMapped; }
+
+private:
+	inline VkDeviceSize GetNodeSize(uint32_t level) const { return m_size >> level; }
+
+	VkDeviceMemory m_memory {VK_NULL_HANDLE};
+	VkDeviceSize m_size {0};
+	uint32_t m_memoryTypeIndex {0};
+	ResourceKind m_kind {ResourceKind::Linear};
+	void* m_pMapped {nullptr};
+	bool m_isDedicated {false};
+
+	// Free node offsets for each level of the tree. Level zero is the whole block.
+	std::vector<std::set<VkDeviceSize>> m_freeLists {};
+
+	VkDeviceSize m_usedBytes {0};
+	uint32_t m_allocationCount {0};
+};
+
+
+class MemoryAllocator
+{
+public:
+	MemoryAllocator(VkPhysicalDevice physicalDevice, VkDevice logicalDevice)
+		:m_physicalDevice {physicalDevice}, m_logicalDevice {logicalDevice} {}
+
+	// Disable copying.
+	MemoryAllocator() = default;
+	MemoryAllocator(const MemoryAllocator&) = delete;
+	MemoryAllocator& operator=(const MemoryAllocator&) = delete;
+
+	void Init();
+
+	void Destroy();
+
+	Allocation Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, ResourceKind kind);
+
+	void Free(Allocation& allocation);
+
+	// Pick allocations out of sparsely used blocks and find them a new home in a fuller block. Only the allocations
+	// passed in are considered, since the caller has to be able to copy and rebind them.
+	std::vector<DefragmentationMove> BeginDefragmentation(const std::vector<Allocation*>& candidates);
+
+	// Release the old memory for each move and point the allocations at their new location.
+	void EndDefragmentation(std::vector<DefragmentationMove>& moves);
+
+	// Give completely empty blocks back to the driver.
+	void ReleaseEmptyBlocks();
+
+	std::vector<HeapStats> GetHeapStats() const;
+
+	// The number of live vkAllocateMemory allocations, to compare against maxMemoryAllocationCount.
+	inline uint32_t GetDeviceMemoryAllocationCount() const { return m_deviceMemoryAllocationCount; }
+
+	uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+
+private:
+	MemoryBlock* CreateBlock(uint32_t memoryTypeIndex, ResourceKind kind, VkDeviceSize size, bool isDedicated);
+
+	void DestroyBlock(MemoryBlock* pBlock);
+
+	VkDeviceSize GetPreferredBlockSize(uint32_t memoryTypeIndex) const;
+
+	std::vector<std::unique_ptr<MemoryBlock>>& GetBlocks(uint32_t memoryTypeIndex, ResourceKind kind);
+
+	VkPhysicalDevice m_physicalDevice {VK_NULL_HANDLE};
+	VkDevice m_logicalDevice {VK_NULL_HANDLE};
+
+	VkPhysicalDeviceMemoryProperties m_memoryProperties {};
+
+	// Blocks for each memory type and resource kind.
+	std::vector<std::vector<std::unique_ptr<MemoryBlock>>> m_blocks {};
+
+	uint32_t m_deviceMemoryAllocationCount {0};
+
+	mutable std::mutex m_mutex {};
+};
+}
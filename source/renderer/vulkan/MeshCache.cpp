@@ -0,0 +1,275 @@
+#include "MeshCache.h"
+
+// STD.
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <type_traits>
+
+#include "Pipeline.h"
+
+
+namespace Jettison::Renderer
+{
+const char* kMeshCacheDirectory = "mesh_cache";
+
+constexpr uint32_t kMeshCacheMagic = 0x48534d4a; // "JMSH"
+
+// Every array starts on this boundary, so the vertices can be used in place however GLM aligns them.
+constexpr uint64_t kMeshCacheAlignment = 16;
+
+
+// Followed by the vertices, the packed vertices, the indices and the levels of detail, in that order.
+struct MeshCacheFileHeader
+{
+	uint32_t magic {kMeshCacheMagic};
+	uint32_t version {kMeshCacheVersion};
+	uint64_t sourceHash {0};
+
+	// Catches files from a build whose Vertex is laid out differently.
+	uint32_t vertexSize {sizeof(Vertex)};
+	uint32_t vertexCount {0};
+	uint32_t indexCount {0};
+	uint32_t lodCount {0};
+	uint64_t packedVertexSize {0};
+
+	VertexLayout layout {};
+	VertexDequantisation dequantisation {};
+	glm::vec4 boundingSphere {0.0f};
+	float texCoordDensity {0.0f};
+	MeshOptimisationStats optimisationStats {};
+};
+
+static_assert(std::is_trivially_copyable_v<MeshCacheFileHeader>, "the mesh cache header is written as it is");
+static_assert(std::is_trivially_copyable_v<Vertex>, "vertices are written as they are");
+static_assert(std::is_trivially_copyable_v<MeshLod>, "levels of detail are written as they are");
+
+
+// Where each array starts in the file, and where the file should end.
+struct MeshCacheSections
+{
+	uint64_t vertices {0};
+	uint64_t packedVertices {0};
+	uint64_t indices {0};
+	uint64_t lods {0};
+	uint64_t end {0};
+};
+
+
+static uint64_t AlignUp(uint64_t value)
+{
+	return (value + kMeshCacheAlignment - 1) & ~(kMeshCacheAlignment - 1);
+}
+
+
+static MeshCacheSections GetSections(const MeshCacheFileHeader& header)
+{
+	MeshCacheSections sections;
+	sections.vertices = AlignUp(sizeof(MeshCacheFileHeader));
+	sections.packedVertices = AlignUp(sections.vertices + static_cast<uint64_t>(sizeof(Vertex)) * header.vertexCount);
+	sections.indices = AlignUp(sections.packedVertices + header.packedVertexSize);
+	sections.lods = AlignUp(sections.indices + static_cast<uint64_t>(sizeof(uint32_t)) * header.indexCount);
+	sections.end = sections.lods + static_cast<uint64_t>(sizeof(MeshLod)) * header.lodCount;
+
+	return sections;
+}
+
+
+static uint64_t RotateLeft(uint64_t value, int shift)
+{
+	return (value << shift) | (value >> (64 - shift));
+}
+
+
+uint64_t HashFileContents(const std::string& path)
+{
+	MappedFile file;
+	if (!file.Open(path))
+	{
+		throw std::runtime_error("failed to read " + path);
+	}
+
+	const uint8_t* pData = file.GetData();
+	size_t size = file.GetSize();
+
+	// A word at a time, each mixed in with a multiply. Byte at a time hashes like FNV-1a would take longer than
+	// loading the cache.
+	constexpr uint64_t kMultiplier = 0x9e3779b97f4a7c15ull;
+	uint64_t hash = 14695981039346656037ull ^ size;
+
+	size_t offset = 0;
+	for (; offset + sizeof(uint64_t) <= size; offset += sizeof(uint64_t))
+	{
+		uint64_t word;
+		memcpy(&word, pData + offset, sizeof(word));
+		hash = (RotateLeft(hash, 5) ^ word) * kMultiplier;
+	}
+
+	if (offset < size)
+	{
+		uint64_t word = 0;
+		memcpy(&word, pData + offset, size - offset);
+		hash = (RotateLeft(hash, 5) ^ word) * kMultiplier;
+	}
+
+	file.Close();
+
+	// Spread the last words' bits over the whole hash.
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdull;
+	hash ^= hash >> 33;
+
+	return hash;
+}
+
+
+std::string GetMeshCachePath(const std::string& sourcePath, const VertexLayout& layout)
+{
+	// Sources with the same name in different directories share a file, and replace each other's entries.
+	std::string layoutKey = std::to_string(static_cast<uint32_t>(layout.position)) + std::to_string(static_cast<uint32_t>(layout.colour))
+		+ std::to_string(static_cast<uint32_t>(layout.texCoord)) + std::to_string(static_cast<uint32_t>(layout.normal));
+
+	std::filesystem::path fileName = std::filesystem::path(sourcePath).stem();
+	fileName += "_" + layoutKey + ".mesh";
+
+	return (std::filesystem::path(kMeshCacheDirectory) / fileName).string();
+}
+
+
+static void WritePadding(std::ofstream& file, uint64_t offset)
+{
+	static const char kZeros[kMeshCacheAlignment] = {};
+	uint64_t position = static_cast<uint64_t>(file.tellp());
+
+	file.write(kZeros, static_cast<std::streamsize>(offset - position));
+}
+
+
+void WriteMeshCache(const std::string& path, uint64_t sourceHash, const MeshCacheView& mesh)
+{
+	MeshCacheFileHeader header;
+	header.sourceHash = sourceHash;
+	header.vertexCount = mesh.vertexCount;
+	header.indexCount = mesh.indexCount;
+	header.lodCount = mesh.lodCount;
+	header.packedVertexSize = mesh.packedVertexSize;
+	header.layout = mesh.layout;
+	header.dequantisation = mesh.dequantisation;
+	header.boundingSphere = mesh.boundingSphere;
+	header.texCoordDensity = mesh.texCoordDensity;
+	header.optimisationStats = mesh.optimisationStats;
+
+	MeshCacheSections sections = GetSections(header);
+
+	std::error_code error;
+	std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+
+	std::string tempPath = path + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			std::cerr << "failed to write mesh cache " << path << "\n";
+			return;
+		}
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+		WritePadding(file, sections.vertices);
+		file.write(reinterpret_cast<const char*>(mesh.pVertices), sizeof(Vertex) * mesh.vertexCount);
+
+		WritePadding(file, sections.packedVertices);
+		file.write(reinterpret_cast<const char*>(mesh.pPackedVertices), static_cast<std::streamsize>(mesh.packedVertexSize));
+
+		WritePadding(file, sections.indices);
+		file.write(reinterpret_cast<const char*>(mesh.pIndices), sizeof(uint32_t) * mesh.indexCount);
+
+		WritePadding(file, sections.lods);
+		file.write(reinterpret_cast<const char*>(mesh.pLods), sizeof(MeshLod) * mesh.lodCount);
+
+		if (!file)
+		{
+			std::cerr << "failed to write mesh cache " << path << "\n";
+			return;
+		}
+	}
+
+	std::filesystem::rename(tempPath, path, error);
+	if (error)
+	{
+		std::cerr << "failed to replace mesh cache " << path << ": " << error.message() << '\n';
+		std::filesystem::remove(tempPath, error);
+	}
+}
+
+
+bool MeshCacheFile::Open(const std::string& path, uint64_t sourceHash, const VertexLayout& layout)
+{
+	Close();
+
+	if (!m_file.Open(path))
+	{
+		return false;
+	}
+
+	MeshCacheFileHeader header;
+	if (m_file.GetSize() < sizeof(header))
+	{
+		Close();
+		return false;
+	}
+
+	memcpy(&header, m_file.GetData(), sizeof(header));
+
+	// Anything stale is quietly imported again, only a damaged file is worth mentioning.
+	if (header.magic != kMeshCacheMagic || header.version != kMeshCacheVersion || header.vertexSize != sizeof(Vertex)
+		|| header.sourceHash != sourceHash || header.layout != layout)
+	{
+		Close();
+		return false;
+	}
+
+	MeshCacheSections sections = GetSections(header);
+	const uint8_t* pData = m_file.GetData();
+	const MeshLod* pLods = reinterpret_cast<const MeshLod*>(pData + sections.lods);
+
+	bool isIntact = sections.end == m_file.GetSize() && header.packedVertexSize == static_cast<uint64_t>(layout.GetStride()) * header.vertexCount
+		&& header.lodCount > 0 && header.lodCount <= kMaxLodCount;
+	for (uint32_t lod = 0; isIntact && lod < header.lodCount; ++lod)
+	{
+		isIntact = static_cast<uint64_t>(pLods[lod].firstIndex) + pLods[lod].indexCount <= header.indexCount;
+	}
+
+	if (!isIntact)
+	{
+		std::cerr << "mesh cache " << path << " is corrupt, ignoring it\n";
+		Close();
+		return false;
+	}
+
+	m_mesh.layout = header.layout;
+	m_mesh.dequantisation = header.dequantisation;
+	m_mesh.boundingSphere = header.boundingSphere;
+	m_mesh.texCoordDensity = header.texCoordDensity;
+	m_mesh.optimisationStats = header.optimisationStats;
+	m_mesh.pVertices = reinterpret_cast<const Vertex*>(pData + sections.vertices);
+	m_mesh.vertexCount = header.vertexCount;
+	m_mesh.pPackedVertices = pData + sections.packedVertices;
+	m_mesh.packedVertexSize = header.packedVertexSize;
+	m_mesh.pIndices = reinterpret_cast<const uint32_t*>(pData + sections.indices);
+	m_mesh.indexCount = header.indexCount;
+	m_mesh.pLods = pLods;
+	m_mesh.lodCount = header.lodCount;
+
+	return true;
+}
+
+
+void MeshCacheFile::Close()
+{
+	m_file.Close();
+	m_mesh = {};
+}
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+// GL Math.
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#define GLM_ENABLE_EXPERIMENTAL
+#include <../glm/glm/glm.hpp>
+
+// STD.
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "MappedFile.h"
+#include "MeshOptimiser.h"
+#include "MeshSimplifier.h"
+#include "VertexLayout.h"
+
+
+namespace Jettison::Renderer
+{
+// Defined in Pipeline.h, which includes this for the models' loading.
+struct Vertex;
+
+
+// Bump whenever the file's layout, or anything which goes into producing its contents, changes. Files from any other
+// version are imported afresh.
+constexpr uint32_t kMeshCacheVersion = 3;
+
+
+// Where the time went loading a model.
+struct MeshLoadStats
+{
+	// Was the model loaded from the cache, rather than imported from its source?
+	bool isCached {false};
+
+	// Hashing the source, to find out whether the cache is still good.
+	std::chrono::duration<double, std::milli> hashTime {0};
+
+	// Parsing the source and welding its vertices, filling in any missing normals. Zero when cached.
+	std::chrono::duration<double, std::milli> parseTime {0};
+
+	// Optimisation, levels of detail, bounds and packing. Zero when cached.
+	std::chrono::duration<double, std::milli> processTime {0};
+
+	// Reading the cache, or writing it after an import.
+	std::chrono::duration<double, std::milli> cacheTime {0};
+
+	// All of the above, plus copying the buffers into staging.
+	std::chrono::duration<double, std::milli> totalTime {0};
+};
+
+
+// Everything a model keeps from importing a mesh. It points at the arrays rather than owning them, so the same
+// description serves a freshly imported mesh being written and a mapped cache file being read.
+struct MeshCacheView
+{
+	VertexLayout layout {};
+	VertexDequantisation dequantisation {};
+	glm::vec4 boundingSphere {0.0f};
+	float texCoordDensity {0.0f};
+	MeshOptimisationStats optimisationStats {};
+
+	// The unpacked vertices, for anything on the CPU which wants them.
+	const Vertex* pVertices {nullptr};
+	uint32_t vertexCount {0};
+
+	// Exactly what goes in the vertex buffer.
+	const uint8_t* pPackedVertices {nullptr};
+	uint64_t packedVertexSize {0};
+
+	// Every level of detail, one after the other.
+	const uint32_t* pIndices {nullptr};
+	uint32_t indexCount {0};
+
+	const MeshLod* pLods {nullptr};
+	uint32_t lodCount {0};
+};
+
+
+// A 64 bit hash of everything in the file, read through a mapping. Fast rather than strong, it only needs to notice the
+// file changing. Throws if the file can't be read.
+uint64_t HashFileContents(const std::string& path);
+
+// Each source and vertex layout has its own file in the cache directory.
+std::string GetMeshCachePath(const std::string& sourcePath, const VertexLayout& layout);
+
+// Write to a temporary file, then rename it over the old one so a crash can never leave a torn file. Failing is only
+// a warning, since the mesh is loaded either way.
+void WriteMeshCache(const std::string& path, uint64_t sourceHash, const MeshCacheView& mesh);
+
+
+// A cache file mapped into memory. Its arrays can be copied straight into staging buffers, there's no parsing.
+class MeshCacheFile
+{
+public:
+	MeshCacheFile() = default;
+
+	// Disable copying.
+	MeshCacheFile(const MeshCacheFile&) = delete;
+	MeshCacheFile& operator=(const MeshCacheFile&) = delete;
+
+	// Returns false if the file is missing, from another version or build, made from a different source or for a
+	// different layout, or the wrong size for what its header says it holds.
+	bool Open(const std::string& path, uint64_t sourceHash, const VertexLayout& layout);
+
+	// The view is only good until the file is closed.
+	void Close();
+
+	inline const MeshCacheView& GetMesh() const { return m_mesh; }
+
+private:
+	MappedFile m_file {};
+
+	MeshCacheView m_mesh {};
+};
+}
@@ -0,0 +1,456 @@
+#include "MeshOptimiser.h"
+
+// STD.
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+
+#include "Pipeline.h"
+
+
+namespace Jettison::Renderer
+{
+// The cache Forsyth's scoring models. Bigger than the one measured with, since the scores only need to favour
+// recently used vertices, not predict the hardware exactly.
+constexpr uint32_t kForsythCacheSize = 32;
+
+constexpr float kCacheDecayPower = 1.5f;
+
+// The last triangle's vertices score a little lower, so the next triangle isn't always a neighbour of the last.
+constexpr float kLastTriangleScore = 0.75f;
+
+// Vertices with few triangles left are favoured, so stragglers get finished off rather than left until the end.
+constexpr float kValenceBoostScale = 2.0f;
+constexpr float kValenceBoostPower = 0.5f;
+
+// Scores are looked up for valences below this, and worked out above it.
+constexpr uint32_t kMaxTabulatedValence = 32;
+
+constexpr uint32_t kInvalidIndex = ~0u;
+
+
+VertexCacheStats AnalyseVertexCache(const std::vector<uint32_t>& indices, uint32_t vertexCount, uint32_t cacheSize)
+{
+	VertexCacheStats stats;
+
+	if (indices.empty() || vertexCount == 0)
+	{
+		return stats;
+	}
+
+	// A vertex is in the cache when it was last pushed fewer than the cache size misses ago.
+	std::vector<uint32_t> pushTime(vertexCount, 0);
+	uint32_t misses = 0;
+
+	for (uint32_t index : indices)
+	{
+		if (index >= vertexCount)
+		{
+			throw std::runtime_error("vertex index out of range");
+		}
+
+		if (pushTime[index] == 0 || misses + 1 - pushTime[index] > cacheSize)
+		{
+			misses++;
+			pushTime[index] = misses;
+		}
+	}
+
+	stats.acmr = static_cast<float>(misses) / (indices.size() / 3);
+	stats.atvr = static_cast<float>(misses) / vertexCount;
+
+	return stats;
+}
+
+
+struct ForsythScores
+{
+	std::array<float, kForsythCacheSize> cachePosition {};
+	std::array<float, kMaxTabulatedValence> valence {};
+
+	ForsythScores()
+	{
+		for (uint32_t position = 0; position < kForsythCacheSize; ++position)
+		{
+			cachePosition[position] = position < 3 ? kLastTriangleScore
+				: std::pow(1.0f - (position - 3) / static_cast<float>(kForsythCacheSize - 3), kCacheDecayPower);
+		}
+
+		for (uint32_t remaining = 1; remaining < kMaxTabulatedValence; ++remaining)
+		{
+			valence[remaining] = kValenceBoostScale * std::pow(static_cast<float>(remaining), -kValenceBoostPower);
+		}
+	}
+
+	float Score(int32_t position, uint32_t remainingValence) const
+	{
+		// Nothing left to draw, so it's of no interest.
+		if (remainingValence == 0)
+		{
+			return -1.0f;
+		}
+
+		float score = position >= 0 ? cachePosition[position] : 0.0f;
+		score += remainingValence < kMaxTabulatedValence ? valence[remainingValence]
+			: kValenceBoostScale * std::pow(static_cast<float>(remainingValence), -kValenceBoostPower);
+
+		return score;
+	}
+};
+
+
+void OptimiseVertexCache(std::vector<uint32_t>& indices, uint32_t vertexCount)
+{
+	static const ForsythScores scores;
+
+	uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	// The triangles using each vertex, packed together. Each vertex's remaining triangles are kept at the front of its
+	// range, so the valence is also the count still to be drawn.
+	std::vector<uint32_t> valence(vertexCount, 0);
+	for (uint32_t index : indices)
+	{
+		if (index >= vertexCount)
+		{
+			throw std::runtime_error("vertex index out of range");
+		}
+
+		valence[index]++;
+	}
+
+	std::vector<uint32_t> firstTriangle(vertexCount, 0);
+	std::exclusive_scan(valence.begin(), valence.end(), firstTriangle.begin(), 0u);
+
+	std::vector<uint32_t> vertexTriangles(indices.size());
+	std::vector<uint32_t> filled(vertexCount, 0);
+	for (uint32_t triangle = 0; triangle < triangleCount; ++triangle)
+	{
+		for (uint32_t corner = 0; corner < 3; ++corner)
+		{
+			uint32_t vertex = indices[triangle * 3 + corner];
+			vertexTriangles[firstTriangle[vertex] + filled[vertex]++] = triangle;
+		}
+	}
+
+	std::vector<int32_t> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+	for (uint32_t vertex = 0; vertex < vertexCount; ++vertex)
+	{
+		vertexScore[vertex] = scores.Score(-1, valence[vertex]);
+	}
+
+	std::vector<float> triangleScore(triangleCount);
+	std::vector<bool> isDrawn(triangleCount, false);
+	uint32_t bestTriangle = 0;
+
+	for (uint32_t triangle = 0; triangle < triangleCount; ++triangle)
+	{
+		triangleScore[triangle] = vertexScore[indices[triangle * 3]] + vertexScore[indices[triangle * 3 + 1]] + vertexScore[indices[triangle * 3 + 2]];
+		if (triangleScore[triangle] > triangleScore[bestTriangle])
+		{
+			bestTriangle = triangle;
+		}
+	}
+
+	// The cache holds three extra entries, for the vertices pushed past its end by the latest triangle.
+	std::array<uint32_t, kForsythCacheSize + 3> cache;
+	std::array<uint32_t, kForsythCacheSize + 3> nextCache;
+	uint32_t cacheCount = 0;
+
+	std::vector<uint32_t> optimised;
+	optimised.reserve(indices.size());
+
+	// When nothing in the cache has triangles left, carry on from the first triangle not yet drawn.
+	uint32_t nextUndrawn = 0;
+
+	while (optimised.size() < indices.size())
+	{
+		if (bestTriangle == kInvalidIndex)
+		{
+			while (isDrawn[nextUndrawn])
+			{
+				nextUndrawn++;
+			}
+
+			bestTriangle = nextUndrawn;
+		}
+
+		const uint32_t* pCorners = &indices[bestTriangle * 3];
+		optimised.insert(optimised.end(), pCorners, pCorners + 3);
+		isDrawn[bestTriangle] = true;
+
+		// Take the triangle out of each of its vertices' remaining triangles.
+		for (uint32_t corner = 0; corner < 3; ++corner)
+		{
+			uint32_t vertex = pCorners[corner];
+			uint32_t* pTriangles = &vertexTriangles[firstTriangle[vertex]];
+			uint32_t* pLast = pTriangles + valence[vertex] - 1;
+			std::iter_swap(std::find(pTriangles, pLast, bestTriangle), pLast);
+			valence[vertex]--;
+		}
+
+		// The triangle's vertices go to the front of the cache, and everything else moves back.
+		uint32_t nextCount = 0;
+		for (uint32_t corner = 0; corner < 3; ++corner)
+		{
+			nextCache[nextCount++] = pCorners[corner];
+		}
+
+		for (uint32_t i = 0; i < cacheCount && nextCount < nextCache.size(); ++i)
+		{
+			uint32_t vertex = cache[i];
+			if (vertex != pCorners[0] && vertex != pCorners[1] && vertex != pCorners[2])
+			{
+				nextCache[nextCount++] = vertex;
+			}
+		}
+
+		cache = nextCache;
+		cacheCount = nextCount;
+
+		// Rescore everything in the cache, including those which have just fallen out, and the triangles around them.
+		for (uint32_t i = 0; i < cacheCount; ++i)
+		{
+			uint32_t vertex = cache[i];
+			cachePosition[vertex] = i < kForsythCacheSize ? static_cast<int32_t>(i) : -1;
+
+			float score = scores.Score(cachePosition[vertex], valence[vertex]);
+			float scoreChange = score - vertexScore[vertex];
+			vertexScore[vertex] = score;
+
+			const uint32_t* pTriangles = &vertexTriangles[firstTriangle[vertex]];
+			for (uint32_t j = 0; j < valence[vertex]; ++j)
+			{
+				triangleScore[pTriangles[j]] += scoreChange;
+			}
+		}
+
+		cacheCount = std::min(cacheCount, kForsythCacheSize);
+
+		// The next triangle is the best of those around the cache.
+		bestTriangle = kInvalidIndex;
+		float bestScore = -1.0f;
+
+		for (uint32_t i = 0; i < cacheCount; ++i)
+		{
+			uint32_t vertex = cache[i];
+			const uint32_t* pTriangles = &vertexTriangles[firstTriangle[vertex]];
+
+			for (uint32_t j = 0; j < valence[vertex]; ++j)
+			{
+				if (triangleScore[pTriangles[j]] > bestScore)
+				{
+					bestScore = triangleScore[pTriangles[j]];
+					bestTriangle = pTriangles[j];
+				}
+			}
+		}
+	}
+
+	indices = std::move(optimised);
+}
+
+
+// Split the triangles into runs which can be drawn in any order without hurting the cache much. Returns the first
+// triangle of each run.
+static std::vector<uint32_t> FindClusters(const std::vector<uint32_t>& indices, uint32_t vertexCount, float threshold)
+{
+	uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+
+	// A triangle with no vertices in the cache is where the cache optimiser jumped somewhere new, so there is nothing
+	// to lose by starting a cluster there.
+	std::vector<uint32_t> hardBoundaries;
+	std::vector<uint32_t> pushTime(vertexCount, 0);
+	std::vector<uint32_t> triangleMisses(triangleCount);
+	uint32_t misses = 0;
+
+	for (uint32_t triangle = 0; triangle < triangleCount; ++triangle)
+	{
+		uint32_t triangleMissCount = 0;
+		for (uint32_t corner = 0; corner < 3; ++corner)
+		{
+			uint32_t vertex = indices[triangle * 3 + corner];
+			if (pushTime[vertex] == 0 || misses + 1 - pushTime[vertex] > kVertexCacheSize)
+			{
+				misses++;
+				pushTime[vertex] = misses;
+				triangleMissCount++;
+			}
+		}
+
+		triangleMisses[triangle] = triangleMissCount;
+		if (triangleMissCount == 3)
+		{
+			hardBoundaries.push_back(triangle);
+		}
+	}
+
+	hardBoundaries.push_back(triangleCount);
+
+	// Within each of those, also split wherever the cluster so far, starting from an empty cache, is no worse than the
+	// threshold allows. A cluster has to be long enough to pay for starting cold.
+	std::vector<uint32_t> clusters;
+	std::fill(pushTime.begin(), pushTime.end(), 0);
+	misses = 0;
+
+	for (size_t i = 0; i + 1 < hardBoundaries.size(); ++i)
+	{
+		uint32_t start = hardBoundaries[i];
+		uint32_t end = hardBoundaries[i + 1];
+
+		uint32_t hardMisses = std::accumulate(triangleMisses.begin() + start, triangleMisses.begin() + end, 0u);
+		float hardAcmr = static_cast<float>(hardMisses) / (end - start);
+
+		clusters.push_back(start);
+
+		uint32_t clusterStartTime = misses;
+		uint32_t clusterStart = start;
+
+		for (uint32_t triangle = start; triangle < end; ++triangle)
+		{
+			for (uint32_t corner = 0; corner < 3; ++corner)
+			{
+				uint32_t vertex = indices[triangle * 3 + corner];
+				if (pushTime[vertex] <= clusterStartTime || misses + 1 - pushTime[vertex] > kVertexCacheSize)
+				{
+					misses++;
+					pushTime[vertex] = misses;
+				}
+			}
+
+			float clusterAcmr = static_cast<float>(misses - clusterStartTime) / (triangle + 1 - clusterStart);
+			if (clusterAcmr <= hardAcmr * threshold && triangle + 1 < end)
+			{
+				clusters.push_back(triangle + 1);
+				clusterStart = triangle + 1;
+				clusterStartTime = misses;
+			}
+		}
+	}
+
+	return clusters;
+}
+
+
+void OptimiseOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, float threshold)
+{
+	uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	std::vector<uint32_t> clusters = FindClusters(indices, static_cast<uint32_t>(vertices.size()), threshold);
+	clusters.push_back(triangleCount);
+
+	uint32_t clusterCount = static_cast<uint32_t>(clusters.size() - 1);
+
+	// Area weighted centres and normals, for each cluster and the whole mesh.
+	std::vector<glm::vec3> clusterCentres(clusterCount, glm::vec3(0.0f));
+	std::vector<glm::vec3> clusterNormals(clusterCount, glm::vec3(0.0f));
+	glm::vec3 meshCentre {0.0f};
+	float meshArea = 0.0f;
+
+	for (uint32_t cluster = 0; cluster < clusterCount; ++cluster)
+	{
+		float clusterArea = 0.0f;
+
+		for (uint32_t triangle = clusters[cluster]; triangle < clusters[cluster + 1]; ++triangle)
+		{
+			const glm::vec3& a = vertices[indices[triangle * 3]].pos;
+			const glm::vec3& b = vertices[indices[triangle * 3 + 1]].pos;
+			const glm::vec3& c = vertices[indices[triangle * 3 + 2]].pos;
+
+			// Twice the area, in the direction of the normal.
+			glm::vec3 normal = glm::cross(b - a, c - a);
+			float area = glm::length(normal);
+
+			clusterCentres[cluster] += (a + b + c) * (area / 3.0f);
+			clusterNormals[cluster] += normal;
+			clusterArea += area;
+		}
+
+		meshCentre += clusterCentres[cluster];
+		meshArea += clusterArea;
+
+		if (clusterArea > 0.0f)
+		{
+			clusterCentres[cluster] /= clusterArea;
+		}
+	}
+
+	if (meshArea > 0.0f)
+	{
+		meshCentre /= meshArea;
+	}
+
+	// Clusters facing away from the middle are on the outside, so draw them first.
+	std::vector<float> sortKeys(clusterCount);
+	for (uint32_t cluster = 0; cluster < clusterCount; ++cluster)
+	{
+		float normalLength = glm::length(clusterNormals[cluster]);
+		glm::vec3 normal = normalLength > 0.0f ? clusterNormals[cluster] / normalLength : glm::vec3(0.0f);
+		sortKeys[cluster] = glm::dot(clusterCentres[cluster] - meshCentre, normal);
+	}
+
+	std::vector<uint32_t> order(clusterCount);
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&sortKeys](uint32_t a, uint32_t b) { return sortKeys[a] > sortKeys[b]; });
+
+	std::vector<uint32_t> reordered;
+	reordered.reserve(indices.size());
+
+	for (uint32_t cluster : order)
+	{
+		reordered.insert(reordered.end(), indices.begin() + clusters[cluster] * 3, indices.begin() + clusters[cluster + 1] * 3);
+	}
+
+	indices = std::move(reordered);
+}
+
+
+void OptimiseVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+	std::vector<uint32_t> remap(vertices.size(), kInvalidIndex);
+	std::vector<Vertex> remapped;
+	remapped.reserve(vertices.size());
+
+	for (auto& index : indices)
+	{
+		if (remap[index] == kInvalidIndex)
+		{
+			remap[index] = static_cast<uint32_t>(remapped.size());
+			remapped.push_back(vertices[index]);
+		}
+
+		index = remap[index];
+	}
+
+	vertices = std::move(remapped);
+}
+
+
+MeshOptimisationStats OptimiseMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+	MeshOptimisationStats stats;
+	stats.vertexCount = static_cast<uint32_t>(vertices.size());
+	stats.triangleCount = static_cast<uint32_t>(indices.size() / 3);
+	stats.before = AnalyseVertexCache(indices, stats.vertexCount);
+
+	// Overdraw works on the cache optimised order, and the fetch order follows whatever order the triangles end up in.
+	OptimiseVertexCache(indices, stats.vertexCount);
+	OptimiseOverdraw(indices, vertices);
+	OptimiseVertexFetch(vertices, indices);
+
+	stats.vertexCount = static_cast<uint32_t>(vertices.size());
+	stats.after = AnalyseVertexCache(indices, stats.vertexCount);
+
+	return stats;
+}
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+// STD.
+#include <cstdint>
+#include <vector>
+
+
+namespace Jettison::Renderer
+{
+// Defined in Pipeline.h, which includes this for the models' statistics.
+struct Vertex;
+
+
+// The FIFO post-transform cache the statistics are measured with, about what desktop GPUs manage.
+constexpr uint32_t kVertexCacheSize = 16;
+
+// How much worse than the cache optimised order the overdraw optimiser may make the cache hit rate, as a ratio.
+constexpr float kOverdrawThreshold = 1.05f;
+
+
+// Post-transform vertex cache efficiency for a list of triangles.
+struct VertexCacheStats
+{
+	// Average cache miss ratio, the vertices transformed per triangle. 0.5 is ideal for a large regular mesh, 3 the
+	// worst possible.
+	float acmr {0.0f};
+
+	// Average transform to vertex ratio, the vertices transformed per unique vertex. 1 is ideal.
+	float atvr {0.0f};
+};
+
+
+struct MeshOptimisationStats
+{
+	uint32_t vertexCount {0};
+	uint32_t triangleCount {0};
+
+	VertexCacheStats before {};
+	VertexCacheStats after {};
+};
+
+
+// Simulate a FIFO cache of the given size over the triangles.
+VertexCacheStats AnalyseVertexCache(const std::vector<uint32_t>& indices, uint32_t vertexCount, uint32_t cacheSize = kVertexCacheSize);
+
+// Reorder the triangles so neighbours are drawn together and their vertices are still in the post-transform cache,
+// with Tom Forsyth's linear speed algorithm. The triangles are unchanged, only their order.
+void OptimiseVertexCache(std::vector<uint32_t>& indices, uint32_t vertexCount);
+
+// Reorder clusters of triangles so those facing out from the middle of the mesh, which tend to hide the rest, are
+// drawn first. After Sander, Nehab and Barczak's "Fast Triangle Reordering". Only splits the cache optimised order
+// where that costs no more than the threshold in cache efficiency, so run OptimiseVertexCache first.
+void OptimiseOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, float threshold = kOverdrawThreshold);
+
+// Reorder the vertices into the order the triangles first use them, so fetching them walks through memory. Vertices
+// no triangle uses are dropped, and the indices are remapped to match.
+void OptimiseVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+// Run all three, in the order they need to be run, measuring the cache before and after.
+MeshOptimisationStats OptimiseMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+}
@@ -0,0 +1,88 @@
+#include "MeshPool.h"
+
+// STD.
+#include <algorithm>
+#include <stdexcept>
+
+
+namespace Jettison::Renderer
+{
+void MeshPool::Init(uint32_t vertexCapacity, uint32_t indexCapacity)
+{
+	m_vertexCapacity = vertexCapacity;
+	m_indexCapacity = indexCapacity;
+	m_vertexCount = 0;
+	m_indexCount = 0;
+	m_meshes.clear();
+
+	m_vertexStride = GetVertexLayout(VertexLayoutPreset::Float).GetStride();
+
+	m_pDeviceContext->CreateBuffer(static_cast<VkDeviceSize>(m_vertexStride) * m_vertexCapacity,
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		m_vertexBuffer, m_vertexBufferAllocation);
+
+	m_pDeviceContext->CreateBuffer(static_cast<VkDeviceSize>(sizeof(uint32_t)) * m_indexCapacity,
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		m_indexBuffer, m_indexBufferAllocation);
+}
+
+
+void MeshPool::Destroy()
+{
+	m_pDeviceContext->DestroyBuffer(m_indexBuffer, m_indexBufferAllocation);
+	m_pDeviceContext->DestroyBuffer(m_vertexBuffer, m_vertexBufferAllocation);
+	m_meshes.clear();
+}
+
+
+MeshHandle MeshPool::AddMesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices)
+{
+	if (vertices.size() > m_vertexCapacity - m_vertexCount || indices.size() > m_indexCapacity - m_indexCount)
+	{
+		throw std::runtime_error("mesh pool is full");
+	}
+
+	MeshRange range;
+	range.vertexOffset = static_cast<int32_t>(m_vertexCount);
+	range.firstIndex = m_indexCount;
+	range.indexCount = static_cast<uint32_t>(indices.size());
+
+	// Centred on the bounding box, which is close enough to the tightest sphere for culling.
+	if (!vertices.empty())
+	{
+		glm::vec3 minimum = vertices[0].pos;
+		glm::vec3 maximum = vertices[0].pos;
+		for (const auto& vertex : vertices)
+		{
+			minimum = glm::min(minimum, vertex.pos);
+			maximum = glm::max(maximum, vertex.pos);
+		}
+
+		glm::vec3 centre = (minimum + maximum) * 0.5f;
+		float radius = 0.0f;
+		for (const auto& vertex : vertices)
+		{
+			radius = std::max(radius, glm::length(vertex.pos - centre));
+		}
+
+		range.boundingSphere = glm::vec4(centre, radius);
+	}
+
+	// The indices stay relative to the mesh, the vertex offset in each draw takes care of the rest. The indirect
+	// pipeline has no per mesh dequantisation, so the pool is always floats.
+	PackedVertices packed = PackVertices(vertices, GetVertexLayout(VertexLayoutPreset::Float));
+
+	UploadManager& uploadManager = m_pDeviceContext->GetUploadManager();
+	uploadManager.UploadBuffer(m_vertexBuffer, packed.data.data(), packed.data.size(),
+		static_cast<VkDeviceSize>(m_vertexStride) * m_vertexCount, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+	uploadManager.UploadBuffer(m_indexBuffer, indices.data(), sizeof(uint32_t) * indices.size(),
+		static_cast<VkDeviceSize>(sizeof(uint32_t)) * m_indexCount, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT);
+	m_uploadTicket = uploadManager.Submit();
+
+	m_vertexCount += static_cast<uint32_t>(vertices.size());
+	m_indexCount += static_cast<uint32_t>(indices.size());
+	m_meshes.push_back(range);
+
+	return static_cast<MeshHandle>(m_meshes.size() - 1);
+}
+}
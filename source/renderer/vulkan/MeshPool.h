@@ -0,0 +1,84 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// STD.
+#include <cstdint>
+#include <vector>
+
+#include "Pipeline.h"
+
+
+namespace Jettison::Renderer
+{
+// Identifies a mesh within the pool.
+using MeshHandle = uint32_t;
+
+
+// Where a mesh lives within the pool's buffers, in the same terms as VkDrawIndexedIndirectCommand.
+struct MeshRange
+{
+	int32_t vertexOffset {0};
+	uint32_t firstIndex {0};
+	uint32_t indexCount {0};
+
+	// Bounds in the mesh's own space, centre in xyz and radius in w.
+	glm::vec4 boundingSphere {0.0f};
+};
+
+
+// A pair of large vertex and index buffers shared by many meshes, so a whole scene can be drawn without binding
+// anything between draws. Space is handed out by bumping an offset, and is only reclaimed when the pool is destroyed.
+class MeshPool
+{
+public:
+	MeshPool(std::shared_ptr<DeviceContext> pDeviceContext)
+		:m_pDeviceContext {pDeviceContext} {}
+
+	// Disable copying.
+	MeshPool() = default;
+	MeshPool(const MeshPool&) = delete;
+	MeshPool& operator=(const MeshPool&) = delete;
+
+	// Capacities are in vertices and indices.
+	void Init(uint32_t vertexCapacity, uint32_t indexCapacity);
+
+	void Destroy();
+
+	// Copy a mesh into the pool. The upload is submitted straight away, and the mesh can't be drawn until the pool
+	// is ready.
+	MeshHandle AddMesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
+
+	// Have all the meshes added so far finished uploading?
+	bool IsReady() const { return m_pDeviceContext->GetUploadManager().IsComplete(m_uploadTicket); }
+
+	inline const MeshRange& GetMeshRange(MeshHandle mesh) const { return m_meshes[mesh]; }
+
+	inline uint32_t GetMeshCount() const { return static_cast<uint32_t>(m_meshes.size()); }
+
+	inline VkBuffer GetVertexBuffer() const { return m_vertexBuffer; }
+
+	inline VkBuffer GetIndexBuffer() const { return m_indexBuffer; }
+
+private:
+	// Vulkan device context.
+	std::shared_ptr<DeviceContext> m_pDeviceContext {nullptr};
+
+	VkBuffer m_vertexBuffer {VK_NULL_HANDLE};
+	Allocation m_vertexBufferAllocation {};
+	VkBuffer m_indexBuffer {VK_NULL_HANDLE};
+	Allocation m_indexBufferAllocation {};
+
+	// Of the float vertex layout, in bytes.
+	uint32_t m_vertexStride {0};
+
+	uint32_t m_vertexCapacity {0};
+	uint32_t m_indexCapacity {0};
+	uint32_t m_vertexCount {0};
+	uint32_t m_indexCount {0};
+
+	std::vector<MeshRange> m_meshes {};
+
+	UploadTicket m_uploadTicket {0};
+};
+}
@@ -0,0 +1,550 @@
+#include "MeshSimplifier.h"
+
+// STD.
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <queue>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "MeshOptimiser.h"
+#include "Pipeline.h"
+
+
+namespace Jettison::Renderer
+{
+// How much more a border edge's plane counts than the triangles around it, so borders keep their shape as they slide.
+constexpr double kBorderPlaneWeight = 10.0;
+
+
+// A symmetric 4x4 matrix, which gives the sum of the squared distances from a point to a set of planes. The planes
+// are weighted by area, and the weight kept, so the error comes out as an average squared distance.
+struct Quadric
+{
+	double xx {0.0};
+	double xy {0.0};
+	double xz {0.0};
+	double xw {0.0};
+	double yy {0.0};
+	double yz {0.0};
+	double yw {0.0};
+	double zz {0.0};
+	double zw {0.0};
+	double ww {0.0};
+	double weight {0.0};
+
+	// The plane is ax + by + cz + d = 0, with a unit normal.
+	void AddPlane(double a, double b, double c, double d, double planeWeight)
+	{
+		xx += planeWeight * a * a;
+		xy += planeWeight * a * b;
+		xz += planeWeight * a * c;
+		xw += planeWeight * a * d;
+		yy += planeWeight * b * b;
+		yz += planeWeight * b * c;
+		yw += planeWeight * b * d;
+		zz += planeWeight * c * c;
+		zw += planeWeight * c * d;
+		ww += planeWeight * d * d;
+		weight += planeWeight;
+	}
+
+	void Add(const Quadric& other)
+	{
+		xx += other.xx;
+		xy += other.xy;
+		xz += other.xz;
+		xw += other.xw;
+		yy += other.yy;
+		yz += other.yz;
+		yw += other.yw;
+		zz += other.zz;
+		zw += other.zw;
+		ww += other.ww;
+		weight += other.weight;
+	}
+
+	// The average squared distance from the point to the planes.
+	double Evaluate(const glm::vec3& point) const
+	{
+		double x = point.x;
+		double y = point.y;
+		double z = point.z;
+
+		double sum = xx * x * x + yy * y * y + zz * z * z + 2.0 * (xy * x * y + xz * x * z + yz * y * z)
+			+ 2.0 * (xw * x + yw * y + zw * z) + ww;
+
+		// Rounding can take a point on every plane just below zero.
+		return weight > 0.0 ? std::max(sum, 0.0) / weight : 0.0;
+	}
+};
+
+
+enum class VertexKind : uint8_t
+{
+	// Free to move onto any neighbour.
+	Manifold,
+
+	// On the mesh's border, so may only slide along it.
+	Border,
+
+	// Shares its position with another vertex, e.g. on a UV seam, or is somewhere the surface isn't a manifold.
+	// Never moves.
+	Locked,
+};
+
+
+// Moving the source vertex onto the target, and what that costs.
+struct Collapse
+{
+	double cost {0.0};
+	uint32_t source {0};
+	uint32_t target {0};
+
+	// The versions of the two vertices when the cost was worked out. If either has changed since, so has the cost.
+	uint32_t sourceVersion {0};
+	uint32_t targetVersion {0};
+
+	bool operator>(const Collapse& other) const { return cost > other.cost; }
+};
+
+
+class EdgeCollapser
+{
+public:
+	EdgeCollapser(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices)
+		:m_vertices {vertices}, m_indices {indices}
+	{
+		m_triangleCount = static_cast<uint32_t>(m_indices.size() / 3);
+		m_liveTriangleCount = m_triangleCount;
+		m_isTriangleLive.assign(m_triangleCount, true);
+
+		uint32_t vertexCount = static_cast<uint32_t>(m_vertices.size());
+		m_quadrics.resize(vertexCount);
+		m_kinds.assign(vertexCount, VertexKind::Manifold);
+		m_versions.assign(vertexCount, 0);
+		m_isVertexLive.assign(vertexCount, true);
+		m_vertexTriangles.resize(vertexCount);
+
+		for (uint32_t triangle = 0; triangle < m_triangleCount; ++triangle)
+		{
+			for (uint32_t corner = 0; corner < 3; ++corner)
+			{
+				m_vertexTriangles[m_indices[triangle * 3 + corner]].push_back(triangle);
+			}
+		}
+
+		ClassifyVertices();
+		AddTriangleQuadrics();
+	}
+
+	void Simplify(uint32_t targetIndexCount, double maxErrorSquared)
+	{
+		std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> collapses;
+
+		for (uint32_t triangle = 0; triangle < m_triangleCount; ++triangle)
+		{
+			for (uint32_t corner = 0; corner < 3; ++corner)
+			{
+				uint32_t a = m_indices[triangle * 3 + corner];
+				uint32_t b = m_indices[triangle * 3 + (corner + 1) % 3];
+
+				// Each interior edge is seen from both of its triangles, but only needs queueing once.
+				if (a < b || IsBorderEdge(a, b))
+				{
+					PushEdge(collapses, a, b);
+				}
+			}
+		}
+
+		while (m_liveTriangleCount * 3 > targetIndexCount && !collapses.empty())
+		{
+			Collapse collapse = collapses.top();
+			collapses.pop();
+
+			if (!m_isVertexLive[collapse.source] || !m_isVertexLive[collapse.target]
+				|| m_versions[collapse.source] != collapse.sourceVersion || m_versions[collapse.target] != collapse.targetVersion)
+			{
+				continue;
+			}
+
+			// Everything left in the queue costs at least as much.
+			if (collapse.cost > maxErrorSquared)
+			{
+				break;
+			}
+
+			if (!CanMove(collapse.source, collapse.target) || IsFolding(collapse.source, collapse.target))
+			{
+				continue;
+			}
+
+			m_maxErrorSquared = std::max(m_maxErrorSquared, collapse.cost);
+			Apply(collapse.source, collapse.target);
+
+			for (uint32_t neighbour : GetNeighbours(collapse.target))
+			{
+				PushEdge(collapses, collapse.target, neighbour);
+			}
+		}
+	}
+
+	std::vector<uint32_t> GetIndices() const
+	{
+		std::vector<uint32_t> indices;
+		indices.reserve(static_cast<size_t>(m_liveTriangleCount) * 3);
+
+		for (uint32_t triangle = 0; triangle < m_triangleCount; ++triangle)
+		{
+			if (m_isTriangleLive[triangle])
+			{
+				indices.insert(indices.end(), m_indices.begin() + triangle * 3, m_indices.begin() + triangle * 3 + 3);
+			}
+		}
+
+		return indices;
+	}
+
+	float GetError() const { return static_cast<float>(std::sqrt(m_maxErrorSquared)); }
+
+private:
+	void ClassifyVertices()
+	{
+		// Vertices in the same place are the two sides of a seam. Moving one would tear it open.
+		std::unordered_map<glm::vec3, uint32_t> firstAtPosition;
+		for (uint32_t vertex = 0; vertex < m_vertices.size(); ++vertex)
+		{
+			if (m_vertexTriangles[vertex].empty())
+			{
+				continue;
+			}
+
+			auto result = firstAtPosition.emplace(m_vertices[vertex].pos, vertex);
+			if (!result.second)
+			{
+				m_kinds[vertex] = VertexKind::Locked;
+				m_kinds[result.first->second] = VertexKind::Locked;
+			}
+		}
+
+		// An edge with one triangle is on the border, and one with more than two isn't on a manifold at all.
+		std::unordered_map<uint64_t, uint32_t> edgeTriangleCounts;
+		for (uint32_t triangle = 0; triangle < m_triangleCount; ++triangle)
+		{
+			for (uint32_t corner = 0; corner < 3; ++corner)
+			{
+				edgeTriangleCounts[GetEdgeKey(m_indices[triangle * 3 + corner], m_indices[triangle * 3 + (corner + 1) % 3])]++;
+			}
+		}
+
+		for (const auto& [key, count] : edgeTriangleCounts)
+		{
+			uint32_t a = static_cast<uint32_t>(key >> 32);
+			uint32_t b = static_cast<uint32_t>(key);
+			VertexKind kind = count == 1 ? VertexKind::Border : count > 2 ? VertexKind::Locked : VertexKind::Manifold;
+
+			for (uint32_t vertex : {a, b})
+			{
+				m_kinds[vertex] = std::max(m_kinds[vertex], kind);
+			}
+		}
+	}
+
+	void AddTriangleQuadrics()
+	{
+		for (uint32_t triangle = 0; triangle < m_triangleCount; ++triangle)
+		{
+			const glm::vec3& p0 = m_vertices[m_indices[triangle * 3 + 0]].pos;
+			const glm::vec3& p1 = m_vertices[m_indices[triangle * 3 + 1]].pos;
+			const glm::vec3& p2 = m_vertices[m_indices[triangle * 3 + 2]].pos;
+
+			glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+			float doubleArea = glm::length(normal);
+			if (doubleArea == 0.0f)
+			{
+				continue;
+			}
+
+			normal = normal / doubleArea;
+
+			Quadric quadric;
+			quadric.AddPlane(normal.x, normal.y, normal.z, -glm::dot(normal, p0), 0.5 * doubleArea);
+			for (uint32_t corner = 0; corner < 3; ++corner)
+			{
+				m_quadrics[m_indices[triangle * 3 + corner]].Add(quadric);
+			}
+
+			// A plane at right angles to the triangle through each border edge, so sliding a border vertex along a
+			// curved border costs something.
+			for (uint32_t corner = 0; corner < 3; ++corner)
+			{
+				uint32_t a = m_indices[triangle * 3 + corner];
+				uint32_t b = m_indices[triangle * 3 + (corner + 1) % 3];
+				if (!IsBorderEdge(a, b))
+				{
+					continue;
+				}
+
+				glm::vec3 edge = m_vertices[b].pos - m_vertices[a].pos;
+				glm::vec3 edgeNormal = glm::cross(edge, normal);
+				float edgeLength = glm::length(edgeNormal);
+				if (edgeLength == 0.0f)
+				{
+					continue;
+				}
+
+				edgeNormal = edgeNormal / edgeLength;
+
+				Quadric borderQuadric;
+				borderQuadric.AddPlane(edgeNormal.x, edgeNormal.y, edgeNormal.z, -glm::dot(edgeNormal, m_vertices[a].pos),
+					kBorderPlaneWeight * edgeLength * edgeLength);
+				m_quadrics[a].Add(borderQuadric);
+				m_quadrics[b].Add(borderQuadric);
+			}
+		}
+	}
+
+	static uint64_t GetEdgeKey(uint32_t a, uint32_t b)
+	{
+		return (static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b);
+	}
+
+	bool IsBorderEdge(uint32_t a, uint32_t b) const
+	{
+		uint32_t sharedCount = 0;
+		for (uint32_t triangle : m_vertexTriangles[a])
+		{
+			if (m_isTriangleLive[triangle] && HasVertex(triangle, b))
+			{
+				sharedCount++;
+			}
+		}
+
+		return sharedCount == 1;
+	}
+
+	bool HasVertex(uint32_t triangle, uint32_t vertex) const
+	{
+		return m_indices[triangle * 3 + 0] == vertex || m_indices[triangle * 3 + 1] == vertex || m_indices[triangle * 3 + 2] == vertex;
+	}
+
+	bool CanMove(uint32_t source, uint32_t target) const
+	{
+		switch (m_kinds[source])
+		{
+			case VertexKind::Manifold:
+				return true;
+
+			case VertexKind::Border:
+				return m_kinds[target] != VertexKind::Manifold && IsBorderEdge(source, target);
+
+			case VertexKind::Locked:
+				return false;
+		}
+
+		return false;
+	}
+
+	double GetCost(uint32_t source, uint32_t target) const
+	{
+		Quadric quadric = m_quadrics[source];
+		quadric.Add(m_quadrics[target]);
+
+		return quadric.Evaluate(m_vertices[target].pos);
+	}
+
+	void PushEdge(std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>>& collapses,
+		uint32_t a, uint32_t b) const
+	{
+		// Whichever way round is allowed and cheaper.
+		bool canMoveA = CanMove(a, b);
+		bool canMoveB = CanMove(b, a);
+		if (!canMoveA && !canMoveB)
+		{
+			return;
+		}
+
+		double costA = canMoveA ? GetCost(a, b) : 0.0;
+		double costB = canMoveB ? GetCost(b, a) : 0.0;
+
+		if (canMoveA && (!canMoveB || costA <= costB))
+		{
+			collapses.push({costA, a, b, m_versions[a], m_versions[b]});
+		}
+		else
+		{
+			collapses.push({costB, b, a, m_versions[b], m_versions[a]});
+		}
+	}
+
+	// Would moving the source turn any of its triangles over?
+	bool IsFolding(uint32_t source, uint32_t target) const
+	{
+		for (uint32_t triangle : m_vertexTriangles[source])
+		{
+			// The triangles with both vertices are the ones which collapse away.
+			if (!m_isTriangleLive[triangle] || HasVertex(triangle, target))
+			{
+				continue;
+			}
+
+			glm::vec3 before[3];
+			glm::vec3 after[3];
+			for (uint32_t corner = 0; corner < 3; ++corner)
+			{
+				uint32_t vertex = m_indices[triangle * 3 + corner];
+				before[corner] = m_vertices[vertex].pos;
+				after[corner] = vertex == source ? m_vertices[target].pos : before[corner];
+			}
+
+			glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+			glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+
+			if (glm::dot(normalBefore, normalBefore) > 0.0f && glm::dot(normalBefore, normalAfter) <= 0.0f)
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	void Apply(uint32_t source, uint32_t target)
+	{
+		m_quadrics[target].Add(m_quadrics[source]);
+		m_isVertexLive[source] = false;
+		m_versions[target]++;
+
+		for (uint32_t triangle : m_vertexTriangles[source])
+		{
+			if (!m_isTriangleLive[triangle])
+			{
+				continue;
+			}
+
+			if (HasVertex(triangle, target))
+			{
+				m_isTriangleLive[triangle] = false;
+				m_liveTriangleCount--;
+				continue;
+			}
+
+			for (uint32_t corner = 0; corner < 3; ++corner)
+			{
+				if (m_indices[triangle * 3 + corner] == source)
+				{
+					m_indices[triangle * 3 + corner] = target;
+				}
+			}
+
+			m_vertexTriangles[target].push_back(triangle);
+		}
+
+		m_vertexTriangles[source].clear();
+
+		auto& targetTriangles = m_vertexTriangles[target];
+		targetTriangles.erase(std::remove_if(targetTriangles.begin(), targetTriangles.end(),
+			[this](uint32_t triangle) { return !m_isTriangleLive[triangle]; }), targetTriangles.end());
+	}
+
+	std::vector<uint32_t> GetNeighbours(uint32_t vertex) const
+	{
+		std::vector<uint32_t> neighbours;
+		for (uint32_t triangle : m_vertexTriangles[vertex])
+		{
+			for (uint32_t corner = 0; corner < 3; ++corner)
+			{
+				uint32_t neighbour = m_indices[triangle * 3 + corner];
+				if (neighbour != vertex && std::find(neighbours.begin(), neighbours.end(), neighbour) == neighbours.end())
+				{
+					neighbours.push_back(neighbour);
+				}
+			}
+		}
+
+		return neighbours;
+	}
+
+	const std::vector<Vertex>& m_vertices;
+
+	// A working copy, rewritten as vertices move.
+	std::vector<uint32_t> m_indices {};
+
+	uint32_t m_triangleCount {0};
+	uint32_t m_liveTriangleCount {0};
+	std::vector<bool> m_isTriangleLive {};
+
+	std::vector<Quadric> m_quadrics {};
+	std::vector<VertexKind> m_kinds {};
+	std::vector<uint32_t> m_versions {};
+	std::vector<bool> m_isVertexLive {};
+
+	// Every triangle each vertex is in. Triangles which have collapsed away are left until they are next in the way.
+	std::vector<std::vector<uint32_t>> m_vertexTriangles {};
+
+	double m_maxErrorSquared {0.0};
+};
+
+
+std::vector<uint32_t> SimplifyMesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, uint32_t targetIndexCount,
+	float maxError, float* pError)
+{
+	if (indices.size() % 3 != 0)
+	{
+		throw std::runtime_error("indices must be a list of triangles");
+	}
+
+	for (uint32_t index : indices)
+	{
+		if (index >= vertices.size())
+		{
+			throw std::runtime_error("vertex index out of range");
+		}
+	}
+
+	EdgeCollapser collapser {vertices, indices};
+	collapser.Simplify(targetIndexCount, static_cast<double>(maxError) * maxError);
+
+	if (pError)
+	{
+		*pError = collapser.GetError();
+	}
+
+	return collapser.GetIndices();
+}
+
+
+std::vector<MeshLod> BuildLodChain(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+	std::vector<MeshLod> lods = {{0, static_cast<uint32_t>(indices.size()), 0.0f}};
+
+	std::vector<uint32_t> previous = indices;
+	float error = 0.0f;
+
+	while (lods.size() < kMaxLodCount && previous.size() / 3 > kMinLodTriangleCount)
+	{
+		uint32_t targetIndexCount = static_cast<uint32_t>(previous.size() / 3 * kLodTriangleRatio) * 3;
+
+		float levelError = 0.0f;
+		std::vector<uint32_t> level = SimplifyMesh(vertices, previous, targetIndexCount, std::numeric_limits<float>::max(), &levelError);
+
+		if (level.size() > previous.size() * kMinLodTriangleRatio)
+		{
+			break;
+		}
+
+		// Each level is measured against the one before, so the errors add up.
+		error += levelError;
+
+		OptimiseVertexCache(level, static_cast<uint32_t>(vertices.size()));
+
+		lods.push_back({static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(level.size()), error});
+		indices.insert(indices.end(), level.begin(), level.end());
+
+		previous = std::move(level);
+	}
+
+	return lods;
+}
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+// STD.
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+
+namespace Jettison::Renderer
+{
+// Defined in Pipeline.h, which includes this for the models' levels of detail.
+struct Vertex;
+
+
+// The most levels of detail a model has, counting the full detail one.
+constexpr uint32_t kMaxLodCount = 8;
+
+// Each level aims for this fraction of the previous level's triangles.
+constexpr float kLodTriangleRatio = 0.5f;
+
+// The chain stops at the first level which can't get below this fraction of the previous level's triangles, since it
+// wouldn't save enough to be worth a level.
+constexpr float kMinLodTriangleRatio = 0.85f;
+
+// Nor is it worth simplifying meshes this small any further.
+constexpr uint32_t kMinLodTriangleCount = 32;
+
+
+// A level of detail, as a range of the model's indices.
+struct MeshLod
+{
+	uint32_t firstIndex {0};
+	uint32_t indexCount {0};
+
+	// How far the level's surface strays from the full detail one, in the mesh's units, as the quadrics estimate it.
+	// Zero for the full detail level. It can be out by a factor of two or so on curved surfaces, which the screen
+	// space threshold LODs are picked with allows for.
+	float error {0.0f};
+};
+
+
+// Collapse edges, cheapest first by Garland and Heckbert's quadric error metric, until there are no more than the
+// target number of indices or the next collapse would stray further than the maximum error. Every collapse moves a
+// vertex onto one of its neighbours, so the result indexes the same vertices as the original. Vertices on UV seams
+// and on the mesh's border stay where they are, apart from borders sliding along themselves, so the outline and the
+// texture mapping hold up. The error of the result, in the mesh's units, is written to pError if it isn't null.
+std::vector<uint32_t> SimplifyMesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, uint32_t targetIndexCount,
+	float maxError = std::numeric_limits<float>::max(), float* pError = nullptr);
+
+// Simplify the indices into a chain of levels, each from the one before, and append them to the indices. Each level
+// is optimised for the vertex cache. Returns every level, the first being the original indices.
+std::vector<MeshLod> BuildLodChain(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+}
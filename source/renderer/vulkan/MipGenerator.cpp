@@ -0,0 +1,514 @@
+#include "MipGenerator.h"
+
+// STD.
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#include "Pipeline.h"
+
+
+namespace Jettison::Renderer
+{
+// Must match kSrgbLevels in downsample.comp.
+constexpr uint32_t kDownsampleSrgbLevels = 1;
+
+// Each dispatch's counter has a stride of its own, which meets the largest storage buffer offset alignment a device
+// is allowed to ask for.
+constexpr VkDeviceSize kDownsampleCounterStride = 256;
+
+// Indexed by kind.
+static const std::array<const char*, 4> kDownsampleShaderPaths {"assets/shaders/downsample.comp.spv", "assets/shaders/downsample_hdr.comp.spv",
+	"assets/shaders/downsample_depth.comp.spv", "assets/shaders/downsample_depth_ms.comp.spv"};
+
+
+// A view of a single level, for sampling or storage.
+static VkImageView CreateLevelView(VkDevice device, VkImage image, VkFormat format, uint32_t level)
+{
+	VkImageViewCreateInfo viewInfo {};
+	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.image = image;
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.format = format;
+	viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1};
+
+	VkImageView levelView;
+	if (vkCreateImageView(device, &viewInfo, nullptr, &levelView) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create mip level view");
+	}
+
+	return levelView;
+}
+
+
+void MipGenerator::Init()
+{
+	VkDevice device = m_pDeviceContext->GetLogicalDevice();
+
+	// The level above the first, every level the dispatch writes, and the counter.
+	std::array<VkDescriptorSetLayoutBinding, 3> bindings {};
+	bindings[0].binding = 0;
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	bindings[0].descriptorCount = 1;
+	bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	bindings[1].binding = 1;
+	bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	bindings[1].descriptorCount = kMaxDownsampleLevels;
+	bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	bindings[2].binding = 2;
+	bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	bindings[2].descriptorCount = 1;
+	bindings[2].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutInfo.pBindings = bindings.data();
+
+	if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &m_descriptorSetLayout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create mip generation descriptor set layout");
+	}
+
+	VkPushConstantRange pushConstantRange {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(DownsampleConstants);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo {};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &m_descriptorSetLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+	if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create mip generation pipeline layout");
+	}
+
+	for (uint32_t kind = 0; kind < static_cast<uint32_t>(DownsampleKind::Count); ++kind)
+	{
+		if (kind == static_cast<uint32_t>(DownsampleKind::DepthMultisampled) && m_pDeviceContext->GetMsaaSamples() == VK_SAMPLE_COUNT_1_BIT)
+		{
+			continue;
+		}
+
+		m_pipelines[kind] = CreateComputePipeline(kDownsampleShaderPaths[kind]);
+	}
+
+	// Texels are fetched directly, so the sampler only needs to exist.
+	VkSamplerCreateInfo samplerInfo {};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_NEAREST;
+	samplerInfo.minFilter = VK_FILTER_NEAREST;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+
+	if (vkCreateSampler(device, &samplerInfo, nullptr, &m_sampler) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create mip generation sampler");
+	}
+}
+
+
+void MipGenerator::Destroy()
+{
+	VkDevice device = m_pDeviceContext->GetLogicalDevice();
+
+	vkDestroySampler(device, m_sampler, nullptr);
+	m_sampler = VK_NULL_HANDLE;
+
+	for (auto& pipeline : m_pipelines)
+	{
+		vkDestroyPipeline(device, pipeline, nullptr);
+		pipeline = VK_NULL_HANDLE;
+	}
+
+	vkDestroyPipelineLayout(device, m_pipelineLayout, nullptr);
+	m_pipelineLayout = VK_NULL_HANDLE;
+	vkDestroyDescriptorSetLayout(device, m_descriptorSetLayout, nullptr);
+	m_descriptorSetLayout = VK_NULL_HANDLE;
+}
+
+
+VkPipeline MipGenerator::CreateComputePipeline(const std::string& shaderPath)
+{
+	VkShaderModule shaderModule = m_pDeviceContext->CreateShaderModule(Pipeline::ReadFile(shaderPath));
+
+	VkComputePipelineCreateInfo pipelineInfo {};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = shaderModule;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = m_pipelineLayout;
+
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	m_pDeviceContext->GetPipelineCache().CreateComputePipeline(pipelineInfo, pipeline);
+
+	vkDestroyShaderModule(m_pDeviceContext->GetLogicalDevice(), shaderModule, nullptr);
+
+	return pipeline;
+}
+
+
+bool MipGenerator::IsFormatSupported(VkFormat format)
+{
+	return format == VK_FORMAT_R8G8B8A8_UNORM || format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_R16G16B16A16_SFLOAT;
+}
+
+
+MipGenerator::DownsampleKind MipGenerator::GetKind(VkFormat format)
+{
+	switch (format)
+	{
+		case VK_FORMAT_R8G8B8A8_UNORM:
+		case VK_FORMAT_R8G8B8A8_SRGB:
+			return DownsampleKind::Rgba8;
+
+		case VK_FORMAT_R16G16B16A16_SFLOAT:
+			return DownsampleKind::Rgba16f;
+
+		default:
+			throw std::runtime_error("unsupported mip generation format");
+	}
+}
+
+
+VkFormat MipGenerator::GetStorageFormat(VkFormat format)
+{
+	return format == VK_FORMAT_R8G8B8A8_SRGB ? VK_FORMAT_R8G8B8A8_UNORM : format;
+}
+
+
+MipChain MipGenerator::CreateChain(VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels)
+{
+	DownsampleKind kind = GetKind(format);
+
+	if (mipLevels <= 1)
+	{
+		return {};
+	}
+
+	std::vector<VkExtent2D> levelExtents;
+	VkExtent2D extent {width, height};
+	for (uint32_t level = 1; level < mipLevels; ++level)
+	{
+		extent = {std::max(1u, extent.width / 2), std::max(1u, extent.height / 2)};
+		levelExtents.push_back(extent);
+	}
+
+	// The first level is sampled in the image's own format, so an sRGB image is decoded as it is read.
+	VkImageView sourceView = CreateLevelView(m_pDeviceContext->GetLogicalDevice(), image, format, 0);
+
+	MipChain chain = CreateDispatches(image, format, kind, 1, {width, height}, levelExtents, sourceView, VK_IMAGE_LAYOUT_GENERAL, 1);
+	chain.sampledViews.push_back(sourceView);
+
+	return chain;
+}
+
+
+MipChain MipGenerator::CreatePyramid(VkImageView depthView, VkImageLayout depthLayout, VkSampleCountFlagBits sampleCount,
+	VkExtent2D depthExtent, VkImage pyramidImage, const std::vector<VkExtent2D>& levelExtents)
+{
+	DownsampleKind kind = sampleCount == VK_SAMPLE_COUNT_1_BIT ? DownsampleKind::Depth : DownsampleKind::DepthMultisampled;
+	if (m_pipelines[static_cast<size_t>(kind)] == VK_NULL_HANDLE)
+	{
+		throw std::runtime_error("no depth pyramid pipeline for the sample count");
+	}
+
+	return CreateDispatches(pyramidImage, VK_FORMAT_R32_SFLOAT, kind, 0, depthExtent, levelExtents, depthView, depthLayout,
+		static_cast<uint32_t>(sampleCount));
+}
+
+
+MipChain MipGenerator::CreateDispatches(VkImage image, VkFormat format, DownsampleKind kind, uint32_t firstLevel, VkExtent2D sourceExtent,
+	const std::vector<VkExtent2D>& levelExtents, VkImageView sourceView, VkImageLayout sourceLayout, uint32_t sampleCount)
+{
+	VkDevice device = m_pDeviceContext->GetLogicalDevice();
+
+	MipChain chain;
+	chain.image = image;
+	chain.firstLevel = firstLevel;
+	chain.levelCount = static_cast<uint32_t>(levelExtents.size());
+
+	// As many levels as one dispatch can manage, unless the sixth is too large for the last group to finish off. Then
+	// the dispatch stops at the sixth, and the next starts from it.
+	std::vector<std::pair<uint32_t, uint32_t>> ranges;
+	for (uint32_t first = 0; first < chain.levelCount;)
+	{
+		uint32_t count = std::min(chain.levelCount - first, kMaxDownsampleLevels);
+		if (count > kDownsampleGroupLevels)
+		{
+			const VkExtent2D& sixthExtent = levelExtents[first + kDownsampleGroupLevels - 1];
+			if (sixthExtent.width > kMaxDownsampleLastGroupSize || sixthExtent.height > kMaxDownsampleLastGroupSize)
+			{
+				count = kDownsampleGroupLevels;
+			}
+		}
+
+		ranges.emplace_back(first, count);
+		first += count;
+	}
+
+	uint32_t dispatchCount = static_cast<uint32_t>(ranges.size());
+
+	// Storage views in the format the shader writes. Later dispatches also sample the last level of the one before,
+	// in the image's own format.
+	VkFormat storageFormat = GetStorageFormat(format);
+	for (uint32_t i = 0; i < chain.levelCount; ++i)
+	{
+		chain.storageViews.push_back(CreateLevelView(device, image, storageFormat, firstLevel + i));
+	}
+
+	for (uint32_t dispatch = 1; dispatch < dispatchCount; ++dispatch)
+	{
+		chain.sampledViews.push_back(CreateLevelView(device, image, format, firstLevel + ranges[dispatch].first - 1));
+	}
+
+	// Host visible, so the counters can start from zero without a fill. After that the last group of each dispatch
+	// puts its counter back to zero itself.
+	m_pDeviceContext->CreateBuffer(dispatchCount * kDownsampleCounterStride, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, chain.counterBuffer, chain.counterAllocation);
+	memset(chain.counterAllocation.pMapped, 0, static_cast<size_t>(dispatchCount * kDownsampleCounterStride));
+
+	std::array<VkDescriptorPoolSize, 3> poolSizes {};
+	poolSizes[0] = {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, dispatchCount};
+	poolSizes[1] = {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, dispatchCount * kMaxDownsampleLevels};
+	poolSizes[2] = {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, dispatchCount};
+
+	VkDescriptorPoolCreateInfo poolInfo {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolInfo.pPoolSizes = poolSizes.data();
+	poolInfo.maxSets = dispatchCount;
+
+	if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &chain.descriptorPool) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create mip generation descriptor pool");
+	}
+
+	std::vector<VkDescriptorSetLayout> layouts(dispatchCount, m_descriptorSetLayout);
+	std::vector<VkDescriptorSet> descriptorSets(dispatchCount);
+
+	VkDescriptorSetAllocateInfo allocInfo {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = chain.descriptorPool;
+	allocInfo.descriptorSetCount = dispatchCount;
+	allocInfo.pSetLayouts = layouts.data();
+
+	if (vkAllocateDescriptorSets(device, &allocInfo, descriptorSets.data()) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to allocate mip generation descriptor sets");
+	}
+
+	bool isSrgb = storageFormat != format;
+
+	for (uint32_t dispatch = 0; dispatch < dispatchCount; ++dispatch)
+	{
+		auto [first, count] = ranges[dispatch];
+		bool isFirst = dispatch == 0;
+
+		VkDescriptorImageInfo sourceInfo {};
+		sourceInfo.sampler = m_sampler;
+		sourceInfo.imageView = isFirst ? sourceView : chain.sampledViews[dispatch - 1];
+		sourceInfo.imageLayout = isFirst ? sourceLayout : VK_IMAGE_LAYOUT_GENERAL;
+
+		// Every element needs a valid view, so those past the last level repeat it. The shader never writes them.
+		std::array<VkDescriptorImageInfo, kMaxDownsampleLevels> levelInfos {};
+		for (uint32_t i = 0; i < kMaxDownsampleLevels; ++i)
+		{
+			levelInfos[i].imageView = chain.storageViews[first + std::min(i, count - 1)];
+			levelInfos[i].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+		}
+
+		VkDescriptorBufferInfo counterInfo {chain.counterBuffer, dispatch * kDownsampleCounterStride, sizeof(uint32_t)};
+
+		std::array<VkWriteDescriptorSet, 3> writes {};
+		writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[0].dstSet = descriptorSets[dispatch];
+		writes[0].dstBinding = 0;
+		writes[0].descriptorCount = 1;
+		writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		writes[0].pImageInfo = &sourceInfo;
+		writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[1].dstSet = descriptorSets[dispatch];
+		writes[1].dstBinding = 1;
+		writes[1].descriptorCount = kMaxDownsampleLevels;
+		writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		writes[1].pImageInfo = levelInfos.data();
+		writes[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[2].dstSet = descriptorSets[dispatch];
+		writes[2].dstBinding = 2;
+		writes[2].descriptorCount = 1;
+		writes[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		writes[2].pBufferInfo = &counterInfo;
+
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+		// Only the attachment itself is multisampled, so only the first dispatch reads it that way.
+		DownsampleKind dispatchKind = !isFirst && kind == DownsampleKind::DepthMultisampled ? DownsampleKind::Depth : kind;
+
+		MipChain::Dispatch& chainDispatch = chain.dispatches.emplace_back();
+		chainDispatch.pipeline = m_pipelines[static_cast<size_t>(dispatchKind)];
+		chainDispatch.descriptorSet = descriptorSets[dispatch];
+
+		DownsampleConstants& constants = chainDispatch.constants;
+		for (uint32_t i = 0; i < kMaxDownsampleLevels; ++i)
+		{
+			const VkExtent2D& levelExtent = levelExtents[first + std::min(i, count - 1)];
+			constants.levelSizes[i][0] = static_cast<int32_t>(levelExtent.width);
+			constants.levelSizes[i][1] = static_cast<int32_t>(levelExtent.height);
+		}
+
+		VkExtent2D dispatchSourceExtent = isFirst ? sourceExtent : levelExtents[first - 1];
+		constants.sourceWidth = static_cast<int32_t>(dispatchSourceExtent.width);
+		constants.sourceHeight = static_cast<int32_t>(dispatchSourceExtent.height);
+		constants.levelCount = static_cast<int32_t>(count);
+		constants.sampleCount = static_cast<int32_t>(isFirst ? sampleCount : 1);
+		constants.flags = isSrgb ? kDownsampleSrgbLevels : 0;
+
+		// A group to each tile of the first level.
+		chainDispatch.groupCountX = (levelExtents[first].width + kDownsampleTileSize - 1) / kDownsampleTileSize;
+		chainDispatch.groupCountY = (levelExtents[first].height + kDownsampleTileSize - 1) / kDownsampleTileSize;
+	}
+
+	return chain;
+}
+
+
+void MipGenerator::RecordGenerate(VkCommandBuffer commandBuffer, const MipChain& chain) const
+{
+	if (chain.dispatches.empty())
+	{
+		return;
+	}
+
+	// The counters were last reset by the previous time the chain was built, if there was one.
+	VkMemoryBarrier counterBarrier {};
+	counterBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	counterBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	counterBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+		1, &counterBarrier, 0, nullptr, 0, nullptr);
+
+	for (size_t i = 0; i < chain.dispatches.size(); ++i)
+	{
+		const MipChain::Dispatch& dispatch = chain.dispatches[i];
+
+		// Each dispatch after the first reads the last level of the one before.
+		if (i > 0)
+		{
+			VkMemoryBarrier levelBarrier {};
+			levelBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			levelBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			levelBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+				1, &levelBarrier, 0, nullptr, 0, nullptr);
+		}
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, dispatch.pipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &dispatch.descriptorSet, 0, nullptr);
+		vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(DownsampleConstants), &dispatch.constants);
+		vkCmdDispatch(commandBuffer, dispatch.groupCountX, dispatch.groupCountY, 1);
+	}
+}
+
+
+void MipGenerator::GenerateMips(VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels)
+{
+	MipChain chain = CreateChain(image, format, width, height, mipLevels);
+
+	UploadManager& uploadManager = m_pDeviceContext->GetUploadManager();
+	uploadManager.RecordGraphicsCommands([this, &chain, image, mipLevels](VkCommandBuffer commandBuffer)
+		{
+			// The upload leaves every level as a transfer destination. The first is read, and the rest overwritten.
+			std::array<VkImageMemoryBarrier, 2> barriers {};
+			for (auto& barrier : barriers)
+			{
+				barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+				barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+				barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barrier.image = image;
+			}
+
+			barriers[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barriers[0].subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+			barriers[0].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			barriers[1].subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 1, mipLevels - 1, 0, 1};
+			barriers[1].srcAccessMask = 0;
+			barriers[1].dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+				0, nullptr, 0, nullptr, mipLevels > 1 ? 2 : 1, barriers.data());
+
+			RecordGenerate(commandBuffer, chain);
+
+			VkImageMemoryBarrier barrier = barriers[0];
+			barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+			barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, 1};
+			barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+				0, nullptr, 0, nullptr, 1, &barrier);
+		});
+
+	// The descriptor sets and views are needed until the batch completes, which may be a while after this frame.
+	DeviceContext* pDeviceContext = m_pDeviceContext.get();
+	uploadManager.RetireWithBatch([pDeviceContext, chain]() mutable
+		{
+			DestroyChain(pDeviceContext, chain);
+		});
+}
+
+
+void MipGenerator::RetireChain(MipChain& chain)
+{
+	DeviceContext* pDeviceContext = m_pDeviceContext.get();
+	MipChain retiredChain = std::move(chain);
+	chain = {};
+
+	m_pDeviceContext->RetireResource([pDeviceContext, retiredChain]() mutable
+		{
+			DestroyChain(pDeviceContext, retiredChain);
+		});
+}
+
+
+void MipGenerator::DestroyChain(DeviceContext* pDeviceContext, MipChain& chain)
+{
+	VkDevice device = pDeviceContext->GetLogicalDevice();
+
+	// Destroying the pool frees its sets.
+	vkDestroyDescriptorPool(device, chain.descriptorPool, nullptr);
+
+	for (auto view : chain.storageViews)
+	{
+		vkDestroyImageView(device, view, nullptr);
+	}
+
+	for (auto view : chain.sampledViews)
+	{
+		vkDestroyImageView(device, view, nullptr);
+	}
+
+	if (chain.counterBuffer != VK_NULL_HANDLE)
+	{
+		pDeviceContext->DestroyBuffer(chain.counterBuffer, chain.counterAllocation);
+	}
+
+	chain = {};
+}
+}
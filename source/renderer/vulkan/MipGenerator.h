@@ -0,0 +1,155 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// STD.
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "DeviceContext.h"
+
+
+namespace Jettison::Renderer
+{
+// The most levels one dispatch builds. Must match MAX_LEVELS in downsample.comp.
+constexpr uint32_t kMaxDownsampleLevels = 12;
+
+// How many levels each group builds on its own, from a 32x32 tile of the first. The last group to finish builds the
+// rest from the sixth level, which it can only do if that's no more than 64x64. Must match GROUP_LEVELS.
+constexpr uint32_t kDownsampleGroupLevels = 6;
+constexpr uint32_t kDownsampleTileSize = 32;
+constexpr uint32_t kMaxDownsampleLastGroupSize = 64;
+
+
+// Pushed with each dispatch. Laid out to match downsample.comp.
+struct DownsampleConstants
+{
+	int32_t levelSizes[kMaxDownsampleLevels][2];
+	int32_t sourceWidth;
+	int32_t sourceHeight;
+	int32_t levelCount;
+	int32_t sampleCount;
+	uint32_t flags;
+};
+
+static_assert(sizeof(DownsampleConstants) == 116, "DownsampleConstants must match the push constants in downsample.comp");
+
+
+// Everything needed to build the levels of one image. Made by the mip generator, and replaced rather than updated,
+// like the views it holds.
+struct MipChain
+{
+	// At most twelve levels at a time, each dispatch reading the last level of the one before.
+	struct Dispatch
+	{
+		VkPipeline pipeline {VK_NULL_HANDLE};
+		VkDescriptorSet descriptorSet {VK_NULL_HANDLE};
+		DownsampleConstants constants {};
+		uint32_t groupCountX {0};
+		uint32_t groupCountY {0};
+	};
+
+	VkImage image {VK_NULL_HANDLE};
+
+	// The levels built, which start at the second for a mip chain, and the first for a depth pyramid.
+	uint32_t firstLevel {0};
+	uint32_t levelCount {0};
+
+	std::vector<Dispatch> dispatches {};
+
+	// Written by the dispatches, and read by the dispatches after them.
+	std::vector<VkImageView> storageViews {};
+	std::vector<VkImageView> sampledViews {};
+
+	// One counter to each dispatch, so the last group can tell it is last.
+	VkBuffer counterBuffer {VK_NULL_HANDLE};
+	Allocation counterAllocation {};
+
+	VkDescriptorPool descriptorPool {VK_NULL_HANDLE};
+};
+
+
+// Builds mip chains and depth pyramids on the GPU, with a compute shader which does up to twelve levels in a single
+// dispatch, rather than a blit and a pair of barriers for every level.
+//
+// Levels are averaged in linear light when the image is sRGB, and the format only needs to support storage through
+// the views the shader writes, rather than blitting with a linear filter. That's RGBA8, UNORM or sRGB, and RGBA16F.
+// Depth pyramids keep the furthest depth instead of the average.
+class MipGenerator
+{
+public:
+	MipGenerator(std::shared_ptr<DeviceContext> pDeviceContext)
+		:m_pDeviceContext {pDeviceContext} {}
+
+	// Disable copying.
+	MipGenerator() = default;
+	MipGenerator(const MipGenerator&) = delete;
+	MipGenerator& operator=(const MipGenerator&) = delete;
+
+	void Init();
+
+	void Destroy();
+
+	// Can a chain be made for images of the format?
+	static bool IsFormatSupported(VkFormat format);
+
+	// For building every level after the first, from the first. The image needs storage and sampled usage, and an
+	// sRGB image must also be created mutable, with extended usage, since it is written through UNORM views. Levels
+	// are half the size of the one before, rounding down, as for any mip chain.
+	MipChain CreateChain(VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels);
+
+	// For building a depth pyramid from a depth attachment, which must be readable in the layout given. The pyramid
+	// is R32_SFLOAT, and its levels round up, so every texel of the attachment is covered.
+	MipChain CreatePyramid(VkImageView depthView, VkImageLayout depthLayout, VkSampleCountFlagBits sampleCount,
+		VkExtent2D depthExtent, VkImage pyramidImage, const std::vector<VkExtent2D>& levelExtents);
+
+	// Record the dispatches. The levels being built must be in the general layout, and so must the first level of a
+	// mip chain. Ends with the levels written, and leaves the barrier for whatever reads them to the caller.
+	void RecordGenerate(VkCommandBuffer commandBuffer, const MipChain& chain) const;
+
+	// Build the rest of a texture's levels once its first has been uploaded, as part of the same upload batch. Every
+	// level is left in SHADER_READ_ONLY_OPTIMAL, for the fragment shaders.
+	void GenerateMips(VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels);
+
+	// Hand the chain to the device context, to be destroyed once the frames in flight are done with it.
+	void RetireChain(MipChain& chain);
+
+	static void DestroyChain(DeviceContext* pDeviceContext, MipChain& chain);
+
+private:
+	enum class DownsampleKind : uint32_t
+	{
+		Rgba8,
+		Rgba16f,
+		Depth,
+		DepthMultisampled,
+		Count,
+	};
+
+	static DownsampleKind GetKind(VkFormat format);
+
+	// The format the levels are written through, e.g. UNORM for an sRGB image.
+	static VkFormat GetStorageFormat(VkFormat format);
+
+	VkPipeline CreateComputePipeline(const std::string& shaderPath);
+
+	// Split the levels into dispatches, then make their views, counters and descriptor sets. The source is the view
+	// the first dispatch reads.
+	MipChain CreateDispatches(VkImage image, VkFormat format, DownsampleKind kind, uint32_t firstLevel, VkExtent2D sourceExtent,
+		const std::vector<VkExtent2D>& levelExtents, VkImageView sourceView, VkImageLayout sourceLayout, uint32_t sampleCount);
+
+	// Vulkan device context.
+	std::shared_ptr<DeviceContext> m_pDeviceContext {nullptr};
+
+	VkDescriptorSetLayout m_descriptorSetLayout {VK_NULL_HANDLE};
+	VkPipelineLayout m_pipelineLayout {VK_NULL_HANDLE};
+
+	// Indexed by kind. The multisampled one only exists when the depth attachment is multisampled.
+	std::array<VkPipeline, static_cast<size_t>(DownsampleKind::Count)> m_pipelines {};
+
+	VkSampler m_sampler {VK_NULL_HANDLE};
+};
+}
@@ -0,0 +1,831 @@
+#include "ObjImporter.h"
+
+// STD.
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#include "MappedFile.h"
+#include "Pipeline.h"
+
+
+namespace Jettison::Renderer
+{
+// Smaller files aren't worth cutting up any further.
+constexpr size_t kMinImportChunkSize = 64 * 1024;
+
+constexpr uint32_t kNoIndex = ~0u;
+
+// Exactly representable, so scaling by them is a single rounding.
+constexpr double kPowersOfTen[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16,
+	1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+// More digits than a 64 bit mantissa holds can't change a float.
+constexpr uint32_t kMaxSignificantDigits = 19;
+
+
+// A vertex as it is welded: position, texture coordinate and normal. Compared bit for bit, so equal keys always hash
+// the same.
+struct WeldKey
+{
+	float values[8];
+};
+
+
+// A face corner, as indices into the whole file's attributes. Missing attributes are kNoIndex.
+struct ObjCorner
+{
+	uint32_t position {kNoIndex};
+	uint32_t texCoord {kNoIndex};
+	uint32_t normal {kNoIndex};
+};
+
+
+// One chunk of whole lines, and everything that comes of it.
+struct ObjChunk
+{
+	const char* pBegin {nullptr};
+	const char* pEnd {nullptr};
+
+	// How many of each attribute and face the chunk declares, then how many attributes the chunks before it declare
+	// between them.
+	uint32_t positionCount {0};
+	uint32_t texCoordCount {0};
+	uint32_t normalCount {0};
+	uint32_t faceCount {0};
+	uint32_t firstPosition {0};
+	uint32_t firstTexCoord {0};
+	uint32_t firstNormal {0};
+
+	// Three for each triangle.
+	std::vector<ObjCorner> corners {};
+
+	// The chunk's welded vertices and their hashes, and each corner's index into them.
+	std::vector<WeldKey> keys {};
+	std::vector<uint64_t> hashes {};
+	std::vector<uint32_t> indices {};
+
+	// The welded vertices sorted by hash partition, and where each partition starts.
+	std::vector<uint32_t> partitionVertices {};
+	std::array<uint32_t, kWeldPartitionCount + 1> partitionStarts {};
+
+	// Each welded vertex's index in the whole mesh.
+	std::vector<uint32_t> remap {};
+
+	// Where the chunk's indices go in the whole mesh.
+	uint32_t firstIndex {0};
+};
+
+
+// The vertices welded by one hash partition.
+struct WeldPartition
+{
+	std::vector<WeldKey> keys {};
+	std::vector<uint64_t> hashes {};
+	uint32_t firstVertex {0};
+};
+
+
+// Open addressing with linear probing, over keys the caller keeps. Each slot holds a key's index and the top half of
+// its hash, so most mismatches are rejected without touching the keys. Grows to stay no more than half full.
+class WeldTable
+{
+public:
+	WeldTable(size_t expectedCount)
+	{
+		size_t capacity = 16;
+		while (capacity < expectedCount * 2)
+		{
+			capacity *= 2;
+		}
+
+		m_slots.assign(capacity, {});
+	}
+
+
+	// Returns the index of an equal key, appending the key and its hash if there isn't one yet.
+	uint32_t FindOrInsert(const WeldKey& key, uint64_t hash, std::vector<WeldKey>& keys, std::vector<uint64_t>& hashes)
+	{
+		uint32_t tag = static_cast<uint32_t>(hash >> 32);
+		size_t mask = m_slots.size() - 1;
+
+		for (size_t slot = hash & mask;; slot = (slot + 1) & mask)
+		{
+			Slot& entry = m_slots[slot];
+
+			if (entry.index == kNoIndex)
+			{
+				uint32_t index = static_cast<uint32_t>(keys.size());
+				keys.push_back(key);
+				hashes.push_back(hash);
+				entry = {index, tag};
+
+				if (keys.size() * 2 > m_slots.size())
+				{
+					Grow(hashes);
+				}
+
+				return index;
+			}
+
+			if (entry.tag == tag && memcmp(&keys[entry.index], &key, sizeof(key)) == 0)
+			{
+				return entry.index;
+			}
+		}
+	}
+
+private:
+	struct Slot
+	{
+		uint32_t index {kNoIndex};
+		uint32_t tag {0};
+	};
+
+
+	// Every key is already known to be unique, so they go straight into the first free slot.
+	void Grow(const std::vector<uint64_t>& hashes)
+	{
+		m_slots.assign(m_slots.size() * 2, {});
+		size_t mask = m_slots.size() - 1;
+
+		for (uint32_t index = 0; index < hashes.size(); ++index)
+		{
+			size_t slot = hashes[index] & mask;
+			while (m_slots[slot].index != kNoIndex)
+			{
+				slot = (slot + 1) & mask;
+			}
+
+			m_slots[slot] = {index, static_cast<uint32_t>(hashes[index] >> 32)};
+		}
+	}
+
+
+	std::vector<Slot> m_slots {};
+};
+
+
+// Each word is mixed in with a multiply, then the result is finished with MurmurHash3's avalanche, so similar vertices
+// land far apart in the table. Unlike combining the components' std::hash with XOR, nearby grid points don't collide.
+static uint64_t HashKey(const WeldKey& key)
+{
+	uint64_t words[4];
+	memcpy(words, key.values, sizeof(words));
+
+	uint64_t hash = 0x243f6a8885a308d3ull;
+	for (uint64_t word : words)
+	{
+		hash ^= word;
+		hash *= 0x9e3779b97f4a7c15ull;
+		hash ^= hash >> 29;
+	}
+
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdull;
+	hash ^= hash >> 33;
+	hash *= 0xc4ceb9fe1a85ec53ull;
+	hash ^= hash >> 33;
+
+	return hash;
+}
+
+
+static uint32_t GetWeldPartition(uint64_t hash)
+{
+	// Neither the bits the tables index with nor their tags, so each partition's table still sees well spread hashes.
+	return static_cast<uint32_t>((hash >> 20) % kWeldPartitionCount);
+}
+
+
+// Run the tasks on up to the given number of threads, the calling thread included, each taking the next task as it
+// finishes the last. The first exception thrown is rethrown once every thread has stopped.
+template <typename Function>
+static void RunTasks(uint32_t threadCount, uint32_t taskCount, const Function& function)
+{
+	std::atomic<uint32_t> nextTask {0};
+	std::exception_ptr pError {nullptr};
+	std::mutex errorMutex;
+
+	auto worker = [&]()
+	{
+		for (uint32_t task = nextTask++; task < taskCount; task = nextTask++)
+		{
+			try
+			{
+				function(task);
+			}
+			catch (...)
+			{
+				std::lock_guard<std::mutex> lock(errorMutex);
+				if (!pError)
+				{
+					pError = std::current_exception();
+				}
+
+				nextTask = taskCount;
+			}
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (uint32_t i = 1; i < std::min(threadCount, taskCount); ++i)
+	{
+		threads.emplace_back(worker);
+	}
+
+	worker();
+
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+
+	if (pError)
+	{
+		std::rethrow_exception(pError);
+	}
+}
+
+
+static bool IsBlank(char character)
+{
+	return character == ' ' || character == '\t';
+}
+
+
+static bool IsDigit(char character)
+{
+	return character >= '0' && character <= '9';
+}
+
+
+static void SkipBlanks(const char*& p, const char* pEnd)
+{
+	while (p < pEnd && IsBlank(*p))
+	{
+		++p;
+	}
+}
+
+
+// Call the function with each line, without its line ending.
+template <typename Function>
+static void ForEachLine(const char* pBegin, const char* pEnd, const Function& function)
+{
+	while (pBegin < pEnd)
+	{
+		const char* pLineEnd = static_cast<const char*>(memchr(pBegin, '\n', pEnd - pBegin));
+		if (!pLineEnd)
+		{
+			pLineEnd = pEnd;
+		}
+
+		const char* pContentEnd = pLineEnd;
+		if (pContentEnd > pBegin && pContentEnd[-1] == '\r')
+		{
+			--pContentEnd;
+		}
+
+		function(pBegin, pContentEnd);
+		pBegin = pLineEnd + 1;
+	}
+}
+
+
+enum class ObjLineType
+{
+	Other,
+	Position,
+	TexCoord,
+	Normal,
+	Face,
+};
+
+
+// Which statement the line holds, leaving p just past its keyword.
+static ObjLineType GetLineType(const char*& p, const char* pEnd)
+{
+	SkipBlanks(p, pEnd);
+
+	size_t length = pEnd - p;
+	if (length >= 2 && p[0] == 'v' && IsBlank(p[1]))
+	{
+		p += 1;
+		return ObjLineType::Position;
+	}
+
+	if (length >= 3 && p[0] == 'v' && (p[1] == 't' || p[1] == 'n') && IsBlank(p[2]))
+	{
+		ObjLineType lineType = p[1] == 't' ? ObjLineType::TexCoord : ObjLineType::Normal;
+		p += 2;
+		return lineType;
+	}
+
+	if (length >= 2 && p[0] == 'f' && IsBlank(p[1]))
+	{
+		p += 1;
+		return ObjLineType::Face;
+	}
+
+	return ObjLineType::Other;
+}
+
+
+// Parse a decimal number, after any blanks. Returns false if there isn't one, or it runs into something else.
+static bool ParseFloat(const char*& p, const char* pEnd, float& value)
+{
+	SkipBlanks(p, pEnd);
+
+	bool isNegative = false;
+	if (p < pEnd && (*p == '-' || *p == '+'))
+	{
+		isNegative = *p == '-';
+		++p;
+	}
+
+	uint64_t mantissa = 0;
+	int32_t exponent = 0;
+	uint32_t significantDigits = 0;
+	bool hasDigits = false;
+
+	for (; p < pEnd && IsDigit(*p); ++p)
+	{
+		hasDigits = true;
+		if (significantDigits < kMaxSignificantDigits)
+		{
+			mantissa = mantissa * 10 + (*p - '0');
+			significantDigits += mantissa != 0 ? 1 : 0;
+		}
+		else
+		{
+			++exponent;
+		}
+	}
+
+	if (p < pEnd && *p == '.')
+	{
+		for (++p; p < pEnd && IsDigit(*p); ++p)
+		{
+			hasDigits = true;
+			if (significantDigits < kMaxSignificantDigits)
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+				significantDigits += mantissa != 0 ? 1 : 0;
+				--exponent;
+			}
+		}
+	}
+
+	if (!hasDigits)
+	{
+		return false;
+	}
+
+	if (p < pEnd && (*p == 'e' || *p == 'E'))
+	{
+		++p;
+
+		bool isExponentNegative = false;
+		if (p < pEnd && (*p == '-' || *p == '+'))
+		{
+			isExponentNegative = *p == '-';
+			++p;
+		}
+
+		if (p == pEnd || !IsDigit(*p))
+		{
+			return false;
+		}
+
+		int32_t explicitExponent = 0;
+		for (; p < pEnd && IsDigit(*p); ++p)
+		{
+			explicitExponent = std::min(explicitExponent * 10 + (*p - '0'), 1000);
+		}
+
+		exponent += isExponentNegative ? -explicitExponent : explicitExponent;
+	}
+
+	if (p < pEnd && !IsBlank(*p))
+	{
+		return false;
+	}
+
+	double result = static_cast<double>(mantissa);
+	for (; exponent > 22; exponent -= 22)
+	{
+		result *= kPowersOfTen[22];
+	}
+
+	for (; exponent < -22; exponent += 22)
+	{
+		result /= kPowersOfTen[22];
+	}
+
+	result = exponent >= 0 ? result * kPowersOfTen[exponent] : result / kPowersOfTen[-exponent];
+	value = static_cast<float>(isNegative ? -result : result);
+
+	return true;
+}
+
+
+static bool ParseInteger(const char*& p, const char* pEnd, int64_t& value)
+{
+	bool isNegative = p < pEnd && *p == '-';
+	if (isNegative)
+	{
+		++p;
+	}
+
+	if (p == pEnd || !IsDigit(*p))
+	{
+		return false;
+	}
+
+	value = 0;
+	for (; p < pEnd && IsDigit(*p); ++p)
+	{
+		value = std::min<int64_t>(value * 10 + (*p - '0'), kNoIndex);
+	}
+
+	value = isNegative ? -value : value;
+
+	return true;
+}
+
+
+// OBJ counts from one, or back from the most recent attribute when negative.
+static uint32_t ResolveIndex(int64_t index, uint32_t countSoFar)
+{
+	int64_t resolved = index > 0 ? index - 1 : countSoFar + index;
+	if (index == 0 || resolved < 0 || resolved >= kNoIndex)
+	{
+		throw std::runtime_error("obj file has an invalid index");
+	}
+
+	return static_cast<uint32_t>(resolved);
+}
+
+
+static void CountAttributes(ObjChunk& chunk)
+{
+	ForEachLine(chunk.pBegin, chunk.pEnd, [&chunk](const char* p, const char* pEnd)
+		{
+			switch (GetLineType(p, pEnd))
+			{
+				case ObjLineType::Position: chunk.positionCount++; break;
+				case ObjLineType::TexCoord: chunk.texCoordCount++; break;
+				case ObjLineType::Normal: chunk.normalCount++; break;
+				case ObjLineType::Face: chunk.faceCount++; break;
+				default: break;
+			}
+		});
+}
+
+
+// The attributes go straight into the whole file's arrays, at the chunk's offsets.
+static void ParseChunk(ObjChunk& chunk, std::vector<float>& positions, std::vector<float>& texCoords, std::vector<float>& normals)
+{
+	uint32_t positionCount = 0;
+	uint32_t texCoordCount = 0;
+	uint32_t normalCount = 0;
+	std::vector<ObjCorner> faceCorners;
+
+	// Enough if every face is a triangle.
+	chunk.corners.reserve(static_cast<size_t>(chunk.faceCount) * 3);
+
+	ForEachLine(chunk.pBegin, chunk.pEnd, [&](const char* p, const char* pEnd)
+		{
+			switch (GetLineType(p, pEnd))
+			{
+				case ObjLineType::Position:
+				{
+					// Anything after the position, e.g. a w or a colour, is ignored.
+					float* pPosition = &positions[(static_cast<size_t>(chunk.firstPosition) + positionCount++) * 3];
+					if (!ParseFloat(p, pEnd, pPosition[0]) || !ParseFloat(p, pEnd, pPosition[1]) || !ParseFloat(p, pEnd, pPosition[2]))
+					{
+						throw std::runtime_error("obj file has a malformed vertex");
+					}
+
+					break;
+				}
+
+				case ObjLineType::TexCoord:
+				{
+					// V is optional.
+					float* pTexCoord = &texCoords[(static_cast<size_t>(chunk.firstTexCoord) + texCoordCount++) * 2];
+					if (!ParseFloat(p, pEnd, pTexCoord[0]))
+					{
+						throw std::runtime_error("obj file has a malformed texture coordinate");
+					}
+
+					SkipBlanks(p, pEnd);
+					pTexCoord[1] = 0.0f;
+					if (p < pEnd && !ParseFloat(p, pEnd, pTexCoord[1]))
+					{
+						throw std::runtime_error("obj file has a malformed texture coordinate");
+					}
+
+					break;
+				}
+
+				case ObjLineType::Normal:
+				{
+					float* pNormal = &normals[(static_cast<size_t>(chunk.firstNormal) + normalCount++) * 3];
+					if (!ParseFloat(p, pEnd, pNormal[0]) || !ParseFloat(p, pEnd, pNormal[1]) || !ParseFloat(p, pEnd, pNormal[2]))
+					{
+						throw std::runtime_error("obj file has a malformed normal");
+					}
+
+					break;
+				}
+
+				case ObjLineType::Face:
+				{
+					faceCorners.clear();
+
+					for (SkipBlanks(p, pEnd); p < pEnd && *p != '#'; SkipBlanks(p, pEnd))
+					{
+						// Position, position/texcoord, position//normal or position/texcoord/normal.
+						ObjCorner corner;
+						int64_t index;
+						if (!ParseInteger(p, pEnd, index))
+						{
+							throw std::runtime_error("obj file has a malformed face");
+						}
+
+						corner.position = ResolveIndex(index, chunk.firstPosition + positionCount);
+
+						if (p < pEnd && *p == '/')
+						{
+							++p;
+							if (p < pEnd && *p != '/')
+							{
+								if (!ParseInteger(p, pEnd, index))
+								{
+									throw std::runtime_error("obj file has a malformed face");
+								}
+
+								corner.texCoord = ResolveIndex(index, chunk.firstTexCoord + texCoordCount);
+							}
+
+							if (p < pEnd && *p == '/')
+							{
+								++p;
+								if (!ParseInteger(p, pEnd, index))
+								{
+									throw std::runtime_error("obj file has a malformed face");
+								}
+
+								corner.normal = ResolveIndex(index, chunk.firstNormal + normalCount);
+							}
+						}
+
+						if (p < pEnd && !IsBlank(*p))
+						{
+							throw std::runtime_error("obj file has a malformed face");
+						}
+
+						faceCorners.push_back(corner);
+					}
+
+					// A fan around the first corner. Points and lines have no triangles.
+					for (size_t i = 2; i < faceCorners.size(); ++i)
+					{
+						chunk.corners.push_back(faceCorners[0]);
+						chunk.corners.push_back(faceCorners[i - 1]);
+						chunk.corners.push_back(faceCorners[i]);
+					}
+
+					break;
+				}
+
+				default:
+					break;
+			}
+		});
+}
+
+
+// Gather each corner's attributes and weld the identical ones, within the chunk.
+static void WeldChunk(ObjChunk& chunk, const std::vector<float>& positions, const std::vector<float>& texCoords, const std::vector<float>& normals)
+{
+	size_t positionCount = positions.size() / 3;
+	size_t texCoordCount = texCoords.size() / 2;
+	size_t normalCount = normals.size() / 3;
+
+	// Most meshes share each vertex between several triangles, so this is usually plenty.
+	WeldTable table(chunk.corners.size() / 4);
+	chunk.indices.resize(chunk.corners.size());
+
+	for (size_t i = 0; i < chunk.corners.size(); ++i)
+	{
+		const ObjCorner& corner = chunk.corners[i];
+		if (corner.position >= positionCount || (corner.texCoord != kNoIndex && corner.texCoord >= texCoordCount)
+			|| (corner.normal != kNoIndex && corner.normal >= normalCount))
+		{
+			throw std::runtime_error("obj file has a face using an attribute which doesn't exist");
+		}
+
+		// Missing attributes are zero. The texture is flipped vertically, since OBJ puts V's origin at the bottom.
+		WeldKey key {};
+		memcpy(key.values, &positions[static_cast<size_t>(corner.position) * 3], sizeof(float) * 3);
+
+		if (corner.texCoord != kNoIndex)
+		{
+			key.values[3] = texCoords[static_cast<size_t>(corner.texCoord) * 2];
+			key.values[4] = 1.0f - texCoords[static_cast<size_t>(corner.texCoord) * 2 + 1];
+		}
+
+		if (corner.normal != kNoIndex)
+		{
+			memcpy(&key.values[5], &normals[static_cast<size_t>(corner.normal) * 3], sizeof(float) * 3);
+		}
+
+		chunk.indices[i] = table.FindOrInsert(key, HashKey(key), chunk.keys, chunk.hashes);
+	}
+
+	chunk.corners.clear();
+	chunk.corners.shrink_to_fit();
+
+	// A counting sort, so each partition's merge only visits its own vertices.
+	for (uint64_t hash : chunk.hashes)
+	{
+		chunk.partitionStarts[GetWeldPartition(hash) + 1]++;
+	}
+
+	for (uint32_t partition = 0; partition < kWeldPartitionCount; ++partition)
+	{
+		chunk.partitionStarts[partition + 1] += chunk.partitionStarts[partition];
+	}
+
+	std::array<uint32_t, kWeldPartitionCount> nextVertex;
+	std::copy(chunk.partitionStarts.begin(), chunk.partitionStarts.end() - 1, nextVertex.begin());
+
+	chunk.partitionVertices.resize(chunk.keys.size());
+	for (uint32_t i = 0; i < chunk.keys.size(); ++i)
+	{
+		chunk.partitionVertices[nextVertex[GetWeldPartition(chunk.hashes[i])]++] = i;
+	}
+}
+
+
+ObjMesh ImportObjMesh(const std::string& path, uint32_t threadCount, ObjImportStats* pStats)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	if (threadCount == 0)
+	{
+		threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+	}
+
+	threadCount = std::min(threadCount, kMaxImportThreads);
+
+	MappedFile file;
+	if (!file.Open(path))
+	{
+		throw std::runtime_error("failed to read " + path);
+	}
+
+	const char* pData = reinterpret_cast<const char*>(file.GetData());
+	size_t size = file.GetSize();
+
+	// Cut the file into chunks of whole lines.
+	uint32_t chunkCount = static_cast<uint32_t>(std::clamp<size_t>(size / kMinImportChunkSize, 1, threadCount * kImportChunksPerThread));
+	std::vector<ObjChunk> chunks(chunkCount);
+
+	const char* pChunkBegin = pData;
+	for (uint32_t i = 0; i < chunkCount; ++i)
+	{
+		const char* pChunkEnd = pData + size;
+		if (i + 1 < chunkCount)
+		{
+			pChunkEnd = std::max(pChunkBegin, pData + size * (i + 1) / chunkCount);
+			const char* pNewline = static_cast<const char*>(memchr(pChunkEnd, '\n', pData + size - pChunkEnd));
+			pChunkEnd = pNewline ? pNewline + 1 : pData + size;
+		}
+
+		chunks[i].pBegin = pChunkBegin;
+		chunks[i].pEnd = pChunkEnd;
+		pChunkBegin = pChunkEnd;
+	}
+
+	// A quick pass to count the attributes, so each chunk knows where its own go and what negative indices refer to.
+	RunTasks(threadCount, chunkCount, [&chunks](uint32_t chunk) { CountAttributes(chunks[chunk]); });
+
+	uint32_t positionCount = 0;
+	uint32_t texCoordCount = 0;
+	uint32_t normalCount = 0;
+	for (auto& chunk : chunks)
+	{
+		chunk.firstPosition = positionCount;
+		chunk.firstTexCoord = texCoordCount;
+		chunk.firstNormal = normalCount;
+		positionCount += chunk.positionCount;
+		texCoordCount += chunk.texCoordCount;
+		normalCount += chunk.normalCount;
+	}
+
+	std::vector<float> positions(static_cast<size_t>(positionCount) * 3);
+	std::vector<float> texCoords(static_cast<size_t>(texCoordCount) * 2);
+	std::vector<float> normals(static_cast<size_t>(normalCount) * 3);
+
+	RunTasks(threadCount, chunkCount, [&](uint32_t chunk) { ParseChunk(chunks[chunk], positions, texCoords, normals); });
+
+	file.Close();
+
+	auto weldStartTime = std::chrono::high_resolution_clock::now();
+
+	RunTasks(threadCount, chunkCount, [&](uint32_t chunk) { WeldChunk(chunks[chunk], positions, texCoords, normals); });
+
+	// Merge the chunks' vertices, each partition taking the vertices whose hashes fall in it. Going through the chunks
+	// in order keeps the result the same from run to run.
+	size_t chunkVertexCount = 0;
+	for (auto& chunk : chunks)
+	{
+		chunk.remap.resize(chunk.keys.size());
+		chunkVertexCount += chunk.keys.size();
+	}
+
+	std::vector<WeldPartition> partitions(kWeldPartitionCount);
+
+	RunTasks(threadCount, kWeldPartitionCount, [&](uint32_t partitionIndex)
+		{
+			WeldPartition& partition = partitions[partitionIndex];
+			WeldTable table(chunkVertexCount / kWeldPartitionCount);
+
+			for (auto& chunk : chunks)
+			{
+				for (uint32_t j = chunk.partitionStarts[partitionIndex]; j < chunk.partitionStarts[partitionIndex + 1]; ++j)
+				{
+					uint32_t i = chunk.partitionVertices[j];
+					chunk.remap[i] = table.FindOrInsert(chunk.keys[i], chunk.hashes[i], partition.keys, partition.hashes);
+				}
+			}
+		});
+
+	uint32_t vertexCount = 0;
+	for (auto& partition : partitions)
+	{
+		partition.firstVertex = vertexCount;
+		vertexCount += static_cast<uint32_t>(partition.keys.size());
+	}
+
+	uint32_t indexCount = 0;
+	for (auto& chunk : chunks)
+	{
+		chunk.firstIndex = indexCount;
+		indexCount += static_cast<uint32_t>(chunk.indices.size());
+	}
+
+	ObjMesh mesh;
+	mesh.vertices.resize(vertexCount);
+	mesh.indices.resize(indexCount);
+	mesh.hasNormals = normalCount > 0;
+
+	RunTasks(threadCount, kWeldPartitionCount, [&](uint32_t partitionIndex)
+		{
+			const WeldPartition& partition = partitions[partitionIndex];
+			for (size_t i = 0; i < partition.keys.size(); ++i)
+			{
+				const float* pValues = partition.keys[i].values;
+
+				Vertex& vertex = mesh.vertices[partition.firstVertex + i];
+				vertex.pos = {pValues[0], pValues[1], pValues[2]};
+				vertex.color = {1.0f, 1.0f, 1.0f};
+				vertex.texCoord = {pValues[3], pValues[4]};
+				vertex.normal = {pValues[5], pValues[6], pValues[7]};
+			}
+		});
+
+	RunTasks(threadCount, chunkCount, [&](uint32_t chunkIndex)
+		{
+			ObjChunk& chunk = chunks[chunkIndex];
+			for (size_t i = 0; i < chunk.remap.size(); ++i)
+			{
+				chunk.remap[i] += partitions[GetWeldPartition(chunk.hashes[i])].firstVertex;
+			}
+
+			for (size_t i = 0; i < chunk.indices.size(); ++i)
+			{
+				mesh.indices[chunk.firstIndex + i] = chunk.remap[chunk.indices[i]];
+			}
+		});
+
+	if (pStats)
+	{
+		pStats->threadCount = threadCount;
+		pStats->chunkCount = chunkCount;
+		pStats->parseTime = weldStartTime - startTime;
+		pStats->weldTime = std::chrono::high_resolution_clock::now() - weldStartTime;
+	}
+
+	return mesh;
+}
+}
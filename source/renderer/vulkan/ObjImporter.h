@@ -0,0 +1,58 @@
+#pragma once
+
+// STD.
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+namespace Jettison::Renderer
+{
+// Defined in Pipeline.h, which includes this for the models' loading.
+struct Vertex;
+
+
+// Upper limit on import threads, no matter how many cores there are.
+constexpr uint32_t kMaxImportThreads = 32;
+
+// The file is cut into this many chunks for each thread, so a thread which finishes early can take another.
+constexpr uint32_t kImportChunksPerThread = 4;
+
+// The welded vertices are shared out between this many hash partitions, each merged on its own. Fixed, rather than
+// following the thread count, so the vertices come out in the same order however many threads there are.
+constexpr uint32_t kWeldPartitionCount = 64;
+
+
+struct ObjImportStats
+{
+	uint32_t threadCount {0};
+	uint32_t chunkCount {0};
+
+	// Counting the lines, then parsing them.
+	std::chrono::duration<double, std::milli> parseTime {0};
+
+	// Gathering each corner's attributes and welding the identical ones.
+	std::chrono::duration<double, std::milli> weldTime {0};
+};
+
+
+// A triangle list with every identical vertex welded into one.
+struct ObjMesh
+{
+	std::vector<Vertex> vertices {};
+	std::vector<uint32_t> indices {};
+
+	// Did the file have any normals? If not, they are all zero.
+	bool hasNormals {false};
+};
+
+
+// Import the positions, texture coordinates and normals of every face in an OBJ file. Polygons are split into fans.
+// Materials, groups and everything else are ignored.
+//
+// The file is mapped and cut into chunks of whole lines, which are parsed in parallel. Identical vertices are welded
+// within each chunk through an open addressing hash table, then the chunks' vertices are merged through one table per
+// hash partition, also in parallel. Zero threads means one per core. Throws if the file can't be read or is malformed.
+ObjMesh ImportObjMesh(const std::string& path, uint32_t threadCount = 0, ObjImportStats* pStats = nullptr);
+}
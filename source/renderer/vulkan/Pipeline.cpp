@@ -1,22 +1,19 @@
 #include "Pipeline.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <fstream>
 #include <iostream>
 #include <stdexcept>
 
-// STB.
-#define STB_IMAGE_IMPLEMENTATION
-#include <../stb/include/stb_image.h>
-
-// Tiny object loader.
-#define TINYOBJLOADER_IMPLEMENTATION
-#include <../tiny_obj_loader/include/tiny_obj_loader.h>
-
 // GLFW / Vulkan.
 #define GLFW_INCLUDE_VULKAN
 #include <../glfw/include/GLFW/glfw3.h>
 
 //#include "Model.h"
+#include "IndirectScene.h"
+#include "InstanceBuffer.h"
 
 
 namespace Jettison::Renderer
@@ -24,6 +21,12 @@ namespace Jettison::Renderer
 const std::string kModelPath = "assets/models/viking_room.wobj";
 const std::string kTexturePath = "assets/textures/viking_room.png";
 
+const std::string kIndirectVertexShaderPath = "assets/shaders/indirect.vert.spv";
+const std::string kIndirectFragmentShaderPath = "assets/shaders/indirect.frag.spv";
+
+// Size of the uniform ring's region for each frame in flight.
+constexpr VkDeviceSize kUniformRingFrameSize = 1024 * 1024;
+
 //const std::string kModelPath = "assets/models/arakkoa_warrior.obj";
 //const std::string kTexturePath = "assets/models/arakkoa_warrior_CreatureSkin1.png";
 
@@ -36,251 +39,417 @@ const std::string kTexturePath = "assets/textures/viking_room.png";
 
 void Model::Destroy()
 {
-	vkDestroyBuffer(m_pDeviceContext->GetLogicalDevice(), m_indexBuffer, nullptr);
-	vkFreeMemory(m_pDeviceContext->GetLogicalDevice(), m_indexBufferMemory, nullptr);
+	// A model which was decoded, but never had its buffers created, still has the cache mapped.
+	m_cacheFile.Close();
+	m_packedVertices = {};
 
-	vkDestroyBuffer(m_pDeviceContext->GetLogicalDevice(), m_vertexBuffer, nullptr);
-	vkFreeMemory(m_pDeviceContext->GetLogicalDevice(), m_vertexBufferMemory, nullptr);
+	m_pDeviceContext->DestroyBuffer(m_indexBuffer, m_indexBufferAllocation);
+	m_pDeviceContext->DestroyBuffer(m_vertexBuffer, m_vertexBufferAllocation);
 }
 
 
 void Model::LoadModel()
 {
-	tinyobj::attrib_t attrib;
-	std::vector<tinyobj::shape_t> shapes;
-	std::vector<tinyobj::material_t> materials;
-	std::string warn;
-	std::string err;
+	LoadModel(kModelPath);
+}
+
+
+void Model::LoadModel(const std::string& path)
+{
+	Decode(path);
+	CreateBuffers();
+}
+
+
+void Model::Decode(const std::string& path, uint32_t threadCount)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	m_loadStats = {};
+	m_vertices.clear();
+	m_indices.clear();
+	m_lods.clear();
+
+	uint64_t sourceHash = HashFileContents(path);
+	auto cacheStartTime = std::chrono::high_resolution_clock::now();
+	m_loadStats.hashTime = cacheStartTime - startTime;
 
-	if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, kModelPath.c_str()))
+	// Only the first load of a source, or the first after it changes, pays for parsing and processing it.
+	std::string cachePath = GetMeshCachePath(path, m_vertexLayout);
+
+	if (m_cacheFile.Open(cachePath, sourceHash, m_vertexLayout))
+	{
+		const MeshCacheView& mesh = m_cacheFile.GetMesh();
+		m_vertices.assign(mesh.pVertices, mesh.pVertices + mesh.vertexCount);
+		m_indices.assign(mesh.pIndices, mesh.pIndices + mesh.indexCount);
+		m_lods.assign(mesh.pLods, mesh.pLods + mesh.lodCount);
+		m_dequantisation = mesh.dequantisation;
+		m_boundingSphere = mesh.boundingSphere;
+		m_texCoordDensity = mesh.texCoordDensity;
+		m_optimisationStats = mesh.optimisationStats;
+
+		// The mapping stays open until the buffers are filled straight from it.
+		m_loadStats.isCached = true;
+		m_loadStats.cacheTime = std::chrono::high_resolution_clock::now() - cacheStartTime;
+	}
+	else
 	{
-		throw std::runtime_error(warn + err);
+		auto parseStartTime = std::chrono::high_resolution_clock::now();
+		ImportObj(path, threadCount);
+
+		auto processStartTime = std::chrono::high_resolution_clock::now();
+		m_loadStats.parseTime = processStartTime - parseStartTime;
+
+		ProcessMesh();
+
+		// The unpacked vertices are kept, for anything on the CPU which wants them.
+		PackedVertices packed = PackVertices(m_vertices, m_vertexLayout);
+		m_dequantisation = packed.dequantisation;
+		m_packedVertices = std::move(packed.data);
+
+		auto writeStartTime = std::chrono::high_resolution_clock::now();
+		m_loadStats.processTime = writeStartTime - processStartTime;
+
+		MeshCacheView mesh;
+		mesh.layout = m_vertexLayout;
+		mesh.dequantisation = m_dequantisation;
+		mesh.boundingSphere = m_boundingSphere;
+		mesh.texCoordDensity = m_texCoordDensity;
+		mesh.optimisationStats = m_optimisationStats;
+		mesh.pVertices = m_vertices.data();
+		mesh.vertexCount = static_cast<uint32_t>(m_vertices.size());
+		mesh.pPackedVertices = m_packedVertices.data();
+		mesh.packedVertexSize = m_packedVertices.size();
+		mesh.pIndices = m_indices.data();
+		mesh.indexCount = static_cast<uint32_t>(m_indices.size());
+		mesh.pLods = m_lods.data();
+		mesh.lodCount = static_cast<uint32_t>(m_lods.size());
+		WriteMeshCache(cachePath, sourceHash, mesh);
+
+		m_loadStats.cacheTime = std::chrono::high_resolution_clock::now() - writeStartTime;
 	}
 
-	std::unordered_map<Vertex, uint32_t> uniqueVertices {};
+	m_loadStats.totalTime = std::chrono::high_resolution_clock::now() - startTime;
+}
+
+
+void Model::CreateBuffers()
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
 
-	for (const auto& shape : shapes)
+	if (m_loadStats.isCached)
 	{
-		for (const auto& index : shape.mesh.indices)
-		{
-			Vertex vertex {};
+		// The buffers are filled straight from the mapping.
+		const MeshCacheView& mesh = m_cacheFile.GetMesh();
+		CreateVertexBuffer(mesh.pPackedVertices, mesh.packedVertexSize);
+		CreateIndexBuffer(mesh.pIndices, mesh.indexCount);
 
-			size_t vertex_index = index.vertex_index;
-			vertex.pos = {
-				attrib.vertices[3 * vertex_index + 0],
-				attrib.vertices[3 * vertex_index + 1],
-				attrib.vertices[3 * vertex_index + 2]
-			};
+		m_cacheFile.Close();
+	}
+	else
+	{
+		CreateVertexBuffer(m_packedVertices.data(), m_packedVertices.size());
+		CreateIndexBuffer(m_indices.data(), static_cast<uint32_t>(m_indices.size()));
 
-			size_t texcoord_index = index.texcoord_index;
-			vertex.texCoord = {
-				attrib.texcoords[2 * texcoord_index + 0],
-				1.0f - attrib.texcoords[2 * texcoord_index + 1]
-			};
+		m_packedVertices = {};
+	}
 
-			vertex.color = {1.0f, 1.0f, 1.0f};
+	// Both buffers go in a single batch. The renderer won't draw the model until it completes.
+	m_uploadTicket = m_pDeviceContext->GetUploadManager().Submit();
+
+	m_loadStats.totalTime += std::chrono::high_resolution_clock::now() - startTime;
+}
 
-			if (uniqueVertices.count(vertex) == 0)
-			{
-				uniqueVertices[vertex] = static_cast<uint32_t>(m_vertices.size());
-				m_vertices.push_back(vertex);
-			}
 
-			m_indices.push_back(uniqueVertices[vertex]);
+void Model::ImportObj(const std::string& path, uint32_t threadCount)
+{
+	ObjMesh mesh = ImportObjMesh(path, threadCount);
+	m_vertices = std::move(mesh.vertices);
+	m_indices = std::move(mesh.indices);
+
+	if (!mesh.hasNormals)
+	{
+		// Each triangle adds its normal to its corners, weighted by its area, which is what the cross product's
+		// length already is.
+		for (size_t i = 0; i + 2 < m_indices.size(); i += 3)
+		{
+			Vertex& vertex0 = m_vertices[m_indices[i + 0]];
+			Vertex& vertex1 = m_vertices[m_indices[i + 1]];
+			Vertex& vertex2 = m_vertices[m_indices[i + 2]];
+
+			glm::vec3 faceNormal = glm::cross(vertex1.pos - vertex0.pos, vertex2.pos - vertex0.pos);
+			vertex0.normal += faceNormal;
+			vertex1.normal += faceNormal;
+			vertex2.normal += faceNormal;
 		}
-	}
 
-	CreateVertexBuffer();
-	CreateIndexBuffer();
+		for (auto& vertex : m_vertices)
+		{
+			float length = glm::length(vertex.normal);
+			vertex.normal = length > 0.0f ? vertex.normal / length : glm::vec3(0.0f, 0.0f, 1.0f);
+		}
+	}
 }
 
 
-void Model::CreateVertexBuffer()
+void Model::ProcessMesh()
 {
-	VkDeviceSize bufferSize = static_cast<VkDeviceSize>(sizeof(m_vertices[0])) * m_vertices.size();
+	// OBJ files list their triangles in whatever order they were authored, which is rarely kind to the GPU.
+	m_optimisationStats = OptimiseMesh(m_vertices, m_indices);
+
+	// The coarser levels go on the end of the indices, so they share the buffers with the full detail one.
+	m_lods = BuildLodChain(m_vertices, m_indices);
 
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-	m_pDeviceContext->CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+	// Centred on the bounding box, as the mesh pool does, which is close enough for picking levels of detail.
+	if (!m_vertices.empty())
+	{
+		glm::vec3 minimum = m_vertices[0].pos;
+		glm::vec3 maximum = m_vertices[0].pos;
+		for (const auto& vertex : m_vertices)
+		{
+			minimum = glm::min(minimum, vertex.pos);
+			maximum = glm::max(maximum, vertex.pos);
+		}
 
-	void* data;
-	vkMapMemory(m_pDeviceContext->GetLogicalDevice(), stagingBufferMemory, 0, bufferSize, 0, &data);
-	memcpy(data, m_vertices.data(), static_cast<size_t>(bufferSize));
-	vkUnmapMemory(m_pDeviceContext->GetLogicalDevice(), stagingBufferMemory);
+		glm::vec3 centre = (minimum + maximum) * 0.5f;
+		float radius = 0.0f;
+		for (const auto& vertex : m_vertices)
+		{
+			radius = std::max(radius, glm::length(vertex.pos - centre));
+		}
+
+		m_boundingSphere = glm::vec4(centre, radius);
+	}
 
-	m_pDeviceContext->CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_vertexBuffer, m_vertexBufferMemory);
+	// The ratio of the full detail level's area in texture space to its area in the model's space. The square root
+	// turns it from areas into lengths.
+	double texCoordArea = 0.0;
+	double surfaceArea = 0.0;
+	uint32_t indexCount = m_lods.empty() ? static_cast<uint32_t>(m_indices.size()) : m_lods[0].indexCount;
 
-	m_pDeviceContext->CopyBuffer(stagingBuffer, m_vertexBuffer, bufferSize);
+	for (uint32_t i = 0; i + 2 < indexCount; i += 3)
+	{
+		const Vertex& vertex0 = m_vertices[m_indices[i + 0]];
+		const Vertex& vertex1 = m_vertices[m_indices[i + 1]];
+		const Vertex& vertex2 = m_vertices[m_indices[i + 2]];
+
+		glm::vec2 texCoordEdge0 = vertex1.texCoord - vertex0.texCoord;
+		glm::vec2 texCoordEdge1 = vertex2.texCoord - vertex0.texCoord;
+		texCoordArea += std::abs(texCoordEdge0.x * texCoordEdge1.y - texCoordEdge0.y * texCoordEdge1.x) * 0.5;
+		surfaceArea += glm::length(glm::cross(vertex1.pos - vertex0.pos, vertex2.pos - vertex0.pos)) * 0.5;
+	}
 
-	vkDestroyBuffer(m_pDeviceContext->GetLogicalDevice(), stagingBuffer, nullptr);
-	vkFreeMemory(m_pDeviceContext->GetLogicalDevice(), stagingBufferMemory, nullptr);
+	m_texCoordDensity = surfaceArea > 0.0 ? static_cast<float>(std::sqrt(texCoordArea / surfaceArea)) : 0.0f;
 }
 
 
-void Model::CreateIndexBuffer()
+void Model::CreateVertexBuffer(const uint8_t* pData, VkDeviceSize size)
 {
-	VkDeviceSize bufferSize = static_cast<VkDeviceSize>(sizeof(m_indices[0])) * m_indices.size();
+	m_vertexBufferSize = size;
 
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-	m_pDeviceContext->CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+	m_pDeviceContext->CreateBuffer(m_vertexBufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_vertexBuffer, m_vertexBufferAllocation);
 
-	void* data;
-	vkMapMemory(m_pDeviceContext->GetLogicalDevice(), stagingBufferMemory, 0, bufferSize, 0, &data);
-	memcpy(data, m_indices.data(), static_cast<size_t>(bufferSize));
-	vkUnmapMemory(m_pDeviceContext->GetLogicalDevice(), stagingBufferMemory);
+	m_pDeviceContext->GetUploadManager().UploadBuffer(m_vertexBuffer, pData, m_vertexBufferSize, 0,
+		VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+}
 
-	m_pDeviceContext->CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_indexBuffer, m_indexBufferMemory);
 
-	m_pDeviceContext->CopyBuffer(stagingBuffer, m_indexBuffer, bufferSize);
+void Model::CreateIndexBuffer(const uint32_t* pIndices, uint32_t indexCount)
+{
+	VkDeviceSize bufferSize = static_cast<VkDeviceSize>(sizeof(uint32_t)) * indexCount;
+
+	m_pDeviceContext->CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_indexBuffer, m_indexBufferAllocation);
 
-	vkDestroyBuffer(m_pDeviceContext->GetLogicalDevice(), stagingBuffer, nullptr);
-	vkFreeMemory(m_pDeviceContext->GetLogicalDevice(), stagingBufferMemory, nullptr);
+	m_pDeviceContext->GetUploadManager().UploadBuffer(m_indexBuffer, pIndices, bufferSize, 0,
+		VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT);
 }
 
 
 void Pipeline::Init()
 {
-	Create();
+	CreateDeviceResources();
+	CreateAssetResources();
+	CreateSwapchainResources();
 }
 
 
-void Pipeline::Create()
+void Pipeline::CreateDeviceResources()
 {
-	CreateImageViews();
+	// Textures and assets come first, since the pipelines' shaders are loaded through the asset manager.
+	m_pTextureStreamer = std::make_shared<TextureStreamer>(m_pDeviceContext);
+	m_pTextureStreamer->Init();
 
-	CreateRenderPass();
-	
-	// TODO: These weren't being re-created. Should it be moved out?
-	CreateDescriptorSetLayout();
-	
-	CreateGraphicsPipeline();
+	m_pAssetManager = std::make_shared<AssetManager>(m_pDeviceContext, m_pTextureStreamer.get());
+	m_pAssetManager->Init();
 
-	// TODO: Does the command pool need re-creating?
+	m_pMipGenerator = std::make_shared<MipGenerator>(m_pDeviceContext);
+	m_pMipGenerator->Init();
 
-	// Colour images.
-	CreateColorResources();
-	
-	// Depth images.
-	CreateDepthResources();
+	CreateRenderPass();
 
-	// Framebuffer.
-	CreateFramebuffers();
+	CreateDescriptorSetLayout();
 
-	// Texture image.
-	CreateTextureImage();
-	
-	// Texture image view.
-	CreateTextureImageView();
-	
-	// Texture sampler.
-	CreateTextureSampler();
+	CreatePipelineLayout();
+
+	CreateGraphicsPipelines();
 
 	// Uniform buffers.
 	CreateUniformBuffers();
 
 	// Descriptor pool.
 	CreateDescriptorPool();
+}
 
-	// Descriptor set layout.
+
+void Pipeline::CreateAssetResources()
+{
+	// Only the default texture's tail is uploaded here, the rest streams in once it is drawn. Throws if it failed.
+	m_textureAsset = m_pAssetManager->LoadTexture(kTexturePath);
+	m_pAssetManager->Wait(m_textureAsset);
+	m_texture = m_pAssetManager->GetTexture(m_textureAsset);
+
+	// Descriptor sets.
 	CreateDescriptorSets();
 }
 
 
-void Pipeline::Recreate()
+void Pipeline::CreateSwapchainResources()
 {
-	m_pDeviceContext->WaitOnWindowResized();
+	CreateImageViews();
 
-	Destroy();
-	Create();
+	// Depth images. The colour images and framebuffers belong to the render graph.
+	CreateDepthResources();
 }
 
 
-void Pipeline::Destroy()
+void Pipeline::Recreate()
 {
-	// Colour images.
-	vkDestroyImageView(m_pDeviceContext->GetLogicalDevice(), m_colorImageView, nullptr);
-	m_colorImageView = VK_NULL_HANDLE;
-	vkDestroyImage(m_pDeviceContext->GetLogicalDevice(), m_colorImage, nullptr);
-	m_colorImage = VK_NULL_HANDLE;
-	vkFreeMemory(m_pDeviceContext->GetLogicalDevice(), m_colorImageMemory, nullptr);
-	m_colorImageMemory = VK_NULL_HANDLE;
+	// The command buffers of the frames in flight may still be using the old resources, so they are handed over to
+	// the device context to destroy later.
+	RetireSwapchainResources();
 
-	// Depth images.
-	vkDestroyImageView(m_pDeviceContext->GetLogicalDevice(), m_depthImageView, nullptr);
-	m_depthImageView = VK_NULL_HANDLE;
-	vkDestroyImage(m_pDeviceContext->GetLogicalDevice(), m_depthImage, nullptr);
-	m_depthImage = VK_NULL_HANDLE;
-	vkFreeMemory(m_pDeviceContext->GetLogicalDevice(), m_depthImageMemory, nullptr);
-	m_depthImageMemory = VK_NULL_HANDLE;
-
-	// Framebuffer.
-	for (auto framebuffer : m_swapchainFramebuffers)
+	// The render pass, and so the pipeline, only depend on the swapchain's format. It is very unlikely to change on a
+	// resize, but it can when the window moves to a different monitor.
+	if (m_pSwapchain->GetImageFormat() != m_renderPassFormat)
 	{
-		vkDestroyFramebuffer(m_pDeviceContext->GetLogicalDevice(), framebuffer, nullptr);
-	}
-	m_swapchainFramebuffers.clear();
+		m_pDeviceContext->WaitIdle();
 
-	// HACK: Trying to see if this is called when it shouldn't be.
-	if (glfwWindowShouldClose(m_pDeviceContext->GetWindow()->GetGLFWWindow()))
-	{
-		int a = 1;
-		a++;
+		DestroyLayoutPipelines();
+		vkDestroyPipeline(m_pDeviceContext->GetLogicalDevice(), m_indirectPipeline, nullptr);
+		vkDestroyRenderPass(m_pDeviceContext->GetLogicalDevice(), m_renderPass, nullptr);
+
+		CreateRenderPass();
+		CreateGraphicsPipelines();
 	}
 
-	// Command pool.
-	vkFreeCommandBuffers(m_pDeviceContext->GetLogicalDevice(), m_pDeviceContext->GetCommandPool(), static_cast<uint32_t>(m_commandBuffers.size()), m_commandBuffers.data());
+	CreateSwapchainResources();
+}
+
+
+void Pipeline::RecreatePipelines()
+{
+	// The frames in flight may still be drawing with the old pipelines.
+	m_pDeviceContext->WaitIdle();
+
+	DestroyLayoutPipelines();
+	vkDestroyPipeline(m_pDeviceContext->GetLogicalDevice(), m_indirectPipeline, nullptr);
+	m_indirectPipeline = VK_NULL_HANDLE;
+
+	CreateGraphicsPipelines();
+}
+
+
+void Pipeline::Destroy()
+{
+	DestroySwapchainResources();
+	DestroyAssetResources();
+	DestroyDeviceResources();
+}
 
-	vkDestroyPipeline(m_pDeviceContext->GetLogicalDevice(), m_graphicsPipeline, nullptr);
-	m_graphicsPipeline = VK_NULL_HANDLE;
+
+void Pipeline::DestroyDeviceResources()
+{
+	DestroyLayoutPipelines();
+	vkDestroyPipeline(m_pDeviceContext->GetLogicalDevice(), m_indirectPipeline, nullptr);
+	m_indirectPipeline = VK_NULL_HANDLE;
 	vkDestroyPipelineLayout(m_pDeviceContext->GetLogicalDevice(), m_pipelineLayout, nullptr);
 	m_pipelineLayout = VK_NULL_HANDLE;
 	vkDestroyRenderPass(m_pDeviceContext->GetLogicalDevice(), m_renderPass, nullptr);
 	m_renderPass = VK_NULL_HANDLE;
 
-	// Swapchain images.
-	for (auto imageView : m_swapchainImageViews)
-	{
-		vkDestroyImageView(m_pDeviceContext->GetLogicalDevice(), imageView, nullptr);
-		imageView = VK_NULL_HANDLE;
-	}
-	m_swapchainImageViews.clear();
-
 	// Uniform buffers.
-	for (size_t i = 0; i < m_pSwapchain->GetImageCount(); ++i)
-	{
-		vkDestroyBuffer(m_pDeviceContext->GetLogicalDevice(), m_uniformBuffers[i], nullptr);
-		m_uniformBuffers[i] = VK_NULL_HANDLE;
-		vkFreeMemory(m_pDeviceContext->GetLogicalDevice(), m_uniformBuffersMemory[i], nullptr);
-		m_uniformBuffersMemory[i] = VK_NULL_HANDLE;
-	}
+	m_pUniformRing->Destroy();
+	m_pUniformRing = nullptr;
 
 	// Descriptor pool.
 	vkDestroyDescriptorPool(m_pDeviceContext->GetLogicalDevice(), m_descriptorPool, nullptr);
 	m_descriptorPool = VK_NULL_HANDLE;
 
-	// Texture sampler.
-	vkDestroySampler(m_pDeviceContext->GetLogicalDevice(), m_textureSampler, nullptr);
-	m_textureSampler = VK_NULL_HANDLE;
-
-	// Texture image view.
-	vkDestroyImageView(m_pDeviceContext->GetLogicalDevice(), m_textureImageView, nullptr);
-	m_textureImageView = VK_NULL_HANDLE;
-
-	// Texture image.
-	vkDestroyImage(m_pDeviceContext->GetLogicalDevice(), m_textureImage, nullptr);
-	m_textureImage = VK_NULL_HANDLE;
-	vkFreeMemory(m_pDeviceContext->GetLogicalDevice(), m_textureImageMemory, nullptr);
-	m_textureImageMemory = VK_NULL_HANDLE;
-
 	// Descriptor set layout.
 	vkDestroyDescriptorSetLayout(m_pDeviceContext->GetLogicalDevice(), m_descriptorSetLayout, nullptr);
 	m_descriptorSetLayout = VK_NULL_HANDLE;
+
+	m_pMipGenerator->Destroy();
+	m_pMipGenerator = nullptr;
+
+	// Assets, then the textures they hold.
+	m_pAssetManager->Destroy();
+	m_pAssetManager = nullptr;
+
+	m_pTextureStreamer->Destroy();
+	m_pTextureStreamer = nullptr;
+}
+
+
+void Pipeline::DestroyAssetResources()
+{
+	// The descriptor set is freed along with the pool.
+	m_descriptorSet = VK_NULL_HANDLE;
+
+	m_pAssetManager->Release(m_textureAsset);
+	m_textureAsset = kInvalidAssetHandle;
+	m_texture = kInvalidStreamedTexture;
+}
+
+
+void Pipeline::DestroySwapchainResources()
+{
+	DestroySwapchainResources(m_pDeviceContext.get(), m_swapchainResources);
+	m_swapchainResources = {};
+}
+
+
+void Pipeline::RetireSwapchainResources()
+{
+	DeviceContext* pDeviceContext = m_pDeviceContext.get();
+	SwapchainResources resources = m_swapchainResources;
+	m_swapchainResources = {};
+
+	m_pDeviceContext->RetireResource([pDeviceContext, resources]() mutable
+		{
+			DestroySwapchainResources(pDeviceContext, resources);
+		});
+}
+
+
+void Pipeline::DestroySwapchainResources(DeviceContext* pDeviceContext, SwapchainResources& resources)
+{
+	// Depth images.
+	vkDestroyImageView(pDeviceContext->GetLogicalDevice(), resources.depthImageView, nullptr);
+	pDeviceContext->DestroyImage(resources.depthImage, resources.depthImageAllocation);
+
+	// Swapchain images. The images themselves belong to the swapchain.
+	for (auto imageView : resources.imageViews)
+	{
+		vkDestroyImageView(pDeviceContext->GetLogicalDevice(), imageView, nullptr);
+	}
 }
 
 
 void Pipeline::CreateRenderPass()
 {
+	// Only the pipelines are created against this render pass. The scene is drawn in the render graph's, which has the
+	// same attachments in the same order, so the two are compatible, and the graph's barriers replace the dependencies.
 	VkAttachmentDescription colorAttachment {};
 	colorAttachment.format = m_pSwapchain->GetImageFormat();
 	colorAttachment.samples = m_pDeviceContext->GetMsaaSamples();
@@ -299,11 +468,11 @@ void Pipeline::CreateRenderPass()
 	depthAttachment.format = m_pDeviceContext->FindDepthFormat();
 	depthAttachment.samples = m_pDeviceContext->GetMsaaSamples();
 	depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
 	depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 	depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
 
 	VkAttachmentReference depthAttachmentRef {};
 	depthAttachmentRef.attachment = 1;
@@ -317,7 +486,7 @@ void Pipeline::CreateRenderPass()
 	colorAttachmentResolve.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	colorAttachmentResolve.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 	colorAttachmentResolve.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	colorAttachmentResolve.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	colorAttachmentResolve.finalLayout = m_pSwapchain->GetFinalLayout();
 
 	VkAttachmentReference colorAttachmentResolveRef {};
 	colorAttachmentResolveRef.attachment = 2;
@@ -330,14 +499,6 @@ void Pipeline::CreateRenderPass()
 	subpass.pDepthStencilAttachment = &depthAttachmentRef;
 	subpass.pResolveAttachments = &colorAttachmentResolveRef;
 
-	VkSubpassDependency dependency {};
-	dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-	dependency.dstSubpass = 0;
-	dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	dependency.srcAccessMask = 0;
-	dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
 	std::array<VkAttachmentDescription, 3> attachments = {colorAttachment, depthAttachment, colorAttachmentResolve};
 	VkRenderPassCreateInfo renderPassInfo {};
 	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
@@ -345,23 +506,148 @@ void Pipeline::CreateRenderPass()
 	renderPassInfo.pAttachments = attachments.data();
 	renderPassInfo.subpassCount = 1;
 	renderPassInfo.pSubpasses = &subpass;
-	renderPassInfo.dependencyCount = 1;
-	renderPassInfo.pDependencies = &dependency;
 
 	if (vkCreateRenderPass(m_pDeviceContext->GetLogicalDevice(), &renderPassInfo, nullptr, &m_renderPass) != VK_SUCCESS)
 	{
 		throw std::runtime_error("failed to create render pass");
 	}
+
+	m_renderPassFormat = m_pSwapchain->GetImageFormat();
 }
 
 
-void Pipeline::CreateGraphicsPipeline()
+void Pipeline::CreatePipelineLayout()
 {
-	auto vertShaderCode = ReadFile("assets/shaders/shader.vert.spv");
-	auto fragShaderCode = ReadFile("assets/shaders/shader.frag.spv");
+	// Set zero is this pipeline's own, the bindless tables are shared by every pipeline.
+	std::array<VkDescriptorSetLayout, 2> setLayouts = {m_descriptorSetLayout, m_pDeviceContext->GetBindlessRegistry().GetDescriptorSetLayout()};
 
-	VkShaderModule vertShaderModule = m_pDeviceContext->CreateShaderModule(vertShaderCode);
-	VkShaderModule fragShaderModule = m_pDeviceContext->CreateShaderModule(fragShaderCode);
+	VkPushConstantRange pushConstantRange {};
+	pushConstantRange.stageFlags = kDrawConstantStages;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(DrawConstants);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo {};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+	pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+	if (vkCreatePipelineLayout(m_pDeviceContext->GetLogicalDevice(), &pipelineLayoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create pipeline layout");
+	}
+}
+
+
+void Pipeline::CreateGraphicsPipelines()
+{
+	// Every shader is queued before the first pipeline is created, so they are read in parallel. Each pipeline then
+	// waits for its own, and these references are dropped once they all have them.
+	std::vector<AssetHandle> shaders {m_pAssetManager->LoadShader(kIndirectVertexShaderPath),
+		m_pAssetManager->LoadShader(kIndirectFragmentShaderPath)};
+
+	for (const auto& layoutPipelines : m_layoutPipelines)
+	{
+		for (const std::string& path : GetLayoutShaderPaths(layoutPipelines.layout))
+		{
+			shaders.push_back(m_pAssetManager->LoadShader(path));
+		}
+	}
+
+	// They all share the layout. The indirect one takes its per draw data from a storage buffer, and its vertices from
+	// the mesh pool, which are always floats.
+	CreateGraphicsPipeline(kIndirectVertexShaderPath, kIndirectFragmentShaderPath, GetVertexLayout(VertexLayoutPreset::Float), false,
+		m_indirectPipeline);
+
+	for (auto& layoutPipelines : m_layoutPipelines)
+	{
+		CreateLayoutPipelines(layoutPipelines);
+	}
+
+	for (AssetHandle shader : shaders)
+	{
+		m_pAssetManager->Release(shader);
+	}
+}
+
+
+void Pipeline::CreateLayoutPipelines(LayoutPipelines& layoutPipelines)
+{
+	// The instanced one takes its transforms from a second vertex binding.
+	const VertexLayout& layout = layoutPipelines.layout;
+	std::array<std::string, 3> shaderPaths = GetLayoutShaderPaths(layout);
+	CreateGraphicsPipeline(shaderPaths[0], shaderPaths[2], layout, false, layoutPipelines.graphicsPipeline);
+	CreateGraphicsPipeline(shaderPaths[1], shaderPaths[2], layout, true, layoutPipelines.instancedPipeline);
+}
+
+
+std::array<std::string, 3> Pipeline::GetLayoutShaderPaths(const VertexLayout& layout)
+{
+	return {"assets/shaders/" + layout.GetVertexShaderName("shader") + ".vert.spv",
+		"assets/shaders/" + layout.GetVertexShaderName("instanced") + ".vert.spv", "assets/shaders/shader.frag.spv"};
+}
+
+
+void Pipeline::DestroyLayoutPipelines()
+{
+	// The layouts are kept, so the same pipelines are created again next time.
+	for (auto& layoutPipelines : m_layoutPipelines)
+	{
+		vkDestroyPipeline(m_pDeviceContext->GetLogicalDevice(), layoutPipelines.instancedPipeline, nullptr);
+		layoutPipelines.instancedPipeline = VK_NULL_HANDLE;
+		vkDestroyPipeline(m_pDeviceContext->GetLogicalDevice(), layoutPipelines.graphicsPipeline, nullptr);
+		layoutPipelines.graphicsPipeline = VK_NULL_HANDLE;
+	}
+}
+
+
+void Pipeline::PrepareVertexLayout(const VertexLayout& layout)
+{
+	for (const auto& layoutPipelines : m_layoutPipelines)
+	{
+		if (layoutPipelines.layout == layout)
+		{
+			return;
+		}
+	}
+
+	m_layoutPipelines.push_back({layout});
+
+	// Before Init, the pipelines are created along with the rest.
+	if (m_pipelineLayout != VK_NULL_HANDLE)
+	{
+		CreateLayoutPipelines(m_layoutPipelines.back());
+	}
+}
+
+
+const Pipeline::LayoutPipelines& Pipeline::GetLayoutPipelines(const VertexLayout& layout) const
+{
+	for (const auto& layoutPipelines : m_layoutPipelines)
+	{
+		if (layoutPipelines.layout == layout)
+		{
+			return layoutPipelines;
+		}
+	}
+
+	throw std::runtime_error("vertex layout has not been prepared");
+}
+
+
+void Pipeline::CreateGraphicsPipeline(const std::string& vertexShaderPath, const std::string& fragmentShaderPath, const VertexLayout& layout, bool isInstanced, VkPipeline& pipeline)
+{
+	// Already loaded, or loading, unless a layout is being prepared on its own.
+	AssetHandle vertexShader = m_pAssetManager->LoadShader(vertexShaderPath);
+	AssetHandle fragmentShader = m_pAssetManager->LoadShader(fragmentShaderPath);
+	m_pAssetManager->Wait(vertexShader);
+	m_pAssetManager->Wait(fragmentShader);
+
+	VkShaderModule vertShaderModule = m_pDeviceContext->CreateShaderModule(m_pAssetManager->GetShaderCode(vertexShader));
+	VkShaderModule fragShaderModule = m_pDeviceContext->CreateShaderModule(m_pAssetManager->GetShaderCode(fragmentShader));
+
+	m_pAssetManager->Release(vertexShader);
+	m_pAssetManager->Release(fragmentShader);
 
 	VkPipelineShaderStageCreateInfo vertShaderStageInfo {};
 	vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -380,12 +666,19 @@ void Pipeline::CreateGraphicsPipeline()
 	VkPipelineVertexInputStateCreateInfo vertexInputInfo {};
 	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 
-	auto bindingDescription = Vertex::getBindingDescription();
-	auto attributeDescriptions = Vertex::getAttributeDescriptions();
+	std::vector<VkVertexInputBindingDescription> bindingDescriptions = {layout.GetBindingDescription()};
+	std::vector<VkVertexInputAttributeDescription> attributeDescriptions = layout.GetAttributeDescriptions();
+
+	if (isInstanced)
+	{
+		auto instanceAttributeDescriptions = InstanceData::getAttributeDescriptions();
+		bindingDescriptions.push_back(InstanceData::getBindingDescription());
+		attributeDescriptions.insert(attributeDescriptions.end(), instanceAttributeDescriptions.begin(), instanceAttributeDescriptions.end());
+	}
 
-	vertexInputInfo.vertexBindingDescriptionCount = 1;
+	vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
 	vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-	vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+	vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
 	vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 
 	VkPipelineInputAssemblyStateCreateInfo inputAssembly {};
@@ -393,24 +686,18 @@ void Pipeline::CreateGraphicsPipeline()
 	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
 	inputAssembly.primitiveRestartEnable = VK_FALSE;
 
-	VkViewport viewport {};
-	viewport.x = 0.0f;
-	viewport.y = 0.0f;
-	viewport.width = static_cast<float>(m_pSwapchain->GetExtents().width);
-	viewport.height = static_cast<float>(m_pSwapchain->GetExtents().height);
-	viewport.minDepth = 0.0f;
-	viewport.maxDepth = 1.0f;
-
-	VkRect2D scissor {};
-	scissor.offset = {0, 0};
-	scissor.extent = m_pSwapchain->GetExtents();
-
+	// The viewport and scissor are set when recording, so the pipeline doesn't depend on the swapchain's size.
 	VkPipelineViewportStateCreateInfo viewportState {};
 	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
 	viewportState.viewportCount = 1;
-	viewportState.pViewports = &viewport;
 	viewportState.scissorCount = 1;
-	viewportState.pScissors = &scissor;
+
+	std::array<VkDynamicState, 2> dynamicStates = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+
+	VkPipelineDynamicStateCreateInfo dynamicState {};
+	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+	dynamicState.pDynamicStates = dynamicStates.data();
 
 	VkPipelineRasterizationStateCreateInfo rasterizer {};
 	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
@@ -442,16 +729,6 @@ void Pipeline::CreateGraphicsPipeline()
 	colorBlending.blendConstants[2] = 0.0f;
 	colorBlending.blendConstants[3] = 0.0f;
 
-	VkPipelineLayoutCreateInfo pipelineLayoutInfo {};
-	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	pipelineLayoutInfo.setLayoutCount = 1;
-	pipelineLayoutInfo.pSetLayouts = &m_descriptorSetLayout;
-	pipelineLayoutInfo.pushConstantRangeCount = 0;
-
-	if (vkCreatePipelineLayout(m_pDeviceContext->GetLogicalDevice(), &pipelineLayoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS) {
-		throw std::runtime_error("failed to create pipeline layout");
-	}
-
 	VkPipelineDepthStencilStateCreateInfo depthStencil {};
 	depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
 	depthStencil.depthTestEnable = VK_TRUE;
@@ -471,103 +748,52 @@ void Pipeline::CreateGraphicsPipeline()
 	pipelineInfo.pMultisampleState = &multisampling;
 	pipelineInfo.pDepthStencilState = &depthStencil;
 	pipelineInfo.pColorBlendState = &colorBlending;
-	pipelineInfo.pDynamicState = nullptr;
+	pipelineInfo.pDynamicState = &dynamicState;
 	pipelineInfo.layout = m_pipelineLayout;
 	pipelineInfo.renderPass = m_renderPass;
 	pipelineInfo.subpass = 0;
 
-	if (vkCreateGraphicsPipelines(m_pDeviceContext->GetLogicalDevice(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_graphicsPipeline) != VK_SUCCESS)
-	{
-		throw std::runtime_error("failed to create graphics pipeline");
-	}
+	m_pDeviceContext->GetPipelineCache().CreateGraphicsPipeline(pipelineInfo, pipeline);
 
 	vkDestroyShaderModule(m_pDeviceContext->GetLogicalDevice(), fragShaderModule, nullptr);
 	vkDestroyShaderModule(m_pDeviceContext->GetLogicalDevice(), vertShaderModule, nullptr);
 }
 
 
-void Pipeline::CreateFramebuffers()
-{
-	m_swapchainFramebuffers.resize(m_pSwapchain->GetImageCount());
-
-	for (size_t i = 0; i < m_swapchainImageViews.size(); ++i)
-	{
-		std::array<VkImageView, 3> attachments = {
-			m_colorImageView,
-			m_depthImageView,
-			m_swapchainImageViews[i]
-		};
-
-		VkFramebufferCreateInfo framebufferInfo {};
-		framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-		framebufferInfo.renderPass = m_renderPass;
-		framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-		framebufferInfo.pAttachments = attachments.data();
-		framebufferInfo.width = m_pSwapchain->GetExtents().width;
-		framebufferInfo.height = m_pSwapchain->GetExtents().height;
-		framebufferInfo.layers = 1;
-
-		if (vkCreateFramebuffer(m_pDeviceContext->GetLogicalDevice(), &framebufferInfo, nullptr, &m_swapchainFramebuffers[i]) != VK_SUCCESS)
-		{
-			throw std::runtime_error("failed to create framebuffer");
-		}
-	}
-}
-
-
 void Pipeline::CreateImageViews()
 {
-	auto imageCount = m_pSwapchain->GetImageCount();
-
-	m_swapchainImages.resize(imageCount);
-
-	vkGetSwapchainImagesKHR(m_pDeviceContext->GetLogicalDevice(), m_pSwapchain->GetVkSwapchainHandle(), m_pSwapchain->GetImageCountAddress(), nullptr);
-	vkGetSwapchainImagesKHR(m_pDeviceContext->GetLogicalDevice(), m_pSwapchain->GetVkSwapchainHandle(), m_pSwapchain->GetImageCountAddress(), m_swapchainImages.data());
+	const std::vector<VkImage>& images = m_pSwapchain->GetImages();
 
-	m_swapchainImageViews.resize(imageCount);
+	m_swapchainResources.imageViews.resize(images.size());
 
-	for (size_t i = 0; i < m_pSwapchain->GetImageCount(); ++i)
+	for (size_t i = 0; i < images.size(); ++i)
 	{
-		m_swapchainImageViews[i] = m_pDeviceContext->CreateImageView(m_swapchainImages[i], m_pSwapchain->GetImageFormat(), VK_IMAGE_ASPECT_COLOR_BIT, 1);
+		m_swapchainResources.imageViews[i] = m_pDeviceContext->CreateImageView(images[i], m_pSwapchain->GetImageFormat(), VK_IMAGE_ASPECT_COLOR_BIT, 1);
 	}
 }
 
 
 void Pipeline::CreateUniformBuffers()
 {
-	VkDeviceSize bufferSize = sizeof(UniformBufferObject);
-
-	m_uniformBuffers.resize(m_pSwapchain->GetImageCount());
-	m_uniformBuffersMemory.resize(m_pSwapchain->GetImageCount());
-
-	for (size_t i = 0; i < m_pSwapchain->GetImageCount(); ++i)
-	{
-		m_pDeviceContext->CreateBuffer(bufferSize,
-			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			m_uniformBuffers[i], m_uniformBuffersMemory[i]);
-	}
+	// One region per frame in flight, each large enough for a few thousand objects.
+	m_pUniformRing = std::make_shared<UniformRing>(m_pDeviceContext);
+	m_pUniformRing->Init(kUniformRingFrameSize, kMaxFramesInFlight);
 }
 
 
 void Pipeline::CreateDescriptorSetLayout()
 {
+	// Textures come from the bindless tables, so this set only holds the per object uniforms.
 	VkDescriptorSetLayoutBinding uboLayoutBinding {};
 	uboLayoutBinding.binding = 0;
-	uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	uboLayoutBinding.descriptorCount = 1;
 	uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 
-	VkDescriptorSetLayoutBinding samplerLayoutBinding {};
-	samplerLayoutBinding.binding = 1;
-	samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	samplerLayoutBinding.descriptorCount = 1;
-	samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-
-	std::array<VkDescriptorSetLayoutBinding, 2> bindings = {uboLayoutBinding, samplerLayoutBinding};
 	VkDescriptorSetLayoutCreateInfo layoutInfo {};
 	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
-	layoutInfo.pBindings = bindings.data();
+	layoutInfo.bindingCount = 1;
+	layoutInfo.pBindings = &uboLayoutBinding;
 
 	if (vkCreateDescriptorSetLayout(m_pDeviceContext->GetLogicalDevice(), &layoutInfo, nullptr, &m_descriptorSetLayout) != VK_SUCCESS)
 	{
@@ -578,17 +804,16 @@ void Pipeline::CreateDescriptorSetLayout()
 
 void Pipeline::CreateDescriptorPool()
 {
-	std::array<VkDescriptorPoolSize, 2> poolSizes {};
-	poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	poolSizes[0].descriptorCount = static_cast<uint32_t>(m_pSwapchain->GetImageCount());
-	poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	poolSizes[1].descriptorCount = static_cast<uint32_t>(m_pSwapchain->GetImageCount());
+	// A single set covers every frame, the dynamic offset selects the uniforms.
+	VkDescriptorPoolSize poolSize {};
+	poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	poolSize.descriptorCount = 1;
 
 	VkDescriptorPoolCreateInfo poolInfo {};
 	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
-	poolInfo.pPoolSizes = poolSizes.data();
-	poolInfo.maxSets = static_cast<uint32_t>(m_pSwapchain->GetImageCount() + 100); // HACK: TODO: ILH: multiplied this by 1000 to test if it stopped the crash, it does.
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+	poolInfo.maxSets = 1;
 
 	if (vkCreateDescriptorPool(m_pDeviceContext->GetLogicalDevice(), &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS)
 	{
@@ -599,205 +824,181 @@ void Pipeline::CreateDescriptorPool()
 
 void Pipeline::CreateDescriptorSets()
 {
-	std::vector<VkDescriptorSetLayout> layouts(m_pSwapchain->GetImageCount(), m_descriptorSetLayout);
 	VkDescriptorSetAllocateInfo allocInfo {};
 	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
 	allocInfo.descriptorPool = m_descriptorPool;
-	allocInfo.descriptorSetCount = static_cast<uint32_t>(m_pSwapchain->GetImageCount());
-	allocInfo.pSetLayouts = layouts.data();
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &m_descriptorSetLayout;
 
-	m_descriptorSets.resize(m_pSwapchain->GetImageCount());
-	if (vkAllocateDescriptorSets(m_pDeviceContext->GetLogicalDevice(), &allocInfo, m_descriptorSets.data()) != VK_SUCCESS)
+	if (vkAllocateDescriptorSets(m_pDeviceContext->GetLogicalDevice(), &allocInfo, &m_descriptorSet) != VK_SUCCESS)
 	{
 		throw std::runtime_error("failed to allocate descriptor sets");
 	}
 
-	for (size_t i = 0; i < m_pSwapchain->GetImageCount(); ++i)
-	{
-		VkDescriptorBufferInfo bufferInfo {};
-		bufferInfo.buffer = m_uniformBuffers[i];
-		bufferInfo.offset = 0;
-		bufferInfo.range = sizeof(UniformBufferObject);
-
-		VkDescriptorImageInfo imageInfo {};
-		imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		imageInfo.imageView = m_textureImageView;
-		imageInfo.sampler = m_textureSampler;
-
-		std::array<VkWriteDescriptorSet, 2> descriptorWrites {};
-		descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		descriptorWrites[0].dstSet = m_descriptorSets[i];
-		descriptorWrites[0].dstBinding = 0;
-		descriptorWrites[0].dstArrayElement = 0;
-		descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		descriptorWrites[0].descriptorCount = 1;
-		descriptorWrites[0].pBufferInfo = &bufferInfo;
-
-		descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		descriptorWrites[1].dstSet = m_descriptorSets[i];
-		descriptorWrites[1].dstBinding = 1;
-		descriptorWrites[1].dstArrayElement = 0;
-		descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		descriptorWrites[1].descriptorCount = 1;
-		descriptorWrites[1].pImageInfo = &imageInfo;
-
-		vkUpdateDescriptorSets(m_pDeviceContext->GetLogicalDevice(), static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
-	}
+	// The range covers a single object, the dynamic offset moves it around the ring.
+	VkDescriptorBufferInfo bufferInfo {};
+	bufferInfo.buffer = m_pUniformRing->GetBuffer();
+	bufferInfo.offset = 0;
+	bufferInfo.range = sizeof(UniformBufferObject);
+
+	VkWriteDescriptorSet descriptorWrite {};
+	descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrite.dstSet = m_descriptorSet;
+	descriptorWrite.dstBinding = 0;
+	descriptorWrite.dstArrayElement = 0;
+	descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	descriptorWrite.descriptorCount = 1;
+	descriptorWrite.pBufferInfo = &bufferInfo;
+
+	vkUpdateDescriptorSets(m_pDeviceContext->GetLogicalDevice(), 1, &descriptorWrite, 0, nullptr);
 }
 
 
-void Pipeline::CreateCommandBuffers(const Model& model)
+void Pipeline::RecordDraws(VkCommandBuffer commandBuffer, const DrawItem* pDrawItems, uint32_t drawCount, uint32_t frameIndex, uint32_t uniformOffset) const
 {
-	m_commandBuffers.resize(m_pSwapchain->GetImageCount());
-
-	VkCommandBufferAllocateInfo allocInfo {};
-	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	allocInfo.commandPool = m_pDeviceContext->GetCommandPool();
-	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	allocInfo.commandBufferCount = static_cast<uint32_t>(m_commandBuffers.size());
-
-	if (vkAllocateCommandBuffers(m_pDeviceContext->GetLogicalDevice(), &allocInfo, m_commandBuffers.data()) != VK_SUCCESS)
+	if (drawCount == 0)
 	{
-		throw std::runtime_error("failed to create command buffers");
+		return;
 	}
 
-	for (size_t i = 0; i < m_commandBuffers.size(); ++i)
+	const LayoutPipelines* pLayoutPipelines = &GetLayoutPipelines(pDrawItems[0].pModel->GetVertexLayout());
+	BindState(commandBuffer, pLayoutPipelines->graphicsPipeline, uniformOffset);
+
+	// Only rebind the buffers when the model changes, which for a sorted draw list is rarely. Likewise the push
+	// constants when the model or texture changes, and the pipeline when switching to or from instancing or to
+	// another vertex layout. The pipelines share a layout, so the descriptor sets and push constants survive the
+	// switch.
+	const Model* pBoundModel = nullptr;
+	BindlessHandle boundTexture = kInvalidBindlessHandle;
+	VkPipeline boundPipeline = pLayoutPipelines->graphicsPipeline;
+
+	for (uint32_t i = 0; i < drawCount; ++i)
 	{
-		VkCommandBufferBeginInfo beginInfo {};
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		const DrawItem& drawItem = pDrawItems[i];
+		bool isModelChanged = drawItem.pModel != pBoundModel;
 
-		if (vkBeginCommandBuffer(m_commandBuffers[i], &beginInfo) != VK_SUCCESS)
+		if (isModelChanged && drawItem.pModel->GetVertexLayout() != pLayoutPipelines->layout)
 		{
-			throw std::runtime_error("failed to begin recording command buffer");
+			pLayoutPipelines = &GetLayoutPipelines(drawItem.pModel->GetVertexLayout());
 		}
 
-		VkRenderPassBeginInfo renderPassInfo {};
-		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		renderPassInfo.renderPass = m_renderPass;
-		renderPassInfo.framebuffer = m_swapchainFramebuffers[i];
-		renderPassInfo.renderArea.offset = {0, 0};
-		renderPassInfo.renderArea.extent = m_pSwapchain->GetExtents();
-
-		std::array<VkClearValue, 2> clearValues {};
-		clearValues[0].color = {0.0f, 0.0f, 0.0f, 1.0f};
-		clearValues[1].depthStencil = {1.0f, 0};
-
-		renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-		renderPassInfo.pClearValues = clearValues.data();
-
-		vkCmdBeginRenderPass(m_commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-		vkCmdBindPipeline(m_commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicsPipeline);
+		VkPipeline pipeline = drawItem.pInstances ? pLayoutPipelines->instancedPipeline : pLayoutPipelines->graphicsPipeline;
+		if (pipeline != boundPipeline)
+		{
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+			boundPipeline = pipeline;
+		}
 
-		// I guess this should run for each model...
-		// HACK: I cheated and only run this entire thing once.
+		if (isModelChanged)
 		{
-			VkBuffer vertexBuffers[] = {model.m_vertexBuffer};
+			VkBuffer vertexBuffers[] = {drawItem.pModel->m_vertexBuffer};
 			VkDeviceSize offsets[] = {0};
-			vkCmdBindVertexBuffers(m_commandBuffers[i], 0, 1, vertexBuffers, offsets);
+			vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
 
-			vkCmdBindIndexBuffer(m_commandBuffers[i], model.m_indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+			vkCmdBindIndexBuffer(commandBuffer, drawItem.pModel->m_indexBuffer, 0, VK_INDEX_TYPE_UINT32);
 
-			vkCmdBindDescriptorSets(m_commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &m_descriptorSets[i], 0, nullptr);
+			pBoundModel = drawItem.pModel;
+		}
 
-			vkCmdDrawIndexed(m_commandBuffers[i], static_cast<uint32_t>(model.m_indices.size()), 1, 0, 0, 0);
+		BindlessHandle texture = GetDrawTexture(drawItem);
+		if (isModelChanged || texture != boundTexture)
+		{
+			DrawConstants drawConstants {texture, 0, drawItem.pModel->GetDequantisation()};
+			vkCmdPushConstants(commandBuffer, m_pipelineLayout, kDrawConstantStages, 0, sizeof(DrawConstants), &drawConstants);
 
-			vkCmdEndRenderPass(m_commandBuffers[i]);
+			boundTexture = texture;
+		}
 
-			if (vkEndCommandBuffer(m_commandBuffers[i]) != VK_SUCCESS)
+		if (drawItem.pInstances)
+		{
+			uint32_t instanceCount = drawItem.pInstances->GetDrawnInstanceCount();
+			if (instanceCount > 0)
 			{
-				throw std::runtime_error("failed to record command buffer");
+				VkBuffer instanceBuffers[] = {drawItem.pInstances->GetBuffer(frameIndex)};
+				VkDeviceSize offsets[] = {0};
+				vkCmdBindVertexBuffers(commandBuffer, 1, 1, instanceBuffers, offsets);
+
+				// One draw for each level of detail, written when the instances are. How many instances each level
+				// gets changes every frame without the command buffers being recorded again.
+				VkBuffer indirectBuffer = drawItem.pInstances->GetIndirectBuffer(frameIndex);
+				uint32_t lodCount = std::max(static_cast<uint32_t>(drawItem.pModel->GetLods().size()), 1u);
+				uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+
+				if (m_pDeviceContext->GetCapabilities().isMultiDrawIndirectSupported)
+				{
+					vkCmdDrawIndexedIndirect(commandBuffer, indirectBuffer, 0, lodCount, stride);
+				}
+				else
+				{
+					for (uint32_t lod = 0; lod < lodCount; ++lod)
+					{
+						vkCmdDrawIndexedIndirect(commandBuffer, indirectBuffer, static_cast<VkDeviceSize>(stride) * lod, 1, stride);
+					}
+				}
 			}
 		}
+		else
+		{
+			vkCmdDrawIndexed(commandBuffer, drawItem.indexCount, 1, drawItem.firstIndex, 0, 0);
+		}
 	}
 }
 
 
-void Pipeline::CreateTextureImage()
+void Pipeline::RecordIndirectDraws(VkCommandBuffer commandBuffer, const IndirectScene& scene, uint32_t frameIndex, uint32_t uniformOffset) const
 {
-	int texWidth;
-	int texHeight;
-	int texChannels;
-
-	stbi_uc* pixels = stbi_load(kTexturePath.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-	VkDeviceSize imageSize = static_cast<uint64_t>(texWidth) * texHeight * 4;
-
-	if (!pixels)
-	{
-		throw std::runtime_error("failed to load texture image");
-	}
+	BindState(commandBuffer, m_indirectPipeline, uniformOffset);
 
-	m_mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1;
+	// Every mesh lives in the pool's megabuffers, so they are bound once for the whole scene.
+	const MeshPool& meshPool = scene.GetMeshPool();
+	VkBuffer vertexBuffers[] = {meshPool.GetVertexBuffer()};
+	VkDeviceSize offsets[] = {0};
+	vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+	vkCmdBindIndexBuffer(commandBuffer, meshPool.GetIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
 
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
+	// The texture comes from the per draw data, the push constants only say where to find it.
+	DrawConstants drawConstants {GetDefaultTexture(), scene.GetDrawDataHandle(frameIndex)};
+	vkCmdPushConstants(commandBuffer, m_pipelineLayout, kDrawConstantStages, 0, sizeof(DrawConstants), &drawConstants);
 
-	m_pDeviceContext->CreateBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-
-	void* data;
-	vkMapMemory(m_pDeviceContext->GetLogicalDevice(), stagingBufferMemory, 0, imageSize, 0, &data);
-	memcpy(data, pixels, static_cast<size_t>(imageSize));
-	vkUnmapMemory(m_pDeviceContext->GetLogicalDevice(), stagingBufferMemory);
-
-	stbi_image_free(pixels);
-
-	m_pDeviceContext->CreateImage(texWidth, texHeight, m_mipLevels, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
-		VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_textureImage, m_textureImageMemory);
-
-	m_pDeviceContext->TransitionImageLayout(m_textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, m_mipLevels);
-
-	m_pDeviceContext->CopyBufferToImage(stagingBuffer, m_textureImage, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
-
-	vkDestroyBuffer(m_pDeviceContext->GetLogicalDevice(), stagingBuffer, nullptr);
-	vkFreeMemory(m_pDeviceContext->GetLogicalDevice(), stagingBufferMemory, nullptr);
-
-	GenerateMipmaps(m_textureImage, VK_FORMAT_R8G8B8A8_SRGB, texWidth, texHeight, m_mipLevels);
-}
-
-
-void Pipeline::CreateTextureImageView()
-{
-	m_textureImageView = m_pDeviceContext->CreateImageView(m_textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, m_mipLevels);
+	scene.RecordDraws(commandBuffer, frameIndex);
 }
 
 
-void Pipeline::CreateTextureSampler()
+BindlessHandle Pipeline::GetDrawTexture(const DrawItem& drawItem) const
 {
-	VkSamplerCreateInfo samplerInfo {};
-	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-	samplerInfo.magFilter = VK_FILTER_LINEAR;
-	samplerInfo.minFilter = VK_FILTER_LINEAR;
-	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-	samplerInfo.anisotropyEnable = VK_TRUE;
-	samplerInfo.maxAnisotropy = 16;
-	samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
-	samplerInfo.unnormalizedCoordinates = VK_FALSE;
-	samplerInfo.compareEnable = VK_FALSE;
-	samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
-	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-	samplerInfo.mipLodBias = 0.0f;
-	samplerInfo.minLod = 0.0f;
-	samplerInfo.maxLod = static_cast<float>(m_mipLevels);
-
-	if (vkCreateSampler(m_pDeviceContext->GetLogicalDevice(), &samplerInfo, nullptr, &m_textureSampler) != VK_SUCCESS)
+	if (drawItem.streamedTexture != kInvalidStreamedTexture)
 	{
-		throw std::runtime_error("failed to create texture sampler");
+		return m_pTextureStreamer->GetHandle(drawItem.streamedTexture);
 	}
+
+	return drawItem.texture != kInvalidBindlessHandle ? drawItem.texture : GetDefaultTexture();
 }
 
 
-void Pipeline::CreateColorResources()
+void Pipeline::BindState(VkCommandBuffer commandBuffer, VkPipeline pipeline, uint32_t uniformOffset) const
 {
-	VkFormat colorFormat = m_pSwapchain->GetImageFormat();
+	// Secondary command buffers inherit none of the primary's state, so everything is bound again here.
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
 
-	m_pDeviceContext->CreateImage(m_pSwapchain->GetExtents().width, m_pSwapchain->GetExtents().height, 1, m_pDeviceContext->GetMsaaSamples(), colorFormat,
-		VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_colorImage, m_colorImageMemory);
+	VkViewport viewport {};
+	viewport.x = 0.0f;
+	viewport.y = 0.0f;
+	viewport.width = static_cast<float>(m_pSwapchain->GetExtents().width);
+	viewport.height = static_cast<float>(m_pSwapchain->GetExtents().height);
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 
-	m_colorImageView = m_pDeviceContext->CreateImageView(m_colorImage, colorFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+	VkRect2D scissor {};
+	scissor.offset = {0, 0};
+	scissor.extent = m_pSwapchain->GetExtents();
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &m_descriptorSet, 1, &uniformOffset);
+
+	// One bind covers every texture for the whole command buffer.
+	VkDescriptorSet bindlessSet = m_pDeviceContext->GetBindlessRegistry().GetDescriptorSet();
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, kBindlessSet, 1, &bindlessSet, 0, nullptr);
 }
 
 
@@ -805,108 +1006,65 @@ void Pipeline::CreateDepthResources()
 {
 	VkFormat depthFormat = m_pDeviceContext->FindDepthFormat();
 
-	m_pDeviceContext->CreateImage(m_pSwapchain->GetExtents().width, m_pSwapchain->GetExtents().height, 1, m_pDeviceContext->GetMsaaSamples(), depthFormat,
-		VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		m_depthImage, m_depthImageMemory);
-	m_depthImageView = m_pDeviceContext->CreateImageView(m_depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
-}
+	// The culling pass samples the depth, if the device allows it at this sample count.
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(m_pDeviceContext->GetPhysicalDevice(), depthFormat, &formatProperties);
 
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(m_pDeviceContext->GetPhysicalDevice(), &properties);
 
-void Pipeline::GenerateMipmaps(VkImage image, VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels)
-{
-	VkFormatProperties formatProperties;
-	vkGetPhysicalDeviceFormatProperties(m_pDeviceContext->GetPhysicalDevice(), imageFormat, &formatProperties);
+	m_isDepthSampled = (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)
+		&& (properties.limits.sampledImageDepthSampleCounts & m_pDeviceContext->GetMsaaSamples());
 
-	if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT))
+	VkImageUsageFlags usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	if (m_isDepthSampled)
 	{
-		throw std::runtime_error("texture image format doesn't support linear blitting");
+		usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
 	}
 
-	VkCommandBuffer commandBuffer = m_pDeviceContext->BeginSingleTimeCommands();
-
-	VkImageMemoryBarrier barrier {};
-	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-	barrier.image = image;
-	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	barrier.subresourceRange.baseArrayLayer = 0;
-	barrier.subresourceRange.layerCount = 1;
-	barrier.subresourceRange.levelCount = 1;
-
-	int32_t mipWidth = texWidth;
-	int32_t mipHeight = texHeight;
-
-	for (uint32_t i = 1; i < mipLevels; ++i)
+	m_pDeviceContext->CreateImage(m_pSwapchain->GetExtents().width, m_pSwapchain->GetExtents().height, 1, m_pDeviceContext->GetMsaaSamples(), depthFormat,
+		VK_IMAGE_TILING_OPTIMAL, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		m_swapchainResources.depthImage, m_swapchainResources.depthImageAllocation);
+	m_swapchainResources.depthImageView = m_pDeviceContext->CreateImageView(m_swapchainResources.depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
+
+	// Each frame expects to find the previous frame's depth, where the render graph leaves it. The first frame finds
+	// it cleared to the far plane, so nothing is occluded. This goes ahead of the frames on the graphics queue.
+	VkImage depthImage = m_swapchainResources.depthImage;
+	VkImageAspectFlags aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+	if (m_pDeviceContext->HasStencilComponent(depthFormat))
 	{
-		barrier.subresourceRange.baseMipLevel = i - 1;
-		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-
-		vkCmdPipelineBarrier(
-			commandBuffer,
-			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
-			0, nullptr,
-			0, nullptr,
-			1, &barrier
-		);
-
-		VkImageBlit blit {};
-		blit.srcOffsets[0] = {0, 0, 0};
-		blit.srcOffsets[1] = {mipWidth, mipHeight, 1};
-		blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		blit.srcSubresource.mipLevel = i - 1;
-		blit.srcSubresource.baseArrayLayer = 0;
-		blit.srcSubresource.layerCount = 1;
-		blit.dstOffsets[0] = {0, 0, 0};
-		blit.dstOffsets[1] = {mipWidth > 1 ? mipWidth / 2 : 1, mipHeight > 1 ? mipHeight / 2 : 1, 1};
-		blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		blit.dstSubresource.mipLevel = i;
-		blit.dstSubresource.baseArrayLayer = 0;
-		blit.dstSubresource.layerCount = 1;
-
-		vkCmdBlitImage(
-			commandBuffer,
-			image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-			image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			1, &blit,
-			VK_FILTER_LINEAR
-		);
-
-		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-		vkCmdPipelineBarrier(
-			commandBuffer,
-			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
-			0, nullptr,
-			0, nullptr,
-			1, &barrier
-		);
-
-		if (mipWidth > 1) mipWidth /= 2;
-		if (mipHeight > 1) mipHeight /= 2;
+		aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
 	}
 
-	barrier.subresourceRange.baseMipLevel = mipLevels - 1;
-	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-	vkCmdPipelineBarrier(
-		commandBuffer,
-		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
-		0, nullptr,
-		0, nullptr,
-		1, &barrier
-	);
-
-	m_pDeviceContext->EndSingleTimeCommands(commandBuffer);
+	UploadManager& uploadManager = m_pDeviceContext->GetUploadManager();
+	uploadManager.RecordGraphicsCommands([depthImage, aspectMask](VkCommandBuffer commandBuffer)
+		{
+			VkImageMemoryBarrier barrier {};
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.image = depthImage;
+			barrier.subresourceRange = {aspectMask, 0, 1, 0, 1};
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+				0, nullptr, 0, nullptr, 1, &barrier);
+
+			VkClearDepthStencilValue clearValue {1.0f, 0};
+			vkCmdClearDepthStencilImage(commandBuffer, depthImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearValue, 1, &barrier.subresourceRange);
+
+			barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+				0, nullptr, 0, nullptr, 1, &barrier);
+		});
+	uploadManager.Submit();
 }
 
 
@@ -13,14 +13,29 @@
 
 // STD.
 #include <array>
+#include <string>
 #include <vector>
 
+#include "AssetManager.h"
 #include "DeviceContext.h"
+#include "FrameContext.h"
+#include "MeshCache.h"
+#include "MeshOptimiser.h"
+#include "MeshSimplifier.h"
+#include "MipGenerator.h"
+#include "ObjImporter.h"
 #include "Swapchain.h"
+#include "TextureStreamer.h"
+#include "UniformRing.h"
+#include "VertexLayout.h"
 
 
 namespace Jettison::Renderer
 {
+class IndirectScene;
+class InstanceBuffer;
+
+
 struct UniformBufferObject
 {
 	alignas(16) glm::mat4 model;
@@ -29,48 +44,18 @@ struct UniformBufferObject
 };
 
 
+// The vertex as it is loaded and processed on the CPU. What goes in the vertex buffer is packed from this with a
+// VertexLayout.
 struct Vertex
 {
 	glm::vec3 pos;
 	glm::vec3 color;
 	glm::vec2 texCoord;
-
-	static VkVertexInputBindingDescription getBindingDescription()
-	{
-		VkVertexInputBindingDescription bindingDescription {};
-		bindingDescription.binding = 0;
-		bindingDescription.stride = sizeof(Vertex);
-		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-		return bindingDescription;
-	}
-
-
-	static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions()
-	{
-		std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions {};
-		attributeDescriptions[0].binding = 0;
-		attributeDescriptions[0].location = 0;
-		attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-		attributeDescriptions[0].offset = offsetof(Vertex, pos);
-
-		attributeDescriptions[1].binding = 0;
-		attributeDescriptions[1].location = 1;
-		attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-		attributeDescriptions[1].offset = offsetof(Vertex, color);
-
-		attributeDescriptions[2].binding = 0;
-		attributeDescriptions[2].location = 2;
-		attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-		attributeDescriptions[2].offset = offsetof(Vertex, texCoord);
-
-		return attributeDescriptions;
-	}
-
+	glm::vec3 normal;
 
 	bool operator==(const Vertex& other) const
 	{
-		return pos == other.pos && color == other.color && texCoord == other.texCoord;
+		return pos == other.pos && color == other.color && texCoord == other.texCoord && normal == other.normal;
 	}
 };
 }
@@ -82,9 +67,10 @@ template<> struct hash<Jettison::Renderer::Vertex>
 {
 	size_t operator()(const Jettison::Renderer::Vertex& vertex) const
 	{
-		return ((hash<glm::vec3>()(vertex.pos) ^
+		return ((((hash<glm::vec3>()(vertex.pos) ^
 			(hash<glm::vec3>()(vertex.color) << 1)) >> 1) ^
-			(hash<glm::vec2>()(vertex.texCoord) << 1);
+			(hash<glm::vec2>()(vertex.texCoord) << 1)) >> 1) ^
+			(hash<glm::vec3>()(vertex.normal) << 1);
 	}
 };
 }
@@ -92,11 +78,15 @@ template<> struct hash<Jettison::Renderer::Vertex>
 
 namespace Jettison::Renderer
 {
+// The model drawn when nothing else is asked for.
+extern const std::string kModelPath;
+
+
 class Model
 {
 public:
-	Model(std::shared_ptr<DeviceContext> pDeviceContext)
-		:m_pDeviceContext {pDeviceContext} {}
+	Model(std::shared_ptr<DeviceContext> pDeviceContext, const VertexLayout& vertexLayout = {})
+		:m_pDeviceContext {pDeviceContext}, m_vertexLayout {vertexLayout} {}
 
 	// Disable copying.
 	Model() = default;
@@ -105,25 +95,131 @@ public:
 
 	void Destroy();
 
+	// Load the default model.
 	void LoadModel();
 
+	// Load an OBJ file. The first load imports it and writes the result to the mesh cache, later loads map the cache
+	// instead, until the file changes.
+	void LoadModel(const std::string& path);
+
+	// The first half of LoadModel, which reads the file or the cache. It touches nothing on the device, so it can run
+	// on any thread, as long as nothing else is using the model. Importing uses as many threads as it's given, with
+	// zero for one per core.
+	void Decode(const std::string& path, uint32_t threadCount = 0);
+
+	// The second half, which creates and uploads the buffers for what was decoded. Only from the thread which owns
+	// the device context.
+	void CreateBuffers();
+
+	// Has the model finished uploading to the device?
+	bool IsReady() const { return m_pDeviceContext->GetUploadManager().IsComplete(m_uploadTicket); }
+
+	const std::vector<Vertex>& GetVertices() const { return m_vertices; }
+
+	// How much reordering the mesh helped the post-transform vertex cache.
+	const MeshOptimisationStats& GetOptimisationStats() const { return m_optimisationStats; }
+
+	// Where the time went in the last load, and whether it came from the cache.
+	const MeshLoadStats& GetLoadStats() const { return m_loadStats; }
+
+	// How the vertex buffer is packed. Pipelines must be prepared for the layout before the model is drawn.
+	const VertexLayout& GetVertexLayout() const { return m_vertexLayout; }
+
+	// Pushed with each draw of the model, to undo the packing's scaling.
+	const VertexDequantisation& GetDequantisation() const { return m_dequantisation; }
+
+	// In bytes.
+	VkDeviceSize GetVertexBufferSize() const { return m_vertexBufferSize; }
+
+	// Every level of detail, full detail first, all in the one index buffer.
+	const std::vector<MeshLod>& GetLods() const { return m_lods; }
+
+	// The full detail level, for drawing the whole model.
+	uint32_t GetIndexCount() const { return m_lods.empty() ? 0 : m_lods[0].indexCount; }
+
+	// In the model's space, as the centre and radius.
+	const glm::vec4& GetBoundingSphere() const { return m_boundingSphere; }
+
+	// How far the texture coordinates move across a unit of the model's surface, on average. A texture n texels across
+	// puts n times this many texels on each unit.
+	float GetTexCoordDensity() const { return m_texCoordDensity; }
+
 	std::vector<uint32_t> m_indices {};
 	VkBuffer m_vertexBuffer {VK_NULL_HANDLE};
 	VkBuffer m_indexBuffer {VK_NULL_HANDLE};
 
 private:
-	void CreateVertexBuffer();
+	// Parse the file and weld its vertices, filling in any missing normals.
+	void ImportObj(const std::string& path, uint32_t threadCount);
 
-	void CreateIndexBuffer();
+	// Everything done to an imported mesh before it is cached: optimisation, levels of detail and bounds.
+	void ProcessMesh();
+
+	void CreateVertexBuffer(const uint8_t* pData, VkDeviceSize size);
+
+	void CreateIndexBuffer(const uint32_t* pIndices, uint32_t indexCount);
 
 	std::shared_ptr<DeviceContext> m_pDeviceContext;
 
 	std::vector<Vertex> m_vertices {};
-	VkDeviceMemory m_vertexBufferMemory {VK_NULL_HANDLE};
-	VkDeviceMemory m_indexBufferMemory {VK_NULL_HANDLE};
+	VertexLayout m_vertexLayout {};
+	VertexDequantisation m_dequantisation {};
+	VkDeviceSize m_vertexBufferSize {0};
+	Allocation m_vertexBufferAllocation {};
+	Allocation m_indexBufferAllocation {};
+
+	UploadTicket m_uploadTicket {0};
+
+	// Held between decoding and creating the buffers. A cached model's buffers are filled straight from the mapping,
+	// an imported one's from its packed vertices.
+	MeshCacheFile m_cacheFile {};
+	std::vector<uint8_t> m_packedVertices {};
+
+	MeshOptimisationStats m_optimisationStats {};
+	MeshLoadStats m_loadStats {};
+
+	std::vector<MeshLod> m_lods {};
+	glm::vec4 m_boundingSphere {0.0f};
+	float m_texCoordDensity {0.0f};
 };
 
 
+// A range of a model's indices to draw.
+struct DrawItem
+{
+	const Model* pModel {nullptr};
+	uint32_t firstIndex {0};
+	uint32_t indexCount {0};
+
+	// A handle from the bindless registry. When invalid, the pipeline's own texture is used.
+	BindlessHandle texture {kInvalidBindlessHandle};
+
+	// A texture from the pipeline's texture streamer, used in place of the handle when valid. The renderer asks for
+	// its levels from how large the model looks.
+	StreamedTextureId streamedTexture {kInvalidStreamedTexture};
+
+	// When set, every instance in the buffer is drawn with this one draw, each with its own transform.
+	InstanceBuffer* pInstances {nullptr};
+};
+
+
+// Pushed for each draw, to pick its resources out of the bindless tables.
+struct DrawConstants
+{
+	uint32_t textureIndex {0};
+
+	// The bindless buffer holding the per draw data, for the indirect pipeline.
+	uint32_t drawDataIndex {0};
+
+	// For the model being drawn. The indirect pipeline's meshes are all floats, so it leaves this alone.
+	VertexDequantisation dequantisation {};
+};
+
+static_assert(sizeof(DrawConstants) == 64, "DrawConstants must match the shaders' push constant block");
+
+constexpr VkShaderStageFlags kDrawConstantStages = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+
+
 class Pipeline
 {
 public:
@@ -137,47 +233,141 @@ public:
 
 	void Init();
 
+	// Rebuild only what depends on the swapchain's images and size, after the swapchain has been recreated.
 	void Recreate();
 
 	void Destroy();
 
-	void CreateCommandBuffers(const Model& model);
+	// Destroy and create every graphics pipeline again, against the same layout, render pass and pipeline cache.
+	// Everything else is left alone. Waits for the device to go idle, and the command buffers need recording again.
+	void RecreatePipelines();
+
+	// Record a run of draws, including all the state they need, so it can go into its own secondary command buffer.
+	// Only reads from the pipeline, so it is safe to call from several threads at once. Instanced draws use the
+	// frame in flight's instance buffers.
+	void RecordDraws(VkCommandBuffer commandBuffer, const DrawItem* pDrawItems, uint32_t drawCount, uint32_t frameIndex, uint32_t uniformOffset) const;
+
+	// Draw an indirect scene with as few indirect calls as the device allows. The recording doesn't depend on how many
+	// objects are in the scene.
+	void RecordIndirectDraws(VkCommandBuffer commandBuffer, const IndirectScene& scene, uint32_t frameIndex, uint32_t uniformOffset) const;
+
+	inline UniformRing& GetUniformRing() { return *m_pUniformRing; }
+
+	// The depth attachment is kept after each frame, in DEPTH_STENCIL_READ_ONLY_OPTIMAL, so the next frame can cull
+	// against it. It changes whenever the swapchain is recreated.
+	inline VkImageView GetDepthImageView() const { return m_swapchainResources.depthImageView; }
+
+	inline VkImage GetDepthImage() const { return m_swapchainResources.depthImage; }
+
+	// For the render graph to resolve into.
+	inline VkImageView GetSwapchainImageView(uint32_t imageIndex) const { return m_swapchainResources.imageViews[imageIndex]; }
+
+	// Can the depth attachment be sampled? If not, there's no occlusion culling.
+	inline bool IsDepthSampled() const { return m_isDepthSampled; }
+
+	// The texture drawn with when a draw item doesn't name its own. Its handle changes as its levels stream in and out.
+	inline BindlessHandle GetDefaultTexture() const { return m_pTextureStreamer->GetHandle(m_texture); }
+
+	inline StreamedTextureId GetDefaultStreamedTexture() const { return m_texture; }
+
+	// The handle a draw item is drawn with.
+	BindlessHandle GetDrawTexture(const DrawItem& drawItem) const;
+
+	inline const TextureLoadStats& GetTextureLoadStats() const { return m_pTextureStreamer->GetLoadStats(m_texture); }
 
-	inline const std::vector<VkCommandBuffer>& GetCommandBuffers() const { return m_commandBuffers; }
-	inline const std::vector<VkDeviceMemory>& GetUniformBuffersMemory() const { return m_uniformBuffersMemory; }
+	inline TextureStreamer& GetTextureStreamer() { return *m_pTextureStreamer; }
+
+	// Loads the pipeline's shaders and textures, and anything else which should arrive while the render loop runs.
+	inline AssetManager& GetAssetManager() { return *m_pAssetManager; }
+
+	// Builds mip chains and depth pyramids with compute.
+	inline MipGenerator& GetMipGenerator() { return *m_pMipGenerator; }
+
+	// Read a whole file, e.g. a SPIR-V shader.
+	static std::vector<char> ReadFile(const std::string& filename);
+
+	// Create the pipelines which draw models with the layout, if they don't exist yet. Not safe to call while
+	// recording. The float layout is always prepared, and prepared layouts survive Destroy and Init.
+	void PrepareVertexLayout(const VertexLayout& layout);
+
+	// Have the pipeline's textures finished uploading to the device? Only their tails need to have.
+	bool IsReady() const { return m_pTextureStreamer->IsReady(m_texture); }
 
 private:
-	void Create();
+	// Everything which depends on the swapchain's images or size. This is all a resize needs to touch.
+	struct SwapchainResources
+	{
+		std::vector<VkImageView> imageViews {};
+
+		VkImage depthImage {VK_NULL_HANDLE};
+		Allocation depthImageAllocation {};
+		VkImageView depthImageView {VK_NULL_HANDLE};
+	};
+
+	// Lives as long as the device: the texture streamer and asset manager, render pass, layouts, pipeline, uniforms and
+	// the descriptor pool.
+	void CreateDeviceResources();
+
+	// Lives as long as the assets: the default texture and the descriptor sets.
+	void CreateAssetResources();
+
+	// Lives as long as the swapchain.
+	void CreateSwapchainResources();
+
+	void DestroyDeviceResources();
+
+	void DestroyAssetResources();
+
+	void DestroySwapchainResources();
+
+	// Hand the swapchain resources to the device context, to be destroyed once the frames in flight are done with them.
+	void RetireSwapchainResources();
+
+	static void DestroySwapchainResources(DeviceContext* pDeviceContext, SwapchainResources& resources);
 
 	void CreateRenderPass();
 
-	void CreateGraphicsPipeline();
+	void CreatePipelineLayout();
 
-	void CreateFramebuffers();
+	// The pipelines for drawing models with one vertex layout.
+	struct LayoutPipelines
+	{
+		VertexLayout layout {};
+		VkPipeline graphicsPipeline {VK_NULL_HANDLE};
 
-	void CreateImageViews();
+		// Takes each instance's transform from an instance buffer.
+		VkPipeline instancedPipeline {VK_NULL_HANDLE};
+	};
 
-	void CreateUniformBuffers();
+	void CreateGraphicsPipelines();
 
-	void CreateDescriptorSetLayout();
+	void CreateLayoutPipelines(LayoutPipelines& layoutPipelines);
 
-	void CreateDescriptorPool();
+	// The vertex shader, instanced vertex shader and fragment shader for drawing models with the layout.
+	static std::array<std::string, 3> GetLayoutShaderPaths(const VertexLayout& layout);
 
-	void CreateDescriptorSets();
+	void DestroyLayoutPipelines();
 
-	void CreateTextureImage();
+	// Throws if the layout hasn't been prepared.
+	const LayoutPipelines& GetLayoutPipelines(const VertexLayout& layout) const;
 
-	void CreateTextureImageView();
+	// Instanced pipelines take a second vertex binding, stepped once per instance.
+	void CreateGraphicsPipeline(const std::string& vertexShaderPath, const std::string& fragmentShaderPath, const VertexLayout& layout, bool isInstanced, VkPipeline& pipeline);
 
-	void CreateTextureSampler();
+	// Bind the pipeline, along with the dynamic state and descriptor sets every draw needs.
+	void BindState(VkCommandBuffer commandBuffer, VkPipeline pipeline, uint32_t uniformOffset) const;
 
-	void CreateColorResources();
+	void CreateImageViews();
 
-	void CreateDepthResources();
+	void CreateUniformBuffers();
 
-	void GenerateMipmaps(VkImage image, VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels);
+	void CreateDescriptorSetLayout();
 
-	static std::vector<char> ReadFile(const std::string& filename);
+	void CreateDescriptorPool();
+
+	void CreateDescriptorSets();
+
+	void CreateDepthResources();
 
 	// Vulkan device context.
 	std::shared_ptr<DeviceContext> m_pDeviceContext;
@@ -187,35 +377,36 @@ private:
 
 	VkRenderPass m_renderPass {VK_NULL_HANDLE};
 
+	// The swapchain format the render pass was created for.
+	VkFormat m_renderPassFormat {VK_FORMAT_UNDEFINED};
+
+	bool m_isDepthSampled {false};
+
 	VkPipelineLayout m_pipelineLayout {VK_NULL_HANDLE};
-	VkPipeline m_graphicsPipeline {VK_NULL_HANDLE};
 
-	std::vector<VkFramebuffer> m_swapchainFramebuffers {};
+	// One entry per prepared vertex layout, the float layout first. There are only ever a handful, so they are
+	// searched in order.
+	std::vector<LayoutPipelines> m_layoutPipelines {{GetVertexLayout(VertexLayoutPreset::Float)}};
 
-	std::vector<VkCommandBuffer> m_commandBuffers {};
+	// Draws meshes from the mesh pool, with per draw data indexed by instance.
+	VkPipeline m_indirectPipeline {VK_NULL_HANDLE};
 
 	VkDescriptorPool m_descriptorPool {VK_NULL_HANDLE};
-	std::vector<VkDescriptorSet> m_descriptorSets {};
+	VkDescriptorSet m_descriptorSet {VK_NULL_HANDLE};
 	VkDescriptorSetLayout m_descriptorSetLayout {VK_NULL_HANDLE};
 
-	std::vector<VkImage> m_swapchainImages {};
-	std::vector<VkImageView> m_swapchainImageViews {};
+	SwapchainResources m_swapchainResources {};
 
-	std::vector<VkBuffer> m_uniformBuffers {};
-	std::vector<VkDeviceMemory> m_uniformBuffersMemory {};
+	// Per object uniforms for every frame in flight, bound with a dynamic offset.
+	std::shared_ptr<UniformRing> m_pUniformRing {nullptr};
 
-	VkImage m_colorImage {VK_NULL_HANDLE};
-	VkDeviceMemory m_colorImageMemory {nullptr};
-	VkImageView m_colorImageView {VK_NULL_HANDLE};
+	// Every texture the pipeline draws with, and the default one.
+	std::shared_ptr<TextureStreamer> m_pTextureStreamer {nullptr};
+	AssetHandle m_textureAsset {kInvalidAssetHandle};
+	StreamedTextureId m_texture {kInvalidStreamedTexture};
 
-	VkImage m_depthImage {VK_NULL_HANDLE};
-	VkDeviceMemory m_depthImageMemory {VK_NULL_HANDLE};
-	VkImageView m_depthImageView {VK_NULL_HANDLE};
+	std::shared_ptr<AssetManager> m_pAssetManager {nullptr};
 
-	uint32_t m_mipLevels {0};
-	VkImage m_textureImage {VK_NULL_HANDLE};
-	VkDeviceMemory m_textureImageMemory {VK_NULL_HANDLE};
-	VkImageView m_textureImageView {VK_NULL_HANDLE};
-	VkSampler m_textureSampler {VK_NULL_HANDLE};
+	std::shared_ptr<MipGenerator> m_pMipGenerator {nullptr};
 };
 }
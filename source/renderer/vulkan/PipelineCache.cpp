@@ -0,0 +1,228 @@
+#include "PipelineCache.h"
+
+// STD.
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+
+namespace Jettison::Renderer
+{
+// Our own header, written in front of the driver's blob.
+struct PipelineCacheFileHeader
+{
+	uint32_t magic {0};
+	uint32_t driverVersion {0};
+	uint64_t dataSize {0};
+	uint64_t checksum {0};
+};
+
+constexpr uint32_t kPipelineCacheMagic = 0x3143504a; // "JPC1"
+
+// The fixed part of the header every driver writes at the start of its blob.
+constexpr size_t kVulkanCacheHeaderSize = 16 + VK_UUID_SIZE;
+
+
+// FNV-1a, good enough to catch a truncated or scribbled file.
+static uint64_t Checksum(const char* pData, size_t size)
+{
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= static_cast<uint8_t>(pData[i]);
+		hash *= 1099511628211ull;
+	}
+
+	return hash;
+}
+
+
+static uint32_t ReadUint32(const char* pData)
+{
+	uint32_t value;
+	memcpy(&value, pData, sizeof(value));
+
+	return value;
+}
+
+
+void PipelineCache::Init(const std::string& path)
+{
+	m_path = path;
+
+	std::vector<char> blob = LoadBlob();
+	m_stats = {};
+	m_stats.isWarm = !blob.empty();
+
+	CreateCache(blob);
+}
+
+
+void PipelineCache::Destroy()
+{
+	Save();
+
+	vkDestroyPipelineCache(m_logicalDevice, m_pipelineCache, nullptr);
+	m_pipelineCache = VK_NULL_HANDLE;
+}
+
+
+void PipelineCache::Reset()
+{
+	vkDestroyPipelineCache(m_logicalDevice, m_pipelineCache, nullptr);
+
+	m_stats = {};
+	CreateCache({});
+}
+
+
+void PipelineCache::CreateCache(const std::vector<char>& blob)
+{
+	VkPipelineCacheCreateInfo createInfo {};
+	createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	createInfo.initialDataSize = blob.size();
+	createInfo.pInitialData = blob.empty() ? nullptr : blob.data();
+
+	if (vkCreatePipelineCache(m_logicalDevice, &createInfo, nullptr, &m_pipelineCache) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create pipeline cache");
+	}
+}
+
+
+std::vector<char> PipelineCache::LoadBlob() const
+{
+	std::ifstream file(m_path, std::ios::binary);
+	if (!file.is_open())
+	{
+		return {};
+	}
+
+	PipelineCacheFileHeader header;
+	file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(m_physicalDevice, &properties);
+
+	if (!file || header.magic != kPipelineCacheMagic || header.driverVersion != properties.driverVersion || header.dataSize < kVulkanCacheHeaderSize)
+	{
+		return {};
+	}
+
+	std::vector<char> blob(static_cast<size_t>(header.dataSize));
+	file.read(blob.data(), blob.size());
+
+	if (!file || Checksum(blob.data(), blob.size()) != header.checksum)
+	{
+		std::cerr << "pipeline cache is corrupt, ignoring it\n";
+		return {};
+	}
+
+	// The driver validates this too, but some drivers have been known to crash on blobs from other devices.
+	uint32_t headerSize = ReadUint32(blob.data());
+	uint32_t headerVersion = ReadUint32(blob.data() + 4);
+	uint32_t vendorID = ReadUint32(blob.data() + 8);
+	uint32_t deviceID = ReadUint32(blob.data() + 12);
+	const char* pPipelineCacheUUID = blob.data() + 16;
+
+	if (headerSize < kVulkanCacheHeaderSize || headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+		|| vendorID != properties.vendorID || deviceID != properties.deviceID
+		|| memcmp(pPipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+	{
+		std::cerr << "pipeline cache was written by a different device or driver, ignoring it\n";
+		return {};
+	}
+
+	return blob;
+}
+
+
+void PipelineCache::Save() const
+{
+	if (m_pipelineCache == VK_NULL_HANDLE || m_path.empty())
+	{
+		return;
+	}
+
+	size_t dataSize = 0;
+	if (vkGetPipelineCacheData(m_logicalDevice, m_pipelineCache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0)
+	{
+		return;
+	}
+
+	std::vector<char> blob(dataSize);
+	if (vkGetPipelineCacheData(m_logicalDevice, m_pipelineCache, &dataSize, blob.data()) != VK_SUCCESS)
+	{
+		return;
+	}
+
+	blob.resize(dataSize);
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(m_physicalDevice, &properties);
+
+	PipelineCacheFileHeader header;
+	header.magic = kPipelineCacheMagic;
+	header.driverVersion = properties.driverVersion;
+	header.dataSize = blob.size();
+	header.checksum = Checksum(blob.data(), blob.size());
+
+	std::string tempPath = m_path + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			std::cerr << "failed to write pipeline cache\n";
+			return;
+		}
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(blob.data(), blob.size());
+
+		if (!file)
+		{
+			std::cerr << "failed to write pipeline cache\n";
+			return;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tempPath, m_path, error);
+	if (error)
+	{
+		std::cerr << "failed to replace pipeline cache: " << error.message() << '\n';
+		std::filesystem::remove(tempPath, error);
+	}
+}
+
+
+void PipelineCache::CreateGraphicsPipeline(const VkGraphicsPipelineCreateInfo& createInfo, VkPipeline& pipeline)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	if (vkCreateGraphicsPipelines(m_logicalDevice, m_pipelineCache, 1, &createInfo, nullptr, &pipeline) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create graphics pipeline");
+	}
+
+	m_stats.creationTime += std::chrono::high_resolution_clock::now() - startTime;
+	m_stats.pipelinesCreated++;
+}
+
+
+void PipelineCache::CreateComputePipeline(const VkComputePipelineCreateInfo& createInfo, VkPipeline& pipeline)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	if (vkCreateComputePipelines(m_logicalDevice, m_pipelineCache, 1, &createInfo, nullptr, &pipeline) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create compute pipeline");
+	}
+
+	m_stats.creationTime += std::chrono::high_resolution_clock::now() - startTime;
+	m_stats.pipelinesCreated++;
+}
+}
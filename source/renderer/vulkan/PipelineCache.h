@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// STD.
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+namespace Jettison::Renderer
+{
+// Time spent creating pipelines through the cache, used to compare cold and warm starts.
+struct PipelineCacheStats
+{
+	uint32_t pipelinesCreated {0};
+	std::chrono::duration<double, std::milli> creationTime {0};
+
+	// Was a valid blob loaded from disk at start up?
+	bool isWarm {false};
+};
+
+
+// A VkPipelineCache shared by every pipeline the device creates. The cache is loaded from disk at start up, but only
+// if the blob was written by the same device and driver, and written back when the device is destroyed.
+class PipelineCache
+{
+public:
+	PipelineCache(VkPhysicalDevice physicalDevice, VkDevice logicalDevice)
+		:m_physicalDevice {physicalDevice}, m_logicalDevice {logicalDevice} {}
+
+	// Disable copying.
+	PipelineCache() = default;
+	PipelineCache(const PipelineCache&) = delete;
+	PipelineCache& operator=(const PipelineCache&) = delete;
+
+	void Init(const std::string& path);
+
+	// Saves the cache to disk before destroying it.
+	void Destroy();
+
+	// Throw away everything in the cache, e.g. to measure a cold start.
+	void Reset();
+
+	// Write the cache to a temporary file, then rename it over the old one so a crash can never leave a torn file.
+	void Save() const;
+
+	void CreateGraphicsPipeline(const VkGraphicsPipelineCreateInfo& createInfo, VkPipeline& pipeline);
+
+	void CreateComputePipeline(const VkComputePipelineCreateInfo& createInfo, VkPipeline& pipeline);
+
+	inline VkPipelineCache GetVkPipelineCache() const { return m_pipelineCache; }
+
+	inline const PipelineCacheStats& GetStats() const { return m_stats; }
+
+private:
+	// Returns an empty blob if the file is missing, corrupt, or from a different device or driver.
+	std::vector<char> LoadBlob() const;
+
+	void CreateCache(const std::vector<char>& blob);
+
+	VkPhysicalDevice m_physicalDevice {VK_NULL_HANDLE};
+	VkDevice m_logicalDevice {VK_NULL_HANDLE};
+
+	VkPipelineCache m_pipelineCache {VK_NULL_HANDLE};
+
+	std::string m_path {};
+
+	PipelineCacheStats m_stats {};
+};
+}
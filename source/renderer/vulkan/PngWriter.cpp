@@ -0,0 +1,139 @@
+#include "PngWriter.h"
+
+// STD.
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+
+namespace Jettison::Renderer
+{
+// The largest block deflate can store without compression.
+constexpr size_t kMaxStoredBlockSize = 65535;
+
+
+static uint32_t Crc32(const uint8_t* pData, size_t size, uint32_t crc = 0)
+{
+	static const std::array<uint32_t, 256> kTable = []()
+		{
+			std::array<uint32_t, 256> table {};
+			for (uint32_t i = 0; i < 256; ++i)
+			{
+				uint32_t value = i;
+				for (int bit = 0; bit < 8; ++bit)
+				{
+					value = (value & 1) ? 0xedb88320u ^ (value >> 1) : value >> 1;
+				}
+				table[i] = value;
+			}
+
+			return table;
+		}();
+
+	crc = ~crc;
+	for (size_t i = 0; i < size; ++i)
+	{
+		crc = kTable[(crc ^ pData[i]) & 0xff] ^ (crc >> 8);
+	}
+
+	return ~crc;
+}
+
+
+static uint32_t Adler32(const uint8_t* pData, size_t size)
+{
+	uint32_t a = 1;
+	uint32_t b = 0;
+	for (size_t i = 0; i < size; ++i)
+	{
+		a = (a + pData[i]) % 65521;
+		b = (b + a) % 65521;
+	}
+
+	return (b << 16) | a;
+}
+
+
+static void AppendUint32(std::vector<uint8_t>& data, uint32_t value)
+{
+	// PNG is big endian throughout.
+	data.push_back(static_cast<uint8_t>(value >> 24));
+	data.push_back(static_cast<uint8_t>(value >> 16));
+	data.push_back(static_cast<uint8_t>(value >> 8));
+	data.push_back(static_cast<uint8_t>(value));
+}
+
+
+static void WriteChunk(std::ofstream& file, const char* pType, const std::vector<uint8_t>& data)
+{
+	std::vector<uint8_t> chunk;
+	AppendUint32(chunk, static_cast<uint32_t>(data.size()));
+	chunk.insert(chunk.end(), pType, pType + 4);
+	chunk.insert(chunk.end(), data.begin(), data.end());
+
+	// The CRC covers the type and data, not the length.
+	AppendUint32(chunk, Crc32(chunk.data() + 4, chunk.size() - 4));
+
+	file.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+}
+
+
+void WritePng(const std::string& path, uint32_t width, uint32_t height, const uint8_t* pPixels)
+{
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		throw std::runtime_error("failed to open " + path + " for writing");
+	}
+
+	const uint8_t kSignature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+	file.write(reinterpret_cast<const char*>(kSignature), sizeof(kSignature));
+
+	// Header, 8 bits per channel RGBA, no interlacing.
+	std::vector<uint8_t> header;
+	AppendUint32(header, width);
+	AppendUint32(header, height);
+	header.insert(header.end(), {8, 6, 0, 0, 0});
+	WriteChunk(file, "IHDR", header);
+
+	// Each row is prefixed with its filter type, which is always none.
+	size_t rowSize = static_cast<size_t>(width) * 4;
+	std::vector<uint8_t> rows;
+	rows.reserve((rowSize + 1) * height);
+	for (uint32_t y = 0; y < height; ++y)
+	{
+		rows.push_back(0);
+		rows.insert(rows.end(), pPixels + y * rowSize, pPixels + (y + 1) * rowSize);
+	}
+
+	// A zlib stream made of stored deflate blocks.
+	std::vector<uint8_t> imageData = {0x78, 0x01};
+	size_t offset = 0;
+	do
+	{
+		size_t blockSize = std::min(kMaxStoredBlockSize, rows.size() - offset);
+		bool isFinal = offset + blockSize == rows.size();
+
+		imageData.push_back(isFinal ? 1 : 0);
+		imageData.push_back(static_cast<uint8_t>(blockSize));
+		imageData.push_back(static_cast<uint8_t>(blockSize >> 8));
+		imageData.push_back(static_cast<uint8_t>(~blockSize));
+		imageData.push_back(static_cast<uint8_t>(~blockSize >> 8));
+		imageData.insert(imageData.end(), rows.begin() + offset, rows.begin() + offset + blockSize);
+
+		offset += blockSize;
+	} while (offset < rows.size());
+
+	AppendUint32(imageData, Adler32(rows.data(), rows.size()));
+	WriteChunk(file, "IDAT", imageData);
+
+	WriteChunk(file, "IEND", {});
+
+	if (!file)
+	{
+		throw std::runtime_error("failed to write " + path);
+	}
+}
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+// STD.
+#include <cstdint>
+#include <string>
+
+
+namespace Jettison::Renderer
+{
+// Write 8 bit RGBA pixels to a PNG file. The image data is stored rather than compressed, since this is only used for
+// screenshots and test output where the file size doesn't matter.
+void WritePng(const std::string& path, uint32_t width, uint32_t height, const uint8_t* pPixels);
+}
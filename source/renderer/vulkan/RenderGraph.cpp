@@ -0,0 +1,1232 @@
+#include "RenderGraph.h"
+
+// STD.
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+
+namespace Jettison::Renderer
+{
+// Everything an access can write. What's left of an access mask is the reads.
+constexpr VkAccessFlags kWriteAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
+	| VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+// Usage which lets an image be created transient, so it need never reach memory on a tiler.
+constexpr VkImageUsageFlags kAttachmentUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT
+	| VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+
+
+struct AccessInfo
+{
+	VkPipelineStageFlags stageMask {0};
+	VkAccessFlags readMask {0};
+	VkAccessFlags writeMask {0};
+	VkImageLayout layout {VK_IMAGE_LAYOUT_UNDEFINED};
+	VkImageUsageFlags usage {0};
+	bool isAttachment {false};
+	bool isImage {true};
+	bool isBuffer {true};
+};
+
+
+static AccessInfo GetAccessInfo(RenderGraphAccess access, bool isDepth)
+{
+	VkImageLayout readOnlyLayout = isDepth ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	switch (access)
+	{
+		case RenderGraphAccess::ColourAttachment:
+			return {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+				VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, true, true, false};
+
+		case RenderGraphAccess::DepthAttachment:
+			return {VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+				VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+				VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, true, true, false};
+
+		case RenderGraphAccess::ResolveAttachment:
+			return {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+				VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, true, true, false};
+
+		case RenderGraphAccess::SampledFragment:
+			return {VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, 0, readOnlyLayout, VK_IMAGE_USAGE_SAMPLED_BIT,
+				false, true, false};
+
+		case RenderGraphAccess::SampledCompute:
+			return {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, 0, readOnlyLayout, VK_IMAGE_USAGE_SAMPLED_BIT,
+				false, true, false};
+
+		case RenderGraphAccess::StorageCompute:
+			return {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL,
+				VK_IMAGE_USAGE_STORAGE_BIT, false, true, true};
+
+		case RenderGraphAccess::TransferSource:
+			return {VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, 0, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				VK_IMAGE_USAGE_TRANSFER_SRC_BIT, false, true, true};
+
+		case RenderGraphAccess::TransferDestination:
+			return {VK_PIPELINE_STAGE_TRANSFER_BIT, 0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				VK_IMAGE_USAGE_TRANSFER_DST_BIT, false, true, true};
+
+		case RenderGraphAccess::IndirectRead:
+			return {VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, 0, VK_IMAGE_LAYOUT_UNDEFINED, 0,
+				false, false, true};
+	}
+
+	throw std::runtime_error("unknown render graph access");
+}
+
+
+static VkImageAspectFlags GetAspectMask(VkFormat format)
+{
+	switch (format)
+	{
+		case VK_FORMAT_D16_UNORM:
+		case VK_FORMAT_X8_D24_UNORM_PACK32:
+		case VK_FORMAT_D32_SFLOAT:
+			return VK_IMAGE_ASPECT_DEPTH_BIT;
+
+		case VK_FORMAT_D16_UNORM_S8_UINT:
+		case VK_FORMAT_D24_UNORM_S8_UINT:
+		case VK_FORMAT_D32_SFLOAT_S8_UINT:
+			return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+
+		default:
+			return VK_IMAGE_ASPECT_COLOR_BIT;
+	}
+}
+
+
+static bool IsOverlapping(uint32_t firstPass, uint32_t lastPass, uint32_t otherFirstPass, uint32_t otherLastPass)
+{
+	return firstPass <= otherLastPass && otherFirstPass <= lastPass;
+}
+
+
+void RenderGraphPassContext::BeginRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents) const
+{
+	VkRenderPassBeginInfo renderPassInfo {};
+	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	renderPassInfo.renderPass = renderPass;
+	renderPassInfo.framebuffer = framebuffer;
+	renderPassInfo.renderArea.offset = {0, 0};
+	renderPassInfo.renderArea.extent = extent;
+	renderPassInfo.clearValueCount = static_cast<uint32_t>(pClearValues->size());
+	renderPassInfo.pClearValues = pClearValues->data();
+
+	vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
+}
+
+
+void RenderGraphPassContext::EndRenderPass(VkCommandBuffer commandBuffer) const
+{
+	vkCmdEndRenderPass(commandBuffer);
+}
+
+
+VkCommandBufferInheritanceInfo RenderGraphPassContext::GetInheritanceInfo() const
+{
+	VkCommandBufferInheritanceInfo inheritanceInfo {};
+	inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritanceInfo.renderPass = renderPass;
+	inheritanceInfo.subpass = 0;
+	inheritanceInfo.framebuffer = framebuffer;
+
+	return inheritanceInfo;
+}
+
+
+void RenderGraph::Destroy()
+{
+	CompiledResources resources = TakeCompiledResources();
+	DestroyCompiledResources(m_pDeviceContext.get(), resources);
+
+	m_passes.clear();
+	m_resources.clear();
+	m_slots.clear();
+	m_finalBarriers = {};
+	m_isCompiled = false;
+	m_stats = {};
+}
+
+
+void RenderGraph::Reset()
+{
+	DeviceContext* pDeviceContext = m_pDeviceContext.get();
+	CompiledResources resources = TakeCompiledResources();
+
+	m_pDeviceContext->RetireResource([pDeviceContext, resources]() mutable
+		{
+			DestroyCompiledResources(pDeviceContext, resources);
+		});
+
+	m_passes.clear();
+	m_resources.clear();
+	m_slots.clear();
+	m_finalBarriers = {};
+	m_isCompiled = false;
+	m_stats = {};
+}
+
+
+RenderGraphResource RenderGraph::CreateImage(const std::string& name, const RenderGraphImageDesc& desc)
+{
+	Resource resource;
+	resource.name = name;
+	resource.isImage = true;
+	resource.desc = desc;
+	resource.aspectMask = GetAspectMask(desc.format);
+	m_resources.push_back(resource);
+
+	return static_cast<RenderGraphResource>(m_resources.size() - 1);
+}
+
+
+RenderGraphResource RenderGraph::ImportImage(const std::string& name, const RenderGraphImageDesc& desc, const RenderGraphState& initialState,
+	const RenderGraphState& finalState)
+{
+	Resource resource;
+	resource.name = name;
+	resource.isImage = true;
+	resource.isImported = true;
+	resource.desc = desc;
+	resource.aspectMask = GetAspectMask(desc.format);
+	resource.initialState = initialState;
+	resource.finalState = finalState;
+	m_resources.push_back(resource);
+
+	return static_cast<RenderGraphResource>(m_resources.size() - 1);
+}
+
+
+RenderGraphResource RenderGraph::ImportBuffer(const std::string& name, const RenderGraphState& initialState)
+{
+	Resource resource;
+	resource.name = name;
+	resource.isImported = true;
+	resource.initialState = initialState;
+	m_resources.push_back(resource);
+
+	return static_cast<RenderGraphResource>(m_resources.size() - 1);
+}
+
+
+void RenderGraph::SetImportedImage(RenderGraphResource resource, VkImage image, VkImageView view)
+{
+	if (resource >= m_resources.size() || !m_resources[resource].isImported || !m_resources[resource].isImage)
+	{
+		throw std::runtime_error("only imported images can be set");
+	}
+
+	m_resources[resource].image = image;
+	m_resources[resource].view = view;
+}
+
+
+RenderGraphPass RenderGraph::AddPass(const std::string& name, RecordFunction record)
+{
+	if (m_isCompiled)
+	{
+		throw std::runtime_error("render graph must be reset before adding passes");
+	}
+
+	Pass pass;
+	pass.name = name;
+	pass.record = std::move(record);
+	m_passes.push_back(std::move(pass));
+
+	return static_cast<RenderGraphPass>(m_passes.size() - 1);
+}
+
+
+void RenderGraph::Read(RenderGraphPass pass, RenderGraphResource resource, RenderGraphAccess access)
+{
+	AddUse(pass, resource, access, false);
+}
+
+
+void RenderGraph::Write(RenderGraphPass pass, RenderGraphResource resource, RenderGraphAccess access)
+{
+	AddUse(pass, resource, access, true);
+}
+
+
+void RenderGraph::AddUse(RenderGraphPass pass, RenderGraphResource resource, RenderGraphAccess access, bool isWrite)
+{
+	if (m_isCompiled || pass >= m_passes.size() || resource >= m_resources.size())
+	{
+		throw std::runtime_error("render graph pass or resource out of range");
+	}
+
+	const Resource& graphResource = m_resources[resource];
+	AccessInfo info = GetAccessInfo(access, graphResource.isImage && (graphResource.aspectMask & VK_IMAGE_ASPECT_DEPTH_BIT));
+
+	if ((graphResource.isImage && !info.isImage) || (!graphResource.isImage && !info.isBuffer))
+	{
+		throw std::runtime_error("render graph access doesn't suit the resource " + graphResource.name);
+	}
+
+	// Attachments are always written, even when loaded, and reads and writes can't be swapped over.
+	if ((isWrite && info.writeMask == 0) || (!isWrite && (info.readMask == 0 || info.isAttachment)))
+	{
+		throw std::runtime_error("render graph access can't be used that way on " + graphResource.name);
+	}
+
+	std::vector<Use>& uses = m_passes[pass].uses;
+	auto it = std::find_if(uses.begin(), uses.end(), [resource](const Use& use) { return use.resource == resource; });
+	if (it == uses.end())
+	{
+		Use use;
+		use.resource = resource;
+		use.layout = info.layout;
+		uses.push_back(use);
+		it = uses.end() - 1;
+	}
+	else if (graphResource.isImage && it->layout != info.layout)
+	{
+		throw std::runtime_error("a pass can only use " + graphResource.name + " in one layout");
+	}
+
+	if (info.isAttachment)
+	{
+		if (it->isAttachment && it->attachment != access)
+		{
+			throw std::runtime_error("a pass can only attach " + graphResource.name + " once");
+		}
+
+		it->isAttachment = true;
+		it->attachment = access;
+	}
+
+	it->stageMask |= info.stageMask;
+	it->accessMask |= info.readMask | (isWrite ? info.writeMask : 0);
+	it->usage |= info.usage;
+	it->isWrite = it->isWrite || isWrite;
+}
+
+
+void RenderGraph::Clear(RenderGraphPass pass, RenderGraphResource resource, const VkClearValue& clearValue)
+{
+	if (pass >= m_passes.size())
+	{
+		throw std::runtime_error("render graph pass out of range");
+	}
+
+	std::vector<Use>& uses = m_passes[pass].uses;
+	auto it = std::find_if(uses.begin(), uses.end(), [resource](const Use& use) { return use.resource == resource; });
+	if (it == uses.end() || !it->isAttachment || it->attachment == RenderGraphAccess::ResolveAttachment)
+	{
+		throw std::runtime_error("only a colour or depth attachment can be cleared");
+	}
+
+	it->isCleared = true;
+	it->clearValue = clearValue;
+}
+
+
+void RenderGraph::KeepPass(RenderGraphPass pass)
+{
+	if (pass >= m_passes.size())
+	{
+		throw std::runtime_error("render graph pass out of range");
+	}
+
+	m_passes[pass].isKept = true;
+}
+
+
+void RenderGraph::Compile()
+{
+	if (m_isCompiled)
+	{
+		throw std::runtime_error("render graph is already compiled");
+	}
+
+	CullPasses();
+	ResolveUses();
+	CreateTransientImages();
+	CreateRenderPasses();
+	BuildBarriers();
+
+	m_stats.passCount = static_cast<uint32_t>(m_passes.size());
+	m_isCompiled = true;
+}
+
+
+void RenderGraph::CullPasses()
+{
+	// Imported resources are what the frame is for. Anything else is only needed if a surviving pass reads it.
+	std::vector<bool> isNeeded(m_resources.size());
+	for (size_t i = 0; i < m_resources.size(); ++i)
+	{
+		isNeeded[i] = m_resources[i].isImported;
+	}
+
+	for (auto pass = m_passes.rbegin(); pass != m_passes.rend(); ++pass)
+	{
+		bool isLive = pass->isKept || std::any_of(pass->uses.begin(), pass->uses.end(),
+			[&isNeeded](const Use& use) { return use.isWrite && isNeeded[use.resource]; });
+
+		if (!isLive)
+		{
+			pass->isCulled = true;
+			pass->culledReason = pass->uses.empty() ? "uses nothing" : "nothing reads what it writes";
+			++m_stats.culledPassCount;
+			continue;
+		}
+
+		// Whatever the pass clears or resolves over, the passes before needn't have written.
+		for (const Use& use : pass->uses)
+		{
+			bool isOverwritten = use.isCleared || (use.isAttachment && use.attachment == RenderGraphAccess::ResolveAttachment);
+			if (isOverwritten && !m_resources[use.resource].isImported)
+			{
+				isNeeded[use.resource] = false;
+			}
+		}
+
+		for (const Use& use : pass->uses)
+		{
+			bool isOverwritten = use.isCleared || (use.isAttachment && use.attachment == RenderGraphAccess::ResolveAttachment);
+			if (!isOverwritten)
+			{
+				isNeeded[use.resource] = true;
+			}
+		}
+	}
+}
+
+
+void RenderGraph::ResolveUses()
+{
+	// Imported images keep their contents from before the frame, unless they arrive undefined.
+	std::vector<bool> hasContents(m_resources.size());
+	for (size_t i = 0; i < m_resources.size(); ++i)
+	{
+		hasContents[i] = m_resources[i].isImported && m_resources[i].initialState.layout != VK_IMAGE_LAYOUT_UNDEFINED;
+	}
+
+	for (uint32_t passIndex = 0; passIndex < m_passes.size(); ++passIndex)
+	{
+		if (m_passes[passIndex].isCulled)
+		{
+			continue;
+		}
+
+		for (Use& use : m_passes[passIndex].uses)
+		{
+			Resource& resource = m_resources[use.resource];
+			resource.firstPass = std::min(resource.firstPass, passIndex);
+			resource.lastPass = std::max(resource.lastPass, passIndex);
+			resource.usage |= use.usage;
+
+			bool isOverwritten = use.isCleared || (use.isAttachment && use.attachment == RenderGraphAccess::ResolveAttachment);
+			use.isDiscarded = resource.isImage && (isOverwritten || !hasContents[use.resource]);
+
+			if (use.isWrite)
+			{
+				hasContents[use.resource] = true;
+			}
+		}
+	}
+
+	// Now the last pass to use each resource is known, an attachment only needs storing if something uses it later.
+	for (uint32_t passIndex = 0; passIndex < m_passes.size(); ++passIndex)
+	{
+		for (Use& use : m_passes[passIndex].uses)
+		{
+			const Resource& resource = m_resources[use.resource];
+			use.isStored = resource.isImported || resource.lastPass > passIndex;
+		}
+	}
+
+	for (Resource& resource : m_resources)
+	{
+		if (resource.isImage && !resource.isImported && resource.usage != 0 && (resource.usage & ~kAttachmentUsage) == 0)
+		{
+			resource.usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+		}
+	}
+}
+
+
+void RenderGraph::CreateTransientImages()
+{
+	VkDevice device = m_pDeviceContext->GetLogicalDevice();
+
+	std::vector<RenderGraphResource> transientImages;
+	for (RenderGraphResource i = 0; i < m_resources.size(); ++i)
+	{
+		Resource& resource = m_resources[i];
+
+		// Only the images a surviving pass uses are created at all.
+		if (!resource.isImage || resource.isImported || resource.firstPass == UINT32_MAX)
+		{
+			continue;
+		}
+
+		VkImageCreateInfo imageInfo {};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.extent = {resource.desc.extent.width, resource.desc.extent.height, 1};
+		imageInfo.mipLevels = resource.desc.mipLevels;
+		imageInfo.arrayLayers = 1;
+		imageInfo.format = resource.desc.format;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageInfo.usage = resource.usage;
+		imageInfo.samples = resource.desc.samples;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		if (vkCreateImage(device, &imageInfo, nullptr, &resource.image) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create render graph image " + resource.name);
+		}
+
+		vkGetImageMemoryRequirements(device, resource.image, &resource.memoryRequirements);
+		transientImages.push_back(i);
+
+		++m_stats.transientImageCount;
+		m_stats.transientSize += resource.memoryRequirements.size;
+	}
+
+	// Largest first, each into the first slot whose images are all finished with before it starts, or start after it
+	// ends, and whose memory types it can use.
+	std::stable_sort(transientImages.begin(), transientImages.end(), [this](RenderGraphResource a, RenderGraphResource b)
+		{
+			return m_resources[a].memoryRequirements.size > m_resources[b].memoryRequirements.size;
+		});
+
+	for (RenderGraphResource i : transientImages)
+	{
+		Resource& resource = m_resources[i];
+
+		for (uint32_t slotIndex = 0; slotIndex < m_slots.size() && resource.slot == UINT32_MAX; ++slotIndex)
+		{
+			const MemorySlot& slot = m_slots[slotIndex];
+			bool isFree = std::none_of(slot.images.begin(), slot.images.end(), [this, &resource](RenderGraphResource other)
+				{
+					return IsOverlapping(resource.firstPass, resource.lastPass, m_resources[other].firstPass, m_resources[other].lastPass);
+				});
+
+			if (isFree && (slot.memoryTypeBits & resource.memoryRequirements.memoryTypeBits) != 0)
+			{
+				resource.slot = slotIndex;
+			}
+		}
+
+		if (resource.slot == UINT32_MAX)
+		{
+			resource.slot = static_cast<uint32_t>(m_slots.size());
+
+			MemorySlot slot;
+			slot.memoryTypeBits = resource.memoryRequirements.memoryTypeBits;
+			m_slots.push_back(slot);
+		}
+
+		MemorySlot& slot = m_slots[resource.slot];
+		slot.images.push_back(i);
+		slot.size = std::max(slot.size, resource.memoryRequirements.size);
+		slot.alignment = std::max(slot.alignment, resource.memoryRequirements.alignment);
+		slot.memoryTypeBits &= resource.memoryRequirements.memoryTypeBits;
+	}
+
+	for (MemorySlot& slot : m_slots)
+	{
+		VkMemoryRequirements requirements {};
+		requirements.size = slot.size;
+		requirements.alignment = slot.alignment;
+		requirements.memoryTypeBits = slot.memoryTypeBits;
+
+		slot.allocation = m_pDeviceContext->GetMemoryAllocator().Allocate(requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, ResourceKind::Optimal);
+		m_stats.allocatedSize += slot.size;
+
+		for (RenderGraphResource i : slot.images)
+		{
+			Resource& resource = m_resources[i];
+
+			if (vkBindImageMemory(device, resource.image, slot.allocation.memory, slot.allocation.offset) != VK_SUCCESS)
+			{
+				throw std::runtime_error("failed to bind render graph image " + resource.name);
+			}
+
+			resource.view = m_pDeviceContext->CreateImageView(resource.image, resource.desc.format, resource.aspectMask, resource.desc.mipLevels);
+		}
+	}
+}
+
+
+void RenderGraph::CreateRenderPasses()
+{
+	for (Pass& pass : m_passes)
+	{
+		if (pass.isCulled)
+		{
+			continue;
+		}
+
+		std::vector<VkAttachmentDescription> attachments;
+		std::vector<VkAttachmentReference> colourReferences;
+		std::vector<VkAttachmentReference> resolveReferences;
+		VkAttachmentReference depthReference {};
+		bool hasDepth = false;
+
+		for (const Use& use : pass.uses)
+		{
+			if (!use.isAttachment)
+			{
+				continue;
+			}
+
+			const Resource& resource = m_resources[use.resource];
+
+			// The graph's barriers move the attachments in and out of their layouts, so the render pass leaves them be.
+			VkAttachmentDescription attachment {};
+			attachment.format = resource.desc.format;
+			attachment.samples = resource.desc.samples;
+			attachment.loadOp = use.isCleared ? VK_ATTACHMENT_LOAD_OP_CLEAR : (use.isDiscarded ? VK_ATTACHMENT_LOAD_OP_DONT_CARE : VK_ATTACHMENT_LOAD_OP_LOAD);
+			attachment.storeOp = use.isStored ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			attachment.initialLayout = use.layout;
+			attachment.finalLayout = use.layout;
+
+			VkAttachmentReference reference {static_cast<uint32_t>(attachments.size()), use.layout};
+			attachments.push_back(attachment);
+			pass.clearValues.push_back(use.clearValue);
+			pass.extent = resource.desc.extent;
+
+			switch (use.attachment)
+			{
+				case RenderGraphAccess::ColourAttachment:
+					colourReferences.push_back(reference);
+					break;
+
+				case RenderGraphAccess::DepthAttachment:
+					if (hasDepth)
+					{
+						throw std::runtime_error("pass " + pass.name + " has more than one depth attachment");
+					}
+
+					depthReference = reference;
+					hasDepth = true;
+					break;
+
+				default:
+					resolveReferences.push_back(reference);
+					break;
+			}
+		}
+
+		if (attachments.empty())
+		{
+			continue;
+		}
+
+		if (!resolveReferences.empty() && resolveReferences.size() != colourReferences.size())
+		{
+			throw std::runtime_error("pass " + pass.name + " must resolve every colour attachment, or none");
+		}
+
+		VkSubpassDescription subpass {};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = static_cast<uint32_t>(colourReferences.size());
+		subpass.pColorAttachments = colourReferences.data();
+		subpass.pResolveAttachments = resolveReferences.empty() ? nullptr : resolveReferences.data();
+		subpass.pDepthStencilAttachment = hasDepth ? &depthReference : nullptr;
+
+		// No dependencies, since the barriers are all recorded outside the render pass.
+		VkRenderPassCreateInfo renderPassInfo {};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+		renderPassInfo.pAttachments = attachments.data();
+		renderPassInfo.subpassCount = 1;
+		renderPassInfo.pSubpasses = &subpass;
+
+		if (vkCreateRenderPass(m_pDeviceContext->GetLogicalDevice(), &renderPassInfo, nullptr, &pass.renderPass) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create render pass for " + pass.name);
+		}
+	}
+}
+
+
+void RenderGraph::BuildBarriers()
+{
+	// What has happened to each resource so far. Writes still to be made available, the reads since the last write,
+	// and which reads the last write has been made visible to.
+	struct TrackedState
+	{
+		VkImageLayout layout {VK_IMAGE_LAYOUT_UNDEFINED};
+		VkPipelineStageFlags writeStageMask {0};
+		VkAccessFlags writeAccessMask {0};
+		VkPipelineStageFlags readStageMask {0};
+		VkPipelineStageFlags visibleStageMask {0};
+		VkAccessFlags visibleAccessMask {0};
+	};
+
+	std::vector<TrackedState> states(m_resources.size());
+	for (size_t i = 0; i < m_resources.size(); ++i)
+	{
+		const Resource& resource = m_resources[i];
+		if (!resource.isImported)
+		{
+			continue;
+		}
+
+		states[i].layout = resource.initialState.layout;
+		if (resource.initialState.accessMask != 0)
+		{
+			states[i].writeStageMask = resource.initialState.stageMask;
+			states[i].writeAccessMask = resource.initialState.accessMask;
+		}
+		else
+		{
+			states[i].readStageMask = resource.initialState.stageMask;
+		}
+	}
+
+	for (uint32_t passIndex = 0; passIndex < m_passes.size(); ++passIndex)
+	{
+		Pass& pass = m_passes[passIndex];
+		if (pass.isCulled)
+		{
+			continue;
+		}
+
+		BarrierBatch& batch = pass.barriers;
+
+		for (const Use& use : pass.uses)
+		{
+			const Resource& resource = m_resources[use.resource];
+			TrackedState& state = states[use.resource];
+			VkAccessFlags readAccessMask = use.accessMask & ~kWriteAccessMask;
+			VkAccessFlags writeAccessMask = use.accessMask & kWriteAccessMask;
+
+			// A transient image starts each frame in memory which was last used by whichever image had it before,
+			// perhaps itself in the previous frame. That use has to finish first, though the contents are thrown away.
+			bool isAliasing = false;
+			if (!resource.isImported && passIndex == resource.firstPass)
+			{
+				RenderGraphResource previous = GetPreviousOccupant(use.resource);
+				const Pass& previousPass = m_passes[m_resources[previous].lastPass];
+				auto previousUse = std::find_if(previousPass.uses.begin(), previousPass.uses.end(),
+					[previous](const Use& other) { return other.resource == previous; });
+
+				state = {};
+				state.readStageMask = previousUse->stageMask;
+				isAliasing = previous != use.resource;
+
+				// Another image's writes are flushed with a memory barrier, since an image barrier only covers its own image.
+				VkAccessFlags previousWriteMask = previousUse->accessMask & kWriteAccessMask;
+				if (isAliasing && previousWriteMask != 0)
+				{
+					batch.srcAccessMask |= previousWriteMask;
+					batch.dstAccessMask |= use.accessMask;
+				}
+				else
+				{
+					state.writeStageMask = previousUse->stageMask;
+					state.writeAccessMask = previousWriteMask;
+				}
+			}
+
+			bool isLayoutChange = resource.isImage && state.layout != use.layout;
+			if (use.isWrite || isLayoutChange)
+			{
+				// Writes wait for everything before them, and a layout change is a write.
+				VkPipelineStageFlags srcStageMask = state.writeStageMask | state.readStageMask;
+				if (srcStageMask != 0 || isLayoutChange)
+				{
+					batch.srcStageMask |= srcStageMask != 0 ? srcStageMask : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+					batch.dstStageMask |= use.stageMask;
+
+					if (resource.isImage && (isLayoutChange || state.writeAccessMask != 0))
+					{
+						ImageBarrier imageBarrier;
+						imageBarrier.resource = use.resource;
+						imageBarrier.oldLayout = use.isDiscarded ? VK_IMAGE_LAYOUT_UNDEFINED : state.layout;
+						imageBarrier.newLayout = use.layout;
+						imageBarrier.srcAccessMask = state.writeAccessMask;
+						imageBarrier.dstAccessMask = use.accessMask;
+						batch.imageBarriers.push_back(imageBarrier);
+					}
+					else if (!resource.isImage && state.writeAccessMask != 0)
+					{
+						batch.srcAccessMask |= state.writeAccessMask;
+						batch.dstAccessMask |= use.accessMask;
+					}
+				}
+
+				state.layout = use.layout;
+				state.writeStageMask = use.isWrite ? use.stageMask : 0;
+				state.writeAccessMask = writeAccessMask;
+				state.readStageMask = use.isWrite ? 0 : use.stageMask;
+				state.visibleStageMask = use.isWrite ? 0 : use.stageMask;
+				state.visibleAccessMask = use.isWrite ? 0 : readAccessMask;
+				continue;
+			}
+
+			// A read in the same layout only waits if there is a write it hasn't yet been made visible to.
+			bool isVisible = (use.stageMask & ~state.visibleStageMask) == 0 && (readAccessMask & ~state.visibleAccessMask) == 0;
+			if (state.writeAccessMask != 0 && !isVisible)
+			{
+				batch.srcStageMask |= state.writeStageMask;
+				batch.dstStageMask |= use.stageMask;
+
+				if (resource.isImage)
+				{
+					ImageBarrier imageBarrier;
+					imageBarrier.resource = use.resource;
+					imageBarrier.oldLayout = state.layout;
+					imageBarrier.newLayout = state.layout;
+					imageBarrier.srcAccessMask = state.writeAccessMask;
+					imageBarrier.dstAccessMask = readAccessMask;
+					batch.imageBarriers.push_back(imageBarrier);
+				}
+				else
+				{
+					batch.srcAccessMask |= state.writeAccessMask;
+					batch.dstAccessMask |= readAccessMask;
+				}
+
+				state.visibleStageMask |= use.stageMask;
+				state.visibleAccessMask |= readAccessMask;
+			}
+
+			state.readStageMask |= use.stageMask;
+		}
+	}
+
+	// Hand the imported images over in the states asked for.
+	for (RenderGraphResource i = 0; i < m_resources.size(); ++i)
+	{
+		const Resource& resource = m_resources[i];
+		const TrackedState& state = states[i];
+		if (!resource.isImported || !resource.isImage)
+		{
+			continue;
+		}
+
+		const RenderGraphState& finalState = resource.finalState;
+		if (state.layout == finalState.layout && state.writeAccessMask == 0)
+		{
+			continue;
+		}
+
+		VkPipelineStageFlags srcStageMask = state.writeStageMask | state.readStageMask;
+		m_finalBarriers.srcStageMask |= srcStageMask != 0 ? srcStageMask : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+		m_finalBarriers.dstStageMask |= finalState.stageMask;
+
+		ImageBarrier imageBarrier;
+		imageBarrier.resource = i;
+		imageBarrier.oldLayout = state.layout;
+		imageBarrier.newLayout = finalState.layout;
+		imageBarrier.srcAccessMask = state.writeAccessMask;
+		imageBarrier.dstAccessMask = finalState.accessMask;
+		m_finalBarriers.imageBarriers.push_back(imageBarrier);
+	}
+
+	for (const Pass& pass : m_passes)
+	{
+		if (!pass.isCulled && !pass.barriers.IsEmpty())
+		{
+			++m_stats.barrierBatchCount;
+			m_stats.imageBarrierCount += static_cast<uint32_t>(pass.barriers.imageBarriers.size());
+			m_stats.memoryBarrierCount += pass.barriers.srcAccessMask != 0 ? 1 : 0;
+		}
+	}
+
+	if (!m_finalBarriers.IsEmpty())
+	{
+		++m_stats.barrierBatchCount;
+		m_stats.imageBarrierCount += static_cast<uint32_t>(m_finalBarriers.imageBarriers.size());
+	}
+}
+
+
+RenderGraphResource RenderGraph::GetPreviousOccupant(RenderGraphResource resource) const
+{
+	// The latest to finish before this starts, or failing that, the latest to finish at all, last frame.
+	const Resource& graphResource = m_resources[resource];
+	RenderGraphResource before = kInvalidRenderGraphResource;
+	RenderGraphResource latest = resource;
+
+	for (RenderGraphResource other : m_slots[graphResource.slot].images)
+	{
+		const Resource& otherResource = m_resources[other];
+		if (otherResource.lastPass < graphResource.firstPass
+			&& (before == kInvalidRenderGraphResource || otherResource.lastPass > m_resources[before].lastPass))
+		{
+			before = other;
+		}
+
+		if (otherResource.lastPass > m_resources[latest].lastPass)
+		{
+			latest = other;
+		}
+	}
+
+	return before != kInvalidRenderGraphResource ? before : latest;
+}
+
+
+void RenderGraph::Execute(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+{
+	if (!m_isCompiled)
+	{
+		throw std::runtime_error("render graph must be compiled before it is executed");
+	}
+
+	for (Pass& pass : m_passes)
+	{
+		if (pass.isCulled)
+		{
+			continue;
+		}
+
+		RecordBarriers(commandBuffer, pass.barriers);
+
+		RenderGraphPassContext context;
+		context.renderPass = pass.renderPass;
+		context.framebuffer = pass.renderPass != VK_NULL_HANDLE ? GetFramebuffer(pass) : VK_NULL_HANDLE;
+		context.extent = pass.extent;
+		context.pClearValues = &pass.clearValues;
+		context.frameIndex = frameIndex;
+
+		pass.record(commandBuffer, context);
+	}
+
+	RecordBarriers(commandBuffer, m_finalBarriers);
+}
+
+
+void RenderGraph::RecordBarriers(VkCommandBuffer commandBuffer, const BarrierBatch& batch) const
+{
+	if (batch.IsEmpty())
+	{
+		return;
+	}
+
+	std::vector<VkImageMemoryBarrier> imageBarriers(batch.imageBarriers.size());
+	for (size_t i = 0; i < batch.imageBarriers.size(); ++i)
+	{
+		const ImageBarrier& imageBarrier = batch.imageBarriers[i];
+		const Resource& resource = m_resources[imageBarrier.resource];
+
+		if (resource.image == VK_NULL_HANDLE)
+		{
+			throw std::runtime_error("render graph image " + resource.name + " hasn't been set");
+		}
+
+		VkImageMemoryBarrier& barrier = imageBarriers[i];
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout = imageBarrier.oldLayout;
+		barrier.newLayout = imageBarrier.newLayout;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = resource.image;
+		barrier.subresourceRange = {resource.aspectMask, 0, resource.desc.mipLevels, 0, 1};
+		barrier.srcAccessMask = imageBarrier.srcAccessMask;
+		barrier.dstAccessMask = imageBarrier.dstAccessMask;
+	}
+
+	VkMemoryBarrier memoryBarrier {};
+	memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	memoryBarrier.srcAccessMask = batch.srcAccessMask;
+	memoryBarrier.dstAccessMask = batch.dstAccessMask;
+	uint32_t memoryBarrierCount = batch.srcAccessMask != 0 ? 1 : 0;
+
+	vkCmdPipelineBarrier(commandBuffer, batch.srcStageMask, batch.dstStageMask, 0, memoryBarrierCount, &memoryBarrier,
+		0, nullptr, static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+}
+
+
+VkFramebuffer RenderGraph::GetFramebuffer(Pass& pass)
+{
+	std::vector<VkImageView> views;
+	for (const Use& use : pass.uses)
+	{
+		if (use.isAttachment)
+		{
+			const Resource& resource = m_resources[use.resource];
+			if (resource.view == VK_NULL_HANDLE)
+			{
+				throw std::runtime_error("render graph image " + resource.name + " hasn't been set");
+			}
+
+			views.push_back(resource.view);
+		}
+	}
+
+	for (const auto& framebuffer : pass.framebuffers)
+	{
+		if (framebuffer.first == views)
+		{
+			return framebuffer.second;
+		}
+	}
+
+	VkFramebufferCreateInfo framebufferInfo {};
+	framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+	framebufferInfo.renderPass = pass.renderPass;
+	framebufferInfo.attachmentCount = static_cast<uint32_t>(views.size());
+	framebufferInfo.pAttachments = views.data();
+	framebufferInfo.width = pass.extent.width;
+	framebufferInfo.height = pass.extent.height;
+	framebufferInfo.layers = 1;
+
+	VkFramebuffer framebuffer;
+	if (vkCreateFramebuffer(m_pDeviceContext->GetLogicalDevice(), &framebufferInfo, nullptr, &framebuffer) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create framebuffer for " + pass.name);
+	}
+
+	pass.framebuffers.emplace_back(std::move(views), framebuffer);
+
+	return framebuffer;
+}
+
+
+VkImage RenderGraph::GetImage(RenderGraphResource resource) const
+{
+	if (!m_isCompiled || resource >= m_resources.size())
+	{
+		throw std::runtime_error("render graph image isn't available");
+	}
+
+	return m_resources[resource].image;
+}
+
+
+VkImageView RenderGraph::GetImageView(RenderGraphResource resource) const
+{
+	if (!m_isCompiled || resource >= m_resources.size())
+	{
+		throw std::runtime_error("render graph image isn't available");
+	}
+
+	return m_resources[resource].view;
+}
+
+
+RenderGraph::CompiledResources RenderGraph::TakeCompiledResources()
+{
+	CompiledResources resources;
+
+	for (Resource& resource : m_resources)
+	{
+		if (!resource.isImported && resource.image != VK_NULL_HANDLE)
+		{
+			resources.images.push_back(resource.image);
+			resources.views.push_back(resource.view);
+			resource.image = VK_NULL_HANDLE;
+			resource.view = VK_NULL_HANDLE;
+		}
+	}
+
+	for (MemorySlot& slot : m_slots)
+	{
+		if (slot.allocation.memory != VK_NULL_HANDLE)
+		{
+			resources.allocations.push_back(slot.allocation);
+			slot.allocation = {};
+		}
+	}
+
+	for (Pass& pass : m_passes)
+	{
+		if (pass.renderPass != VK_NULL_HANDLE)
+		{
+			resources.renderPasses.push_back(pass.renderPass);
+			pass.renderPass = VK_NULL_HANDLE;
+		}
+
+		for (const auto& framebuffer : pass.framebuffers)
+		{
+			resources.framebuffers.push_back(framebuffer.second);
+		}
+
+		pass.framebuffers.clear();
+	}
+
+	return resources;
+}
+
+
+void RenderGraph::DestroyCompiledResources(DeviceContext* pDeviceContext, CompiledResources& resources)
+{
+	VkDevice device = pDeviceContext->GetLogicalDevice();
+
+	for (auto framebuffer : resources.framebuffers)
+	{
+		vkDestroyFramebuffer(device, framebuffer, nullptr);
+	}
+
+	for (auto renderPass : resources.renderPasses)
+	{
+		vkDestroyRenderPass(device, renderPass, nullptr);
+	}
+
+	for (auto view : resources.views)
+	{
+		vkDestroyImageView(device, view, nullptr);
+	}
+
+	// The images share their memory, so it is freed separately.
+	for (auto image : resources.images)
+	{
+		vkDestroyImage(device, image, nullptr);
+	}
+
+	for (auto& allocation : resources.allocations)
+	{
+		pDeviceContext->GetMemoryAllocator().Free(allocation);
+	}
+
+	resources = {};
+}
+
+
+static std::string GetStageNames(VkPipelineStageFlags stageMask)
+{
+	static const std::pair<VkPipelineStageFlags, const char*> kStageNames[] = {
+		{VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, "top"},
+		{VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, "indirect"},
+		{VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, "vertex"},
+		{VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, "fragment"},
+		{VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT, "early tests"},
+		{VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, "late tests"},
+		{VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, "colour output"},
+		{VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, "compute"},
+		{VK_PIPELINE_STAGE_TRANSFER_BIT, "transfer"},
+		{VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, "bottom"},
+		{VK_PIPELINE_STAGE_HOST_BIT, "host"},
+		{VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, "all"},
+	};
+
+	std::string names;
+	for (const auto& stageName : kStageNames)
+	{
+		if (stageMask & stageName.first)
+		{
+			names += (names.empty() ? "" : " | ") + std::string(stageName.second);
+		}
+	}
+
+	return names.empty() ? "none" : names;
+}
+
+
+static const char* GetLayoutName(VkImageLayout layout)
+{
+	switch (layout)
+	{
+		case VK_IMAGE_LAYOUT_UNDEFINED: return "undefined";
+		case VK_IMAGE_LAYOUT_GENERAL: return "general";
+		case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL: return "colour attachment";
+		case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL: return "depth attachment";
+		case VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL: return "depth read only";
+		case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL: return "shader read only";
+		case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL: return "transfer source";
+		case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL: return "transfer destination";
+		case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR: return "present";
+		default: return "other";
+	}
+}
+
+
+std::string RenderGraph::Dump() const
+{
+	std::ostringstream stream;
+
+	auto dumpBarriers = [this, &stream](const BarrierBatch& batch)
+		{
+			if (batch.IsEmpty())
+			{
+				return;
+			}
+
+			stream << "    barrier " << GetStageNames(batch.srcStageMask) << " -> " << GetStageNames(batch.dstStageMask) << "\n";
+			if (batch.srcAccessMask != 0)
+			{
+				stream << "      memory\n";
+			}
+
+			for (const ImageBarrier& imageBarrier : batch.imageBarriers)
+			{
+				stream << "      " << m_resources[imageBarrier.resource].name << ": " << GetLayoutName(imageBarrier.oldLayout)
+					<< " -> " << GetLayoutName(imageBarrier.newLayout) << "\n";
+			}
+		};
+
+	stream << "render graph, " << m_stats.passCount << " passes, " << m_stats.culledPassCount << " culled, "
+		<< m_stats.barrierBatchCount << " barrier batches with " << m_stats.imageBarrierCount << " image and "
+		<< m_stats.memoryBarrierCount << " memory barriers\n";
+
+	for (const Pass& pass : m_passes)
+	{
+		if (pass.isCulled)
+		{
+			stream << "  pass " << pass.name << ": culled, " << pass.culledReason << "\n";
+			continue;
+		}
+
+		stream << "  pass " << pass.name << (pass.renderPass != VK_NULL_HANDLE ? ", render pass" : "") << "\n";
+		dumpBarriers(pass.barriers);
+
+		for (const Use& use : pass.uses)
+		{
+			const Resource& resource = m_resources[use.resource];
+			stream << "    " << (use.isWrite ? "write " : "read ") << resource.name << " at " << GetStageNames(use.stageMask);
+
+			if (resource.isImage)
+			{
+				stream << ", " << GetLayoutName(use.layout);
+			}
+
+			if (use.isAttachment)
+			{
+				stream << (use.isCleared ? ", clear" : (use.isDiscarded ? ", don't load" : ", load"))
+					<< (use.isStored ? ", store" : ", don't store");
+			}
+
+			stream << "\n";
+		}
+	}
+
+	if (!m_finalBarriers.IsEmpty())
+	{
+		stream << "  end of frame\n";
+		dumpBarriers(m_finalBarriers);
+	}
+
+	for (const Resource& resource : m_resources)
+	{
+		if (!resource.isImage || resource.isImported)
+		{
+			continue;
+		}
+
+		stream << "  transient " << resource.name << ": " << resource.desc.extent.width << " x " << resource.desc.extent.height
+			<< ", " << resource.desc.samples << (resource.desc.samples == 1 ? " sample, " : " samples, ") << resource.desc.mipLevels
+			<< (resource.desc.mipLevels == 1 ? " level" : " levels");
+
+		if (resource.slot == UINT32_MAX)
+		{
+			stream << ", never created\n";
+			continue;
+		}
+
+		stream << ", " << resource.memoryRequirements.size / 1024 << " KB, passes " << resource.firstPass << " to "
+			<< resource.lastPass << ", slot " << resource.slot << "\n";
+	}
+
+	stream << "  " << m_stats.transientSize / 1024 << " KB of transient images in " << m_stats.allocatedSize / 1024 << " KB of memory, "
+		<< (m_stats.transientSize - m_stats.allocatedSize) / 1024 << " KB saved by aliasing\n";
+
+	return stream.str();
+}
+}
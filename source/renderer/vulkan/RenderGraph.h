@@ -0,0 +1,330 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// STD.
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "DeviceContext.h"
+
+
+namespace Jettison::Renderer
+{
+// An image or buffer declared to the render graph.
+using RenderGraphResource = uint32_t;
+
+constexpr RenderGraphResource kInvalidRenderGraphResource = UINT32_MAX;
+
+using RenderGraphPass = uint32_t;
+
+
+// How a pass uses a resource. Each implies the stages, access and, for images, the layout, so the graph can work out
+// the barriers between passes for itself.
+enum class RenderGraphAccess : uint32_t
+{
+	// Images only. Attachments are numbered in the order they are declared, so the graph's render pass can match one
+	// the pass's pipelines were created against.
+	ColourAttachment,
+	DepthAttachment,
+	ResolveAttachment,
+	SampledFragment,
+	SampledCompute,
+
+	// Images, in the general layout, or buffers.
+	StorageCompute,
+	TransferSource,
+	TransferDestination,
+
+	// Buffers only.
+	IndirectRead,
+};
+
+
+// Where an imported resource is when the frame starts, or must be left when it ends. The stages are the ones the
+// frame has to wait on, and the access is any writes still to be made available, so zero for a resource last read.
+struct RenderGraphState
+{
+	VkImageLayout layout {VK_IMAGE_LAYOUT_UNDEFINED};
+	VkPipelineStageFlags stageMask {VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT};
+	VkAccessFlags accessMask {0};
+};
+
+
+struct RenderGraphImageDesc
+{
+	VkFormat format {VK_FORMAT_UNDEFINED};
+	VkExtent2D extent {0, 0};
+	VkSampleCountFlagBits samples {VK_SAMPLE_COUNT_1_BIT};
+	uint32_t mipLevels {1};
+};
+
+
+// What the last compile came to.
+struct RenderGraphStats
+{
+	uint32_t passCount {0};
+	uint32_t culledPassCount {0};
+
+	// Each execution records one barrier command for every batch, before the passes which need one and at the end.
+	uint32_t barrierBatchCount {0};
+	uint32_t imageBarrierCount {0};
+	uint32_t memoryBarrierCount {0};
+
+	uint32_t transientImageCount {0};
+
+	// What the transient images would take in their own memory, and what they take aliased.
+	VkDeviceSize transientSize {0};
+	VkDeviceSize allocatedSize {0};
+};
+
+
+// Handed to each pass as it records. A pass with attachments begins and ends its own render pass, so it can choose
+// to record into secondary command buffers.
+struct RenderGraphPassContext
+{
+	VkRenderPass renderPass {VK_NULL_HANDLE};
+	VkFramebuffer framebuffer {VK_NULL_HANDLE};
+	VkExtent2D extent {0, 0};
+	const std::vector<VkClearValue>* pClearValues {nullptr};
+
+	// The frame in flight being recorded.
+	uint32_t frameIndex {0};
+
+	void BeginRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents) const;
+
+	void EndRenderPass(VkCommandBuffer commandBuffer) const;
+
+	// What secondary command buffers need to know to continue the render pass.
+	VkCommandBufferInheritanceInfo GetInheritanceInfo() const;
+};
+
+
+// A frame described as passes, each declaring which resources it reads and writes. Compiling the graph culls the
+// passes nothing depends on, works out the fewest barriers between the rest, one batch before each pass at most, and
+// makes a render pass for each pass with attachments, with load and store ops to match how the attachments are used.
+//
+// Transient images are created by the graph, and only live from the first pass which uses them to the last. Those
+// whose lifetimes don't overlap share memory. Imported resources belong to someone else, and are never culled.
+//
+// The graph is built and compiled once, then executed into as many command buffers as need it, until something it
+// depends on changes. Then it is reset and built again, and the old images and render passes are retired.
+class RenderGraph
+{
+public:
+	using RecordFunction = std::function<void(VkCommandBuffer commandBuffer, const RenderGraphPassContext& context)>;
+
+	RenderGraph(std::shared_ptr<DeviceContext> pDeviceContext)
+		:m_pDeviceContext {pDeviceContext} {}
+
+	// Disable copying.
+	RenderGraph() = default;
+	RenderGraph(const RenderGraph&) = delete;
+	RenderGraph& operator=(const RenderGraph&) = delete;
+
+	void Destroy();
+
+	// Throw away the passes and resources, handing the compiled images and render passes to the device context to
+	// destroy once the frames in flight are done with them.
+	void Reset();
+
+	// An image the graph creates, which lives only as long as the passes using it.
+	RenderGraphResource CreateImage(const std::string& name, const RenderGraphImageDesc& desc);
+
+	// An image owned elsewhere. It may be bound later, or changed between executions, e.g. for each swapchain image.
+	RenderGraphResource ImportImage(const std::string& name, const RenderGraphImageDesc& desc, const RenderGraphState& initialState,
+		const RenderGraphState& finalState);
+
+	// A buffer owned elsewhere. Buffers are synchronised with memory barriers, so the graph never needs the handle.
+	RenderGraphResource ImportBuffer(const std::string& name, const RenderGraphState& initialState);
+
+	void SetImportedImage(RenderGraphResource resource, VkImage image, VkImageView view);
+
+	// Passes run in the order they are added.
+	RenderGraphPass AddPass(const std::string& name, RecordFunction record);
+
+	void Read(RenderGraphPass pass, RenderGraphResource resource, RenderGraphAccess access);
+
+	// A pass may use a resource more than once, e.g. filling a buffer before a compute shader writes it. The uses are
+	// merged, and must agree on the layout.
+	void Write(RenderGraphPass pass, RenderGraphResource resource, RenderGraphAccess access);
+
+	// Clear an attachment as the pass's render pass begins, rather than loading it.
+	void Clear(RenderGraphPass pass, RenderGraphResource resource, const VkClearValue& clearValue);
+
+	// Keep the pass even though nothing in the graph reads what it writes, e.g. when the host reads it.
+	void KeepPass(RenderGraphPass pass);
+
+	void Compile();
+
+	// Record every pass which survived culling, with its barriers, then leave the imported images as asked.
+	void Execute(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+
+	// Only valid after compiling.
+	VkImage GetImage(RenderGraphResource resource) const;
+
+	VkImageView GetImageView(RenderGraphResource resource) const;
+
+	inline bool IsCompiled() const { return m_isCompiled; }
+
+	inline const RenderGraphStats& GetStats() const { return m_stats; }
+
+	// The compiled graph as text: each pass with its barriers and render pass, or why it was culled, then the
+	// transient images and the memory they share.
+	std::string Dump() const;
+
+private:
+	struct Use
+	{
+		RenderGraphResource resource {kInvalidRenderGraphResource};
+
+		// Every use the pass declared, merged.
+		VkPipelineStageFlags stageMask {0};
+		VkAccessFlags accessMask {0};
+		VkImageUsageFlags usage {0};
+		VkImageLayout layout {VK_IMAGE_LAYOUT_UNDEFINED};
+		bool isWrite {false};
+
+		// Attachments only.
+		RenderGraphAccess attachment {RenderGraphAccess::StorageCompute};
+		bool isAttachment {false};
+		bool isCleared {false};
+		VkClearValue clearValue {};
+
+		// Worked out when compiling. The contents are discarded if nothing before the pass left any, or the pass
+		// clears or resolves over them.
+		bool isDiscarded {false};
+		bool isStored {false};
+	};
+
+	struct ImageBarrier
+	{
+		RenderGraphResource resource {kInvalidRenderGraphResource};
+		VkImageLayout oldLayout {VK_IMAGE_LAYOUT_UNDEFINED};
+		VkImageLayout newLayout {VK_IMAGE_LAYOUT_UNDEFINED};
+		VkAccessFlags srcAccessMask {0};
+		VkAccessFlags dstAccessMask {0};
+	};
+
+	// Everything one barrier command needs, bar the images, which are looked up as it is recorded.
+	struct BarrierBatch
+	{
+		VkPipelineStageFlags srcStageMask {0};
+		VkPipelineStageFlags dstStageMask {0};
+
+		// For buffers, and for memory an image has taken over from another.
+		VkAccessFlags srcAccessMask {0};
+		VkAccessFlags dstAccessMask {0};
+
+		std::vector<ImageBarrier> imageBarriers {};
+
+		// Anything which needs waiting on sets the stages.
+		inline bool IsEmpty() const { return dstStageMask == 0; }
+	};
+
+	struct Pass
+	{
+		std::string name {};
+		RecordFunction record {};
+		std::vector<Use> uses {};
+		bool isKept {false};
+
+		// Worked out when compiling.
+		bool isCulled {false};
+		std::string culledReason {};
+		BarrierBatch barriers {};
+		VkRenderPass renderPass {VK_NULL_HANDLE};
+		VkExtent2D extent {0, 0};
+		std::vector<VkClearValue> clearValues {};
+
+		// One for each set of attachment views seen so far, created as the pass is first executed with them.
+		std::vector<std::pair<std::vector<VkImageView>, VkFramebuffer>> framebuffers {};
+	};
+
+	struct Resource
+	{
+		std::string name {};
+		bool isImage {false};
+		bool isImported {false};
+		RenderGraphImageDesc desc {};
+		VkImageAspectFlags aspectMask {0};
+		RenderGraphState initialState {};
+		RenderGraphState finalState {};
+
+		VkImage image {VK_NULL_HANDLE};
+		VkImageView view {VK_NULL_HANDLE};
+
+		// Worked out when compiling. Transient images are only created if a pass survives to use them.
+		uint32_t firstPass {UINT32_MAX};
+		uint32_t lastPass {0};
+		VkImageUsageFlags usage {0};
+		VkMemoryRequirements memoryRequirements {};
+		uint32_t slot {UINT32_MAX};
+	};
+
+	// Memory shared by transient images whose lifetimes don't overlap, each bound at the start.
+	struct MemorySlot
+	{
+		std::vector<RenderGraphResource> images {};
+		VkDeviceSize size {0};
+		VkDeviceSize alignment {1};
+		uint32_t memoryTypeBits {0};
+		Allocation allocation {};
+	};
+
+	// Everything the compile creates, retired together.
+	struct CompiledResources
+	{
+		std::vector<VkImage> images {};
+		std::vector<VkImageView> views {};
+		std::vector<Allocation> allocations {};
+		std::vector<VkRenderPass> renderPasses {};
+		std::vector<VkFramebuffer> framebuffers {};
+	};
+
+	// Drop the passes which nothing surviving depends on, working back from the imported resources.
+	void CullPasses();
+
+	// Lifetimes and usage of the transient images, then whether each attachment is loaded and stored.
+	void ResolveUses();
+
+	void CreateTransientImages();
+
+	void CreateRenderPasses();
+
+	// Walk the passes in order, tracking each resource's layout and the stages still to be waited on.
+	void BuildBarriers();
+
+	// Which transient image last used the memory this one is bound to, which may be itself, in the previous frame.
+	RenderGraphResource GetPreviousOccupant(RenderGraphResource resource) const;
+
+	void RecordBarriers(VkCommandBuffer commandBuffer, const BarrierBatch& batch) const;
+
+	VkFramebuffer GetFramebuffer(Pass& pass);
+
+	// Merge a use into the pass's use of the resource, adding one if it is the first.
+	void AddUse(RenderGraphPass pass, RenderGraphResource resource, RenderGraphAccess access, bool isWrite);
+
+	// Gather up what compiling created into the compiled resources, ready to be retired or destroyed.
+	CompiledResources TakeCompiledResources();
+
+	static void DestroyCompiledResources(DeviceContext* pDeviceContext, CompiledResources& resources);
+
+	// Vulkan device context.
+	std::shared_ptr<DeviceContext> m_pDeviceContext {nullptr};
+
+	std::vector<Pass> m_passes {};
+	std::vector<Resource> m_resources {};
+	std::vector<MemorySlot> m_slots {};
+
+	// Leaves the imported images in their final states.
+	BarrierBatch m_finalBarriers {};
+
+	bool m_isCompiled {false};
+
+	RenderGraphStats m_stats {};
+};
+}
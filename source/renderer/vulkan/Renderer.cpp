@@ -2,17 +2,20 @@
 
 #include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
 #include <set>
 #include <stdexcept>
+#include <thread>
 #include <vector>
 
 
 namespace Jettison::Renderer
 {
-constexpr int kMaxFramesInFlight = 2;
+// Below this many draws it costs more to wake the recording threads than it saves.
+constexpr uint32_t kMinParallelDrawCount = 1024;
 
 
 void Renderer::Init()
@@ -23,62 +26,349 @@ void Renderer::Init()
 
 void Renderer::InitVulkan()
 {
-	// Device initialisation.
-	assert(m_pWindow != nullptr && m_pWindow->GetGLFWWindow() != nullptr);
+	// Device initialisation. There is no window when headless.
+	assert(m_pWindow == nullptr || m_pWindow->GetGLFWWindow() != nullptr);
 
-	CreateSyncObjects();
+	// Every frame needs a command pool per recording thread, so the most threads we'll ever use is settled here.
+	m_maxRecordingThreadCount = std::clamp(std::thread::hardware_concurrency(), 1u, kMaxRecordingThreads);
+
+	// The swapchain starts out with the default latency mode's settings too.
+	LatencySettings latencySettings = GetLatencySettings(m_latencyMode);
+	m_isFrameLimited = latencySettings.isFrameLimited;
+
+	m_pFrameContext = std::make_shared<FrameContext>(m_pDeviceContext, m_pSwapchain);
+	m_pFrameContext->Init(latencySettings.framesInFlight, m_maxRecordingThreadCount);
+
+	m_pCommandRecorder = std::make_shared<CommandRecorder>(m_pFrameContext);
+	m_pCommandRecorder->Init(m_maxRecordingThreadCount);
+
+	m_pGpuProfiler = std::make_shared<GpuProfiler>(m_pDeviceContext);
+	m_pGpuProfiler->Init(kMaxFramesInFlight);
+	m_frameScope = m_pGpuProfiler->RegisterScope("frame");
+	m_scenePassScope = m_pGpuProfiler->RegisterScope("scene pass");
+	m_cullingScope = m_pGpuProfiler->RegisterScope("culling");
+
+	m_pGpuCuller = std::make_shared<GpuCuller>(m_pDeviceContext, m_pSwapchain, m_pPipeline);
+	m_pGpuCuller->Init();
+
+	m_pRenderGraph = std::make_shared<RenderGraph>(m_pDeviceContext);
+	BuildRenderGraph();
+
+	m_imagesInFlight.resize(m_pSwapchain->GetImageCount(), VK_NULL_HANDLE);
 }
 
 
 void Renderer::Destroy()
 {
-	for (size_t i = 0; i < kMaxFramesInFlight; ++i)
+	m_pRenderGraph->Destroy();
+	m_pGpuCuller->Destroy();
+	m_pGpuProfiler->Destroy();
+	m_pCommandRecorder->Destroy();
+	m_pFrameContext->Destroy();
+}
+
+
+void Renderer::SetModel(const Model* pModel)
+{
+	std::vector<DrawItem> drawList;
+
+	if (pModel)
 	{
-		vkDestroySemaphore(m_pDeviceContext->GetLogicalDevice(), m_renderFinishedSemaphores[i], nullptr);
-		vkDestroySemaphore(m_pDeviceContext->GetLogicalDevice(), m_imageAvailableSemaphores[i], nullptr);
-		vkDestroyFence(m_pDeviceContext->GetLogicalDevice(), m_inFlightFences[i], nullptr);
+		drawList.push_back({pModel, 0, pModel->GetIndexCount()});
 	}
+
+	SetDrawList(std::move(drawList));
 }
 
 
-void Renderer::CreateSyncObjects()
+void Renderer::SetDrawList(std::vector<DrawItem> drawList)
 {
-	m_imageAvailableSemaphores.resize(kMaxFramesInFlight);
-	m_renderFinishedSemaphores.resize(kMaxFramesInFlight);
-	m_inFlightFences.resize(kMaxFramesInFlight);
-	m_imagesInFlight.resize(m_pSwapchain->GetImageCount(), VK_NULL_HANDLE);
+	m_drawList = std::move(drawList);
+
+	m_drawListModels.clear();
+	m_drawListTextures.clear();
+	m_instancedDrawItems.clear();
+	for (const auto& drawItem : m_drawList)
+	{
+		if (std::find(m_drawListModels.begin(), m_drawListModels.end(), drawItem.pModel) == m_drawListModels.end())
+		{
+			m_drawListModels.push_back(drawItem.pModel);
+
+			// Nothing is recording yet, so this is the safe place to create any pipelines the model's layout needs.
+			m_pPipeline->PrepareVertexLayout(drawItem.pModel->GetVertexLayout());
+		}
 
-	VkSemaphoreCreateInfo semaphoreInfo {};
-	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		if (drawItem.streamedTexture != kInvalidStreamedTexture
+			&& std::find(m_drawListTextures.begin(), m_drawListTextures.end(), drawItem.streamedTexture) == m_drawListTextures.end())
+		{
+			m_drawListTextures.push_back(drawItem.streamedTexture);
+		}
 
-	VkFenceCreateInfo fenceInfo {};
-	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-	fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+		if (drawItem.pInstances)
+		{
+			// The instances are sorted by level of detail, and the draws written, for one particular item.
+			if (std::any_of(m_instancedDrawItems.begin(), m_instancedDrawItems.end(),
+				[&drawItem](const DrawItem* pDrawItem) { return pDrawItem->pInstances == drawItem.pInstances; }))
+			{
+				throw std::runtime_error("an instance buffer can only be drawn by one draw item");
+			}
+
+			m_instancedDrawItems.push_back(&drawItem);
+		}
+	}
 
-	for (size_t i = 0; i < kMaxFramesInFlight; ++i)
+	MarkSceneDirty();
+}
+
+
+void Renderer::SetIndirectScene(IndirectScene* pIndirectScene)
+{
+	m_pIndirectScene = pIndirectScene;
+	m_pGpuCuller->SetScene(pIndirectScene);
+
+	// The culler needs the pyramid handing back, along with the new scene.
+	m_isRenderGraphDirty = true;
+
+	if (m_pIndirectScene)
+	{
+		m_pIndirectScene->SetCulled(m_isCullingEnabled);
+	}
+
+	MarkSceneDirty();
+}
+
+
+void Renderer::SetCullingEnabled(bool isCullingEnabled)
+{
+	m_isCullingEnabled = isCullingEnabled;
+
+	if (m_pIndirectScene)
+	{
+		m_pIndirectScene->SetCulled(m_isCullingEnabled);
+	}
+
+	// Culling is recorded into the command buffers, along with which buffers the draws read. The render graph follows
+	// on the next frame.
+	MarkSceneDirty();
+}
+
+
+void Renderer::SetRecordingThreadCount(uint32_t threadCount)
+{
+	if (threadCount == 0 || threadCount > m_maxRecordingThreadCount)
 	{
-		if (vkCreateSemaphore(m_pDeviceContext->GetLogicalDevice(), &semaphoreInfo, nullptr, &m_imageAvailableSemaphores[i]) != VK_SUCCESS
-			|| vkCreateSemaphore(m_pDeviceContext->GetLogicalDevice(), &semaphoreInfo, nullptr, &m_renderFinishedSemaphores[i]) != VK_SUCCESS
-			|| vkCreateFence(m_pDeviceContext->GetLogicalDevice(), &fenceInfo, nullptr, &m_inFlightFences[i]) != VK_SUCCESS)
+		throw std::runtime_error("recording thread count out of range");
+	}
+
+	// The workers are idle between frames, so they can simply be replaced.
+	m_pCommandRecorder->Destroy();
+	m_pCommandRecorder->Init(threadCount);
+	MarkSceneDirty();
+}
+
+
+void Renderer::SetLatencyMode(LatencyMode latencyMode)
+{
+	LatencySettings latencySettings = GetLatencySettings(latencyMode);
+
+	// The number of frames in flight is changing, so every frame has to be finished with first.
+	m_pDeviceContext->WaitIdle();
+
+	m_pFrameContext->Destroy();
+	m_pFrameContext->Init(latencySettings.framesInFlight, m_maxRecordingThreadCount);
+	m_pFrameContext->ResetLatencyStats();
+
+	m_pSwapchain->SetLatencySettings(latencySettings);
+	RecreateSwapchain();
+
+	m_latencyMode = latencyMode;
+	m_isFrameLimited = latencySettings.isFrameLimited;
+}
+
+
+void Renderer::BeginInputSampling()
+{
+	if (m_isFrameLimited)
+	{
+		m_pFrameContext->WaitForPreviousFrame();
+	}
+
+	m_pFrameContext->MarkInputSampled();
+}
+
+
+void Renderer::RecreateSwapchain()
+{
+	// Nothing here waits for the device. The old swapchain and everything sized to it are retired, and destroyed once
+	// the frames in flight have finished with them.
+	m_pSwapchain->Recreate();
+	m_pPipeline->Recreate();
+	m_swapchainRecreateCount++;
+
+	// The graph's transient images are sized to the swapchain too. Building it marks every recorded command buffer
+	// stale.
+	BuildRenderGraph();
+	m_imagesInFlight.assign(m_pSwapchain->GetImageCount(), VK_NULL_HANDLE);
+}
+
+
+void Renderer::BuildRenderGraph()
+{
+	bool isCulled = m_isSceneReady && m_pIndirectScene && m_isCullingEnabled;
+	VkExtent2D extent = m_pSwapchain->GetExtents();
+	VkSampleCountFlagBits msaaSamples = m_pDeviceContext->GetMsaaSamples();
+
+	// Whatever was compiled before is retired, as frames in flight may still be using it.
+	RenderGraph& graph = *m_pRenderGraph;
+	graph.Reset();
+
+	// Each swapchain image arrives undefined, once the image available semaphore has been waited on, and leaves to be
+	// presented, or copied back to the host when headless.
+	RenderGraphImageDesc swapchainDesc {m_pSwapchain->GetImageFormat(), extent, VK_SAMPLE_COUNT_1_BIT, 1};
+	RenderGraphState swapchainFinalState {m_pSwapchain->GetFinalLayout(), VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0};
+	if (m_pSwapchain->IsHeadless())
+	{
+		swapchainFinalState = {VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT};
+	}
+
+	m_swapchainImageResource = graph.ImportImage("swapchain image", swapchainDesc,
+		{VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0}, swapchainFinalState);
+
+	// The depth attachment outlives the frame, since the next one culls against it, so it stays with the pipeline.
+	RenderGraphImageDesc depthDesc {m_pDeviceContext->FindDepthFormat(), extent, msaaSamples, 1};
+	RenderGraphResource depth = graph.ImportImage("depth", depthDesc,
+		{VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0},
+		{VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT});
+	graph.SetImportedImage(depth, m_pPipeline->GetDepthImage(), m_pPipeline->GetDepthImageView());
+
+	RenderGraphResource colour = graph.CreateImage("msaa colour", {m_pSwapchain->GetImageFormat(), extent, msaaSamples, 1});
+
+	RenderGraphResource culledDraws = kInvalidRenderGraphResource;
+	RenderGraphResource pyramid = kInvalidRenderGraphResource;
+	if (isCulled)
+	{
+		// The previous submission's draws read the culled draws before they are written again.
+		culledDraws = graph.ImportBuffer("culled draws", {VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0});
+
+		// Only needed until culling is done, so it shares memory with the colour attachment.
+		pyramid = graph.CreateImage("hi-z pyramid", m_pGpuCuller->GetPyramidDesc());
+
+		// Without the depth attachment there's nothing to build, and the culling pass skips the occlusion test.
+		bool isPyramidBuilt = m_pPipeline->IsDepthSampled();
+		if (isPyramidBuilt)
 		{
-			throw std::runtime_error("failed to create semaphores");
+			RenderGraphPass pyramidPass = graph.AddPass("hi-z pyramid", [this](VkCommandBuffer commandBuffer, const RenderGraphPassContext& context)
+				{
+					m_pGpuProfiler->BeginScope(commandBuffer, context.frameIndex, m_cullingScope);
+					m_pGpuCuller->RecordBuildPyramid(commandBuffer);
+				});
+			graph.Read(pyramidPass, depth, RenderGraphAccess::SampledCompute);
+			graph.Write(pyramidPass, pyramid, RenderGraphAccess::StorageCompute);
 		}
+
+		RenderGraphPass cullingPass = graph.AddPass("culling", [this, isPyramidBuilt](VkCommandBuffer commandBuffer, const RenderGraphPassContext& context)
+			{
+				if (!isPyramidBuilt)
+				{
+					m_pGpuProfiler->BeginScope(commandBuffer, context.frameIndex, m_cullingScope);
+				}
+
+				m_pGpuCuller->RecordCulling(commandBuffer, context.frameIndex);
+				m_pGpuProfiler->EndScope(commandBuffer, context.frameIndex, m_cullingScope);
+			});
+		graph.Read(cullingPass, pyramid, RenderGraphAccess::SampledCompute);
+		graph.Write(cullingPass, culledDraws, RenderGraphAccess::TransferDestination);
+		graph.Write(cullingPass, culledDraws, RenderGraphAccess::StorageCompute);
+	}
+
+	// The attachments are declared in the same order as the pipeline's render pass, so its pipelines can draw here.
+	RenderGraphPass scenePass = graph.AddPass("scene", [this](VkCommandBuffer commandBuffer, const RenderGraphPassContext& context)
+		{
+			RecordScenePass(commandBuffer, context);
+		});
+
+	VkClearValue colourClear {};
+	colourClear.color = {0.0f, 0.0f, 0.0f, 1.0f};
+	VkClearValue depthClear {};
+	depthClear.depthStencil = {1.0f, 0};
+
+	graph.Write(scenePass, colour, RenderGraphAccess::ColourAttachment);
+	graph.Clear(scenePass, colour, colourClear);
+	graph.Write(scenePass, depth, RenderGraphAccess::DepthAttachment);
+	graph.Clear(scenePass, depth, depthClear);
+	graph.Write(scenePass, m_swapchainImageResource, RenderGraphAccess::ResolveAttachment);
+
+	if (isCulled)
+	{
+		graph.Read(scenePass, culledDraws, RenderGraphAccess::IndirectRead);
 	}
+
+	graph.Compile();
+
+	m_pGpuCuller->SetPyramid(isCulled ? graph.GetImage(pyramid) : VK_NULL_HANDLE);
+
+	m_isRenderGraphCulled = isCulled;
+	m_isRenderGraphDirty = false;
+	MarkSceneDirty();
 }
 
 
 void Renderer::DrawFrame()
 {
-	vkWaitForFences(m_pDeviceContext->GetLogicalDevice(), 1, &m_inFlightFences[m_currentFrame], VK_TRUE, UINT64_MAX);
+	// Pick up any uploads which have finished. The model is only drawn once its data is on the device, so loading
+	// never holds up rendering.
+	m_pDeviceContext->GetUploadManager().Update();
+
+	// Create the device resources for any assets the workers have finished decoding, so they can be drawn once their
+	// uploads complete.
+	m_pPipeline->GetAssetManager().Update();
+
+	// Swap in any texture levels which have arrived, and stream what the last frame asked for. The textures' handles
+	// are baked into the command buffers.
+	if (m_pPipeline->GetTextureStreamer().Update())
+	{
+		MarkSceneDirty();
+	}
+
+	TextureStreamer& textureStreamer = m_pPipeline->GetTextureStreamer();
+	bool isSceneReady = (!m_drawList.empty() || m_pIndirectScene) && m_pPipeline->IsReady()
+		&& std::all_of(m_drawListModels.begin(), m_drawListModels.end(), [](const Model* pModel) { return pModel->IsReady(); })
+		&& std::all_of(m_drawListTextures.begin(), m_drawListTextures.end(),
+			[&textureStreamer](StreamedTextureId texture) { return textureStreamer.IsReady(texture); })
+		&& (!m_pIndirectScene || m_pIndirectScene->GetMeshPool().IsReady());
+	if (isSceneReady != m_isSceneReady)
+	{
+		m_isSceneReady = isSceneReady;
+		MarkSceneDirty();
+	}
+
+	// Culling adds passes to the graph, which can only be culled once the scene is ready.
+	bool isCulled = m_isSceneReady && m_pIndirectScene && m_isCullingEnabled;
+	if (m_isRenderGraphDirty || isCulled != m_isRenderGraphCulled)
+	{
+		BuildRenderGraph();
+	}
+
+	// The instance counts are baked into the command buffers, but the transforms aren't.
+	for (auto pDrawItem : m_instancedDrawItems)
+	{
+		if (pDrawItem->pInstances->LatchInstanceCount())
+		{
+			MarkSceneDirty();
+		}
+	}
+
+	Frame& frame = m_pFrameContext->BeginFrame(m_sceneVersion);
+
+	// The frame's fence has signalled, so its timestamps from last time round are ready.
+	m_pGpuProfiler->CollectResults(m_pFrameContext->GetCurrentFrameIndex());
 
 	uint32_t imageIndex;
-	VkResult result = vkAcquireNextImageKHR(m_pDeviceContext->GetLogicalDevice(), m_pSwapchain->GetVkSwapchainHandle(), 
-		UINT64_MAX, m_imageAvailableSemaphores[m_currentFrame], VK_NULL_HANDLE, &imageIndex);
+	VkResult result = m_pSwapchain->AcquireNextImage(frame.imageAvailableSemaphore, imageIndex);
 
 	if (result == VK_ERROR_OUT_OF_DATE_KHR)
 	{
-		m_pSwapchain->Recreate();
-		m_pPipeline->Recreate();
+		RecreateSwapchain();
 		return;
 	}
 	else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
@@ -86,66 +376,198 @@ void Renderer::DrawFrame()
 		throw std::runtime_error("failed to aquire swap chain image");
 	}
 
+	// Every frame which acquires an image goes on to be submitted, so this runs once per frame in flight.
+	m_pDeviceContext->CollectRetiredResources(m_pFrameContext->GetFramesInFlight());
+
 	if (m_imagesInFlight[imageIndex] != VK_NULL_HANDLE)
 	{
 		vkWaitForFences(m_pDeviceContext->GetLogicalDevice(), 1, &m_imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
 	}
 
-	m_imagesInFlight[imageIndex] = m_inFlightFences[m_currentFrame];
+	m_imagesInFlight[imageIndex] = frame.inFlightFence;
 
-	UpdateUniformBuffer(imageIndex);
+	uint32_t uniformOffset = UpdateUniformBuffer(m_pFrameContext->GetCurrentFrameIndex());
+
+	// The levels of detail are picked as the instances are copied, so they follow the camera without re-recording.
+	for (auto pDrawItem : m_instancedDrawItems)
+	{
+		pDrawItem->pInstances->Update(m_pFrameContext->GetCurrentFrameIndex(), *pDrawItem, &m_lodSelector);
+	}
+
+	if (m_isSceneReady)
+	{
+		RequestTextureLevels();
+	}
+
+	if (m_isSceneReady)
+	{
+		uint64_t triangleCount = 0;
+		for (const auto& drawItem : m_drawList)
+		{
+			triangleCount += drawItem.pInstances ? drawItem.pInstances->GetDrawnTriangleCount() : drawItem.indexCount / 3;
+		}
+
+		m_pFrameContext->SetTriangleCount(triangleCount);
+	}
+
+	// The indirect scene's objects are written straight into this frame's buffers, there's nothing to record.
+	if (m_pIndirectScene)
+	{
+		auto updateStartTime = std::chrono::high_resolution_clock::now();
+		m_pIndirectScene->Update(m_pFrameContext->GetCurrentFrameIndex(), m_pPipeline->GetDefaultTexture());
+		m_pFrameContext->SetSceneUpdateTime(std::chrono::high_resolution_clock::now() - updateStartTime);
+	}
+
+	// Also collects the statistics from the last time this frame was culled.
+	m_pGpuCuller->Update(m_pFrameContext->GetCurrentFrameIndex(), m_viewProjection);
+
+	// Only record when the scene has changed since this frame's command buffers were last used.
+	VkCommandBuffer commandBuffer = m_pFrameContext->GetCommandBuffer(imageIndex);
+	if (!m_pFrameContext->IsRecorded(imageIndex))
+	{
+		auto recordStartTime = std::chrono::high_resolution_clock::now();
+		RecordCommandBuffer(commandBuffer, imageIndex, uniformOffset);
+		m_pFrameContext->MarkRecorded(imageIndex);
+		m_pFrameContext->SetRecordTime(std::chrono::high_resolution_clock::now() - recordStartTime);
+	}
+
+	// There's no presentation engine to synchronise with when headless.
+	uint32_t semaphoreCount = m_pSwapchain->IsHeadless() ? 0 : 1;
 
 	VkSubmitInfo submitInfo {};
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-	VkSemaphore waitSemaphores[] = {m_imageAvailableSemaphores[m_currentFrame]};
+	VkSemaphore waitSemaphores[] = {frame.imageAvailableSemaphore};
 	VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-	submitInfo.waitSemaphoreCount = 1;
+	submitInfo.waitSemaphoreCount = semaphoreCount;
 	submitInfo.pWaitSemaphores = waitSemaphores;
 	submitInfo.pWaitDstStageMask = waitStages;
 
 	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &m_pPipeline->GetCommandBuffers()[imageIndex];
+	submitInfo.pCommandBuffers = &commandBuffer;
 
-	VkSemaphore signalSemaphores[] = {m_renderFinishedSemaphores[m_currentFrame]};
-	submitInfo.signalSemaphoreCount = 1;
+	VkSemaphore signalSemaphores[] = {frame.renderFinishedSemaphore};
+	submitInfo.signalSemaphoreCount = semaphoreCount;
 	submitInfo.pSignalSemaphores = signalSemaphores;
 
-	vkResetFences(m_pDeviceContext->GetLogicalDevice(), 1, &m_inFlightFences[m_currentFrame]);
+	vkResetFences(m_pDeviceContext->GetLogicalDevice(), 1, &frame.inFlightFence);
 
-	if (vkQueueSubmit(m_pDeviceContext->GetGraphicsQueue(), 1, &submitInfo, m_inFlightFences[m_currentFrame]) != VK_SUCCESS)
+	if (vkQueueSubmit(m_pDeviceContext->GetGraphicsQueue(), 1, &submitInfo, frame.inFlightFence) != VK_SUCCESS)
 	{
 		throw std::runtime_error("failed to submit the draw command buffer");
 	}
 
-	VkPresentInfoKHR presentInfo {};
-	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-	presentInfo.waitSemaphoreCount = 1;
-	presentInfo.pWaitSemaphores = signalSemaphores;
+	m_pGpuProfiler->MarkSubmitted(m_pFrameContext->GetCurrentFrameIndex());
+	m_pFrameContext->MarkSubmitted();
+
+	if (m_isRenderGraphCulled)
+	{
+		m_pGpuCuller->MarkSubmitted(m_pFrameContext->GetCurrentFrameIndex());
+	}
 
-	VkSwapchainKHR swapChains[] = {m_pSwapchain->GetVkSwapchainHandle()};
-	presentInfo.swapchainCount = 1;
-	presentInfo.pSwapchains = swapChains;
-	presentInfo.pImageIndices = &imageIndex;
+	m_lastImageIndex = imageIndex;
 
-	result = vkQueuePresentKHR(m_pDeviceContext->GetPresentQueue(), &presentInfo);
+	result = m_pSwapchain->Present(frame.renderFinishedSemaphore, imageIndex);
 
-	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || m_pWindow->HasBeenResized())
+	bool hasBeenResized = m_pWindow != nullptr && m_pWindow->HasBeenResized();
+	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || hasBeenResized)
 	{
-		m_pSwapchain->Recreate();
-		m_pPipeline->Recreate();
-		m_pWindow->HasBeenResized(false);
+		RecreateSwapchain();
+		if (m_pWindow != nullptr)
+		{
+			m_pWindow->HasBeenResized(false);
+		}
 	}
 	else if (result != VK_SUCCESS)
 	{
 		throw std::runtime_error("failed to present swap chain image");
 	}
 
-	m_currentFrame = (m_currentFrame + 1) % kMaxFramesInFlight;
+	m_pFrameContext->EndFrame();
 }
 
 
-void Renderer::UpdateUniformBuffer(uint32_t currentImage)
+void Renderer::RecordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex, uint32_t uniformOffset)
+{
+	uint32_t frameIndex = m_pFrameContext->GetCurrentFrameIndex();
+
+	VkCommandBufferBeginInfo beginInfo {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+
+	if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to begin recording command buffer");
+	}
+
+	// The command buffer is submitted many times, so the queries are reset on every submission, not just once.
+	m_pGpuProfiler->ResetQueries(commandBuffer, frameIndex);
+	m_pGpuProfiler->BeginScope(commandBuffer, frameIndex, m_frameScope);
+
+	// The graph puts in every barrier between the passes, and leaves the swapchain image ready to present.
+	m_recordImageIndex = imageIndex;
+	m_recordUniformOffset = uniformOffset;
+	m_pRenderGraph->SetImportedImage(m_swapchainImageResource, m_pSwapchain->GetImages()[imageIndex], m_pPipeline->GetSwapchainImageView(imageIndex));
+	m_pRenderGraph->Execute(commandBuffer, frameIndex);
+
+	m_pGpuProfiler->EndScope(commandBuffer, frameIndex, m_frameScope);
+
+	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to record command buffer");
+	}
+}
+
+
+void Renderer::RecordScenePass(VkCommandBuffer commandBuffer, const RenderGraphPassContext& context)
+{
+	uint32_t frameIndex = context.frameIndex;
+	uint32_t uniformOffset = m_recordUniformOffset;
+	uint32_t drawCount = m_isSceneReady ? static_cast<uint32_t>(m_drawList.size()) : 0;
+	bool isIndirectSceneDrawn = m_isSceneReady && m_pIndirectScene;
+
+	m_pGpuProfiler->BeginScope(commandBuffer, frameIndex, m_scenePassScope);
+
+	if (m_pCommandRecorder->GetThreadCount() > 1 && drawCount >= kMinParallelDrawCount)
+	{
+		context.BeginRenderPass(commandBuffer, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+		m_pCommandRecorder->Record(commandBuffer, m_recordImageIndex, context.GetInheritanceInfo(), drawCount,
+			[this, frameIndex, drawCount, isIndirectSceneDrawn, uniformOffset](VkCommandBuffer secondaryCommandBuffer, uint32_t firstDraw, uint32_t count)
+			{
+				m_pPipeline->RecordDraws(secondaryCommandBuffer, m_drawList.data() + firstDraw, count, frameIndex, uniformOffset);
+
+				// The last slice keeps the indirect scene after the draw list.
+				if (isIndirectSceneDrawn && firstDraw + count == drawCount)
+				{
+					m_pPipeline->RecordIndirectDraws(secondaryCommandBuffer, *m_pIndirectScene, frameIndex, uniformOffset);
+				}
+			});
+		context.EndRenderPass(commandBuffer);
+	}
+	else
+	{
+		context.BeginRenderPass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+		m_pPipeline->RecordDraws(commandBuffer, m_drawList.data(), drawCount, frameIndex, uniformOffset);
+
+		if (isIndirectSceneDrawn)
+		{
+			m_pPipeline->RecordIndirectDraws(commandBuffer, *m_pIndirectScene, frameIndex, uniformOffset);
+		}
+
+		context.EndRenderPass(commandBuffer);
+	}
+
+	m_pGpuProfiler->EndScope(commandBuffer, frameIndex, m_scenePassScope);
+}
+
+
+void Renderer::SaveScreenshot(const std::string& path)
+{
+	m_pDeviceContext->WaitIdle();
+	m_pSwapchain->SaveImage(m_lastImageIndex, path);
+}
+
+
+uint32_t Renderer::UpdateUniformBuffer(uint32_t frameIndex)
 {
 	static auto startTime = std::chrono::high_resolution_clock::now();
 
@@ -154,15 +576,72 @@ void Renderer::UpdateUniformBuffer(uint32_t currentImage)
 
 	UniformBufferObject ubo {};
 	ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(45.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+	m_modelTransform = ubo.model;
 	ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
 	ubo.projection = glm::perspective(glm::radians(45.0f), m_pSwapchain->GetExtents().width / static_cast<float>(m_pSwapchain->GetExtents().height), 0.1f, 10.0f);
 
 	// Flip projection matrix on the y axis for Vulkan.
 	ubo.projection[1][1] *= -1;
 
-	void* data;
-	vkMapMemory(m_pDeviceContext->GetLogicalDevice(), m_pPipeline->GetUniformBuffersMemory()[currentImage], 0, sizeof(ubo), 0, &data);
-	memcpy(data, &ubo, sizeof(ubo));
-	vkUnmapMemory(m_pDeviceContext->GetLogicalDevice(), m_pPipeline->GetUniformBuffersMemory()[currentImage]);
+	m_viewProjection = ubo.projection * ubo.view;
+
+	// The camera sits at the view's origin. How big a unit looks follows from the vertical field of view.
+	m_lodSelector.cameraPosition = glm::vec3(glm::inverse(ubo.view)[3]);
+	m_lodSelector.pixelsPerUnit = std::abs(ubo.projection[1][1]) * m_pSwapchain->GetExtents().height * 0.5f;
+
+	// The ring is persistently mapped, so this is just a copy into this frame's region.
+	UniformRing& uniformRing = m_pPipeline->GetUniformRing();
+	uniformRing.BeginFrame(frameIndex);
+
+	return uniformRing.Push(ubo);
+}
+
+
+void Renderer::RequestTextureLevels()
+{
+	TextureStreamer& textureStreamer = m_pPipeline->GetTextureStreamer();
+
+	// Every draw without instances shares the one transform.
+	glm::vec4 squaredScales = m_modelTransform[0] * m_modelTransform[0] + m_modelTransform[1] * m_modelTransform[1]
+		+ m_modelTransform[2] * m_modelTransform[2];
+	float modelScale = std::sqrt(std::max({squaredScales.x, squaredScales.y, squaredScales.z}));
+
+	for (const auto& drawItem : m_drawList)
+	{
+		// Textures from the bindless registry are always fully resident.
+		StreamedTextureId texture = drawItem.streamedTexture;
+		if (texture == kInvalidStreamedTexture && drawItem.texture == kInvalidBindlessHandle)
+		{
+			texture = m_pPipeline->GetDefaultStreamedTexture();
+		}
+
+		if (texture == kInvalidStreamedTexture)
+		{
+			continue;
+		}
+
+		float pixelsPerUnit;
+		if (drawItem.pInstances)
+		{
+			pixelsPerUnit = drawItem.pInstances->GetMaxPixelsPerUnit();
+		}
+		else
+		{
+			glm::vec4 boundingSphere = drawItem.pModel->GetBoundingSphere();
+			glm::vec3 centre = glm::vec3(m_modelTransform * glm::vec4(glm::vec3(boundingSphere), 1.0f));
+			pixelsPerUnit = m_lodSelector.GetPixelsPerUnit(centre, boundingSphere.w * modelScale, modelScale);
+		}
+
+		if (pixelsPerUnit > 0.0f)
+		{
+			textureStreamer.RequestTexelDensity(texture, drawItem.pModel->GetTexCoordDensity(), pixelsPerUnit);
+		}
+	}
+
+	// The indirect scene's objects can be anywhere, and the GPU decides which are drawn, so its texture is kept sharp.
+	if (m_pIndirectScene)
+	{
+		textureStreamer.RequestLevel(m_pPipeline->GetDefaultStreamedTexture(), 0);
+	}
 }
 }
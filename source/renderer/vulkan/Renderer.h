@@ -5,9 +5,19 @@
 // STD.
 #include <array>
 #include <stdio.h>
+#include <string>
+#include <vector>
 
+#include "CommandRecorder.h"
 #include "DeviceContext.h"
+#include "FrameContext.h"
+#include "GpuCuller.h"
+#include "GpuProfiler.h"
+#include "IndirectScene.h"
+#include "InstanceBuffer.h"
+#include "LatencyMode.h"
 #include "Pipeline.h"
+#include "RenderGraph.h"
 #include "Swapchain.h"
 #include "Window.h"
 
@@ -41,13 +51,104 @@ public:
 
 	void DrawFrame();
 
+	// Write the most recently drawn image to a PNG. Only supported when headless.
+	void SaveScreenshot(const std::string& path);
+
+	// Set the model to draw. The command buffers are re-recorded the next time each of them is used.
+	void SetModel(const Model* pModel);
+
+	// Set everything to draw, in order. Nothing is drawn until every model and texture in the list has finished uploading. Draw
+	// items with an instance buffer draw all of its instances, and each buffer may only be in one item.
+	void SetDrawList(std::vector<DrawItem> drawList);
+
+	// Set a scene to draw with multi draw indirect, after the draw list. Its objects can change freely without the
+	// command buffers being re-recorded. Not owned, and may be null.
+	void SetIndirectScene(IndirectScene* pIndirectScene);
+
+	// Cull the indirect scene on the GPU before drawing it. On by default.
+	void SetCullingEnabled(bool isCullingEnabled);
+
+	inline bool IsCullingEnabled() const { return m_isCullingEnabled; }
+
+	// What the GPU culling pass did, a few frames behind the CPU.
+	inline const CullStats& GetCullStats() const { return m_pGpuCuller->GetStats(); }
+
+	inline GpuCuller& GetGpuCuller() { return *m_pGpuCuller; }
+
+	// The camera of the most recent frame.
+	inline const glm::mat4& GetViewProjection() const { return m_viewProjection; }
+
+	// Draw each instance at the coarsest level of detail which looks close enough to the full one. On by default.
+	// Draws without instances always use the indices they are given.
+	void SetLodEnabled(bool isLodEnabled) { m_lodSelector.isEnabled = isLodEnabled; }
+
+	inline bool IsLodEnabled() const { return m_lodSelector.isEnabled; }
+
+	// How many pixels of error a level of detail may show.
+	void SetLodPixelError(float maxPixelError) { m_lodSelector.maxPixelError = maxPixelError; }
+
+	inline float GetLodPixelError() const { return m_lodSelector.maxPixelError; }
+
+	// How many threads record the draw list. Between one and the maximum, which is fixed at start up.
+	void SetRecordingThreadCount(uint32_t threadCount);
+
+	inline uint32_t GetRecordingThreadCount() const { return m_pCommandRecorder->GetThreadCount(); }
+
+	inline uint32_t GetMaxRecordingThreadCount() const { return m_maxRecordingThreadCount; }
+
+	// Force the command buffers to be re-recorded, e.g. after the scene has been altered.
+	void MarkSceneDirty() { ++m_sceneVersion; }
+
+	// The passes of the frame, as last built.
+	inline const RenderGraph& GetRenderGraph() const { return *m_pRenderGraph; }
+
+	inline const FrameStats& GetFrameStats() const { return m_pFrameContext->GetStats(); }
+
+	// Change the frames in flight, swapchain image count and present mode together. Waits for the device to go idle,
+	// so it isn't something to do every frame.
+	void SetLatencyMode(LatencyMode latencyMode);
+
+	inline LatencyMode GetLatencyMode() const { return m_latencyMode; }
+
+	// Override whether the latency mode waits on the previous frame before sampling input.
+	void SetFrameLimited(bool isFrameLimited) { m_isFrameLimited = isFrameLimited; }
+
+	// Call just before polling for input. When frame limited this first waits for the previous frame to finish on
+	// the GPU, so the input is as fresh as it can be by the time it is drawn.
+	void BeginInputSampling();
+
+	inline const LatencyStats& GetLatencyStats() const { return m_pFrameContext->GetLatencyStats(); }
+
+	// GPU timings for each pass, a few frames behind the CPU.
+	inline const GpuProfiler& GetGpuProfiler() const { return *m_pGpuProfiler; }
+
+	// Has everything in the scene finished uploading, so it is being drawn?
+	inline bool IsSceneReady() const { return m_isSceneReady; }
+
+	// How many times the swapchain has been recreated, e.g. by the window being resized.
+	inline uint32_t GetSwapchainRecreateCount() const { return m_swapchainRecreateCount; }
 
 private:
 	void InitVulkan();
 
-	void CreateSyncObjects();
+	void RecreateSwapchain();
+
+	// Describe the frame to the render graph and compile it: the depth pyramid and culling passes when the indirect
+	// scene is culled, then the scene pass. Needed again whenever the swapchain or what's culled changes.
+	void BuildRenderGraph();
+
+	// Record everything for a swapchain image into the current frame's primary command buffer.
+	void RecordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex, uint32_t uniformOffset);
+
+	// The render graph's scene pass, drawing the draw list then the indirect scene, across the recording threads if
+	// the list is long enough.
+	void RecordScenePass(VkCommandBuffer commandBuffer, const RenderGraphPassContext& context);
 
-	void UpdateUniformBuffer(uint32_t currentImage);
+	// Write this frame's uniforms, returning their dynamic offset in the uniform ring. Also keeps the camera for culling.
+	uint32_t UpdateUniformBuffer(uint32_t frameIndex);
+
+	// Ask the texture streamer for the levels each draw's texture needs, from how large its model looks this frame.
+	void RequestTextureLevels();
 
 	// Vulkan device context.
 	std::shared_ptr<DeviceContext> m_pDeviceContext {nullptr};
@@ -58,14 +159,71 @@ private:
 	// Pipeline.
 	std::shared_ptr<Jettison::Renderer::Pipeline> m_pPipeline {nullptr};
 
-	VkSampleCountFlagBits m_msaaSamples {VK_SAMPLE_COUNT_1_BIT};
+	// Per frame command pools and synchronisation objects.
+	std::shared_ptr<FrameContext> m_pFrameContext {nullptr};
 
-	std::vector<VkSemaphore> m_imageAvailableSemaphores {};
-	std::vector<VkSemaphore> m_renderFinishedSemaphores {};
+	VkSampleCountFlagBits m_msaaSamples {VK_SAMPLE_COUNT_1_BIT};
 
-	size_t m_currentFrame {0};
 	std::vector<VkFence> m_imagesInFlight {};
-	std::vector<VkFence> m_inFlightFences {};
+
+	// Bumped whenever the recorded command buffers no longer match what should be drawn.
+	uint64_t m_sceneVersion {1};
+
+	std::vector<DrawItem> m_drawList {};
+
+	// Every model and streamed texture in the draw list, once each, to check they have all uploaded.
+	std::vector<const Model*> m_drawListModels {};
+	std::vector<StreamedTextureId> m_drawListTextures {};
+
+	// Every draw item with an instance buffer, to copy their instances into each frame. Points into the draw list.
+	std::vector<const DrawItem*> m_instancedDrawItems {};
+
+	// Follows the camera of the current frame.
+	LodSelector m_lodSelector {};
+
+	// Not owned.
+	IndirectScene* m_pIndirectScene {nullptr};
+
+	// Culls the indirect scene against the frustum and last frame's depth.
+	std::shared_ptr<GpuCuller> m_pGpuCuller {nullptr};
+	bool m_isCullingEnabled {true};
+
+	// The camera used for this frame's uniforms.
+	glm::mat4 m_viewProjection {1.0f};
+
+	// Where this frame's uniforms put the draws without instances.
+	glm::mat4 m_modelTransform {1.0f};
+
+	// Records large draw lists across several threads.
+	std::shared_ptr<CommandRecorder> m_pCommandRecorder {nullptr};
+
+	uint32_t m_maxRecordingThreadCount {1};
+
+	LatencyMode m_latencyMode {LatencyMode::Throughput};
+	bool m_isFrameLimited {false};
+
+	// Every pass of the frame, with the barriers between them, the MSAA colour attachment and the depth pyramid.
+	std::shared_ptr<RenderGraph> m_pRenderGraph {nullptr};
+	RenderGraphResource m_swapchainImageResource {kInvalidRenderGraphResource};
+	bool m_isRenderGraphCulled {false};
+	bool m_isRenderGraphDirty {true};
+
+	// What the passes are recording for, set just before the graph is executed.
+	uint32_t m_recordImageIndex {0};
+	uint32_t m_recordUniformOffset {0};
+
+	// Timestamps around each pass.
+	std::shared_ptr<GpuProfiler> m_pGpuProfiler {nullptr};
+	GpuScopeId m_frameScope {0};
+	GpuScopeId m_scenePassScope {0};
+	GpuScopeId m_cullingScope {0};
+
+	// Have the models and textures finished uploading?
+	bool m_isSceneReady {false};
+
+	uint32_t m_swapchainRecreateCount {0};
+
+	uint32_t m_lastImageIndex {0};
 
 	std::shared_ptr<Window> m_pWindow {nullptr};
 
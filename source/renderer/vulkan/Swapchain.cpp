@@ -1,10 +1,13 @@
 #include "Swapchain.h"
 
+#include "PngWriter.h"
+
 // GLFW / Vulkan.
 #define GLFW_INCLUDE_VULKAN
 #include <../glfw/include/GLFW/glfw3.h>
 
 // STD.
+#include <algorithm>
 #include <array>
 #include <cmath>
 #include <cstring>
@@ -16,11 +19,39 @@ namespace Jettison::Renderer
 {
 void Swapchain::Init()
 {
-	Create();
+	if (IsHeadless())
+	{
+		CreateHeadless();
+	}
+	else
+	{
+		Create(VK_NULL_HANDLE);
+	}
+}
+
+
+void Swapchain::CreateHeadless()
+{
+	m_swapchainImageCount = m_headlessSettings.imageCount;
+	m_swapchainImageFormat = VK_FORMAT_R8G8B8A8_SRGB;
+	m_swapchainExtent = m_headlessSettings.extent;
+
+	m_images.resize(m_swapchainImageCount);
+	m_imageAllocations.resize(m_swapchainImageCount);
+
+	// Transfer source, so the images can be read back for screenshots.
+	for (uint32_t i = 0; i < m_swapchainImageCount; ++i)
+	{
+		m_pDeviceContext->CreateImage(m_swapchainExtent.width, m_swapchainExtent.height, 1, VK_SAMPLE_COUNT_1_BIT, m_swapchainImageFormat,
+			VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_images[i], m_imageAllocations[i]);
+	}
+
+	m_nextImageIndex = 0;
 }
 
 
-void Swapchain::Create()
+void Swapchain::Create(VkSwapchainKHR oldSwapchain)
 {
 	SwapChainSupportDetails swapChainSupport = m_pDeviceContext->QuerySwapChainSupport(m_pDeviceContext->GetPhysicalDevice());
 
@@ -28,8 +59,7 @@ void Swapchain::Create()
 	VkPresentModeKHR presentMode = ChooseSwapPresentMode(swapChainSupport.presentModes);
 	VkExtent2D extent = ChooseSwapExtent(swapChainSupport.capabilities);
 
-	// Get a reasonable amount of swapchain images.
-	m_swapchainImageCount = std::max(swapChainSupport.capabilities.minImageCount + 1, swapChainSupport.capabilities.maxImageCount);
+	m_swapchainImageCount = ChooseImageCount(swapChainSupport.capabilities);
 
 	VkSwapchainCreateInfoKHR createInfo {};
 	createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
@@ -64,7 +94,8 @@ void Swapchain::Create()
 	createInfo.presentMode = presentMode;
 	createInfo.clipped = VK_TRUE;
 
-	createInfo.oldSwapchain = VK_NULL_HANDLE;
+	// Lets the driver hand over resources from the old swapchain, and keeps presenting while the new one is built.
+	createInfo.oldSwapchain = oldSwapchain;
 
 	if (vkCreateSwapchainKHR(m_pDeviceContext->GetLogicalDevice(), &createInfo, nullptr, &m_vkSwapchainHandle) != VK_SUCCESS)
 	{
@@ -73,21 +104,138 @@ void Swapchain::Create()
 
 	m_swapchainImageFormat = surfaceFormat.format;
 	m_swapchainExtent = extent;
+	m_presentMode = presentMode;
+
+	// The driver may have created more images than were asked for.
+	vkGetSwapchainImagesKHR(m_pDeviceContext->GetLogicalDevice(), m_vkSwapchainHandle, &m_swapchainImageCount, nullptr);
+	m_images.resize(m_swapchainImageCount);
+	vkGetSwapchainImagesKHR(m_pDeviceContext->GetLogicalDevice(), m_vkSwapchainHandle, &m_swapchainImageCount, m_images.data());
 }
 
 
 void Swapchain::Recreate()
 {
+	// The headless images never change size.
+	if (IsHeadless())
+	{
+		return;
+	}
+
 	m_pDeviceContext->WaitOnWindowResized();
 
-	Destroy();
-	Create();
+	VkSwapchainKHR oldSwapchain = m_vkSwapchainHandle;
+	Create(oldSwapchain);
+
+	VkDevice logicalDevice = m_pDeviceContext->GetLogicalDevice();
+	m_pDeviceContext->RetireResource([logicalDevice, oldSwapchain]()
+		{
+			vkDestroySwapchainKHR(logicalDevice, oldSwapchain, nullptr);
+		});
 }
 
 
 void Swapchain::Destroy()
 {
-	vkDestroySwapchainKHR(m_pDeviceContext->GetLogicalDevice(), m_vkSwapchainHandle, nullptr);
+	if (IsHeadless())
+	{
+		for (uint32_t i = 0; i < m_images.size(); ++i)
+		{
+			m_pDeviceContext->DestroyImage(m_images[i], m_imageAllocations[i]);
+		}
+
+		m_imageAllocations.clear();
+	}
+	else
+	{
+		vkDestroySwapchainKHR(m_pDeviceContext->GetLogicalDevice(), m_vkSwapchainHandle, nullptr);
+		m_vkSwapchainHandle = VK_NULL_HANDLE;
+	}
+
+	m_images.clear();
+}
+
+
+VkResult Swapchain::AcquireNextImage(VkSemaphore imageAvailableSemaphore, uint32_t& imageIndex)
+{
+	if (IsHeadless())
+	{
+		// The images are handed out in turn. The renderer waits on whichever frame last drew to the image.
+		imageIndex = m_nextImageIndex;
+		m_nextImageIndex = (m_nextImageIndex + 1) % m_swapchainImageCount;
+
+		return VK_SUCCESS;
+	}
+
+	return vkAcquireNextImageKHR(m_pDeviceContext->GetLogicalDevice(), m_vkSwapchainHandle, UINT64_MAX, imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
+}
+
+
+VkResult Swapchain::Present(VkSemaphore renderFinishedSemaphore, uint32_t imageIndex)
+{
+	if (IsHeadless())
+	{
+		return VK_SUCCESS;
+	}
+
+	VkPresentInfoKHR presentInfo {};
+	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+	presentInfo.waitSemaphoreCount = 1;
+	presentInfo.pWaitSemaphores = &renderFinishedSemaphore;
+	presentInfo.swapchainCount = 1;
+	presentInfo.pSwapchains = &m_vkSwapchainHandle;
+	presentInfo.pImageIndices = &imageIndex;
+
+	return vkQueuePresentKHR(m_pDeviceContext->GetPresentQueue(), &presentInfo);
+}
+
+
+void Swapchain::SaveImage(uint32_t imageIndex, const std::string& path)
+{
+	if (!IsHeadless())
+	{
+		throw std::runtime_error("images can only be saved when headless");
+	}
+
+	VkDeviceSize imageSize = static_cast<VkDeviceSize>(m_swapchainExtent.width) * m_swapchainExtent.height * 4;
+
+	VkBuffer readbackBuffer;
+	Allocation readbackAllocation;
+	m_pDeviceContext->CreateBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, readbackBuffer, readbackAllocation);
+
+	VkCommandBuffer commandBuffer = m_pDeviceContext->BeginSingleTimeCommands();
+
+	// The render graph's final barrier has already moved the image to TRANSFER_SRC_OPTIMAL. It is imported with that
+	// final state when headless, so the barrier also makes the colour writes visible to the transfer read.
+	VkBufferImageCopy region {};
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = 1;
+	region.imageExtent = {m_swapchainExtent.width, m_swapchainExtent.height, 1};
+
+	vkCmdCopyImageToBuffer(commandBuffer, m_images[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readbackBuffer, 1, &region);
+
+	VkBufferMemoryBarrier barrier {};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = readbackBuffer;
+	barrier.offset = 0;
+	barrier.size = VK_WHOLE_SIZE;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+		0, nullptr,
+		1, &barrier,
+		0, nullptr);
+
+	m_pDeviceContext->EndSingleTimeCommands(commandBuffer);
+
+	WritePng(path, m_swapchainExtent.width, m_swapchainExtent.height, static_cast<const uint8_t*>(readbackAllocation.pMapped));
+
+	m_pDeviceContext->DestroyBuffer(readbackBuffer, readbackAllocation);
 }
 
 
@@ -107,18 +255,33 @@ VkSurfaceFormatKHR Swapchain::ChooseSwapSurfaceFormat(const std::vector<VkSurfac
 
 VkPresentModeKHR Swapchain::ChooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes)
 {
-	for (const VkPresentModeKHR& availablePresentMode : availablePresentModes)
+	for (VkPresentModeKHR presentMode : m_latencySettings.presentModes)
 	{
-		if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR)
+		if (std::find(availablePresentModes.begin(), availablePresentModes.end(), presentMode) != availablePresentModes.end())
 		{
-			return availablePresentMode;
+			return presentMode;
 		}
 	}
 
+	// The only mode every device has to support.
 	return VK_PRESENT_MODE_FIFO_KHR;
 }
 
 
+uint32_t Swapchain::ChooseImageCount(const VkSurfaceCapabilitiesKHR& capabilities) const
+{
+	uint32_t imageCount = std::max(m_latencySettings.imageCount, capabilities.minImageCount);
+
+	// A max of zero means there is no limit.
+	if (capabilities.maxImageCount > 0)
+	{
+		imageCount = std::min(imageCount, capabilities.maxImageCount);
+	}
+
+	return imageCount;
+}
+
+
 VkExtent2D Swapchain::ChooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities)
 {
 	if (capabilities.currentExtent.width != UINT32_MAX)
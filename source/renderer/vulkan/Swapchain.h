@@ -3,18 +3,30 @@
 #include <vulkan/vulkan.h>
 
 #include "DeviceContext.h"
+#include "LatencyMode.h"
 
 // STD.
 #include <string>
+#include <vector>
 
 
 namespace Jettison::Renderer
 {
+// The offscreen images which stand in for the swapchain when the device is headless.
+struct HeadlessSettings
+{
+	uint32_t imageCount {3};
+	VkExtent2D extent {1920, 1080};
+};
+
+
+// Presents to the window's surface, or when the device is headless renders into a ring of offscreen images. Either way
+// the pipeline and renderer see the same set of images, and the same acquire / present calls.
 class Swapchain
 {
 public:
-	Swapchain(std::shared_ptr<DeviceContext> pDeviceContext)
-		:m_pDeviceContext {pDeviceContext} {}
+	Swapchain(std::shared_ptr<DeviceContext> pDeviceContext, HeadlessSettings headlessSettings = {})
+		:m_pDeviceContext {pDeviceContext}, m_headlessSettings {headlessSettings} {}
 
 	// Disable copying.
 	Swapchain() = default;
@@ -23,22 +35,48 @@ public:
 
 	void Init();
 
+	// Create a new swapchain from the old one. The old swapchain is retired rather than destroyed, since the frames in
+	// flight may still be presenting its images.
 	void Recreate();
 
 	void Destroy();
 
+	// Choose the image count and present mode. Takes effect the next time the swapchain is created or recreated. The
+	// headless images are unaffected.
+	void SetLatencySettings(const LatencySettings& latencySettings) { m_latencySettings = latencySettings; }
+
+	// Acquire the next image. When headless the semaphore is not signalled, since nothing is waiting on a presentation
+	// engine. Returns VK_ERROR_OUT_OF_DATE_KHR or VK_SUBOPTIMAL_KHR when the swapchain should be recreated.
+	VkResult AcquireNextImage(VkSemaphore imageAvailableSemaphore, uint32_t& imageIndex);
+
+	// Queue an image for presentation once the semaphore is signalled. Does nothing when headless.
+	VkResult Present(VkSemaphore renderFinishedSemaphore, uint32_t imageIndex);
+
+	// Copy an image back to the host and write it out as a PNG. Only available when headless, and the image must no
+	// longer be in use by the device.
+	void SaveImage(uint32_t imageIndex, const std::string& path);
+
+	inline bool IsHeadless() const { return m_pDeviceContext->IsHeadless(); }
+
+	// The layout the render pass should leave the images in.
+	inline VkImageLayout GetFinalLayout() const { return IsHeadless() ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR; }
+
+	inline const std::vector<VkImage>& GetImages() const { return m_images; }
+
 	inline VkSwapchainKHR GetVkSwapchainHandle() const { return m_vkSwapchainHandle; }
 
 	inline VkExtent2D GetExtents() const { return m_swapchainExtent; }
 
 	inline uint32_t GetImageCount() const { return m_swapchainImageCount; }
 
-	inline uint32_t* GetImageCountAddress() { return &m_swapchainImageCount; }
-
 	inline VkFormat GetImageFormat() const { return m_swapchainImageFormat; }
 
+	inline VkPresentModeKHR GetPresentMode() const { return m_presentMode; }
+
 private:
-	void Create();
+	void Create(VkSwapchainKHR oldSwapchain);
+
+	void CreateHeadless();
 
 	VkSurfaceFormatKHR ChooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats);
 
@@ -46,6 +84,8 @@ private:
 
 	VkExtent2D ChooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities);
 
+	uint32_t ChooseImageCount(const VkSurfaceCapabilitiesKHR& capabilities) const;
+
 	// Vulkan device context.
 	std::shared_ptr<DeviceContext> m_pDeviceContext;
 
@@ -56,5 +96,15 @@ private:
 	uint32_t m_swapchainImageCount {0};
 	VkFormat m_swapchainImageFormat {VK_FORMAT_UNDEFINED};
 	VkExtent2D m_swapchainExtent {0, 0};
+	VkPresentModeKHR m_presentMode {VK_PRESENT_MODE_FIFO_KHR};
+
+	LatencySettings m_latencySettings {GetLatencySettings(LatencyMode::Throughput)};
+
+	std::vector<VkImage> m_images {};
+
+	// Headless images, which unlike the swapchain's own images need to be allocated.
+	HeadlessSettings m_headlessSettings {};
+	std::vector<Allocation> m_imageAllocations {};
+	uint32_t m_nextImageIndex {0};
 };
 }
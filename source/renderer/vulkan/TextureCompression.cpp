@@ -0,0 +1,843 @@
+#include "TextureCompression.h"
+
+// STD.
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <future>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+
+namespace Jettison::Renderer
+{
+constexpr uint32_t kBlockSize = 4;
+constexpr uint32_t kBlockTexelCount = kBlockSize * kBlockSize;
+
+// Power iterations to find a block's principal axis. It converges quickly for the near linear spreads that compress well.
+constexpr uint32_t kPrincipalAxisIterations = 8;
+
+// BC7's 4 bit interpolation weights, out of 64.
+constexpr uint32_t kBc7Weights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+// One RGBA8 block, row by row.
+using TexelBlock = uint8_t[kBlockTexelCount][4];
+
+
+const char* GetTextureFormatName(TextureFormat format)
+{
+	switch (format)
+	{
+		case TextureFormat::Rgba8: return "rgba8";
+		case TextureFormat::Bc1: return "bc1";
+		case TextureFormat::Bc3: return "bc3";
+		case TextureFormat::Bc5: return "bc5";
+		case TextureFormat::Bc7: return "bc7";
+	}
+
+	return "unknown";
+}
+
+
+TextureFormat ParseTextureFormat(const std::string& name)
+{
+	for (TextureFormat format : {TextureFormat::Rgba8, TextureFormat::Bc1, TextureFormat::Bc3, TextureFormat::Bc5, TextureFormat::Bc7})
+	{
+		if (name == GetTextureFormatName(format))
+		{
+			return format;
+		}
+	}
+
+	throw std::runtime_error("unknown texture format " + name);
+}
+
+
+VkFormat GetTextureVkFormat(TextureFormat format, bool isSrgb)
+{
+	switch (format)
+	{
+		case TextureFormat::Rgba8: return isSrgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+		case TextureFormat::Bc1: return isSrgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+		case TextureFormat::Bc3: return isSrgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK;
+		case TextureFormat::Bc5: return VK_FORMAT_BC5_UNORM_BLOCK;
+		case TextureFormat::Bc7: return isSrgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+	}
+
+	return VK_FORMAT_UNDEFINED;
+}
+
+
+bool IsBlockCompressed(TextureFormat format)
+{
+	return format != TextureFormat::Rgba8;
+}
+
+
+static uint32_t GetBytesPerBlock(TextureFormat format)
+{
+	return format == TextureFormat::Bc1 ? 8 : 16;
+}
+
+
+uint64_t GetTextureLevelSize(TextureFormat format, uint32_t width, uint32_t height)
+{
+	if (!IsBlockCompressed(format))
+	{
+		return static_cast<uint64_t>(width) * height * 4;
+	}
+
+	uint64_t blockCount = static_cast<uint64_t>((width + kBlockSize - 1) / kBlockSize) * ((height + kBlockSize - 1) / kBlockSize);
+
+	return blockCount * GetBytesPerBlock(format);
+}
+
+
+// Copy out the block at the given block coordinates, repeating the last row and column past the edges.
+static void ReadBlock(const uint8_t* pTexels, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY, TexelBlock& block)
+{
+	for (uint32_t y = 0; y < kBlockSize; ++y)
+	{
+		uint32_t texelY = std::min(blockY * kBlockSize + y, height - 1);
+		for (uint32_t x = 0; x < kBlockSize; ++x)
+		{
+			uint32_t texelX = std::min(blockX * kBlockSize + x, width - 1);
+			memcpy(block[y * kBlockSize + x], pTexels + (static_cast<size_t>(texelY) * width + texelX) * 4, 4);
+		}
+	}
+}
+
+
+// The inverse, dropping whatever hangs off the edges.
+static void WriteBlock(const TexelBlock& block, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY, uint8_t* pTexels)
+{
+	for (uint32_t y = 0; y < kBlockSize && blockY * kBlockSize + y < height; ++y)
+	{
+		for (uint32_t x = 0; x < kBlockSize && blockX * kBlockSize + x < width; ++x)
+		{
+			size_t texel = static_cast<size_t>(blockY * kBlockSize + y) * width + blockX * kBlockSize + x;
+			memcpy(pTexels + texel * 4, block[y * kBlockSize + x], 4);
+		}
+	}
+}
+
+
+// The direction of greatest spread through the first channelCount channels, about their mean. Zero for a flat block.
+static void FindPrincipalAxis(const TexelBlock& block, uint32_t channelCount, float mean[4], float axis[4])
+{
+	for (uint32_t c = 0; c < 4; ++c)
+	{
+		mean[c] = 0.0f;
+		axis[c] = 0.0f;
+	}
+
+	for (uint32_t i = 0; i < kBlockTexelCount; ++i)
+	{
+		for (uint32_t c = 0; c < channelCount; ++c)
+		{
+			mean[c] += block[i][c];
+		}
+	}
+
+	for (uint32_t c = 0; c < channelCount; ++c)
+	{
+		mean[c] /= kBlockTexelCount;
+	}
+
+	float covariance[4][4] = {};
+	for (uint32_t i = 0; i < kBlockTexelCount; ++i)
+	{
+		for (uint32_t row = 0; row < channelCount; ++row)
+		{
+			for (uint32_t column = 0; column < channelCount; ++column)
+			{
+				covariance[row][column] += (block[i][row] - mean[row]) * (block[i][column] - mean[column]);
+			}
+		}
+	}
+
+	// Start from the channel with the most variance, so a single varying channel is found straight away.
+	uint32_t widest = 0;
+	for (uint32_t c = 1; c < channelCount; ++c)
+	{
+		widest = covariance[c][c] > covariance[widest][widest] ? c : widest;
+	}
+
+	if (covariance[widest][widest] <= 0.0f)
+	{
+		return;
+	}
+
+	for (uint32_t c = 0; c < channelCount; ++c)
+	{
+		axis[c] = covariance[widest][c];
+	}
+
+	for (uint32_t iteration = 0; iteration < kPrincipalAxisIterations; ++iteration)
+	{
+		float next[4] = {};
+		float length = 0.0f;
+		for (uint32_t row = 0; row < channelCount; ++row)
+		{
+			for (uint32_t column = 0; column < channelCount; ++column)
+			{
+				next[row] += covariance[row][column] * axis[column];
+			}
+
+			length += next[row] * next[row];
+		}
+
+		if (length <= 0.0f)
+		{
+			return;
+		}
+
+		length = std::sqrt(length);
+		for (uint32_t c = 0; c < channelCount; ++c)
+		{
+			axis[c] = next[c] / length;
+		}
+	}
+}
+
+
+// The block's extent along its principal axis, as a starting point for the endpoints.
+static void FindEndpoints(const TexelBlock& block, uint32_t channelCount, float endpoints[2][4])
+{
+	float mean[4];
+	float axis[4];
+	FindPrincipalAxis(block, channelCount, mean, axis);
+
+	float minProjection = 0.0f;
+	float maxProjection = 0.0f;
+	for (uint32_t i = 0; i < kBlockTexelCount; ++i)
+	{
+		float projection = 0.0f;
+		for (uint32_t c = 0; c < channelCount; ++c)
+		{
+			projection += (block[i][c] - mean[c]) * axis[c];
+		}
+
+		minProjection = std::min(minProjection, projection);
+		maxProjection = std::max(maxProjection, projection);
+	}
+
+	for (uint32_t c = 0; c < 4; ++c)
+	{
+		endpoints[0][c] = std::clamp(mean[c] + axis[c] * minProjection, 0.0f, 255.0f);
+		endpoints[1][c] = std::clamp(mean[c] + axis[c] * maxProjection, 0.0f, 255.0f);
+	}
+}
+
+
+// Given each texel's weight towards the second endpoint, the endpoints with the least squared error. Returns false
+// when every texel has the same weight, leaving the endpoints as they were.
+static bool FitEndpoints(const TexelBlock& block, uint32_t channelCount, const float weights[kBlockTexelCount], float endpoints[2][4])
+{
+	float alpha = 0.0f;
+	float beta = 0.0f;
+	float gamma = 0.0f;
+	float first[4] = {};
+	float second[4] = {};
+
+	for (uint32_t i = 0; i < kBlockTexelCount; ++i)
+	{
+		float w = weights[i];
+		alpha += (1.0f - w) * (1.0f - w);
+		beta += (1.0f - w) * w;
+		gamma += w * w;
+
+		for (uint32_t c = 0; c < channelCount; ++c)
+		{
+			first[c] += (1.0f - w) * block[i][c];
+			second[c] += w * block[i][c];
+		}
+	}
+
+	float determinant = alpha * gamma - beta * beta;
+	if (std::abs(determinant) < 1e-6f)
+	{
+		return false;
+	}
+
+	for (uint32_t c = 0; c < channelCount; ++c)
+	{
+		endpoints[0][c] = std::clamp((gamma * first[c] - beta * second[c]) / determinant, 0.0f, 255.0f);
+		endpoints[1][c] = std::clamp((alpha * second[c] - beta * first[c]) / determinant, 0.0f, 255.0f);
+	}
+
+	return true;
+}
+
+
+static uint32_t GetSquaredDistance(const uint8_t* pA, const uint8_t* pB, uint32_t channelCount)
+{
+	uint32_t distance = 0;
+	for (uint32_t c = 0; c < channelCount; ++c)
+	{
+		int32_t difference = static_cast<int32_t>(pA[c]) - pB[c];
+		distance += difference * difference;
+	}
+
+	return distance;
+}
+
+
+// Pick the nearest palette entry for every texel. Returns the total squared error.
+static uint32_t ChooseIndices(const TexelBlock& block, uint32_t channelCount, const uint8_t palette[][4], uint32_t paletteSize,
+	uint8_t indices[kBlockTexelCount])
+{
+	uint32_t totalError = 0;
+	for (uint32_t i = 0; i < kBlockTexelCount; ++i)
+	{
+		uint32_t bestError = ~0u;
+		for (uint32_t entry = 0; entry < paletteSize; ++entry)
+		{
+			uint32_t error = GetSquaredDistance(block[i], palette[entry], channelCount);
+			if (error < bestError)
+			{
+				bestError = error;
+				indices[i] = static_cast<uint8_t>(entry);
+			}
+		}
+
+		totalError += bestError;
+	}
+
+	return totalError;
+}
+
+
+// BC1 colour.
+
+static uint16_t QuantiseRgb565(const float colour[4])
+{
+	uint32_t red = static_cast<uint32_t>(std::lround(colour[0] * 31.0f / 255.0f));
+	uint32_t green = static_cast<uint32_t>(std::lround(colour[1] * 63.0f / 255.0f));
+	uint32_t blue = static_cast<uint32_t>(std::lround(colour[2] * 31.0f / 255.0f));
+
+	return static_cast<uint16_t>((red << 11) | (green << 5) | blue);
+}
+
+
+static void ExpandRgb565(uint16_t colour, uint8_t expanded[4])
+{
+	uint32_t red = (colour >> 11) & 31;
+	uint32_t green = (colour >> 5) & 63;
+	uint32_t blue = colour & 31;
+
+	expanded[0] = static_cast<uint8_t>((red << 3) | (red >> 2));
+	expanded[1] = static_cast<uint8_t>((green << 2) | (green >> 4));
+	expanded[2] = static_cast<uint8_t>((blue << 3) | (blue >> 2));
+	expanded[3] = 255;
+}
+
+
+// Always the four colour palette, which is all BC3 ever uses, so the first endpoint must be the greater.
+static void GetColourPalette(uint16_t colour0, uint16_t colour1, uint8_t palette[4][4])
+{
+	ExpandRgb565(colour0, palette[0]);
+	ExpandRgb565(colour1, palette[1]);
+
+	for (uint32_t c = 0; c < 4; ++c)
+	{
+		palette[2][c] = static_cast<uint8_t>((2 * palette[0][c] + palette[1][c]) / 3);
+		palette[3][c] = static_cast<uint8_t>((palette[0][c] + 2 * palette[1][c]) / 3);
+	}
+}
+
+
+// Each index's weight towards the second endpoint.
+constexpr float kColourIndexWeights[4] = {0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f};
+
+
+// Returns the squared error, writing the endpoints and indices for it.
+static uint32_t QuantiseColourEndpoints(const TexelBlock& block, const float endpoints[2][4], uint16_t& colour0, uint16_t& colour1,
+	uint8_t indices[kBlockTexelCount])
+{
+	colour0 = QuantiseRgb565(endpoints[0]);
+	colour1 = QuantiseRgb565(endpoints[1]);
+	if (colour0 < colour1)
+	{
+		std::swap(colour0, colour1);
+	}
+
+	uint8_t palette[4][4];
+	GetColourPalette(colour0, colour1, palette);
+
+	// Equal endpoints would mean the three colour palette, where the third entry differs.
+	return ChooseIndices(block, 3, palette, colour0 == colour1 ? 1 : 4, indices);
+}
+
+
+static void EncodeColourBlock(const TexelBlock& block, uint8_t* pOut)
+{
+	float endpoints[2][4];
+	FindEndpoints(block, 3, endpoints);
+
+	uint16_t colour0;
+	uint16_t colour1;
+	uint8_t indices[kBlockTexelCount];
+	uint32_t error = QuantiseColourEndpoints(block, endpoints, colour0, colour1, indices);
+
+	// One round of least squares from the first guess's indices.
+	float weights[kBlockTexelCount];
+	for (uint32_t i = 0; i < kBlockTexelCount; ++i)
+	{
+		weights[i] = kColourIndexWeights[indices[i]];
+	}
+
+	float fitted[2][4] = {};
+	if (error > 0 && colour0 != colour1 && FitEndpoints(block, 3, weights, fitted))
+	{
+		uint16_t fittedColour0;
+		uint16_t fittedColour1;
+		uint8_t fittedIndices[kBlockTexelCount];
+		uint32_t fittedError = QuantiseColourEndpoints(block, fitted, fittedColour0, fittedColour1, fittedIndices);
+
+		if (fittedError < error)
+		{
+			colour0 = fittedColour0;
+			colour1 = fittedColour1;
+			memcpy(indices, fittedIndices, sizeof(indices));
+		}
+	}
+
+	uint32_t packedIndices = 0;
+	for (uint32_t i = 0; i < kBlockTexelCount; ++i)
+	{
+		packedIndices |= static_cast<uint32_t>(indices[i]) << (i * 2);
+	}
+
+	memcpy(pOut, &colour0, 2);
+	memcpy(pOut + 2, &colour1, 2);
+	memcpy(pOut + 4, &packedIndices, 4);
+}
+
+
+static void DecodeColourBlock(const uint8_t* pIn, TexelBlock& block)
+{
+	uint16_t colour0;
+	uint16_t colour1;
+	uint32_t packedIndices;
+	memcpy(&colour0, pIn, 2);
+	memcpy(&colour1, pIn + 2, 2);
+	memcpy(&packedIndices, pIn + 4, 4);
+
+	uint8_t palette[4][4];
+	GetColourPalette(colour0, colour1, palette);
+
+	for (uint32_t i = 0; i < kBlockTexelCount; ++i)
+	{
+		memcpy(block[i], palette[(packedIndices >> (i * 2)) & 3], 3);
+	}
+}
+
+
+// BC4 single channel, used for BC3's alpha and both of BC5's channels.
+
+// Always the eight value palette, the first endpoint the greater, unless the channel is flat.
+static void GetChannelPalette(uint8_t value0, uint8_t value1, uint8_t palette[8])
+{
+	palette[0] = value0;
+	palette[1] = value1;
+
+	for (uint32_t i = 1; i < 7; ++i)
+	{
+		if (value0 > value1)
+		{
+			palette[i + 1] = static_cast<uint8_t>(((7 - i) * value0 + i * value1 + 3) / 7);
+		}
+		else
+		{
+			palette[i + 1] = i < 5 ? static_cast<uint8_t>(((5 - i) * value0 + i * value1 + 2) / 5) : (i == 5 ? 0 : 255);
+		}
+	}
+}
+
+
+static void EncodeChannelBlock(const TexelBlock& block, uint32_t channel, uint8_t* pOut)
+{
+	uint8_t minValue = 255;
+	uint8_t maxValue = 0;
+	for (uint32_t i = 0; i < kBlockTexelCount; ++i)
+	{
+		minValue = std::min(minValue, block[i][channel]);
+		maxValue = std::max(maxValue, block[i][channel]);
+	}
+
+	uint8_t palette[8];
+	GetChannelPalette(maxValue, minValue, palette);
+
+	uint64_t packed = static_cast<uint64_t>(maxValue) | (static_cast<uint64_t>(minValue) << 8);
+	for (uint32_t i = 0; i < kBlockTexelCount; ++i)
+	{
+		uint32_t bestIndex = 0;
+		uint32_t bestError = ~0u;
+		for (uint32_t entry = 0; entry < (maxValue > minValue ? 8u : 1u); ++entry)
+		{
+			uint32_t error = static_cast<uint32_t>(std::abs(static_cast<int32_t>(block[i][channel]) - palette[entry]));
+			if (error < bestError)
+			{
+				bestError = error;
+				bestIndex = entry;
+			}
+		}
+
+		packed |= static_cast<uint64_t>(bestIndex) << (16 + i * 3);
+	}
+
+	memcpy(pOut, &packed, 8);
+}
+
+
+static void DecodeChannelBlock(const uint8_t* pIn, uint32_t channel, TexelBlock& block)
+{
+	uint64_t packed;
+	memcpy(&packed, pIn, 8);
+
+	uint8_t palette[8];
+	GetChannelPalette(static_cast<uint8_t>(packed), static_cast<uint8_t>(packed >> 8), palette);
+
+	for (uint32_t i = 0; i < kBlockTexelCount; ++i)
+	{
+		block[i][channel] = palette[(packed >> (16 + i * 3)) & 7];
+	}
+}
+
+
+// BC7 mode 6.
+
+// A 7 bit endpoint, given the low bit shared by all four of its channels.
+static void QuantiseBc7Endpoint(const float endpoint[4], uint8_t lowBit, uint8_t quantised[4])
+{
+	for (uint32_t c = 0; c < 4; ++c)
+	{
+		quantised[c] = static_cast<uint8_t>(std::clamp(static_cast<int32_t>(std::lround((endpoint[c] - lowBit) / 2.0f)), 0, 127));
+	}
+}
+
+
+static void GetBc7Palette(const uint8_t endpoints[2][4], const uint8_t lowBits[2], uint8_t palette[16][4])
+{
+	for (uint32_t c = 0; c < 4; ++c)
+	{
+		uint32_t value0 = (endpoints[0][c] << 1) | lowBits[0];
+		uint32_t value1 = (endpoints[1][c] << 1) | lowBits[1];
+
+		for (uint32_t i = 0; i < 16; ++i)
+		{
+			palette[i][c] = static_cast<uint8_t>(((64 - kBc7Weights[i]) * value0 + kBc7Weights[i] * value1 + 32) >> 6);
+		}
+	}
+}
+
+
+struct Bc7Mode6Block
+{
+	uint8_t endpoints[2][4] {};
+	uint8_t lowBits[2] {};
+	uint8_t indices[kBlockTexelCount] {};
+	uint32_t error {~0u};
+};
+
+
+// Tries every pair of low bits, since they decide which values the endpoints can reach. Opaque blocks must keep an
+// alpha of exactly 255, which only both bits set can reach.
+static Bc7Mode6Block QuantiseBc7Endpoints(const TexelBlock& block, const float endpoints[2][4], bool isOpaque)
+{
+	Bc7Mode6Block best;
+	for (uint8_t lowBits = isOpaque ? 3 : 0; lowBits < 4; ++lowBits)
+	{
+		Bc7Mode6Block encoded;
+		encoded.lowBits[0] = lowBits & 1;
+		encoded.lowBits[1] = lowBits >> 1;
+		QuantiseBc7Endpoint(endpoints[0], encoded.lowBits[0], encoded.endpoints[0]);
+		QuantiseBc7Endpoint(endpoints[1], encoded.lowBits[1], encoded.endpoints[1]);
+
+		uint8_t palette[16][4];
+		GetBc7Palette(encoded.endpoints, encoded.lowBits, palette);
+		encoded.error = ChooseIndices(block, 4, palette, 16, encoded.indices);
+
+		if (encoded.error < best.error)
+		{
+			best = encoded;
+		}
+	}
+
+	return best;
+}
+
+
+// Writes up to 32 bits at a time into a 128 bit block, least significant first.
+class BlockBitWriter
+{
+public:
+	BlockBitWriter(uint8_t* pOut)
+		:m_pOut {pOut}
+	{
+		memset(m_pOut, 0, 16);
+	}
+
+	void Write(uint32_t value, uint32_t bitCount)
+	{
+		for (uint32_t bit = 0; bit < bitCount; ++bit, ++m_position)
+		{
+			m_pOut[m_position / 8] |= static_cast<uint8_t>(((value >> bit) & 1) << (m_position % 8));
+		}
+	}
+
+private:
+	uint8_t* m_pOut {nullptr};
+	uint32_t m_position {0};
+};
+
+
+class BlockBitReader
+{
+public:
+	BlockBitReader(const uint8_t* pIn)
+		:m_pIn {pIn} {}
+
+	uint32_t Read(uint32_t bitCount)
+	{
+		uint32_t value = 0;
+		for (uint32_t bit = 0; bit < bitCount; ++bit, ++m_position)
+		{
+			value |= static_cast<uint32_t>((m_pIn[m_position / 8] >> (m_position % 8)) & 1) << bit;
+		}
+
+		return value;
+	}
+
+private:
+	const uint8_t* m_pIn {nullptr};
+	uint32_t m_position {0};
+};
+
+
+static void EncodeBc7Block(const TexelBlock& block, uint8_t* pOut)
+{
+	bool isOpaque = true;
+	for (uint32_t i = 0; i < kBlockTexelCount; ++i)
+	{
+		isOpaque = isOpaque && block[i][3] == 255;
+	}
+
+	float endpoints[2][4];
+	FindEndpoints(block, 4, endpoints);
+	Bc7Mode6Block encoded = QuantiseBc7Endpoints(block, endpoints, isOpaque);
+
+	// One round of least squares from the first guess's indices.
+	float weights[kBlockTexelCount];
+	for (uint32_t i = 0; i < kBlockTexelCount; ++i)
+	{
+		weights[i] = kBc7Weights[encoded.indices[i]] / 64.0f;
+	}
+
+	if (encoded.error > 0 && FitEndpoints(block, 4, weights, endpoints))
+	{
+		Bc7Mode6Block fitted = QuantiseBc7Endpoints(block, endpoints, isOpaque);
+		if (fitted.error < encoded.error)
+		{
+			encoded = fitted;
+		}
+	}
+
+	// The first texel's index drops its top bit, so it must be in the lower half of the palette.
+	if (encoded.indices[0] >= 8)
+	{
+		std::swap(encoded.endpoints[0], encoded.endpoints[1]);
+		std::swap(encoded.lowBits[0], encoded.lowBits[1]);
+
+		for (uint32_t i = 0; i < kBlockTexelCount; ++i)
+		{
+			encoded.indices[i] = static_cast<uint8_t>(15 - encoded.indices[i]);
+		}
+	}
+
+	BlockBitWriter writer(pOut);
+	writer.Write(1 << 6, 7);
+
+	for (uint32_t c = 0; c < 4; ++c)
+	{
+		writer.Write(encoded.endpoints[0][c], 7);
+		writer.Write(encoded.endpoints[1][c], 7);
+	}
+
+	writer.Write(encoded.lowBits[0], 1);
+	writer.Write(encoded.lowBits[1], 1);
+
+	for (uint32_t i = 0; i < kBlockTexelCount; ++i)
+	{
+		writer.Write(encoded.indices[i], i == 0 ? 3 : 4);
+	}
+}
+
+
+static void DecodeBc7Block(const uint8_t* pIn, TexelBlock& block)
+{
+	BlockBitReader reader(pIn);
+	if (reader.Read(7) != 1 << 6)
+	{
+		throw std::runtime_error("only mode 6 bc7 blocks can be decompressed");
+	}
+
+	uint8_t endpoints[2][4];
+	for (uint32_t c = 0; c < 4; ++c)
+	{
+		endpoints[0][c] = static_cast<uint8_t>(reader.Read(7));
+		endpoints[1][c] = static_cast<uint8_t>(reader.Read(7));
+	}
+
+	uint8_t lowBits[2];
+	lowBits[0] = static_cast<uint8_t>(reader.Read(1));
+	lowBits[1] = static_cast<uint8_t>(reader.Read(1));
+
+	uint8_t palette[16][4];
+	GetBc7Palette(endpoints, lowBits, palette);
+
+	for (uint32_t i = 0; i < kBlockTexelCount; ++i)
+	{
+		memcpy(block[i], palette[reader.Read(i == 0 ? 3 : 4)], 4);
+	}
+}
+
+
+static void EncodeBlock(TextureFormat format, const TexelBlock& block, uint8_t* pOut)
+{
+	switch (format)
+	{
+		case TextureFormat::Bc1:
+			EncodeColourBlock(block, pOut);
+			break;
+
+		case TextureFormat::Bc3:
+			EncodeChannelBlock(block, 3, pOut);
+			EncodeColourBlock(block, pOut + 8);
+			break;
+
+		case TextureFormat::Bc5:
+			EncodeChannelBlock(block, 0, pOut);
+			EncodeChannelBlock(block, 1, pOut + 8);
+			break;
+
+		case TextureFormat::Bc7:
+			EncodeBc7Block(block, pOut);
+			break;
+
+		default:
+			break;
+	}
+}
+
+
+static void DecodeBlock(TextureFormat format, const uint8_t* pIn, TexelBlock& block)
+{
+	// Whatever the format doesn't store reads back as opaque, with no blue for BC5.
+	memset(block, 255, sizeof(block));
+
+	switch (format)
+	{
+		case TextureFormat::Bc1:
+			DecodeColourBlock(pIn, block);
+			break;
+
+		case TextureFormat::Bc3:
+			DecodeChannelBlock(pIn, 3, block);
+			DecodeColourBlock(pIn + 8, block);
+			break;
+
+		case TextureFormat::Bc5:
+			DecodeChannelBlock(pIn, 0, block);
+			DecodeChannelBlock(pIn + 8, 1, block);
+			for (uint32_t i = 0; i < kBlockTexelCount; ++i)
+			{
+				block[i][2] = 0;
+			}
+			break;
+
+		case TextureFormat::Bc7:
+			DecodeBc7Block(pIn, block);
+			break;
+
+		default:
+			break;
+	}
+}
+
+
+void CompressTextureLevel(TextureFormat format, const uint8_t* pTexels, uint32_t width, uint32_t height, uint8_t* pBlocks, uint32_t threadCount)
+{
+	if (!IsBlockCompressed(format))
+	{
+		memcpy(pBlocks, pTexels, GetTextureLevelSize(format, width, height));
+		return;
+	}
+
+	uint32_t blocksWide = (width + kBlockSize - 1) / kBlockSize;
+	uint32_t blocksHigh = (height + kBlockSize - 1) / kBlockSize;
+	uint32_t bytesPerBlock = GetBytesPerBlock(format);
+
+	if (threadCount == 0)
+	{
+		threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+	}
+
+	threadCount = std::min(threadCount, blocksHigh);
+
+	// Each thread takes the next row of blocks as it finishes the last.
+	std::atomic<uint32_t> nextRow {0};
+	auto compressRows = [&]()
+	{
+		TexelBlock block;
+		for (uint32_t blockY = nextRow++; blockY < blocksHigh; blockY = nextRow++)
+		{
+			for (uint32_t blockX = 0; blockX < blocksWide; ++blockX)
+			{
+				ReadBlock(pTexels, width, height, blockX, blockY, block);
+				EncodeBlock(format, block, pBlocks + (static_cast<size_t>(blockY) * blocksWide + blockX) * bytesPerBlock);
+			}
+		}
+	};
+
+	std::vector<std::future<void>> workers;
+	for (uint32_t i = 1; i < threadCount; ++i)
+	{
+		workers.push_back(std::async(std::launch::async, compressRows));
+	}
+
+	compressRows();
+
+	for (auto& worker : workers)
+	{
+		worker.get();
+	}
+}
+
+
+void DecompressTextureLevel(TextureFormat format, const uint8_t* pBlocks, uint32_t width, uint32_t height, uint8_t* pTexels)
+{
+	if (!IsBlockCompressed(format))
+	{
+		memcpy(pTexels, pBlocks, GetTextureLevelSize(format, width, height));
+		return;
+	}
+
+	uint32_t blocksWide = (width + kBlockSize - 1) / kBlockSize;
+	uint32_t blocksHigh = (height + kBlockSize - 1) / kBlockSize;
+	uint32_t bytesPerBlock = GetBytesPerBlock(format);
+
+	TexelBlock block;
+	for (uint32_t blockY = 0; blockY < blocksHigh; ++blockY)
+	{
+		for (uint32_t blockX = 0; blockX < blocksWide; ++blockX)
+		{
+			DecodeBlock(format, pBlocks + (static_cast<size_t>(blockY) * blocksWide + blockX) * bytesPerBlock, block);
+			WriteBlock(block, width, height, blockX, blockY, pTexels);
+		}
+	}
+}
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// STD.
+#include <cstdint>
+#include <string>
+
+
+namespace Jettison::Renderer
+{
+// How a cooked texture's texels are stored. The block formats work on 4 x 4 texel blocks.
+enum class TextureFormat : uint32_t
+{
+	// Uncompressed, 4 bytes a texel.
+	Rgba8,
+
+	// Colour without alpha, 8 bytes a block. 8x smaller than RGBA8.
+	Bc1,
+
+	// BC1's colour plus a separate alpha channel, 16 bytes a block.
+	Bc3,
+
+	// Two independent channels, 16 bytes a block, for tangent space normal maps. Blue and alpha are dropped.
+	Bc5,
+
+	// Colour and alpha at a much higher quality than BC1 or BC3, 16 bytes a block. Only mode 6 is written: one
+	// subset with 4 bit indices and RGBA endpoints.
+	Bc7,
+};
+
+
+const char* GetTextureFormatName(TextureFormat format);
+
+// Accepts the names returned by GetTextureFormatName.
+TextureFormat ParseTextureFormat(const std::string& name);
+
+// The sRGB formats decode to linear in the sampler. BC5 has no sRGB format, its channels are always linear.
+VkFormat GetTextureVkFormat(TextureFormat format, bool isSrgb);
+
+bool IsBlockCompressed(TextureFormat format);
+
+// Bytes for one level of the given size. Block formats round up to whole blocks.
+uint64_t GetTextureLevelSize(TextureFormat format, uint32_t width, uint32_t height);
+
+
+// Compress a level of RGBA8 texels, tightly packed. Blocks which hang off the edge repeat the edge texels. The blocks
+// are shared between threads, zero meaning one per core.
+void CompressTextureLevel(TextureFormat format, const uint8_t* pTexels, uint32_t width, uint32_t height, uint8_t* pBlocks,
+	uint32_t threadCount = 0);
+
+// Back to RGBA8, for devices without the block formats. Only reads what CompressTextureLevel writes, so BC7 blocks
+// must be mode 6.
+void DecompressTextureLevel(TextureFormat format, const uint8_t* pBlocks, uint32_t width, uint32_t height, uint8_t* pTexels);
+}
@@ -0,0 +1,473 @@
+#include "TextureCooker.h"
+
+// STB.
+#define STB_IMAGE_IMPLEMENTATION
+#include <../stb/include/stb_image.h>
+
+// STD.
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <type_traits>
+
+
+namespace Jettison::Renderer
+{
+const char* kTextureCacheDirectory = "texture_cache";
+
+constexpr uint32_t kTextureFileMagic = 0x5845544a; // "JTEX"
+
+// Every level starts on this boundary, which suits any texel block size for buffer to image copies.
+constexpr uint64_t kTextureLevelAlignment = 16;
+
+
+// Followed by the level descriptions, then the levels' data.
+struct TextureFileHeader
+{
+	uint32_t magic {kTextureFileMagic};
+	uint32_t version {kTextureFileVersion};
+	uint64_t sourceHash {0};
+
+	TextureFormat format {TextureFormat::Rgba8};
+	uint32_t isSrgb {0};
+	uint32_t isNormalMap {0};
+	uint32_t width {0};
+	uint32_t height {0};
+	uint32_t levelCount {0};
+	uint64_t dataSize {0};
+};
+
+static_assert(std::is_trivially_copyable_v<TextureFileHeader>, "the texture file header is written as it is");
+static_assert(std::is_trivially_copyable_v<TextureLevel>, "texture levels are written as they are");
+
+
+// A level being filtered, in linear light. Colour is premultiplied by alpha, except for normal maps.
+struct FilterLevel
+{
+	uint32_t width {0};
+	uint32_t height {0};
+	std::vector<float> texels {};
+};
+
+
+// One source texel's share of a filtered texel.
+struct FilterTap
+{
+	uint32_t source {0};
+	float weight {0.0f};
+};
+
+
+static uint64_t AlignUp(uint64_t value)
+{
+	return (value + kTextureLevelAlignment - 1) & ~(kTextureLevelAlignment - 1);
+}
+
+
+static float SrgbToLinear(float value)
+{
+	return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+
+static float LinearToSrgb(float value)
+{
+	return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+}
+
+
+static uint8_t ToUnorm8(float value)
+{
+	return static_cast<uint8_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+}
+
+
+static FilterLevel DecodeLevel(const uint8_t* pTexels, uint32_t width, uint32_t height, const TextureCookSettings& settings)
+{
+	float toLinear[256];
+	for (uint32_t i = 0; i < 256; ++i)
+	{
+		toLinear[i] = settings.isSrgb ? SrgbToLinear(i / 255.0f) : i / 255.0f;
+	}
+
+	FilterLevel level;
+	level.width = width;
+	level.height = height;
+	level.texels.resize(static_cast<size_t>(width) * height * 4);
+
+	for (size_t i = 0; i < static_cast<size_t>(width) * height; ++i)
+	{
+		const uint8_t* pTexel = pTexels + i * 4;
+		float* pFiltered = &level.texels[i * 4];
+		float alpha = pTexel[3] / 255.0f;
+
+		for (uint32_t c = 0; c < 3; ++c)
+		{
+			pFiltered[c] = settings.isNormalMap ? pTexel[c] / 255.0f * 2.0f - 1.0f : toLinear[pTexel[c]] * alpha;
+		}
+
+		pFiltered[3] = alpha;
+	}
+
+	return level;
+}
+
+
+static void EncodeLevel(const FilterLevel& level, const TextureCookSettings& settings, std::vector<uint8_t>& texels)
+{
+	texels.resize(static_cast<size_t>(level.width) * level.height * 4);
+
+	for (size_t i = 0; i < static_cast<size_t>(level.width) * level.height; ++i)
+	{
+		const float* pFiltered = &level.texels[i * 4];
+		uint8_t* pTexel = &texels[i * 4];
+		float alpha = pFiltered[3];
+
+		if (settings.isNormalMap)
+		{
+			float length = std::sqrt(pFiltered[0] * pFiltered[0] + pFiltered[1] * pFiltered[1] + pFiltered[2] * pFiltered[2]);
+			for (uint32_t c = 0; c < 3; ++c)
+			{
+				float normal = length > 0.0f ? pFiltered[c] / length : (c == 2 ? 1.0f : 0.0f);
+				pTexel[c] = ToUnorm8(normal * 0.5f + 0.5f);
+			}
+		}
+		else
+		{
+			for (uint32_t c = 0; c < 3; ++c)
+			{
+				float colour = alpha > 0.0f ? pFiltered[c] / alpha : 0.0f;
+				pTexel[c] = ToUnorm8(settings.isSrgb ? LinearToSrgb(std::clamp(colour, 0.0f, 1.0f)) : colour);
+			}
+		}
+
+		pTexel[3] = ToUnorm8(alpha);
+	}
+}
+
+
+// Each destination texel covers an equal span of the source. Texels partly inside it are weighted by how much is.
+static std::vector<std::vector<FilterTap>> GetBoxFilterTaps(uint32_t sourceSize, uint32_t destinationSize)
+{
+	std::vector<std::vector<FilterTap>> taps(destinationSize);
+	double scale = static_cast<double>(sourceSize) / destinationSize;
+
+	for (uint32_t destination = 0; destination < destinationSize; ++destination)
+	{
+		double begin = destination * scale;
+		double end = (destination + 1) * scale;
+
+		for (uint32_t source = static_cast<uint32_t>(begin); source < sourceSize && source < end; ++source)
+		{
+			double coverage = std::min<double>(source + 1, end) - std::max<double>(source, begin);
+			if (coverage > 0.0)
+			{
+				taps[destination].push_back({source, static_cast<float>(coverage / scale)});
+			}
+		}
+	}
+
+	return taps;
+}
+
+
+// Half the size, rounding down, horizontally then vertically.
+static FilterLevel Downsample(const FilterLevel& source)
+{
+	uint32_t width = std::max(source.width / 2, 1u);
+	uint32_t height = std::max(source.height / 2, 1u);
+	std::vector<std::vector<FilterTap>> columnTaps = GetBoxFilterTaps(source.width, width);
+	std::vector<std::vector<FilterTap>> rowTaps = GetBoxFilterTaps(source.height, height);
+
+	std::vector<float> narrowed(static_cast<size_t>(width) * source.height * 4, 0.0f);
+	for (uint32_t y = 0; y < source.height; ++y)
+	{
+		for (uint32_t x = 0; x < width; ++x)
+		{
+			float* pNarrowed = &narrowed[(static_cast<size_t>(y) * width + x) * 4];
+			for (const FilterTap& tap : columnTaps[x])
+			{
+				const float* pSource = &source.texels[(static_cast<size_t>(y) * source.width + tap.source) * 4];
+				for (uint32_t c = 0; c < 4; ++c)
+				{
+					pNarrowed[c] += pSource[c] * tap.weight;
+				}
+			}
+		}
+	}
+
+	FilterLevel level;
+	level.width = width;
+	level.height = height;
+	level.texels.assign(static_cast<size_t>(width) * height * 4, 0.0f);
+
+	for (uint32_t y = 0; y < height; ++y)
+	{
+		for (const FilterTap& tap : rowTaps[y])
+		{
+			for (uint32_t x = 0; x < width; ++x)
+			{
+				const float* pNarrowed = &narrowed[(static_cast<size_t>(tap.source) * width + x) * 4];
+				float* pTexel = &level.texels[(static_cast<size_t>(y) * width + x) * 4];
+				for (uint32_t c = 0; c < 4; ++c)
+				{
+					pTexel[c] += pNarrowed[c] * tap.weight;
+				}
+			}
+		}
+	}
+
+	return level;
+}
+
+
+TextureView CookedTexture::GetView() const
+{
+	TextureView view;
+	view.settings = settings;
+	view.width = width;
+	view.height = height;
+	view.pLevels = levels.data();
+	view.levelCount = static_cast<uint32_t>(levels.size());
+	view.pData = data.data();
+	view.dataSize = data.size();
+
+	return view;
+}
+
+
+CookedTexture CookTexture(const uint8_t* pTexels, uint32_t width, uint32_t height, const TextureCookSettings& settings, uint32_t threadCount)
+{
+	if (settings.isSrgb && (settings.isNormalMap || settings.format == TextureFormat::Bc5))
+	{
+		throw std::runtime_error("normal maps and bc5 textures can't be srgb");
+	}
+
+	uint32_t levelCount = 1;
+	while (levelCount < 32 && std::max(width, height) >> levelCount)
+	{
+		++levelCount;
+	}
+
+	if (width == 0 || height == 0 || levelCount > kMaxTextureLevels)
+	{
+		throw std::runtime_error("texture size " + std::to_string(width) + " x " + std::to_string(height) + " can't be cooked");
+	}
+
+	CookedTexture cooked;
+	cooked.settings = settings;
+	cooked.width = width;
+	cooked.height = height;
+	cooked.levels.resize(levelCount);
+
+	uint64_t dataSize = 0;
+	for (uint32_t i = 0; i < levelCount; ++i)
+	{
+		TextureLevel& level = cooked.levels[i];
+		level.width = std::max(width >> i, 1u);
+		level.height = std::max(height >> i, 1u);
+		level.offset = AlignUp(dataSize);
+		level.size = GetTextureLevelSize(settings.format, level.width, level.height);
+		dataSize = level.offset + level.size;
+	}
+
+	cooked.data.resize(dataSize);
+
+	// The full detail level is compressed straight from the source. Each smaller one is filtered from the one before
+	// at full precision, and only rounded to 8 bits for compression.
+	FilterLevel filterLevel;
+	std::vector<uint8_t> levelTexels;
+
+	for (uint32_t i = 0; i < levelCount; ++i)
+	{
+		const TextureLevel& level = cooked.levels[i];
+		const uint8_t* pLevelTexels = pTexels;
+
+		if (i == 1)
+		{
+			filterLevel = Downsample(DecodeLevel(pTexels, width, height, settings));
+		}
+		else if (i > 1)
+		{
+			filterLevel = Downsample(filterLevel);
+		}
+
+		if (i > 0)
+		{
+			EncodeLevel(filterLevel, settings, levelTexels);
+			pLevelTexels = levelTexels.data();
+		}
+
+		CompressTextureLevel(settings.format, pLevelTexels, level.width, level.height, cooked.data.data() + level.offset, threadCount);
+	}
+
+	return cooked;
+}
+
+
+CookedTexture CookTextureFile(const std::string& sourcePath, const TextureCookSettings& settings, uint32_t threadCount)
+{
+	int width;
+	int height;
+	int channels;
+
+	stbi_uc* pixels = stbi_load(sourcePath.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+	if (!pixels)
+	{
+		throw std::runtime_error("failed to load texture image " + sourcePath);
+	}
+
+	CookedTexture cooked;
+	try
+	{
+		cooked = CookTexture(pixels, static_cast<uint32_t>(width), static_cast<uint32_t>(height), settings, threadCount);
+	}
+	catch (...)
+	{
+		stbi_image_free(pixels);
+		throw;
+	}
+
+	stbi_image_free(pixels);
+
+	return cooked;
+}
+
+
+std::string GetTextureCachePath(const std::string& sourcePath, const TextureCookSettings& settings)
+{
+	// Sources with the same name in different directories share a file, and replace each other's entries.
+	std::filesystem::path fileName = std::filesystem::path(sourcePath).stem();
+	fileName += std::string("_") + GetTextureFormatName(settings.format) + (settings.isNormalMap ? "_normal" : settings.isSrgb ? "_srgb" : "_linear")
+		+ ".tex";
+
+	return (std::filesystem::path(kTextureCacheDirectory) / fileName).string();
+}
+
+
+static uint64_t GetDataOffset(uint32_t levelCount)
+{
+	return AlignUp(AlignUp(sizeof(TextureFileHeader)) + sizeof(TextureLevel) * levelCount);
+}
+
+
+void WriteTextureFile(const std::string& path, uint64_t sourceHash, const TextureView& texture)
+{
+	TextureFileHeader header;
+	header.sourceHash = sourceHash;
+	header.format = texture.settings.format;
+	header.isSrgb = texture.settings.isSrgb ? 1 : 0;
+	header.isNormalMap = texture.settings.isNormalMap ? 1 : 0;
+	header.width = texture.width;
+	header.height = texture.height;
+	header.levelCount = texture.levelCount;
+	header.dataSize = texture.dataSize;
+
+	std::error_code error;
+	std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+
+	std::string tempPath = path + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			std::cerr << "failed to write texture " << path << "\n";
+			return;
+		}
+
+		static const char kZeros[kTextureLevelAlignment] = {};
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(kZeros, static_cast<std::streamsize>(AlignUp(sizeof(header)) - sizeof(header)));
+		file.write(reinterpret_cast<const char*>(texture.pLevels), sizeof(TextureLevel) * texture.levelCount);
+		file.write(kZeros, static_cast<std::streamsize>(GetDataOffset(texture.levelCount) - static_cast<uint64_t>(file.tellp())));
+		file.write(reinterpret_cast<const char*>(texture.pData), static_cast<std::streamsize>(texture.dataSize));
+
+		if (!file)
+		{
+			std::cerr << "failed to write texture " << path << "\n";
+			return;
+		}
+	}
+
+	std::filesystem::rename(tempPath, path, error);
+	if (error)
+	{
+		std::cerr << "failed to replace texture " << path << ": " << error.message() << '\n';
+		std::filesystem::remove(tempPath, error);
+	}
+}
+
+
+bool TextureFile::Open(const std::string& path, uint64_t sourceHash, const TextureCookSettings& settings)
+{
+	Close();
+
+	if (!m_file.Open(path))
+	{
+		return false;
+	}
+
+	TextureFileHeader header;
+	if (m_file.GetSize() < sizeof(header))
+	{
+		Close();
+		return false;
+	}
+
+	memcpy(&header, m_file.GetData(), sizeof(header));
+
+	TextureCookSettings fileSettings;
+	fileSettings.format = header.format;
+	fileSettings.isSrgb = header.isSrgb != 0;
+	fileSettings.isNormalMap = header.isNormalMap != 0;
+
+	// Anything stale is quietly cooked again, only a damaged file is worth mentioning.
+	if (header.magic != kTextureFileMagic || header.version != kTextureFileVersion || header.sourceHash != sourceHash || fileSettings != settings)
+	{
+		Close();
+		return false;
+	}
+
+	const uint8_t* pData = m_file.GetData();
+	const TextureLevel* pLevels = reinterpret_cast<const TextureLevel*>(pData + AlignUp(sizeof(header)));
+	uint64_t dataOffset = GetDataOffset(header.levelCount);
+
+	bool isIntact = header.levelCount > 0 && header.levelCount <= kMaxTextureLevels && dataOffset + header.dataSize == m_file.GetSize();
+	for (uint32_t i = 0; isIntact && i < header.levelCount; ++i)
+	{
+		const TextureLevel& level = pLevels[i];
+		isIntact = level.width == std::max(header.width >> i, 1u) && level.height == std::max(header.height >> i, 1u)
+			&& level.size == GetTextureLevelSize(header.format, level.width, level.height) && level.offset % kTextureLevelAlignment == 0
+			&& level.offset + level.size <= header.dataSize;
+	}
+
+	if (!isIntact)
+	{
+		std::cerr << "texture " << path << " is corrupt, ignoring it\n";
+		Close();
+		return false;
+	}
+
+	m_texture.settings = fileSettings;
+	m_texture.width = header.width;
+	m_texture.height = header.height;
+	m_texture.pLevels = pLevels;
+	m_texture.levelCount = header.levelCount;
+	m_texture.pData = pData + dataOffset;
+	m_texture.dataSize = header.dataSize;
+
+	return true;
+}
+
+
+void TextureFile::Close()
+{
+	m_file.Close();
+	m_texture = {};
+}
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+// STD.
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+#include "TextureCompression.h"
+
+
+namespace Jettison::Renderer
+{
+// Bump whenever the file's layout, or the filtering and compression which produce its contents, change. Files from
+// any other version are cooked afresh.
+constexpr uint32_t kTextureFileVersion = 1;
+
+// Enough levels for a texture 65536 texels across.
+constexpr uint32_t kMaxTextureLevels = 17;
+
+
+struct TextureCookSettings
+{
+	TextureFormat format {TextureFormat::Bc7};
+
+	// Colour is filtered in linear light, then stored and sampled as sRGB.
+	bool isSrgb {true};
+
+	// Tangent space normals, stored as 0.5 + 0.5 * n. Each level is renormalised after filtering. Never sRGB.
+	bool isNormalMap {false};
+
+	bool operator==(const TextureCookSettings& other) const
+	{
+		return format == other.format && isSrgb == other.isSrgb && isNormalMap == other.isNormalMap;
+	}
+
+	bool operator!=(const TextureCookSettings& other) const { return !(*this == other); }
+};
+
+
+struct TextureLevel
+{
+	// From the start of the texture's data, always a multiple of 16 bytes so it can be copied straight to an image.
+	uint64_t offset {0};
+	uint64_t size {0};
+	uint32_t width {0};
+	uint32_t height {0};
+};
+
+
+// A cooked texture's levels, largest first. It points at them rather than owning them, so the same description
+// serves a freshly cooked texture and a mapped file.
+struct TextureView
+{
+	TextureCookSettings settings {};
+	uint32_t width {0};
+	uint32_t height {0};
+
+	const TextureLevel* pLevels {nullptr};
+	uint32_t levelCount {0};
+
+	const uint8_t* pData {nullptr};
+	uint64_t dataSize {0};
+};
+
+
+struct CookedTexture
+{
+	TextureCookSettings settings {};
+	uint32_t width {0};
+	uint32_t height {0};
+	std::vector<TextureLevel> levels {};
+	std::vector<uint8_t> data {};
+
+	TextureView GetView() const;
+};
+
+
+// Where the time went loading a texture, and what it cost on the device.
+struct TextureLoadStats
+{
+	// Was the texture mapped from the cache, rather than cooked from its source?
+	bool isCached {false};
+
+	// Does the device hold the texture compressed? If the device can't sample the cooked format, it is decompressed
+	// when loaded, and the precomputed levels are still used.
+	bool isCompressed {false};
+
+	TextureFormat format {TextureFormat::Rgba8};
+	uint32_t width {0};
+	uint32_t height {0};
+	uint32_t levelCount {0};
+
+	// Every level, as uploaded, and what the same levels would take as RGBA8.
+	uint64_t size {0};
+	uint64_t uncompressedSize {0};
+
+	// Hashing the source, to find out whether the cache is still good.
+	std::chrono::duration<double, std::milli> hashTime {0};
+
+	// Decoding the source, filtering its levels and compressing them. Zero when cached.
+	std::chrono::duration<double, std::milli> cookTime {0};
+
+	// Reading the cache, or writing it after cooking.
+	std::chrono::duration<double, std::milli> cacheTime {0};
+
+	// All of the above, plus copying the levels into staging.
+	std::chrono::duration<double, std::milli> totalTime {0};
+};
+
+
+// Filter RGBA8 texels, tightly packed, into the full chain of levels down to 1 x 1, then compress each. Each level
+// is an area weighted box filter of the one before, so sizes which don't halve evenly lose nothing. Colour is
+// weighted by alpha, so transparent texels don't bleed into their neighbours.
+CookedTexture CookTexture(const uint8_t* pTexels, uint32_t width, uint32_t height, const TextureCookSettings& settings,
+	uint32_t threadCount = 0);
+
+// Decode an image file, e.g. a PNG, then cook it. Throws if it can't be read.
+CookedTexture CookTextureFile(const std::string& sourcePath, const TextureCookSettings& settings, uint32_t threadCount = 0);
+
+// Each source and set of settings has its own file in the cache directory.
+std::string GetTextureCachePath(const std::string& sourcePath, const TextureCookSettings& settings);
+
+// Write to a temporary file, then rename it over the old one so a crash can never leave a torn file. Failing is only
+// a warning, since the texture is loaded either way.
+void WriteTextureFile(const std::string& path, uint64_t sourceHash, const TextureView& texture);
+
+
+// A cooked texture file mapped into memory. Its levels can be copied straight into a staging buffer.
+class TextureFile
+{
+public:
+	TextureFile() = default;
+
+	// Disable copying.
+	TextureFile(const TextureFile&) = delete;
+	TextureFile& operator=(const TextureFile&) = delete;
+
+	// Returns false if the file is missing, from another version, made from a different source or with different
+	// settings, or its levels don't fit what its header says it holds.
+	bool Open(const std::string& path, uint64_t sourceHash, const TextureCookSettings& settings);
+
+	// The view is only good until the file is closed.
+	void Close();
+
+	inline const TextureView& GetTexture() const { return m_texture; }
+
+private:
+	MappedFile m_file {};
+
+	TextureView m_texture {};
+};
+}
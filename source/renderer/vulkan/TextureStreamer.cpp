@@ -0,0 +1,640 @@
+#include "TextureStreamer.h"
+
+// STD.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+
+
+namespace Jettison::Renderer
+{
+uint32_t GetRequiredTextureLevel(uint32_t width, uint32_t height, uint32_t levelCount, float texCoordDensity, float pixelsPerUnit)
+{
+	// Without texture coordinates, every texel is the same one.
+	if (!(texCoordDensity > 0.0f))
+	{
+		return levelCount - 1;
+	}
+
+	// How many of the largest level's texels land on each pixel. Anything up to one needs the largest level, and each
+	// level after it covers twice as many.
+	float texelsPerPixel = texCoordDensity * static_cast<float>(std::max(width, height)) / pixelsPerUnit;
+	if (!(texelsPerPixel > 1.0f))
+	{
+		return 0;
+	}
+
+	float level = std::floor(std::log2(texelsPerPixel));
+	return std::min(static_cast<uint32_t>(level), levelCount - 1);
+}
+
+
+void TextureStreamer::Init()
+{
+	VkSamplerCreateInfo samplerInfo {};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_LINEAR;
+	samplerInfo.minFilter = VK_FILTER_LINEAR;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerInfo.anisotropyEnable = VK_TRUE;
+	samplerInfo.maxAnisotropy = 16;
+	samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+	samplerInfo.unnormalizedCoordinates = VK_FALSE;
+	samplerInfo.compareEnable = VK_FALSE;
+	samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+	samplerInfo.mipLodBias = 0.0f;
+	samplerInfo.minLod = 0.0f;
+	samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+	if (vkCreateSampler(m_pDeviceContext->GetLogicalDevice(), &samplerInfo, nullptr, &m_sampler) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create texture sampler");
+	}
+
+	m_frameNumber = 0;
+	m_stats = {m_stats.budget};
+}
+
+
+void TextureStreamer::Destroy()
+{
+	// Nothing is drawing, but the uploads may still be running.
+	UploadManager& uploadManager = m_pDeviceContext->GetUploadManager();
+
+	for (auto& orphan : m_orphanedImages)
+	{
+		uploadManager.Wait(orphan.ticket);
+		if (orphan.handle != kInvalidBindlessHandle)
+		{
+			m_pDeviceContext->GetBindlessRegistry().ReleaseTexture(orphan.handle);
+		}
+
+		DestroyImage(m_pDeviceContext.get(), orphan.image);
+	}
+
+	m_orphanedImages.clear();
+
+	for (auto& pTexture : m_textures)
+	{
+		if (!pTexture)
+		{
+			continue;
+		}
+
+		if (pTexture->isStreaming)
+		{
+			uploadManager.Wait(pTexture->streamingTicket);
+			DestroyImage(m_pDeviceContext.get(), pTexture->streaming);
+		}
+
+		uploadManager.Wait(pTexture->residentTicket);
+		m_pDeviceContext->GetBindlessRegistry().ReleaseTexture(pTexture->handle);
+		DestroyImage(m_pDeviceContext.get(), pTexture->resident);
+	}
+
+	m_textures.clear();
+	m_freeIds.clear();
+
+	vkDestroySampler(m_pDeviceContext->GetLogicalDevice(), m_sampler, nullptr);
+	m_sampler = VK_NULL_HANDLE;
+}
+
+
+StreamedTextureId TextureStreamer::LoadTexture(const std::string& path, const TextureCookSettings& settings)
+{
+	return AddTexture(DecodeTexture(path, settings));
+}
+
+
+DecodedTexture TextureStreamer::DecodeTexture(const std::string& path, const TextureCookSettings& settings, uint32_t threadCount) const
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	DecodedTexture decoded;
+	decoded.path = path;
+	decoded.settings = settings;
+
+	// Cooked once, the first time the source is seen, then mapped straight from the cache until it changes.
+	decoded.sourceHash = HashFileContents(path);
+	decoded.cachePath = GetTextureCachePath(path, settings);
+
+	auto cacheStartTime = std::chrono::high_resolution_clock::now();
+	decoded.loadStats.hashTime = cacheStartTime - startTime;
+
+	TextureFile file;
+	TextureView view;
+
+	if (file.Open(decoded.cachePath, decoded.sourceHash, settings))
+	{
+		view = file.GetTexture();
+		decoded.loadStats.isCached = true;
+		decoded.loadStats.cacheTime = std::chrono::high_resolution_clock::now() - cacheStartTime;
+	}
+	else
+	{
+		auto cookStartTime = std::chrono::high_resolution_clock::now();
+		decoded.levels = CookTextureFile(path, settings, threadCount);
+		view = decoded.levels.GetView();
+
+		auto writeStartTime = std::chrono::high_resolution_clock::now();
+		decoded.loadStats.cookTime = writeStartTime - cookStartTime;
+
+		WriteTextureFile(decoded.cachePath, decoded.sourceHash, view);
+		decoded.loadStats.cacheTime = std::chrono::high_resolution_clock::now() - writeStartTime;
+	}
+
+	// Without the compressed format every level is decompressed now, rather than each time it streams in. That still
+	// saves generating them.
+	decoded.format = GetTextureVkFormat(settings.format, settings.isSrgb);
+	decoded.loadStats.isCompressed = IsBlockCompressed(settings.format);
+
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(m_pDeviceContext->GetPhysicalDevice(), decoded.format, &formatProperties);
+
+	VkFormatFeatureFlags requiredFeatures = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+	bool isFormatSupported = (formatProperties.optimalTilingFeatures & requiredFeatures) == requiredFeatures
+		&& (!decoded.loadStats.isCompressed || m_pDeviceContext->GetCapabilities().isTextureCompressionBcSupported);
+
+	if (!isFormatSupported)
+	{
+		CookedTexture decompressed;
+		decompressed.settings = view.settings;
+		decompressed.width = view.width;
+		decompressed.height = view.height;
+		decompressed.levels.assign(view.pLevels, view.pLevels + view.levelCount);
+
+		uint64_t dataSize = 0;
+		for (auto& level : decompressed.levels)
+		{
+			level.offset = dataSize;
+			level.size = GetTextureLevelSize(TextureFormat::Rgba8, level.width, level.height);
+			dataSize += level.size;
+		}
+
+		decompressed.data.resize(dataSize);
+		for (uint32_t i = 0; i < view.levelCount; ++i)
+		{
+			const TextureLevel& level = view.pLevels[i];
+			DecompressTextureLevel(settings.format, view.pData + level.offset, level.width, level.height,
+				decompressed.data.data() + decompressed.levels[i].offset);
+		}
+
+		decoded.levels = std::move(decompressed);
+		decoded.format = GetTextureVkFormat(TextureFormat::Rgba8, settings.isSrgb);
+		decoded.loadStats.isCompressed = false;
+	}
+
+	file.Close();
+
+	decoded.loadStats.totalTime = std::chrono::high_resolution_clock::now() - startTime;
+
+	return decoded;
+}
+
+
+StreamedTextureId TextureStreamer::AddTexture(DecodedTexture&& decoded)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	auto pTexture = std::make_unique<StreamedTexture>();
+	StreamedTexture& texture = *pTexture;
+	texture.path = decoded.path;
+	texture.format = decoded.format;
+	texture.loadStats = decoded.loadStats;
+
+	// The mapping is opened again here, rather than handed over, since the texture keeps it for as long as it is
+	// loaded. The header was checked moments ago, so this is cheap.
+	if (decoded.levels.data.empty())
+	{
+		if (!texture.file.Open(decoded.cachePath, decoded.sourceHash, decoded.settings))
+		{
+			throw std::runtime_error("failed to map cooked texture " + decoded.path);
+		}
+
+		texture.view = texture.file.GetTexture();
+	}
+	else
+	{
+		texture.levels = std::move(decoded.levels);
+		texture.view = texture.levels.GetView();
+	}
+
+	// The tail is every level from the first which fits, and at least the last.
+	uint32_t levelCount = texture.view.levelCount;
+	texture.tailLevel = levelCount - 1;
+	while (texture.tailLevel > 0
+		&& std::max(texture.view.pLevels[texture.tailLevel - 1].width, texture.view.pLevels[texture.tailLevel - 1].height) <= kTextureTailSize)
+	{
+		texture.tailLevel--;
+	}
+
+	texture.pendingRequestLevel = levelCount;
+	texture.requestedLevel = texture.tailLevel;
+	texture.targetLevel = texture.tailLevel;
+	texture.lastUsedFrame = m_frameNumber;
+
+	UploadManager& uploadManager = m_pDeviceContext->GetUploadManager();
+	texture.resident = UploadLevels(texture, texture.tailLevel);
+	texture.residentTicket = uploadManager.Submit();
+	texture.handle = m_pDeviceContext->GetBindlessRegistry().RegisterTexture(texture.resident.imageView, m_sampler);
+
+	m_stats.uploadedSize += GetLevelsSize(texture, texture.tailLevel);
+
+	texture.loadStats.format = texture.loadStats.isCompressed ? decoded.settings.format : TextureFormat::Rgba8;
+	texture.loadStats.width = texture.view.width;
+	texture.loadStats.height = texture.view.height;
+	texture.loadStats.levelCount = levelCount;
+	texture.loadStats.size = GetLevelsSize(texture, 0);
+
+	for (uint32_t i = 0; i < levelCount; ++i)
+	{
+		texture.loadStats.uncompressedSize += GetTextureLevelSize(TextureFormat::Rgba8, texture.view.pLevels[i].width, texture.view.pLevels[i].height);
+	}
+
+	texture.loadStats.totalTime += std::chrono::high_resolution_clock::now() - startTime;
+
+	StreamedTextureId id;
+	if (!m_freeIds.empty())
+	{
+		id = m_freeIds.back();
+		m_freeIds.pop_back();
+		m_textures[id] = std::move(pTexture);
+	}
+	else
+	{
+		id = static_cast<StreamedTextureId>(m_textures.size());
+		m_textures.push_back(std::move(pTexture));
+	}
+
+	return id;
+}
+
+
+void TextureStreamer::ReleaseTexture(StreamedTextureId id)
+{
+	StreamedTexture& texture = GetTexture(id);
+
+	// Either image may still be uploading.
+	m_orphanedImages.push_back({texture.resident, texture.residentTicket, texture.handle});
+
+	if (texture.isStreaming)
+	{
+		m_orphanedImages.push_back({texture.streaming, texture.streamingTicket, kInvalidBindlessHandle});
+	}
+
+	texture.file.Close();
+	m_textures[id] = nullptr;
+	m_freeIds.push_back(id);
+}
+
+
+BindlessHandle TextureStreamer::GetHandle(StreamedTextureId texture) const
+{
+	return GetTexture(texture).handle;
+}
+
+
+bool TextureStreamer::IsReady(StreamedTextureId texture) const
+{
+	return m_pDeviceContext->GetUploadManager().IsComplete(GetTexture(texture).residentTicket);
+}
+
+
+void TextureStreamer::RequestLevel(StreamedTextureId id, uint32_t level)
+{
+	StreamedTexture& texture = GetTexture(id);
+	texture.pendingRequestLevel = std::min(texture.pendingRequestLevel, level);
+}
+
+
+void TextureStreamer::RequestTexelDensity(StreamedTextureId id, float texCoordDensity, float pixelsPerUnit)
+{
+	StreamedTexture& texture = GetTexture(id);
+	RequestLevel(id, GetRequiredTextureLevel(texture.view.width, texture.view.height, texture.view.levelCount, texCoordDensity, pixelsPerUnit));
+}
+
+
+bool TextureStreamer::Update()
+{
+	m_frameNumber++;
+
+	UploadManager& uploadManager = m_pDeviceContext->GetUploadManager();
+	bool hasHandleChanged = false;
+
+	for (size_t i = 0; i < m_orphanedImages.size();)
+	{
+		if (uploadManager.IsComplete(m_orphanedImages[i].ticket))
+		{
+			RetireImage(m_orphanedImages[i].image, m_orphanedImages[i].handle);
+			m_orphanedImages[i] = m_orphanedImages.back();
+			m_orphanedImages.pop_back();
+		}
+		else
+		{
+			++i;
+		}
+	}
+
+	// Swap in the levels which have arrived, and take the requests since the last update. A texture which wasn't
+	// asked for keeps what it last asked for, but grows older.
+	std::vector<StreamedTexture*> textures;
+	for (auto& pTexture : m_textures)
+	{
+		if (!pTexture)
+		{
+			continue;
+		}
+
+		StreamedTexture& texture = *pTexture;
+		textures.push_back(&texture);
+
+		if (texture.isStreaming && uploadManager.IsComplete(texture.streamingTicket))
+		{
+			RetireImage(texture.resident, texture.handle);
+
+			texture.resident = texture.streaming;
+			texture.residentTicket = texture.streamingTicket;
+			texture.handle = m_pDeviceContext->GetBindlessRegistry().RegisterTexture(texture.resident.imageView, m_sampler);
+			texture.streaming = {};
+			texture.streamingTicket = 0;
+			texture.isStreaming = false;
+
+			hasHandleChanged = true;
+		}
+
+		if (texture.pendingRequestLevel < texture.view.levelCount)
+		{
+			texture.requestedLevel = std::min(texture.pendingRequestLevel, texture.tailLevel);
+			texture.lastUsedFrame = m_frameNumber;
+			texture.pendingRequestLevel = texture.view.levelCount;
+		}
+	}
+
+	// Fit the requests into the budget. The least recently used textures give up their most detailed levels first,
+	// all the way down to their tails, before the next is touched. Ties go to the first loaded, so two textures
+	// drawn every frame don't take turns.
+	std::stable_sort(textures.begin(), textures.end(), [](const StreamedTexture* pA, const StreamedTexture* pB)
+		{
+			return pA->lastUsedFrame < pB->lastUsedFrame;
+		});
+
+	VkDeviceSize targetSize = 0;
+	m_stats.requestedSize = 0;
+
+	for (StreamedTexture* pTexture : textures)
+	{
+		pTexture->targetLevel = pTexture->requestedLevel;
+		targetSize += GetLevelsSize(*pTexture, pTexture->targetLevel);
+	}
+
+	m_stats.requestedSize = targetSize;
+
+	for (StreamedTexture* pTexture : textures)
+	{
+		while (targetSize > m_stats.budget && pTexture->targetLevel < pTexture->tailLevel)
+		{
+			targetSize -= GetLevelsSize(*pTexture, pTexture->targetLevel) - GetLevelsSize(*pTexture, pTexture->targetLevel + 1);
+			pTexture->targetLevel++;
+		}
+	}
+
+	// Evictions go first, since they are cheap and free memory. Then the most recently used stream in, as far as the
+	// upload limit allows.
+	VkDeviceSize uploadSize = 0;
+	bool isUploading = false;
+
+	for (StreamedTexture* pTexture : textures)
+	{
+		StreamedTexture& texture = *pTexture;
+		if (!texture.isStreaming && texture.targetLevel > texture.resident.firstLevel)
+		{
+			texture.streaming = UploadLevels(texture, texture.targetLevel);
+			texture.isStreaming = true;
+			texture.evictionCount++;
+			m_stats.evictionCount++;
+
+			uploadSize += GetLevelsSize(texture, texture.targetLevel);
+			isUploading = true;
+		}
+	}
+
+	for (auto it = textures.rbegin(); it != textures.rend(); ++it)
+	{
+		StreamedTexture& texture = **it;
+		if (texture.isStreaming || texture.targetLevel >= texture.resident.firstLevel)
+		{
+			continue;
+		}
+
+		// Short of the limit, the texture streams part of the way there, and the rest on a later frame.
+		uint32_t level = texture.targetLevel;
+		while (level + 1 < texture.resident.firstLevel && uploadSize + GetLevelsSize(texture, level) > m_uploadLimit)
+		{
+			level++;
+		}
+
+		if (uploadSize + GetLevelsSize(texture, level) > m_uploadLimit && isUploading)
+		{
+			continue;
+		}
+
+		texture.streaming = UploadLevels(texture, level);
+		texture.isStreaming = true;
+		texture.streamInCount++;
+		m_stats.streamInCount++;
+
+		uploadSize += GetLevelsSize(texture, level);
+		isUploading = true;
+	}
+
+	// Everything started this update goes in one batch.
+	if (isUploading)
+	{
+		UploadTicket ticket = uploadManager.Submit();
+		for (StreamedTexture* pTexture : textures)
+		{
+			if (pTexture->isStreaming && pTexture->streamingTicket == 0)
+			{
+				pTexture->streamingTicket = ticket;
+			}
+		}
+
+		m_stats.uploadedSize += uploadSize;
+	}
+
+	m_stats.textureCount = static_cast<uint32_t>(textures.size());
+	m_stats.residentSize = 0;
+	m_stats.streamingCount = 0;
+
+	for (const StreamedTexture* pTexture : textures)
+	{
+		m_stats.residentSize += GetLevelsSize(*pTexture, pTexture->resident.firstLevel);
+		m_stats.streamingCount += pTexture->isStreaming ? 1 : 0;
+	}
+
+	return hasHandleChanged;
+}
+
+
+TextureResidencyStats TextureStreamer::GetResidencyStats(StreamedTextureId id) const
+{
+	const StreamedTexture& texture = GetTexture(id);
+
+	TextureResidencyStats stats;
+	stats.path = texture.path;
+	stats.width = texture.view.width;
+	stats.height = texture.view.height;
+	stats.levelCount = texture.view.levelCount;
+	stats.residentLevel = texture.resident.firstLevel;
+	stats.requestedLevel = texture.requestedLevel;
+	stats.targetLevel = texture.targetLevel;
+	stats.tailLevel = texture.tailLevel;
+	stats.residentSize = GetLevelsSize(texture, texture.resident.firstLevel);
+	stats.fullSize = GetLevelsSize(texture, 0);
+	stats.lastUsedFrame = texture.lastUsedFrame;
+	stats.isStreaming = texture.isStreaming;
+	stats.streamInCount = texture.streamInCount;
+	stats.evictionCount = texture.evictionCount;
+
+	return stats;
+}
+
+
+const TextureLoadStats& TextureStreamer::GetLoadStats(StreamedTextureId texture) const
+{
+	return GetTexture(texture).loadStats;
+}
+
+
+std::vector<StreamedTextureId> TextureStreamer::GetTextures() const
+{
+	std::vector<StreamedTextureId> textures;
+	for (StreamedTextureId id = 0; id < m_textures.size(); ++id)
+	{
+		if (m_textures[id])
+		{
+			textures.push_back(id);
+		}
+	}
+
+	return textures;
+}
+
+
+TextureStreamer::StreamedTexture& TextureStreamer::GetTexture(StreamedTextureId texture)
+{
+	if (texture >= m_textures.size() || !m_textures[texture])
+	{
+		throw std::runtime_error("unknown streamed texture");
+	}
+
+	return *m_textures[texture];
+}
+
+
+const TextureStreamer::StreamedTexture& TextureStreamer::GetTexture(StreamedTextureId texture) const
+{
+	if (texture >= m_textures.size() || !m_textures[texture])
+	{
+		throw std::runtime_error("unknown streamed texture");
+	}
+
+	return *m_textures[texture];
+}
+
+
+VkDeviceSize TextureStreamer::GetLevelsSize(const StreamedTexture& texture, uint32_t firstLevel)
+{
+	VkDeviceSize size = 0;
+	for (uint32_t i = firstLevel; i < texture.view.levelCount; ++i)
+	{
+		size += texture.view.pLevels[i].size;
+	}
+
+	return size;
+}
+
+
+TextureStreamer::TextureImage TextureStreamer::UploadLevels(const StreamedTexture& texture, uint32_t firstLevel)
+{
+	TextureImage image;
+	image.firstLevel = firstLevel;
+
+	const TextureLevel& first = texture.view.pLevels[firstLevel];
+	uint32_t levelCount = texture.view.levelCount - firstLevel;
+
+	m_pDeviceContext->CreateImage(first.width, first.height, levelCount, VK_SAMPLE_COUNT_1_BIT, texture.format, VK_IMAGE_TILING_OPTIMAL,
+		VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image.image, image.allocation);
+
+	// The levels are stored one after the other, so the run from the first down is one copy into staging.
+	std::vector<VkBufferImageCopy> regions(levelCount);
+	for (uint32_t i = 0; i < levelCount; ++i)
+	{
+		const TextureLevel& level = texture.view.pLevels[firstLevel + i];
+
+		VkBufferImageCopy& region = regions[i];
+		region.bufferOffset = level.offset - first.offset;
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = i;
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = 1;
+		region.imageOffset = {0, 0, 0};
+		region.imageExtent = {level.width, level.height, 1};
+	}
+
+	UploadManager& uploadManager = m_pDeviceContext->GetUploadManager();
+	uploadManager.UploadImage(image.image, texture.view.pData + first.offset, texture.view.dataSize - first.offset, regions, levelCount);
+
+	VkImage textureImage = image.image;
+	uploadManager.RecordGraphicsCommands([textureImage, levelCount](VkCommandBuffer commandBuffer)
+		{
+			VkImageMemoryBarrier barrier {};
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.image = textureImage;
+			barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1};
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+				0, nullptr, 0, nullptr, 1, &barrier);
+		});
+
+	image.imageView = m_pDeviceContext->CreateImageView(image.image, texture.format, VK_IMAGE_ASPECT_COLOR_BIT, levelCount);
+
+	return image;
+}
+
+
+void TextureStreamer::RetireImage(const TextureImage& image, BindlessHandle handle)
+{
+	if (handle != kInvalidBindlessHandle)
+	{
+		m_pDeviceContext->GetBindlessRegistry().ReleaseTexture(handle);
+	}
+
+	DeviceContext* pDeviceContext = m_pDeviceContext.get();
+	TextureImage retired = image;
+
+	m_pDeviceContext->RetireResource([pDeviceContext, retired]() mutable
+		{
+			DestroyImage(pDeviceContext, retired);
+		});
+}
+
+
+void TextureStreamer::DestroyImage(DeviceContext* pDeviceContext, TextureImage& image)
+{
+	vkDestroyImageView(pDeviceContext->GetLogicalDevice(), image.imageView, nullptr);
+	image.imageView = VK_NULL_HANDLE;
+
+	pDeviceContext->DestroyImage(image.image, image.allocation);
+}
+}
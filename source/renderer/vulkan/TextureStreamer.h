@@ -0,0 +1,281 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// STD.
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "DeviceContext.h"
+#include "TextureCooker.h"
+
+
+namespace Jettison::Renderer
+{
+// Identifies a texture loaded through the texture streamer. Unlike its bindless handle, it stays the same as the
+// texture's levels stream in and out.
+using StreamedTextureId = uint32_t;
+
+constexpr StreamedTextureId kInvalidStreamedTexture = UINT32_MAX;
+
+// Levels no larger than this across make up a texture's tail, which is uploaded when it loads and never evicted.
+constexpr uint32_t kTextureTailSize = 64;
+
+// How much device memory the streamed textures' levels may take, unless told otherwise.
+constexpr VkDeviceSize kDefaultTextureBudget = 256 * 1024 * 1024;
+
+// How much may be copied into staging memory each frame, unless told otherwise. A swap which needs more than this
+// still goes ahead if it is the only one that frame, so no texture can be starved.
+constexpr VkDeviceSize kDefaultTextureUploadLimit = 16 * 1024 * 1024;
+
+
+// The most detailed level a texture needs, so each pixel shows no more than one of its texels. The density is how far
+// the texture coordinates move across a unit of the model's surface, and the pixels are how many a unit covers at
+// the model's nearest point. Rounds towards more detail, since trilinear filtering blends in the next level down.
+uint32_t GetRequiredTextureLevel(uint32_t width, uint32_t height, uint32_t levelCount, float texCoordDensity, float pixelsPerUnit);
+
+
+// A texture read from the texture cache, or cooked, and ready for the streamer to upload its tail.
+struct DecodedTexture
+{
+	std::string path {};
+	TextureCookSettings settings {};
+	uint64_t sourceHash {0};
+	std::string cachePath {};
+
+	// Empty when the levels can be mapped straight from the cache. Otherwise they were just cooked, or decompressed
+	// because the device can't sample their format.
+	CookedTexture levels {};
+
+	// What the levels will be uploaded as.
+	VkFormat format {VK_FORMAT_UNDEFINED};
+
+	TextureLoadStats loadStats {};
+};
+
+
+// Where one texture's levels stand.
+struct TextureResidencyStats
+{
+	std::string path {};
+	uint32_t width {0};
+	uint32_t height {0};
+	uint32_t levelCount {0};
+
+	// The most detailed resident level. Every level after it, down to 1 x 1, is resident too.
+	uint32_t residentLevel {0};
+
+	// The most detailed level asked for the last time the texture was drawn.
+	uint32_t requestedLevel {0};
+
+	// As far as the budget lets the texture go towards the requested level. It streams towards this.
+	uint32_t targetLevel {0};
+
+	// The first level of the tail, which is always resident.
+	uint32_t tailLevel {0};
+
+	// The resident levels, and what every level would take.
+	VkDeviceSize residentSize {0};
+	VkDeviceSize fullSize {0};
+
+	// The streamer's frame number when the texture was last asked for.
+	uint64_t lastUsedFrame {0};
+
+	// Are new levels uploading, waiting to be swapped in?
+	bool isStreaming {false};
+
+	uint32_t streamInCount {0};
+	uint32_t evictionCount {0};
+};
+
+
+// Across every streamed texture.
+struct TextureStreamingStats
+{
+	VkDeviceSize budget {0};
+
+	// The levels resident now, and what the textures would take at the levels they asked for.
+	VkDeviceSize residentSize {0};
+	VkDeviceSize requestedSize {0};
+
+	uint32_t textureCount {0};
+
+	// How many textures have new levels uploading.
+	uint32_t streamingCount {0};
+
+	// Since the streamer was initialised.
+	VkDeviceSize uploadedSize {0};
+	uint32_t streamInCount {0};
+	uint32_t evictionCount {0};
+};
+
+
+// Keeps textures' most detailed levels on the device only while something on screen needs them, within a budget.
+//
+// A texture loads with just its tail resident. Each frame the renderer asks for the level every draw needs, from how
+// large its model looks, and the streamer works out which levels each texture can have. When the requests don't fit
+// the budget, the least recently drawn textures give up their most detailed levels first.
+//
+// The levels are mapped from the texture cache, so a change of levels is a copy into staging memory, with no decoding.
+// The new levels go into a new image, uploaded in the background, and nothing changes until the upload completes.
+// The new image then replaces the old one, along with its bindless handle, and the old one is retired once the frames
+// in flight are done with it. The budget covers the levels the textures settle on, so both images exist for the few
+// frames a swap takes.
+//
+// Only to be used from the thread which owns the device context.
+class TextureStreamer
+{
+public:
+	TextureStreamer(std::shared_ptr<DeviceContext> pDeviceContext)
+		:m_pDeviceContext {pDeviceContext} {}
+
+	// Disable copying.
+	TextureStreamer() = default;
+	TextureStreamer(const TextureStreamer&) = delete;
+	TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+	void Init();
+
+	// Destroys every texture. The device must be idle.
+	void Destroy();
+
+	// Load an image file, cooking it first if the texture cache doesn't have it. Only the tail is uploaded now, the
+	// other levels stream in as they are asked for. Throws if the file can't be read.
+	StreamedTextureId LoadTexture(const std::string& path, const TextureCookSettings& settings = {});
+
+	// The first half of LoadTexture, which does the hashing, cooking and any decompressing. It touches nothing on the
+	// device, so it can run on any thread. Cooking uses as many threads as it's given, with zero for one per core.
+	// Throws if the file can't be read.
+	DecodedTexture DecodeTexture(const std::string& path, const TextureCookSettings& settings = {}, uint32_t threadCount = 0) const;
+
+	// The second half, which maps the levels and uploads the tail.
+	StreamedTextureId AddTexture(DecodedTexture&& decoded);
+
+	// The texture's levels are retired, along with its handle, once they have finished uploading and the frames in
+	// flight are done with them.
+	void ReleaseTexture(StreamedTextureId texture);
+
+	// Changes whenever the texture's levels are swapped, which Update reports.
+	BindlessHandle GetHandle(StreamedTextureId texture) const;
+
+	// Has the texture's tail finished uploading, so it can be drawn?
+	bool IsReady(StreamedTextureId texture) const;
+
+	// Ask for the texture to have at least this level resident. Called for every draw of the texture each frame,
+	// and the most detailed request wins.
+	void RequestLevel(StreamedTextureId texture, uint32_t level);
+
+	// Ask for the level a draw needs, as GetRequiredTextureLevel works it out.
+	void RequestTexelDensity(StreamedTextureId texture, float texCoordDensity, float pixelsPerUnit);
+
+	// Called once per frame, before the frame's command buffers are recorded. Swaps in any levels which have finished
+	// uploading, then evicts and streams levels to fit the requests since the last update into the budget. Returns
+	// true if any texture's handle has changed, in which case the command buffers need recording again.
+	bool Update();
+
+	void SetBudget(VkDeviceSize budget) { m_stats.budget = budget; }
+
+	inline VkDeviceSize GetBudget() const { return m_stats.budget; }
+
+	void SetUploadLimit(VkDeviceSize uploadLimit) { m_uploadLimit = uploadLimit; }
+
+	inline VkDeviceSize GetUploadLimit() const { return m_uploadLimit; }
+
+	// Every texture's stats, for tuning the budget.
+	TextureResidencyStats GetResidencyStats(StreamedTextureId texture) const;
+
+	const TextureLoadStats& GetLoadStats(StreamedTextureId texture) const;
+
+	inline const TextureStreamingStats& GetStats() const { return m_stats; }
+
+	// Every texture which is loaded, by id.
+	std::vector<StreamedTextureId> GetTextures() const;
+
+private:
+	// A run of a texture's levels, from the first down to 1 x 1, in an image of their own.
+	struct TextureImage
+	{
+		VkImage image {VK_NULL_HANDLE};
+		Allocation allocation {};
+		VkImageView imageView {VK_NULL_HANDLE};
+		uint32_t firstLevel {0};
+	};
+
+	struct StreamedTexture
+	{
+		std::string path {};
+
+		// The levels are read straight from the mapping while the texture is loaded. If the texture was just cooked,
+		// or the device can't sample its format, they are held in memory instead.
+		TextureFile file {};
+		CookedTexture levels {};
+		TextureView view {};
+
+		VkFormat format {VK_FORMAT_UNDEFINED};
+		TextureLoadStats loadStats {};
+		uint32_t tailLevel {0};
+
+		TextureImage resident {};
+		BindlessHandle handle {kInvalidBindlessHandle};
+		UploadTicket residentTicket {0};
+
+		// New levels on their way to the device.
+		bool isStreaming {false};
+		TextureImage streaming {};
+		UploadTicket streamingTicket {0};
+
+		// The most detailed level asked for since the last update, or the level count if none was.
+		uint32_t pendingRequestLevel {0};
+
+		uint32_t requestedLevel {0};
+		uint32_t targetLevel {0};
+		uint64_t lastUsedFrame {0};
+
+		uint32_t streamInCount {0};
+		uint32_t evictionCount {0};
+	};
+
+	// An image whose texture has been released. It can't be retired until its upload completes.
+	struct OrphanedImage
+	{
+		TextureImage image {};
+		UploadTicket ticket {0};
+		BindlessHandle handle {kInvalidBindlessHandle};
+	};
+
+	StreamedTexture& GetTexture(StreamedTextureId texture);
+
+	const StreamedTexture& GetTexture(StreamedTextureId texture) const;
+
+	// What the levels from the first down take on the device.
+	static VkDeviceSize GetLevelsSize(const StreamedTexture& texture, uint32_t firstLevel);
+
+	// Create an image for the levels from the first down, and record copying them into it.
+	TextureImage UploadLevels(const StreamedTexture& texture, uint32_t firstLevel);
+
+	// Destroy the image, and release the handle, once the frames in flight are done with them.
+	void RetireImage(const TextureImage& image, BindlessHandle handle);
+
+	static void DestroyImage(DeviceContext* pDeviceContext, TextureImage& image);
+
+	std::shared_ptr<DeviceContext> m_pDeviceContext {nullptr};
+
+	// Shared by every texture. It has no level limits, each image only holds the levels it has.
+	VkSampler m_sampler {VK_NULL_HANDLE};
+
+	// Indexed by id. Released textures leave a null behind, which is reused by the next load.
+	std::vector<std::unique_ptr<StreamedTexture>> m_textures {};
+	std::vector<StreamedTextureId> m_freeIds {};
+
+	std::vector<OrphanedImage> m_orphanedImages {};
+
+	// Counts the updates, to tell how recently each texture was drawn.
+	uint64_t m_frameNumber {0};
+
+	VkDeviceSize m_uploadLimit {kDefaultTextureUploadLimit};
+
+	TextureStreamingStats m_stats {kDefaultTextureBudget};
+};
+}
@@ -0,0 +1,68 @@
+#include "UniformRing.h"
+
+// STD.
+#include <algorithm>
+#include <stdexcept>
+
+
+namespace Jettison::Renderer
+{
+static VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+
+void UniformRing::Init(VkDeviceSize frameSize, uint32_t frameCount)
+{
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(m_pDeviceContext->GetPhysicalDevice(), &properties);
+
+	// The spec guarantees the alignment is a power of two.
+	m_alignment = std::max<VkDeviceSize>(properties.limits.minUniformBufferOffsetAlignment, 16);
+	m_frameSize = AlignUp(frameSize, m_alignment);
+	m_frameCount = frameCount;
+
+	m_pDeviceContext->CreateBuffer(m_frameSize * m_frameCount,
+		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		m_buffer, m_bufferAllocation);
+
+	// The allocator keeps host visible memory mapped for the lifetime of the buffer.
+	m_pMapped = static_cast<uint8_t*>(m_bufferAllocation.pMapped);
+	m_frameBegin = 0;
+	m_head = 0;
+}
+
+
+void UniformRing::Destroy()
+{
+	m_pDeviceContext->DestroyBuffer(m_buffer, m_bufferAllocation);
+	m_pMapped = nullptr;
+}
+
+
+void UniformRing::BeginFrame(uint32_t frameIndex)
+{
+	m_frameBegin = m_frameSize * (frameIndex % m_frameCount);
+	m_head = m_frameBegin;
+}
+
+
+UniformAllocation UniformRing::Allocate(VkDeviceSize size)
+{
+	VkDeviceSize alignedSize = AlignUp(size, m_alignment);
+
+	if (m_head + alignedSize > m_frameBegin + m_frameSize)
+	{
+		throw std::runtime_error("uniform ring buffer exhausted for this frame");
+	}
+
+	UniformAllocation allocation;
+	allocation.pData = m_pMapped + m_head;
+	allocation.dynamicOffset = static_cast<uint32_t>(m_head);
+
+	m_head += alignedSize;
+
+	return allocation;
+}
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// STD.
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+#include "DeviceContext.h"
+
+
+namespace Jettison::Renderer
+{
+// A sub-allocation from the uniform ring. The offset is passed as a dynamic offset when binding the descriptor set.
+struct UniformAllocation
+{
+	void* pData {nullptr};
+	uint32_t dynamicOffset {0};
+};
+
+
+// A single persistently mapped, host coherent uniform buffer split into one region per frame in flight. Each frame
+// hands out aligned sub-allocations from its own region, so writing uniforms never needs a map / unmap, or any other
+// driver call.
+//
+// The region is rewound at the start of each frame, so the same sequence of allocations produces the same offsets
+// every frame. Command buffers recorded with those offsets stay valid until the scene changes.
+class UniformRing
+{
+public:
+	UniformRing(std::shared_ptr<DeviceContext> pDeviceContext)
+		:m_pDeviceContext {pDeviceContext} {}
+
+	// Disable copying.
+	UniformRing() = default;
+	UniformRing(const UniformRing&) = delete;
+	UniformRing& operator=(const UniformRing&) = delete;
+
+	void Init(VkDeviceSize frameSize, uint32_t frameCount);
+
+	void Destroy();
+
+	// Rewind to the start of the region owned by the given frame in flight.
+	void BeginFrame(uint32_t frameIndex);
+
+	UniformAllocation Allocate(VkDeviceSize size);
+
+	template <typename T>
+	uint32_t Push(const T& value)
+	{
+		UniformAllocation allocation = Allocate(sizeof(T));
+		memcpy(allocation.pData, &value, sizeof(T));
+
+		return allocation.dynamicOffset;
+	}
+
+	inline VkBuffer GetBuffer() const { return m_buffer; }
+
+	inline VkDeviceSize GetFrameSize() const { return m_frameSize; }
+
+	// Number of bytes handed out so far this frame, including alignment padding.
+	inline VkDeviceSize GetBytesUsed() const { return m_head - m_frameBegin; }
+
+private:
+	// Vulkan device context.
+	std::shared_ptr<DeviceContext> m_pDeviceContext {nullptr};
+
+	VkBuffer m_buffer {VK_NULL_HANDLE};
+	Allocation m_bufferAllocation {};
+	uint8_t* m_pMapped {nullptr};
+
+	VkDeviceSize m_alignment {256};
+	VkDeviceSize m_frameSize {0};
+	uint32_t m_frameCount {0};
+
+	VkDeviceSize m_frameBegin {0};
+	VkDeviceSize m_head {0};
+};
+}
@@ -0,0 +1,396 @@
+#include "UploadManager.h"
+
+#include "DeviceContext.h"
+
+// STD.
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+
+namespace Jettison::Renderer
+{
+void UploadManager::Init()
+{
+	QueueFamilyIndices indices = m_pDeviceContext->FindQueueFamilies(m_pDeviceContext->GetPhysicalDevice());
+	m_graphicsFamily = indices.graphicsFamily.value();
+	m_transferFamily = indices.transferFamily.value();
+
+	// Command buffers only live for a single batch.
+	VkCommandPoolCreateInfo poolInfo {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	poolInfo.queueFamilyIndex = m_transferFamily;
+
+	if (vkCreateCommandPool(m_pDeviceContext->GetLogicalDevice(), &poolInfo, nullptr, &m_transferCommandPool) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create transfer command pool");
+	}
+
+	if (HasDedicatedTransferQueue())
+	{
+		poolInfo.queueFamilyIndex = m_graphicsFamily;
+
+		if (vkCreateCommandPool(m_pDeviceContext->GetLogicalDevice(), &poolInfo, nullptr, &m_graphicsCommandPool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create upload command pool");
+		}
+	}
+}
+
+
+void UploadManager::Destroy()
+{
+	if (m_isRecording)
+	{
+		Submit();
+	}
+
+	Wait(m_nextTicket - 1);
+
+	vkDestroyCommandPool(m_pDeviceContext->GetLogicalDevice(), m_graphicsCommandPool, nullptr);
+	m_graphicsCommandPool = VK_NULL_HANDLE;
+	vkDestroyCommandPool(m_pDeviceContext->GetLogicalDevice(), m_transferCommandPool, nullptr);
+	m_transferCommandPool = VK_NULL_HANDLE;
+}
+
+
+VkCommandBuffer UploadManager::AllocateCommandBuffer(VkCommandPool commandPool)
+{
+	VkCommandBufferAllocateInfo allocInfo {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandPool = commandPool;
+	allocInfo.commandBufferCount = 1;
+
+	VkCommandBuffer commandBuffer;
+	if (vkAllocateCommandBuffers(m_pDeviceContext->GetLogicalDevice(), &allocInfo, &commandBuffer) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to allocate upload command buffer");
+	}
+
+	VkCommandBufferBeginInfo beginInfo {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+	return commandBuffer;
+}
+
+
+void UploadManager::BeginBatch()
+{
+	if (m_isRecording)
+	{
+		return;
+	}
+
+	m_currentBatch = {};
+	m_currentBatch.transferCommandBuffer = AllocateCommandBuffer(m_transferCommandPool);
+	m_isRecording = true;
+}
+
+
+VkCommandBuffer UploadManager::GetGraphicsCommandBuffer()
+{
+	BeginBatch();
+
+	// Without a dedicated transfer queue everything goes through the graphics queue anyway.
+	if (!HasDedicatedTransferQueue())
+	{
+		return m_currentBatch.transferCommandBuffer;
+	}
+
+	if (m_currentBatch.graphicsCommandBuffer == VK_NULL_HANDLE)
+	{
+		m_currentBatch.graphicsCommandBuffer = AllocateCommandBuffer(m_graphicsCommandPool);
+	}
+
+	return m_currentBatch.graphicsCommandBuffer;
+}
+
+
+UploadManager::StagingBuffer UploadManager::CreateStagingBuffer(const void* pData, VkDeviceSize size)
+{
+	StagingBuffer staging;
+	m_pDeviceContext->CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		staging.buffer, staging.allocation);
+
+	memcpy(staging.allocation.pMapped, pData, static_cast<size_t>(size));
+
+	return staging;
+}
+
+
+void UploadManager::UploadBuffer(VkBuffer buffer, const void* pData, VkDeviceSize size, VkDeviceSize offset,
+	VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask)
+{
+	BeginBatch();
+
+	StagingBuffer staging = CreateStagingBuffer(pData, size);
+	m_currentBatch.stagingBuffers.push_back(staging);
+
+	VkBufferCopy copyRegion {};
+	copyRegion.dstOffset = offset;
+	copyRegion.size = size;
+	vkCmdCopyBuffer(m_currentBatch.transferCommandBuffer, staging.buffer, buffer, 1, &copyRegion);
+
+	VkBufferMemoryBarrier barrier {};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.buffer = buffer;
+	barrier.offset = offset;
+	barrier.size = size;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+	if (HasDedicatedTransferQueue())
+	{
+		// Release on the transfer queue...
+		barrier.srcQueueFamilyIndex = m_transferFamily;
+		barrier.dstQueueFamilyIndex = m_graphicsFamily;
+		barrier.dstAccessMask = 0;
+
+		vkCmdPipelineBarrier(m_currentBatch.transferCommandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+			0, nullptr, 1, &barrier, 0, nullptr);
+
+		// ...and acquire on the graphics queue.
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = dstAccessMask;
+
+		vkCmdPipelineBarrier(GetGraphicsCommandBuffer(),
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStageMask, 0,
+			0, nullptr, 1, &barrier, 0, nullptr);
+	}
+	else
+	{
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstAccessMask = dstAccessMask;
+
+		vkCmdPipelineBarrier(m_currentBatch.transferCommandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, dstStageMask, 0,
+			0, nullptr, 1, &barrier, 0, nullptr);
+	}
+}
+
+
+void UploadManager::UploadImage(VkImage image, const void* pPixels, VkDeviceSize size, uint32_t width, uint32_t height, uint32_t mipLevels)
+{
+	VkBufferImageCopy region {};
+	region.bufferOffset = 0;
+	region.bufferRowLength = 0;
+	region.bufferImageHeight = 0;
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = 1;
+	region.imageOffset = {0, 0, 0};
+	region.imageExtent = {width, height, 1};
+
+	UploadImage(image, pPixels, size, {region}, mipLevels);
+}
+
+
+void UploadManager::UploadImage(VkImage image, const void* pData, VkDeviceSize size, const std::vector<VkBufferImageCopy>& regions, uint32_t mipLevels)
+{
+	BeginBatch();
+
+	StagingBuffer staging = CreateStagingBuffer(pData, size);
+	m_currentBatch.stagingBuffers.push_back(staging);
+
+	VkImageMemoryBarrier barrier {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = mipLevels;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(m_currentBatch.transferCommandBuffer,
+		VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+		0, nullptr, 0, nullptr, 1, &barrier);
+
+	vkCmdCopyBufferToImage(m_currentBatch.transferCommandBuffer, staging.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		static_cast<uint32_t>(regions.size()), regions.data());
+
+	if (HasDedicatedTransferQueue())
+	{
+		// Hand the image over to the graphics family, keeping the layout the same.
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.srcQueueFamilyIndex = m_transferFamily;
+		barrier.dstQueueFamilyIndex = m_graphicsFamily;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = 0;
+
+		vkCmdPipelineBarrier(m_currentBatch.transferCommandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+			0, nullptr, 0, nullptr, 1, &barrier);
+
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+
+		vkCmdPipelineBarrier(GetGraphicsCommandBuffer(),
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+			0, nullptr, 0, nullptr, 1, &barrier);
+	}
+}
+
+
+void UploadManager::RecordGraphicsCommands(const std::function<void(VkCommandBuffer)>& record)
+{
+	record(GetGraphicsCommandBuffer());
+}
+
+
+void UploadManager::RetireWithBatch(std::function<void()> destroy)
+{
+	BeginBatch();
+	m_currentBatch.retiredResources.push_back(std::move(destroy));
+}
+
+
+UploadTicket UploadManager::Submit()
+{
+	if (!m_isRecording)
+	{
+		// Nothing new, so this completes along with everything submitted before it.
+		return m_nextTicket - 1;
+	}
+
+	Batch& batch = m_currentBatch;
+	batch.ticket = m_nextTicket++;
+
+	VkFenceCreateInfo fenceInfo {};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+	if (vkCreateFence(m_pDeviceContext->GetLogicalDevice(), &fenceInfo, nullptr, &batch.fence) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create upload fence");
+	}
+
+	vkEndCommandBuffer(batch.transferCommandBuffer);
+
+	VkSubmitInfo submitInfo {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &batch.transferCommandBuffer;
+
+	if (batch.graphicsCommandBuffer == VK_NULL_HANDLE)
+	{
+		if (vkQueueSubmit(m_pDeviceContext->GetTransferQueue(), 1, &submitInfo, batch.fence) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to submit upload batch");
+		}
+	}
+	else
+	{
+		VkSemaphoreCreateInfo semaphoreInfo {};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+		if (vkCreateSemaphore(m_pDeviceContext->GetLogicalDevice(), &semaphoreInfo, nullptr, &batch.transferComplete) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create upload semaphore");
+		}
+
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &batch.transferComplete;
+
+		if (vkQueueSubmit(m_pDeviceContext->GetTransferQueue(), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to submit upload batch");
+		}
+
+		vkEndCommandBuffer(batch.graphicsCommandBuffer);
+
+		// Only this submission waits on the copies, the frames around it carry on regardless.
+		VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+		VkSubmitInfo acquireInfo {};
+		acquireInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		acquireInfo.waitSemaphoreCount = 1;
+		acquireInfo.pWaitSemaphores = &batch.transferComplete;
+		acquireInfo.pWaitDstStageMask = &waitStage;
+		acquireInfo.commandBufferCount = 1;
+		acquireInfo.pCommandBuffers = &batch.graphicsCommandBuffer;
+
+		if (vkQueueSubmit(m_pDeviceContext->GetGraphicsQueue(), 1, &acquireInfo, batch.fence) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to submit upload acquire");
+		}
+	}
+
+	m_pendingBatches.push_back(std::move(batch));
+	m_currentBatch = {};
+	m_isRecording = false;
+
+	return m_pendingBatches.back().ticket;
+}
+
+
+void UploadManager::Update()
+{
+	while (!m_pendingBatches.empty())
+	{
+		Batch& batch = m_pendingBatches.front();
+		if (vkGetFenceStatus(m_pDeviceContext->GetLogicalDevice(), batch.fence) != VK_SUCCESS)
+		{
+			break;
+		}
+
+		m_completedTicket = batch.ticket;
+		ReleaseBatch(batch);
+		m_pendingBatches.pop_front();
+	}
+}
+
+
+void UploadManager::Wait(UploadTicket ticket)
+{
+	while (!m_pendingBatches.empty() && m_pendingBatches.front().ticket <= ticket)
+	{
+		Batch& batch = m_pendingBatches.front();
+		vkWaitForFences(m_pDeviceContext->GetLogicalDevice(), 1, &batch.fence, VK_TRUE, UINT64_MAX);
+
+		m_completedTicket = batch.ticket;
+		ReleaseBatch(batch);
+		m_pendingBatches.pop_front();
+	}
+}
+
+
+void UploadManager::ReleaseBatch(Batch& batch)
+{
+	for (auto& staging : batch.stagingBuffers)
+	{
+		m_pDeviceContext->DestroyBuffer(staging.buffer, staging.allocation);
+	}
+
+	batch.stagingBuffers.clear();
+
+	for (auto& destroy : batch.retiredResources)
+	{
+		destroy();
+	}
+
+	batch.retiredResources.clear();
+
+	vkFreeCommandBuffers(m_pDeviceContext->GetLogicalDevice(), m_transferCommandPool, 1, &batch.transferCommandBuffer);
+
+	if (batch.graphicsCommandBuffer != VK_NULL_HANDLE)
+	{
+		vkFreeCommandBuffers(m_pDeviceContext->GetLogicalDevice(), m_graphicsCommandPool, 1, &batch.graphicsCommandBuffer);
+	}
+
+	vkDestroySemaphore(m_pDeviceContext->GetLogicalDevice(), batch.transferComplete, nullptr);
+	vkDestroyFence(m_pDeviceContext->GetLogicalDevice(), batch.fence, nullptr);
+}
+}
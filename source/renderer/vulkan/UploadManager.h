@@ -0,0 +1,134 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// STD.
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <vector>
+
+#include "MemoryAllocator.h"
+
+
+namespace Jettison::Renderer
+{
+class DeviceContext;
+
+
+// Identifies a submitted batch of uploads. Tickets increase monotonically, and zero is always complete.
+using UploadTicket = uint64_t;
+
+
+// Batches copies from host memory into buffers and images, and submits them on the transfer queue without waiting.
+// When the device has a dedicated transfer queue family the resources are released from it and acquired by the
+// graphics family, so they are ready for use on the graphics queue once their ticket is complete.
+//
+// Only to be used from the thread which owns the device context.
+class UploadManager
+{
+public:
+	// The device context owns the upload manager, so it is held by a plain pointer.
+	UploadManager(DeviceContext* pDeviceContext)
+		:m_pDeviceContext {pDeviceContext} {}
+
+	// Disable copying.
+	UploadManager() = default;
+	UploadManager(const UploadManager&) = delete;
+	UploadManager& operator=(const UploadManager&) = delete;
+
+	void Init();
+
+	void Destroy();
+
+	// Copy data into a buffer. The destination stage and access describe how the graphics queue will use it.
+	void UploadBuffer(VkBuffer buffer, const void* pData, VkDeviceSize size, VkDeviceSize offset,
+		VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask);
+
+	// Copy pixels into the first mip level of an image. Every mip level is left in TRANSFER_DST_OPTIMAL and owned
+	// by the graphics queue family, ready for the graphics commands to finish it off.
+	void UploadImage(VkImage image, const void* pPixels, VkDeviceSize size, uint32_t width, uint32_t height, uint32_t mipLevels);
+
+	// Copy data into any number of an image's mip levels, e.g. a compressed texture with its levels precomputed. The
+	// regions' buffer offsets are from the start of the data. The image is left as above.
+	void UploadImage(VkImage image, const void* pData, VkDeviceSize size, const std::vector<VkBufferImageCopy>& regions, uint32_t mipLevels);
+
+	// Record commands which must run on the graphics queue after this batch's copies, e.g. mip generation or the
+	// final layout transition of an image.
+	void RecordGraphicsCommands(const std::function<void(VkCommandBuffer)>& record);
+
+	// Destroy something once this batch completes, e.g. the descriptor sets its graphics commands bind.
+	void RetireWithBatch(std::function<void()> destroy);
+
+	// Submit everything recorded since the last submit. Returns a ticket which can be polled for completion.
+	UploadTicket Submit();
+
+	// Poll the in flight batches, releasing the staging memory and command buffers of any that have finished.
+	// Intended to be called once per frame.
+	void Update();
+
+	inline bool IsComplete(UploadTicket ticket) const { return ticket <= m_completedTicket; }
+
+	// Block until the ticket completes. Only for start up or tear down, never during a frame.
+	void Wait(UploadTicket ticket);
+
+	inline bool HasDedicatedTransferQueue() const { return m_transferFamily != m_graphicsFamily; }
+
+private:
+	struct StagingBuffer
+	{
+		VkBuffer buffer {VK_NULL_HANDLE};
+		Allocation allocation {};
+	};
+
+	struct Batch
+	{
+		UploadTicket ticket {0};
+
+		VkCommandBuffer transferCommandBuffer {VK_NULL_HANDLE};
+
+		// Acquires ownership and runs any graphics work. Only used when there is a dedicated transfer queue.
+		VkCommandBuffer graphicsCommandBuffer {VK_NULL_HANDLE};
+
+		// Orders the graphics submission after the transfer submission.
+		VkSemaphore transferComplete {VK_NULL_HANDLE};
+
+		// Signalled when the last submission in the batch has completed.
+		VkFence fence {VK_NULL_HANDLE};
+
+		std::vector<StagingBuffer> stagingBuffers {};
+
+		std::vector<std::function<void()>> retiredResources {};
+	};
+
+	void BeginBatch();
+
+	// The command buffer for work which needs a graphics capable queue.
+	VkCommandBuffer GetGraphicsCommandBuffer();
+
+	StagingBuffer CreateStagingBuffer(const void* pData, VkDeviceSize size);
+
+	void ReleaseBatch(Batch& batch);
+
+	VkCommandBuffer AllocateCommandBuffer(VkCommandPool commandPool);
+
+	// Not owned.
+	DeviceContext* m_pDeviceContext {nullptr};
+
+	uint32_t m_graphicsFamily {0};
+	uint32_t m_transferFamily {0};
+
+	VkCommandPool m_transferCommandPool {VK_NULL_HANDLE};
+	VkCommandPool m_graphicsCommandPool {VK_NULL_HANDLE};
+
+	// The batch being recorded, if any.
+	bool m_isRecording {false};
+	Batch m_currentBatch {};
+
+	// Submitted batches, oldest first.
+	std::deque<Batch> m_pendingBatches {};
+
+	UploadTicket m_nextTicket {1};
+	UploadTicket m_completedTicket {0};
+};
+}
@@ -0,0 +1,483 @@
+#include "VertexLayout.h"
+
+// GL Math.
+#include <../glm/glm/gtc/packing.hpp>
+
+// STD.
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "Pipeline.h"
+
+
+namespace Jettison::Renderer
+{
+// Where each attribute starts within a vertex. Attributes a layout drops take no space.
+struct AttributeOffsets
+{
+	uint32_t position {0};
+	uint32_t colour {0};
+	uint32_t texCoord {0};
+	uint32_t normal {0};
+	uint32_t stride {0};
+};
+
+
+static uint32_t GetPositionSize(PositionFormat format)
+{
+	return format == PositionFormat::Float32 ? 3 * sizeof(float) : 4 * sizeof(uint16_t);
+}
+
+
+static uint32_t GetColourSize(ColourFormat format)
+{
+	switch (format)
+	{
+		case ColourFormat::None:
+			return 0;
+
+		case ColourFormat::Float32:
+			return 3 * sizeof(float);
+
+		case ColourFormat::Unorm8:
+			return 4 * sizeof(uint8_t);
+	}
+
+	return 0;
+}
+
+
+static uint32_t GetTexCoordSize(TexCoordFormat format)
+{
+	return format == TexCoordFormat::Float32 ? 2 * sizeof(float) : 2 * sizeof(uint16_t);
+}
+
+
+static uint32_t GetNormalSize(NormalFormat format)
+{
+	return format == NormalFormat::None ? 0 : 2 * sizeof(int16_t);
+}
+
+
+// The float layout comes out the same as the old fixed vertex: position, colour, then texture coordinates.
+static AttributeOffsets GetAttributeOffsets(const VertexLayout& layout)
+{
+	AttributeOffsets offsets;
+	offsets.position = 0;
+	offsets.colour = offsets.position + GetPositionSize(layout.position);
+	offsets.texCoord = offsets.colour + GetColourSize(layout.colour);
+	offsets.normal = offsets.texCoord + GetTexCoordSize(layout.texCoord);
+	offsets.stride = offsets.normal + GetNormalSize(layout.normal);
+
+	return offsets;
+}
+
+
+uint32_t VertexLayout::GetStride() const
+{
+	return GetAttributeOffsets(*this).stride;
+}
+
+
+VkVertexInputBindingDescription VertexLayout::GetBindingDescription() const
+{
+	VkVertexInputBindingDescription bindingDescription {};
+	bindingDescription.binding = 0;
+	bindingDescription.stride = GetStride();
+	bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+	return bindingDescription;
+}
+
+
+std::vector<VkVertexInputAttributeDescription> VertexLayout::GetAttributeDescriptions() const
+{
+	AttributeOffsets offsets = GetAttributeOffsets(*this);
+	std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+
+	VkVertexInputAttributeDescription positionDescription {};
+	positionDescription.binding = 0;
+	positionDescription.location = kPositionLocation;
+	positionDescription.offset = offsets.position;
+	switch (position)
+	{
+		case PositionFormat::Float32:
+			positionDescription.format = VK_FORMAT_R32G32B32_SFLOAT;
+			break;
+
+		case PositionFormat::Float16:
+			positionDescription.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+			break;
+
+		case PositionFormat::Snorm16:
+			positionDescription.format = VK_FORMAT_R16G16B16A16_SNORM;
+			break;
+	}
+	attributeDescriptions.push_back(positionDescription);
+
+	if (colour != ColourFormat::None)
+	{
+		VkVertexInputAttributeDescription colourDescription {};
+		colourDescription.binding = 0;
+		colourDescription.location = kColourLocation;
+		colourDescription.format = colour == ColourFormat::Float32 ? VK_FORMAT_R32G32B32_SFLOAT : VK_FORMAT_R8G8B8A8_UNORM;
+		colourDescription.offset = offsets.colour;
+		attributeDescriptions.push_back(colourDescription);
+	}
+
+	VkVertexInputAttributeDescription texCoordDescription {};
+	texCoordDescription.binding = 0;
+	texCoordDescription.location = kTexCoordLocation;
+	texCoordDescription.format = texCoord == TexCoordFormat::Float32 ? VK_FORMAT_R32G32_SFLOAT : VK_FORMAT_R16G16_UNORM;
+	texCoordDescription.offset = offsets.texCoord;
+	attributeDescriptions.push_back(texCoordDescription);
+
+	if (normal != NormalFormat::None)
+	{
+		VkVertexInputAttributeDescription normalDescription {};
+		normalDescription.binding = 0;
+		normalDescription.location = kNormalLocation;
+		normalDescription.format = VK_FORMAT_R16G16_SNORM;
+		normalDescription.offset = offsets.normal;
+		attributeDescriptions.push_back(normalDescription);
+	}
+
+	return attributeDescriptions;
+}
+
+
+std::string VertexLayout::GetVertexShaderName(const std::string& baseName) const
+{
+	std::string name = baseName;
+
+	if (colour == ColourFormat::None)
+	{
+		name += "_nocolour";
+	}
+
+	if (normal != NormalFormat::None)
+	{
+		name += "_normal";
+	}
+
+	return name;
+}
+
+
+VertexLayout GetVertexLayout(VertexLayoutPreset preset)
+{
+	VertexLayout layout;
+
+	switch (preset)
+	{
+		case VertexLayoutPreset::Float:
+			break;
+
+		case VertexLayoutPreset::Half:
+			layout.position = PositionFormat::Float16;
+			layout.colour = ColourFormat::None;
+			break;
+
+		case VertexLayoutPreset::Compact:
+			layout.position = PositionFormat::Snorm16;
+			layout.colour = ColourFormat::None;
+			layout.texCoord = TexCoordFormat::Unorm16;
+			break;
+
+		case VertexLayoutPreset::CompactLit:
+			layout.position = PositionFormat::Snorm16;
+			layout.colour = ColourFormat::None;
+			layout.texCoord = TexCoordFormat::Unorm16;
+			layout.normal = NormalFormat::Octahedral16;
+			break;
+	}
+
+	return layout;
+}
+
+
+const char* GetVertexLayoutPresetName(VertexLayoutPreset preset)
+{
+	switch (preset)
+	{
+		case VertexLayoutPreset::Float:
+			return "float";
+
+		case VertexLayoutPreset::Half:
+			return "half";
+
+		case VertexLayoutPreset::Compact:
+			return "compact";
+
+		case VertexLayoutPreset::CompactLit:
+			return "compact-lit";
+	}
+
+	return "unknown";
+}
+
+
+VertexLayoutPreset ParseVertexLayoutPreset(const std::string& name)
+{
+	for (VertexLayoutPreset preset : {VertexLayoutPreset::Float, VertexLayoutPreset::Half, VertexLayoutPreset::Compact,
+		VertexLayoutPreset::CompactLit})
+	{
+		if (name == GetVertexLayoutPresetName(preset))
+		{
+			return preset;
+		}
+	}
+
+	throw std::runtime_error("unknown vertex layout " + name);
+}
+
+
+glm::vec2 EncodeOctahedral(const glm::vec3& normal)
+{
+	float length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+	if (length == 0.0f)
+	{
+		return glm::vec2(0.0f);
+	}
+
+	glm::vec3 octahedron = normal / length;
+	if (octahedron.z >= 0.0f)
+	{
+		return glm::vec2(octahedron.x, octahedron.y);
+	}
+
+	// The lower half is folded over the diagonals onto the corners.
+	return glm::vec2((1.0f - std::abs(octahedron.y)) * (octahedron.x >= 0.0f ? 1.0f : -1.0f),
+		(1.0f - std::abs(octahedron.x)) * (octahedron.y >= 0.0f ? 1.0f : -1.0f));
+}
+
+
+glm::vec3 DecodeOctahedral(const glm::vec2& encoded)
+{
+	// Matches the vertex shaders.
+	glm::vec3 normal(encoded.x, encoded.y, 1.0f - std::abs(encoded.x) - std::abs(encoded.y));
+	float fold = std::max(-normal.z, 0.0f);
+	normal.x += normal.x >= 0.0f ? -fold : fold;
+	normal.y += normal.y >= 0.0f ? -fold : fold;
+
+	return glm::normalize(normal);
+}
+
+
+static void Write(std::vector<uint8_t>& data, size_t offset, const void* pValue, size_t size)
+{
+	std::memcpy(data.data() + offset, pValue, size);
+}
+
+
+PackedVertices PackVertices(const std::vector<Vertex>& vertices, const VertexLayout& layout)
+{
+	AttributeOffsets offsets = GetAttributeOffsets(layout);
+
+	PackedVertices packed;
+	packed.layout = layout;
+	packed.vertexCount = static_cast<uint32_t>(vertices.size());
+	packed.data.resize(static_cast<size_t>(offsets.stride) * vertices.size());
+
+	if (vertices.empty())
+	{
+		return packed;
+	}
+
+	glm::vec3 positionMinimum = vertices[0].pos;
+	glm::vec3 positionMaximum = vertices[0].pos;
+	glm::vec2 texCoordMinimum = vertices[0].texCoord;
+	glm::vec2 texCoordMaximum = vertices[0].texCoord;
+	for (const auto& vertex : vertices)
+	{
+		positionMinimum = glm::min(positionMinimum, vertex.pos);
+		positionMaximum = glm::max(positionMaximum, vertex.pos);
+		texCoordMinimum = glm::min(texCoordMinimum, vertex.texCoord);
+		texCoordMaximum = glm::max(texCoordMaximum, vertex.texCoord);
+	}
+
+	// A flat mesh has no extent along one axis, which would otherwise divide by zero.
+	glm::vec3 centre = (positionMinimum + positionMaximum) * 0.5f;
+	glm::vec3 halfExtent = (positionMaximum - positionMinimum) * 0.5f;
+	halfExtent = glm::vec3(halfExtent.x > 0.0f ? halfExtent.x : 1.0f, halfExtent.y > 0.0f ? halfExtent.y : 1.0f,
+		halfExtent.z > 0.0f ? halfExtent.z : 1.0f);
+
+	glm::vec2 texCoordRange = texCoordMaximum - texCoordMinimum;
+	texCoordRange = glm::vec2(texCoordRange.x > 0.0f ? texCoordRange.x : 1.0f, texCoordRange.y > 0.0f ? texCoordRange.y : 1.0f);
+
+	VertexDequantisation& dequantisation = packed.dequantisation;
+	if (layout.position == PositionFormat::Float16)
+	{
+		dequantisation.positionOffset = glm::vec4(centre, 0.0f);
+	}
+	else if (layout.position == PositionFormat::Snorm16)
+	{
+		dequantisation.positionScale = glm::vec4(halfExtent, 1.0f);
+		dequantisation.positionOffset = glm::vec4(centre, 0.0f);
+	}
+
+	if (layout.texCoord == TexCoordFormat::Unorm16)
+	{
+		dequantisation.texCoordTransform = glm::vec4(texCoordRange, texCoordMinimum);
+	}
+
+	glm::vec3 positionScale = glm::vec3(dequantisation.positionScale);
+	glm::vec3 positionOffset = glm::vec3(dequantisation.positionOffset);
+
+	for (size_t i = 0; i < vertices.size(); ++i)
+	{
+		const Vertex& vertex = vertices[i];
+		size_t base = i * offsets.stride;
+
+		glm::vec3 position = (vertex.pos - positionOffset) / positionScale;
+		switch (layout.position)
+		{
+			case PositionFormat::Float32:
+				Write(packed.data, base + offsets.position, &vertex.pos, 3 * sizeof(float));
+				break;
+
+			case PositionFormat::Float16:
+			{
+				uint16_t halves[4] = {glm::packHalf1x16(position.x), glm::packHalf1x16(position.y), glm::packHalf1x16(position.z),
+					glm::packHalf1x16(1.0f)};
+				Write(packed.data, base + offsets.position, halves, sizeof(halves));
+				break;
+			}
+
+			case PositionFormat::Snorm16:
+			{
+				uint16_t snorms[4] = {glm::packSnorm1x16(position.x), glm::packSnorm1x16(position.y), glm::packSnorm1x16(position.z),
+					glm::packSnorm1x16(1.0f)};
+				Write(packed.data, base + offsets.position, snorms, sizeof(snorms));
+				break;
+			}
+		}
+
+		switch (layout.colour)
+		{
+			case ColourFormat::None:
+				break;
+
+			case ColourFormat::Float32:
+				Write(packed.data, base + offsets.colour, &vertex.color, 3 * sizeof(float));
+				break;
+
+			case ColourFormat::Unorm8:
+			{
+				glm::vec3 colour = glm::clamp(vertex.color, 0.0f, 1.0f) * 255.0f + 0.5f;
+				uint8_t bytes[4] = {static_cast<uint8_t>(colour.r), static_cast<uint8_t>(colour.g), static_cast<uint8_t>(colour.b), 255};
+				Write(packed.data, base + offsets.colour, bytes, sizeof(bytes));
+				break;
+			}
+		}
+
+		if (layout.texCoord == TexCoordFormat::Float32)
+		{
+			Write(packed.data, base + offsets.texCoord, &vertex.texCoord, 2 * sizeof(float));
+		}
+		else
+		{
+			glm::vec2 texCoord = (vertex.texCoord - texCoordMinimum) / texCoordRange;
+			uint16_t unorms[2] = {glm::packUnorm1x16(texCoord.x), glm::packUnorm1x16(texCoord.y)};
+			Write(packed.data, base + offsets.texCoord, unorms, sizeof(unorms));
+		}
+
+		if (layout.normal == NormalFormat::Octahedral16)
+		{
+			glm::vec2 encoded = EncodeOctahedral(vertex.normal);
+			uint16_t snorms[2] = {glm::packSnorm1x16(encoded.x), glm::packSnorm1x16(encoded.y)};
+			Write(packed.data, base + offsets.normal, snorms, sizeof(snorms));
+		}
+	}
+
+	return packed;
+}
+
+
+static void Read(const std::vector<uint8_t>& data, size_t offset, void* pValue, size_t size)
+{
+	std::memcpy(pValue, data.data() + offset, size);
+}
+
+
+Vertex UnpackVertex(const PackedVertices& packed, uint32_t index)
+{
+	if (index >= packed.vertexCount)
+	{
+		throw std::runtime_error("packed vertex index out of range");
+	}
+
+	const VertexLayout& layout = packed.layout;
+	const VertexDequantisation& dequantisation = packed.dequantisation;
+	AttributeOffsets offsets = GetAttributeOffsets(layout);
+	size_t base = static_cast<size_t>(index) * offsets.stride;
+
+	Vertex vertex {};
+
+	glm::vec3 position {0.0f};
+	switch (layout.position)
+	{
+		case PositionFormat::Float32:
+			Read(packed.data, base + offsets.position, &position, 3 * sizeof(float));
+			break;
+
+		case PositionFormat::Float16:
+		{
+			uint16_t halves[4];
+			Read(packed.data, base + offsets.position, halves, sizeof(halves));
+			position = glm::vec3(glm::unpackHalf1x16(halves[0]), glm::unpackHalf1x16(halves[1]), glm::unpackHalf1x16(halves[2]));
+			break;
+		}
+
+		case PositionFormat::Snorm16:
+		{
+			uint16_t snorms[4];
+			Read(packed.data, base + offsets.position, snorms, sizeof(snorms));
+			position = glm::vec3(glm::unpackSnorm1x16(snorms[0]), glm::unpackSnorm1x16(snorms[1]), glm::unpackSnorm1x16(snorms[2]));
+			break;
+		}
+	}
+	vertex.pos = position * glm::vec3(dequantisation.positionScale) + glm::vec3(dequantisation.positionOffset);
+
+	switch (layout.colour)
+	{
+		case ColourFormat::None:
+			vertex.color = glm::vec3(1.0f);
+			break;
+
+		case ColourFormat::Float32:
+			Read(packed.data, base + offsets.colour, &vertex.color, 3 * sizeof(float));
+			break;
+
+		case ColourFormat::Unorm8:
+		{
+			uint8_t bytes[4];
+			Read(packed.data, base + offsets.colour, bytes, sizeof(bytes));
+			vertex.color = glm::vec3(bytes[0], bytes[1], bytes[2]) / 255.0f;
+			break;
+		}
+	}
+
+	if (layout.texCoord == TexCoordFormat::Float32)
+	{
+		Read(packed.data, base + offsets.texCoord, &vertex.texCoord, 2 * sizeof(float));
+	}
+	else
+	{
+		uint16_t unorms[2];
+		Read(packed.data, base + offsets.texCoord, unorms, sizeof(unorms));
+		glm::vec2 texCoord(glm::unpackUnorm1x16(unorms[0]), glm::unpackUnorm1x16(unorms[1]));
+		vertex.texCoord = texCoord * glm::vec2(dequantisation.texCoordTransform) + glm::vec2(dequantisation.texCoordTransform.z, dequantisation.texCoordTransform.w);
+	}
+
+	if (layout.normal == NormalFormat::Octahedral16)
+	{
+		uint16_t snorms[2];
+		Read(packed.data, base + offsets.normal, snorms, sizeof(snorms));
+		vertex.normal = DecodeOctahedral(glm::vec2(glm::unpackSnorm1x16(snorms[0]), glm::unpackSnorm1x16(snorms[1])));
+	}
+
+	return vertex;
+}
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// GL Math.
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#define GLM_ENABLE_EXPERIMENTAL
+#include <../glm/glm/glm.hpp>
+
+// STD.
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+namespace Jettison::Renderer
+{
+// Defined in Pipeline.h, which includes this for the models' vertex layouts.
+struct Vertex;
+
+
+// Shader input locations. The instance attributes follow on from these.
+constexpr uint32_t kPositionLocation = 0;
+constexpr uint32_t kColourLocation = 1;
+constexpr uint32_t kTexCoordLocation = 2;
+constexpr uint32_t kNormalLocation = 3;
+constexpr uint32_t kVertexLocationCount = 4;
+
+
+// The 16 bit formats all have four components, even where only three are used. Three component 16 bit vertex formats
+// aren't guaranteed to be supported, four are.
+enum class PositionFormat
+{
+	Float32,
+
+	// Relative to the centre of the mesh, so the precision is spent where the vertices are.
+	Float16,
+
+	// Scaled to the mesh's bounding box.
+	Snorm16,
+};
+
+
+enum class ColourFormat
+{
+	None,
+	Float32,
+	Unorm8,
+};
+
+
+enum class TexCoordFormat
+{
+	Float32,
+
+	// Scaled to the range of the mesh's texture coordinates, so tiling coordinates outside zero to one survive.
+	Unorm16,
+};
+
+
+enum class NormalFormat
+{
+	None,
+
+	// The unit sphere folded onto an octahedron and flattened to a square, two components.
+	Octahedral16,
+};
+
+
+// How the vertices of a mesh are packed into its vertex buffer. The attribute descriptions, the stride and which
+// vertex shader variant draws it all follow from this.
+struct VertexLayout
+{
+	PositionFormat position {PositionFormat::Float32};
+	ColourFormat colour {ColourFormat::Float32};
+	TexCoordFormat texCoord {TexCoordFormat::Float32};
+	NormalFormat normal {NormalFormat::None};
+
+	uint32_t GetStride() const;
+
+	// Binding zero, stepped per vertex.
+	VkVertexInputBindingDescription GetBindingDescription() const;
+
+	std::vector<VkVertexInputAttributeDescription> GetAttributeDescriptions() const;
+
+	// The name of the SPIR-V for this layout's variant of a vertex shader, e.g. "shader" gives "shader_nocolour". The
+	// variants are compiled with HAS_COLOUR and HAS_NORMAL defined to match. The formats don't need variants of their
+	// own, since the vertex input converts them to floats and the draw constants undo the scaling.
+	std::string GetVertexShaderName(const std::string& baseName) const;
+
+	bool operator==(const VertexLayout& other) const
+	{
+		return position == other.position && colour == other.colour && texCoord == other.texCoord && normal == other.normal;
+	}
+
+	bool operator!=(const VertexLayout& other) const { return !(*this == other); }
+};
+
+
+// The layouts which can be picked by name.
+enum class VertexLayoutPreset
+{
+	// All floats, 32 bytes a vertex. What every mesh used before layouts could be chosen.
+	Float,
+
+	// Half positions and no colour, 16 bytes.
+	Half,
+
+	// Snorm positions, unorm texture coordinates and no colour, 12 bytes.
+	Compact,
+
+	// Compact, with octahedral normals for lighting, 16 bytes.
+	CompactLit,
+};
+
+
+VertexLayout GetVertexLayout(VertexLayoutPreset preset);
+
+const char* GetVertexLayoutPresetName(VertexLayoutPreset preset);
+
+// Accepts the names returned by GetVertexLayoutPresetName.
+VertexLayoutPreset ParseVertexLayoutPreset(const std::string& name);
+
+
+// Undoes the per mesh scaling of the packed attributes, pushed with each draw. Identity for the float formats.
+struct VertexDequantisation
+{
+	// Position in the mesh's own space is packed * scale + offset. W is unused.
+	glm::vec4 positionScale {1.0f};
+	glm::vec4 positionOffset {0.0f};
+
+	// Scale in xy, offset in zw.
+	glm::vec4 texCoordTransform {1.0f, 1.0f, 0.0f, 0.0f};
+};
+
+
+struct PackedVertices
+{
+	VertexLayout layout {};
+	VertexDequantisation dequantisation {};
+
+	uint32_t vertexCount {0};
+
+	// The stride times the vertex count, ready to copy into a vertex buffer.
+	std::vector<uint8_t> data {};
+};
+
+
+PackedVertices PackVertices(const std::vector<Vertex>& vertices, const VertexLayout& layout);
+
+// What the vertex input and shader will make of a packed vertex, for checking the precision lost to a layout. Dropped
+// attributes come back as the shader's defaults, white and a zero normal.
+Vertex UnpackVertex(const PackedVertices& packed, uint32_t index);
+
+// Octahedral normal encoding, both ways. The encoded value is in -1 to 1.
+glm::vec2 EncodeOctahedral(const glm::vec3& normal);
+glm::vec3 DecodeOctahedral(const glm::vec2& encoded);
+}
@@ -1,5 +1,19 @@
 #!/bin/sh
-glslc shader.vert -o shader.vert.spv
+glslc -DHAS_COLOUR shader.vert -o shader.vert.spv
+glslc shader.vert -o shader_nocolour.vert.spv
+glslc -DHAS_COLOUR -DHAS_NORMAL shader.vert -o shader_normal.vert.spv
+glslc -DHAS_NORMAL shader.vert -o shader_nocolour_normal.vert.spv
 glslc shader.frag -o shader.frag.spv
+glslc indirect.vert -o indirect.vert.spv
+glslc indirect.frag -o indirect.frag.spv
+glslc -DHAS_COLOUR instanced.vert -o instanced.vert.spv
+glslc instanced.vert -o instanced_nocolour.vert.spv
+glslc -DHAS_COLOUR -DHAS_NORMAL instanced.vert -o instanced_normal.vert.spv
+glslc -DHAS_NORMAL instanced.vert -o instanced_nocolour_normal.vert.spv
+glslc downsample.comp -o downsample.comp.spv
+glslc -DHDR downsample.comp -o downsample_hdr.comp.spv
+glslc -DDEPTH downsample.comp -o downsample_depth.comp.spv
+glslc -DDEPTH -DMULTISAMPLED downsample.comp -o downsample_depth_ms.comp.spv
+glslc cull.comp -o cull.comp.spv
 glslc imgui.vert -o imgui.vert.spv
 glslc imgui.frag -o imgui.frag.spv
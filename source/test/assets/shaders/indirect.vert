@@ -0,0 +1,48 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(binding = 0) uniform UniformBufferObject
+{
+	mat4 model;
+	mat4 view;
+	mat4 proj;
+} ubo;
+
+struct DrawData
+{
+	mat4 model;
+	vec4 boundingSphere;
+	uint textureIndex;
+};
+
+// The bindless tables, shared by every pipeline.
+layout(std430, set = 1, binding = 1) readonly buffer DrawDataBuffer
+{
+	DrawData draws[];
+} drawDataBuffers[];
+
+layout(push_constant) uniform DrawConstants
+{
+	uint textureIndex;
+	uint drawDataIndex;
+} drawConstants;
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inColor;
+layout(location = 2) in vec2 inTexCoord;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) flat out uint fragTextureIndex;
+
+void main()
+{
+	// Each indirect draw's first instance is its index into the draw data.
+	DrawData draw = drawDataBuffers[drawConstants.drawDataIndex].draws[gl_InstanceIndex];
+
+	gl_Position = ubo.proj * ubo.view * draw.model * vec4(inPosition, 1.0);
+	fragColor = inColor;
+	fragTexCoord = inTexCoord;
+	fragTextureIndex = draw.textureIndex;
+}
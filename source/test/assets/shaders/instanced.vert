@@ -0,0 +1,67 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Compiled once for each combination of HAS_COLOUR and HAS_NORMAL, to match the vertex layouts.
+
+layout(binding = 0) uniform UniformBufferObject
+{
+	mat4 model;
+	mat4 view;
+	mat4 proj;
+} ubo;
+
+// Undoes the model's vertex packing. Identity for the float layout.
+layout(push_constant) uniform DrawConstants
+{
+	uint textureIndex;
+	uint drawDataIndex;
+	vec4 positionScale;
+	vec4 positionOffset;
+	vec4 texCoordTransform;
+} drawConstants;
+
+layout(location = 0) in vec3 inPosition;
+#ifdef HAS_COLOUR
+layout(location = 1) in vec3 inColor;
+#endif
+layout(location = 2) in vec2 inTexCoord;
+#ifdef HAS_NORMAL
+layout(location = 3) in vec2 inNormal;
+#endif
+
+// Stepped once per instance, the top three rows of its transform.
+layout(location = 4) in vec4 inInstanceRow0;
+layout(location = 5) in vec4 inInstanceRow1;
+layout(location = 6) in vec4 inInstanceRow2;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+#ifdef HAS_NORMAL
+layout(location = 2) out vec3 fragNormal;
+
+vec3 DecodeOctahedral(vec2 encoded)
+{
+	vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+	float fold = max(-normal.z, 0.0);
+	normal.xy += mix(vec2(fold), vec2(-fold), greaterThanEqual(normal.xy, vec2(0.0)));
+	return normalize(normal);
+}
+#endif
+
+void main()
+{
+	vec4 position = vec4(inPosition * drawConstants.positionScale.xyz + drawConstants.positionOffset.xyz, 1.0);
+	vec4 worldPosition = vec4(dot(inInstanceRow0, position), dot(inInstanceRow1, position), dot(inInstanceRow2, position), 1.0);
+
+	gl_Position = ubo.proj * ubo.view * worldPosition;
+#ifdef HAS_COLOUR
+	fragColor = inColor;
+#else
+	fragColor = vec3(1.0);
+#endif
+	fragTexCoord = inTexCoord * drawConstants.texCoordTransform.xy + drawConstants.texCoordTransform.zw;
+#ifdef HAS_NORMAL
+	// Fine while the instances are only rotated and uniformly scaled.
+	fragNormal = transpose(mat3(inInstanceRow0.xyz, inInstanceRow1.xyz, inInstanceRow2.xyz)) * DecodeOctahedral(inNormal);
+#endif
+}
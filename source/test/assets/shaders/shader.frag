@@ -1,7 +1,15 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
+#extension GL_EXT_nonuniform_qualifier : require
 
-layout(binding = 1) uniform sampler2D texSampler;
+// The bindless tables, shared by every pipeline.
+layout(set = 1, binding = 0) uniform sampler2D textures[];
+
+layout(push_constant) uniform DrawConstants
+{
+	uint textureIndex;
+	uint drawDataIndex;
+} drawConstants;
 
 layout(location = 0) in vec3 fragColor;
 layout(location = 1) in vec2 fragTexCoord;
@@ -10,5 +18,5 @@ layout(location = 0) out vec4 outColor;
 
 void main()
 {
-	outColor = texture(texSampler, fragTexCoord);
+	outColor = texture(textures[nonuniformEXT(drawConstants.textureIndex)], fragTexCoord);
 }
\ No newline at end of file
@@ -1,6 +1,8 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
+// Compiled once for each combination of HAS_COLOUR and HAS_NORMAL, to match the vertex layouts.
+
 layout(binding = 0) uniform UniformBufferObject
 {
     mat4 model;
@@ -8,16 +10,51 @@ layout(binding = 0) uniform UniformBufferObject
     mat4 proj;
 } ubo;
 
+// Undoes the model's vertex packing. Identity for the float layout.
+layout(push_constant) uniform DrawConstants
+{
+    uint textureIndex;
+    uint drawDataIndex;
+    vec4 positionScale;
+    vec4 positionOffset;
+    vec4 texCoordTransform;
+} drawConstants;
+
 layout(location = 0) in vec3 inPosition;
+#ifdef HAS_COLOUR
 layout(location = 1) in vec3 inColor;
+#endif
 layout(location = 2) in vec2 inTexCoord;
+#ifdef HAS_NORMAL
+layout(location = 3) in vec2 inNormal;
+#endif
 
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
+#ifdef HAS_NORMAL
+layout(location = 2) out vec3 fragNormal;
+
+vec3 DecodeOctahedral(vec2 encoded)
+{
+    vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float fold = max(-normal.z, 0.0);
+    normal.xy += mix(vec2(fold), vec2(-fold), greaterThanEqual(normal.xy, vec2(0.0)));
+    return normalize(normal);
+}
+#endif
 
 void main()
 {
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
+    vec3 position = inPosition * drawConstants.positionScale.xyz + drawConstants.positionOffset.xyz;
+
+    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(position, 1.0);
+#ifdef HAS_COLOUR
     fragColor = inColor;
-    fragTexCoord = inTexCoord;
-}
\ No newline at end of file
+#else
+    fragColor = vec3(1.0);
+#endif
+    fragTexCoord = inTexCoord * drawConstants.texCoordTransform.xy + drawConstants.texCoordTransform.zw;
+#ifdef HAS_NORMAL
+    fragNormal = mat3(ubo.model) * DecodeOctahedral(inNormal);
+#endif
+}
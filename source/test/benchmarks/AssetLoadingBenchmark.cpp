@@ -0,0 +1,185 @@
+#include "Benchmarks.h"
+
+#include <vulkan/AssetManager.h>
+#include <vulkan/MeshCache.h>
+#include <vulkan/PngWriter.h>
+
+// STD.
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+namespace Jettison::Benchmarks
+{
+// Each model has a material of its own, with one texture, so there are three assets to each.
+constexpr uint32_t kAssetModelCount = 100;
+
+// Small enough that hundreds of them load in seconds, even cooked on one core.
+constexpr uint32_t kAssetGridSize = 24;
+constexpr uint32_t kAssetTextureSize = 128;
+
+// BC1 cooks far faster than the default BC7, and the cooking isn't what's being measured.
+const Renderer::TextureCookSettings kAssetTextureSettings {Renderer::TextureFormat::Bc1, true, false};
+
+
+struct AssetFiles
+{
+	std::vector<std::string> modelPaths;
+	std::vector<std::string> texturePaths;
+};
+
+
+// A distinct pattern for each texture, so none of them could be mistaken for another.
+static void WriteTexture(const std::string& path, uint32_t seed)
+{
+	std::vector<uint8_t> pixels(4 * kAssetTextureSize * kAssetTextureSize);
+	for (uint32_t y = 0; y < kAssetTextureSize; ++y)
+	{
+		for (uint32_t x = 0; x < kAssetTextureSize; ++x)
+		{
+			uint8_t* pPixel = &pixels[4 * (y * kAssetTextureSize + x)];
+			pPixel[0] = static_cast<uint8_t>(x * 2 + seed);
+			pPixel[1] = static_cast<uint8_t>(y * 2 + seed * 3);
+			pPixel[2] = static_cast<uint8_t>((x ^ y) + seed * 7);
+			pPixel[3] = 255;
+		}
+	}
+
+	Renderer::WritePng(path, kAssetTextureSize, kAssetTextureSize, pixels.data());
+}
+
+
+// Load every model and material, drawing frames until they are all ready. Returns the frame times.
+static std::vector<double> LoadAll(const BenchmarkContext& context, Renderer::AssetManager& assetManager, const AssetFiles& files,
+	std::vector<Renderer::AssetHandle>& assets)
+{
+	const Renderer::VertexLayout& layout = context.pModel->GetVertexLayout();
+
+	for (uint32_t i = 0; i < kAssetModelCount; ++i)
+	{
+		assets.push_back(assetManager.LoadModel(files.modelPaths[i], layout));
+		assets.push_back(assetManager.LoadMaterial({files.texturePaths[i], kAssetTextureSettings}));
+	}
+
+	// The renderer only updates the pipeline's asset manager, so this one is updated here, at the same point.
+	std::vector<double> frameTimes;
+	while (true)
+	{
+		auto startTime = std::chrono::high_resolution_clock::now();
+		assetManager.Update();
+		context.pRenderer->DrawFrame();
+		frameTimes.push_back(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count());
+
+		const Renderer::AssetStats& stats = assetManager.GetStats();
+		if (stats.failedCount > 0)
+		{
+			for (Renderer::AssetHandle asset : assets)
+			{
+				if (assetManager.GetState(asset) == Renderer::AssetState::Failed)
+				{
+					throw std::runtime_error(assetManager.GetError(asset));
+				}
+			}
+		}
+
+		if (stats.decodingCount == 0 && stats.decodedCount == 0)
+		{
+			return frameTimes;
+		}
+	}
+}
+
+
+void RunAssetLoadingBenchmark(const BenchmarkContext& context)
+{
+	AssetFiles files;
+	std::filesystem::path directory = std::filesystem::temp_directory_path() / "jettison_asset_loading_benchmark";
+	std::filesystem::create_directories(directory);
+
+	for (uint32_t i = 0; i < kAssetModelCount; ++i)
+	{
+		files.modelPaths.push_back((directory / ("model" + std::to_string(i) + ".obj")).string());
+		files.texturePaths.push_back((directory / ("texture" + std::to_string(i) + ".png")).string());
+
+		WriteGridObj(files.modelPaths.back(), kAssetGridSize);
+		WriteTexture(files.texturePaths.back(), i);
+	}
+
+	std::cout << kAssetModelCount << " models, " << 2 * kAssetGridSize * kAssetGridSize << " triangles each, and " << kAssetModelCount
+		<< " materials with a " << kAssetTextureSize << " x " << kAssetTextureSize << " texture each\n";
+
+	// Something to draw while the assets load, so the frames cost what they would in a game.
+	context.pRenderer->SetModel(context.pModel);
+	while (!context.pRenderer->IsSceneReady())
+	{
+		context.pRenderer->DrawFrame();
+	}
+
+	// One worker against the default, which is one per core, less one for the render loop.
+	std::vector<uint32_t> threadCounts {1};
+	if (context.pPipeline->GetAssetManager().GetThreadCount() > 1)
+	{
+		threadCounts.push_back(context.pPipeline->GetAssetManager().GetThreadCount());
+	}
+
+	const Renderer::VertexLayout& layout = context.pModel->GetVertexLayout();
+
+	for (uint32_t threadCount : threadCounts)
+	{
+		for (bool isCold : {true, false})
+		{
+			// Cold loads import every model and cook every texture, warm ones map them from the caches.
+			if (isCold)
+			{
+				for (uint32_t i = 0; i < kAssetModelCount; ++i)
+				{
+					std::error_code error;
+					std::filesystem::remove(Renderer::GetMeshCachePath(files.modelPaths[i], layout), error);
+					std::filesystem::remove(Renderer::GetTextureCachePath(files.texturePaths[i], kAssetTextureSettings), error);
+				}
+			}
+
+			Renderer::AssetManager assetManager {context.pDeviceContext, &context.pPipeline->GetTextureStreamer()};
+			assetManager.Init(threadCount);
+
+			auto startTime = std::chrono::high_resolution_clock::now();
+			std::vector<Renderer::AssetHandle> assets;
+			std::vector<double> frameTimes = LoadAll(context, assetManager, files, assets);
+			std::chrono::duration<double, std::milli> loadTime = std::chrono::high_resolution_clock::now() - startTime;
+
+			// Loading the same material again shares it, and its texture.
+			Renderer::AssetHandle material = assetManager.LoadMaterial({files.texturePaths[0], kAssetTextureSettings});
+			Renderer::AssetHandle texture = assetManager.LoadTexture(files.texturePaths[0], kAssetTextureSettings);
+			if (material != assets[1] || assetManager.GetMaterial(material).baseColour != assetManager.GetTexture(texture))
+			{
+				throw std::runtime_error("loading a material again didn't share it");
+			}
+
+			assetManager.Release(material);
+			assetManager.Release(texture);
+
+			const Renderer::AssetStats& stats = assetManager.GetStats();
+			std::cout << threadCount << (threadCount == 1 ? " thread, " : " threads, ") << (isCold ? "cold" : "warm") << ": "
+				<< stats.loadCount << " assets in " << loadTime.count() << " ms over " << frameTimes.size() << " frames, "
+				<< stats.decodeTime.count() << " ms decoding across the threads (" << stats.decodeTime / loadTime << "x), "
+				<< stats.createTime.count() << " ms creating, " << stats.uploadedSize / 1024 << " KB uploaded\n";
+			ReportTimings("frame while loading", frameTimes);
+
+			for (Renderer::AssetHandle asset : assets)
+			{
+				assetManager.Release(asset);
+			}
+
+			context.pDeviceContext->WaitIdle();
+			assetManager.Destroy();
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::remove_all(directory, error);
+}
+}
@@ -0,0 +1,94 @@
+#include "Benchmarks.h"
+
+// STD.
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <stdexcept>
+
+
+namespace Jettison::Benchmarks
+{
+void ReportTimings(const std::string& label, std::vector<double> samples)
+{
+	if (samples.empty())
+	{
+		std::cout << label << ": no samples\n";
+		return;
+	}
+
+	std::sort(samples.begin(), samples.end());
+	double mean = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+
+	std::cout << std::fixed << std::setprecision(3)
+		<< label << ": min " << samples.front()
+		<< " ms, median " << samples[samples.size() / 2]
+		<< " ms, mean " << mean
+		<< " ms, max " << samples.back()
+		<< " ms (" << samples.size() << " samples)\n";
+}
+
+
+void ReportHeapStats(const std::vector<Renderer::HeapStats>& heapStats)
+{
+	for (size_t i = 0; i < heapStats.size(); ++i)
+	{
+		const Renderer::HeapStats& heap = heapStats[i];
+		if (heap.blockCount == 0)
+		{
+			continue;
+		}
+
+		std::cout << "heap " << i << (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT ? " (device local)" : "") << ": "
+			<< heap.blockCount << " blocks, " << heap.blockBytes / 1024 << " KB of " << heap.heapSize / 1024 << " KB allocated, "
+			<< heap.usedBytes / 1024 << " KB used by " << heap.allocationCount << " allocations\n";
+	}
+}
+
+
+void WriteGridObj(const std::string& path, uint32_t gridSize)
+{
+	std::ofstream file(path, std::ios::trunc);
+	if (!file.is_open())
+	{
+		throw std::runtime_error("failed to write " + path);
+	}
+
+	uint32_t rowLength = gridSize + 1;
+	for (uint32_t y = 0; y < rowLength; ++y)
+	{
+		for (uint32_t x = 0; x < rowLength; ++x)
+		{
+			float u = static_cast<float>(x) / gridSize;
+			float v = static_cast<float>(y) / gridSize;
+			float height = 0.02f * std::sin(u * 40.0f) * std::cos(v * 30.0f);
+
+			file << "v " << u - 0.5f << " " << v - 0.5f << " " << height << "\n";
+			file << "vt " << u << " " << v << "\n";
+			file << "vn 0 0 1\n";
+		}
+	}
+
+	for (uint32_t y = 0; y < gridSize; ++y)
+	{
+		for (uint32_t x = 0; x < gridSize; ++x)
+		{
+			// OBJ counts from one.
+			uint32_t corners[4] = {y * rowLength + x + 1, y * rowLength + x + 2, (y + 1) * rowLength + x + 2, (y + 1) * rowLength + x + 1};
+
+			file << "f " << corners[0] << "/" << corners[0] << "/" << corners[0] << " " << corners[1] << "/" << corners[1] << "/" << corners[1]
+				<< " " << corners[2] << "/" << corners[2] << "/" << corners[2] << "\n";
+			file << "f " << corners[0] << "/" << corners[0] << "/" << corners[0] << " " << corners[2] << "/" << corners[2] << "/" << corners[2]
+				<< " " << corners[3] << "/" << corners[3] << "/" << corners[3] << "\n";
+		}
+	}
+
+	if (!file)
+	{
+		throw std::runtime_error("failed to write " + path);
+	}
+}
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <vulkan/DeviceContext.h>
+#include <vulkan/Pipeline.h>
+#include <vulkan/Renderer.h>
+#include <vulkan/Swapchain.h>
+#include <vulkan/Window.h>
+
+// STD.
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+namespace Jettison::Benchmarks
+{
+// Everything a benchmark needs to drive the renderer. It is all initialised before the benchmark runs, and torn
+// down afterwards by the caller.
+struct BenchmarkContext
+{
+	std::shared_ptr<Renderer::Window> pWindow {nullptr};
+	std::shared_ptr<Renderer::DeviceContext> pDeviceContext {nullptr};
+	std::shared_ptr<Renderer::Swapchain> pSwapchain {nullptr};
+	std::shared_ptr<Renderer::Pipeline> pPipeline {nullptr};
+	std::shared_ptr<Renderer::Renderer> pRenderer {nullptr};
+	Renderer::Model* pModel {nullptr};
+
+	// How many times to repeat the measurement.
+	uint32_t iterations {10};
+};
+
+
+// Print the min, median, mean and max of a set of samples, in milliseconds.
+void ReportTimings(const std::string& label, std::vector<double> samples);
+
+// Print the blocks and bytes allocated from each memory heap the allocator has touched.
+void ReportHeapStats(const std::vector<Renderer::HeapStats>& heapStats);
+
+// Write a rippled sheet of quads as an OBJ, two triangles each, with normals and texture coordinates so there's as much
+// to parse as in a real model.
+void WriteGridObj(const std::string& path, uint32_t gridSize);
+
+
+// Loads a hundred models and materials on one worker, then on the default pool, cold and then warm from the caches,
+// drawing frames all the while.
+void RunAssetLoadingBenchmark(const BenchmarkContext& context);
+
+// Records a large draw list on one thread, then two and so on, to see how well recording scales.
+void RunCommandRecordingBenchmark(const BenchmarkContext& context);
+
+// Culls ever more spheres and boxes on the CPU with each SIMD path, checking each against the scalar path.
+void RunCpuCullingBenchmark(const BenchmarkContext& context);
+
+// Culls a large grid of objects on the GPU, checking the frustum test against the CPU and timing each pass.
+void RunGpuCullingBenchmark(const BenchmarkContext& context);
+
+// Compares the CPU cost of submitting ever more objects one draw call at a time, against a single indirect call.
+void RunIndirectDrawBenchmark(const BenchmarkContext& context);
+
+// Draws ever more instances of the model with a single draw, rewriting their transforms from a job every frame.
+void RunInstancingBenchmark(const BenchmarkContext& context);
+
+// Runs each latency mode in turn, measuring the input to present latency and frame time.
+void RunLatencyModesBenchmark(const BenchmarkContext& context);
+
+// Prints the model's levels of detail, then draws a field of instances with them off and on, counting the triangles.
+void RunLodBenchmark(const BenchmarkContext& context);
+
+// Imports a million triangle OBJ, then loads it again from the mesh cache, checking the two match.
+void RunMeshCacheBenchmark(const BenchmarkContext& context);
+
+// Fragments a heap with buffers, then moves them out of the sparse blocks, checking their contents survive and the
+// blocks are given back.
+void RunMemoryDefragmentationBenchmark(const BenchmarkContext& context);
+
+// Builds mip chains with the compute downsampler and with a blit per level, checking the levels against the CPU.
+void RunMipGenerationBenchmark(const BenchmarkContext& context);
+
+// Imports a two million triangle OBJ on one thread, then two and so on, checking each against the old importer.
+void RunObjImportBenchmark(const BenchmarkContext& context);
+
+// Compares the time to create the pipelines with a cold, empty cache against a warm one.
+void RunPipelineCacheBenchmark(const BenchmarkContext& context);
+
+// Compiles a frame's worth of passes into a render graph, checking the unused pass is culled and transient images
+// share memory, then prints the graph along with the renderer's own.
+void RunRenderGraphBenchmark(const BenchmarkContext& context);
+
+// Resizes the window every frame, measuring the cost of each resize and checking nothing leaks.
+void RunResizeStormBenchmark(const BenchmarkContext& context);
+
+// Cooks the default texture in each format, comparing the size and quality, then times loading it cooked against
+// decoding the source and filtering its levels.
+void RunTextureCompressionBenchmark(const BenchmarkContext& context);
+
+// Evicts the default texture to its tail and times it streaming back in, then asks for more textures than the budget
+// fits, checking the least recently used give way.
+void RunTextureStreamingBenchmark(const BenchmarkContext& context);
+
+// Packs the model in each vertex layout, checking the precision lost, then draws many copies of it in each.
+void RunVertexLayoutsBenchmark(const BenchmarkContext& context);
+}
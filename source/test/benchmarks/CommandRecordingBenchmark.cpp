@@ -0,0 +1,75 @@
+#include "Benchmarks.h"
+
+// STD.
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+
+
+namespace Jettison::Benchmarks
+{
+// Enough draws that recording them is a real cost on the CPU.
+constexpr uint32_t kRecordingDrawCount = 50000;
+
+
+void RunCommandRecordingBenchmark(const BenchmarkContext& context)
+{
+	uint32_t triangleCount = context.pModel->GetIndexCount() / 3;
+	if (triangleCount == 0)
+	{
+		throw std::runtime_error("the command recording benchmark needs a model");
+	}
+
+	// Cut the model into small slices, so each draw is cheap for the GPU and the recording dominates.
+	uint32_t trianglesPerDraw = std::max(1u, triangleCount / kRecordingDrawCount);
+
+	std::vector<Renderer::DrawItem> drawList(kRecordingDrawCount);
+	for (uint32_t i = 0; i < kRecordingDrawCount; ++i)
+	{
+		uint32_t firstTriangle = (i * trianglesPerDraw) % (triangleCount - trianglesPerDraw + 1);
+		drawList[i] = {context.pModel, firstTriangle * 3, trianglesPerDraw * 3};
+	}
+
+	context.pRenderer->SetDrawList(std::move(drawList));
+
+	// Wait for the uploads, otherwise nothing is recorded.
+	while (!context.pRenderer->IsSceneReady())
+	{
+		context.pRenderer->DrawFrame();
+	}
+
+	uint32_t originalThreadCount = context.pRenderer->GetRecordingThreadCount();
+	double singleThreadMedian = 0.0;
+
+	for (uint32_t threadCount = 1; threadCount <= context.pRenderer->GetMaxRecordingThreadCount(); ++threadCount)
+	{
+		context.pRenderer->SetRecordingThreadCount(threadCount);
+
+		std::vector<double> recordTimes;
+
+		for (uint32_t i = 0; i < context.iterations; ++i)
+		{
+			// Every frame re-records, since the command buffers are otherwise reused.
+			context.pRenderer->MarkSceneDirty();
+			context.pRenderer->DrawFrame();
+
+			recordTimes.push_back(context.pRenderer->GetFrameStats().recordTime.count());
+		}
+
+		std::sort(recordTimes.begin(), recordTimes.end());
+		double median = recordTimes[recordTimes.size() / 2];
+		if (threadCount == 1)
+		{
+			singleThreadMedian = median;
+		}
+
+		ReportTimings("record " + std::to_string(kRecordingDrawCount) + " draws on " + std::to_string(threadCount) + " threads", recordTimes);
+		std::cout << "  speed up " << singleThreadMedian / median << "x\n";
+	}
+
+	// Put things back the way they were.
+	context.pRenderer->SetRecordingThreadCount(originalThreadCount);
+	context.pRenderer->SetModel(context.pModel);
+}
+}
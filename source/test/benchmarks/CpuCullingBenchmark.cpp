@@ -0,0 +1,126 @@
+#include "Benchmarks.h"
+
+#include <vulkan/FrustumCulling.h>
+
+// STD.
+#include <array>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+
+
+namespace Jettison::Benchmarks
+{
+constexpr std::array<uint32_t, 3> kCpuCullingObjectCounts = {10000, 100000, 1000000};
+
+constexpr std::array<Renderer::CullingPath, 3> kCullingPaths = {Renderer::CullingPath::Scalar, Renderer::CullingPath::Sse,
+	Renderer::CullingPath::Avx2};
+
+// The objects are scattered through a cube around the origin, big enough that most are outside the camera's view.
+constexpr float kCpuCullingSceneExtent = 10.0f;
+constexpr float kCpuCullingMaxRadius = 0.25f;
+
+
+template <typename Cull>
+static std::vector<double> TimeCulling(uint32_t iterations, std::vector<uint32_t>& visible, Cull cull)
+{
+	std::vector<double> times;
+
+	for (uint32_t i = 0; i < iterations; ++i)
+	{
+		visible.clear();
+
+		auto startTime = std::chrono::high_resolution_clock::now();
+		cull();
+		std::chrono::duration<double, std::milli> time = std::chrono::high_resolution_clock::now() - startTime;
+
+		times.push_back(time.count());
+	}
+
+	return times;
+}
+
+
+void RunCpuCullingBenchmark(const BenchmarkContext& context)
+{
+	// The same camera the renderer draws with, once it has drawn something.
+	context.pRenderer->DrawFrame();
+	Renderer::Frustum frustum = Renderer::Frustum::FromViewProjection(context.pRenderer->GetViewProjection());
+
+	for (auto path : kCullingPaths)
+	{
+		std::cout << Renderer::GetCullingPathName(path) << (Renderer::IsCullingPathSupported(path) ? " supported" : " not supported") << "\n";
+	}
+
+	std::cout << "fastest culling path " << Renderer::GetCullingPathName(Renderer::GetFastestCullingPath()) << "\n";
+
+	// The same scene every run.
+	std::mt19937 random {1234};
+	std::uniform_real_distribution<float> position {-kCpuCullingSceneExtent, kCpuCullingSceneExtent};
+	std::uniform_real_distribution<float> size {0.0f, kCpuCullingMaxRadius};
+
+	bool isCorrect = true;
+
+	for (uint32_t objectCount : kCpuCullingObjectCounts)
+	{
+		Renderer::SphereBounds spheres;
+		Renderer::BoxBounds boxes;
+		spheres.Reserve(objectCount);
+		boxes.Reserve(objectCount);
+
+		for (uint32_t i = 0; i < objectCount; ++i)
+		{
+			glm::vec3 centre {position(random), position(random), position(random)};
+			glm::vec3 extent {size(random), size(random), size(random)};
+
+			spheres.Add(glm::vec4(centre, size(random)));
+			boxes.Add(centre - extent, centre + extent);
+		}
+
+		// The scalar path is the reference the others must match exactly, since they sum in the same order.
+		std::vector<uint32_t> referenceSpheres;
+		std::vector<uint32_t> referenceBoxes;
+		Renderer::CullSpheres(frustum, spheres, referenceSpheres, Renderer::CullingPath::Scalar);
+		Renderer::CullBoxes(frustum, boxes, referenceBoxes, Renderer::CullingPath::Scalar);
+
+		std::cout << objectCount << " objects: " << referenceSpheres.size() << " spheres and " << referenceBoxes.size()
+			<< " boxes visible\n";
+
+		for (auto path : kCullingPaths)
+		{
+			if (!Renderer::IsCullingPathSupported(path))
+			{
+				continue;
+			}
+
+			std::string label = std::string(Renderer::GetCullingPathName(path)) + " " + std::to_string(objectCount);
+			std::vector<uint32_t> visible;
+			visible.reserve(objectCount + Renderer::kCullingLaneCount);
+
+			ReportTimings(label + " spheres", TimeCulling(context.iterations, visible,
+				[&]() { Renderer::CullSpheres(frustum, spheres, visible, path); }));
+
+			if (visible != referenceSpheres)
+			{
+				std::cout << label << " spheres DISAGREE with the scalar path\n";
+				isCorrect = false;
+			}
+
+			ReportTimings(label + " boxes", TimeCulling(context.iterations, visible,
+				[&]() { Renderer::CullBoxes(frustum, boxes, visible, path); }));
+
+			if (visible != referenceBoxes)
+			{
+				std::cout << label << " boxes DISAGREE with the scalar path\n";
+				isCorrect = false;
+			}
+		}
+	}
+
+	if (!isCorrect)
+	{
+		throw std::runtime_error("a SIMD culling path disagrees with the scalar path");
+	}
+}
+}
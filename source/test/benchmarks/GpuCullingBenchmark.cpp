@@ -0,0 +1,231 @@
+#include "Benchmarks.h"
+
+#include <vulkan/GpuCuller.h>
+#include <vulkan/IndirectScene.h>
+#include <vulkan/MeshPool.h>
+
+// STD.
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+
+namespace Jettison::Benchmarks
+{
+// A grid of small objects, spread far wider than the camera can see.
+constexpr uint32_t kCullingGridSize = 100;
+constexpr float kCullingGridExtent = 20.0f;
+
+// Each object only draws a few triangles, it's the number of them that matters.
+constexpr uint32_t kCullingTrianglesPerObject = 16;
+
+// The statistics come back a few frames late, so let them catch up after changing anything.
+constexpr uint32_t kCullingSettleFrames = Renderer::kMaxFramesInFlight * 2 + 1;
+
+// Objects this close to a plane may land either side of it, depending on rounding.
+constexpr float kPlaneTolerance = 1e-4f;
+
+
+struct FrustumReference
+{
+	uint32_t culled {0};
+
+	// How many were too close to a plane to be sure about.
+	uint32_t borderline {0};
+};
+
+
+// Count the objects outside the frustum on the CPU, to check the GPU's count against.
+static FrustumReference CountFrustumCulled(const std::vector<Renderer::SceneObject>& objects, const Renderer::MeshPool& meshPool,
+	const glm::mat4& viewProjection)
+{
+	glm::mat4 rows = glm::transpose(viewProjection);
+	std::array<glm::vec4, 6> planes = {rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1], rows[3] - rows[1], rows[2], rows[3] - rows[2]};
+
+	for (auto& plane : planes)
+	{
+		plane /= glm::length(glm::vec3(plane));
+	}
+
+	FrustumReference reference;
+
+	for (const auto& object : objects)
+	{
+		glm::vec4 boundingSphere = meshPool.GetMeshRange(object.mesh).boundingSphere;
+		glm::vec3 centre = glm::vec3(object.transform * glm::vec4(glm::vec3(boundingSphere), 1.0f));
+		float scale = std::max(std::max(glm::length(glm::vec3(object.transform[0])), glm::length(glm::vec3(object.transform[1]))),
+			glm::length(glm::vec3(object.transform[2])));
+		float radius = boundingSphere.w * scale;
+
+		bool isCulled = false;
+		bool isBorderline = false;
+
+		for (const auto& plane : planes)
+		{
+			float distance = glm::dot(glm::vec3(plane), centre) + plane.w + radius;
+			isCulled = isCulled || distance < 0.0f;
+			isBorderline = isBorderline || std::abs(distance) < kPlaneTolerance;
+		}
+
+		reference.culled += isCulled ? 1 : 0;
+		reference.borderline += isBorderline ? 1 : 0;
+	}
+
+	return reference;
+}
+
+
+static float GetScopeTime(const Renderer::GpuProfiler& gpuProfiler, const std::string& name)
+{
+	for (const auto& scope : gpuProfiler.GetScopeStats())
+	{
+		if (scope.name == name)
+		{
+			return scope.lastTime;
+		}
+	}
+
+	return 0.0f;
+}
+
+
+static void DrawFrames(const BenchmarkContext& context, uint32_t frameCount)
+{
+	for (uint32_t i = 0; i < frameCount; ++i)
+	{
+		context.pRenderer->DrawFrame();
+	}
+}
+
+
+static void ReportCullStats(const std::string& label, const Renderer::CullStats& stats)
+{
+	std::cout << label << ": tested " << stats.tested << ", frustum culled " << stats.frustumCulled
+		<< ", occlusion culled " << stats.occlusionCulled << ", drawn " << stats.drawn << "\n";
+}
+
+
+void RunGpuCullingBenchmark(const BenchmarkContext& context)
+{
+	uint32_t triangleCount = context.pModel->GetIndexCount() / 3;
+	if (triangleCount < kCullingTrianglesPerObject)
+	{
+		throw std::runtime_error("the GPU culling benchmark needs a model");
+	}
+
+	const auto& vertices = context.pModel->GetVertices();
+	std::vector<uint32_t> modelIndices(context.pModel->m_indices.begin(), context.pModel->m_indices.begin() + triangleCount * 3);
+
+	// A small piece of the model for the grid, and all of it for the occluder.
+	std::vector<uint32_t> indices(modelIndices.begin(), modelIndices.begin() + kCullingTrianglesPerObject * 3);
+
+	Renderer::MeshPool meshPool {context.pDeviceContext};
+	meshPool.Init(static_cast<uint32_t>(vertices.size()) * 2, static_cast<uint32_t>(indices.size() + modelIndices.size()));
+	Renderer::MeshHandle mesh = meshPool.AddMesh(vertices, indices);
+	Renderer::MeshHandle occluderMesh = meshPool.AddMesh(vertices, modelIndices);
+
+	uint32_t objectCount = kCullingGridSize * kCullingGridSize;
+	std::vector<Renderer::SceneObject> objects(objectCount + 1);
+	float spacing = kCullingGridExtent / kCullingGridSize;
+
+	for (uint32_t i = 0; i < objectCount; ++i)
+	{
+		glm::vec3 position {-kCullingGridExtent * 0.5f + spacing * (i % kCullingGridSize), -kCullingGridExtent * 0.5f + spacing * (i / kCullingGridSize), 0.0f};
+
+		objects[i].mesh = mesh;
+		objects[i].transform = glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(spacing * 0.5f));
+	}
+
+	// Between the camera and the middle of the grid, hiding a good part of it.
+	objects[objectCount].mesh = occluderMesh;
+	objects[objectCount].transform = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(0.8f, 0.8f, 0.4f)), glm::vec3(0.8f));
+
+	Renderer::IndirectScene indirectScene {context.pDeviceContext, &meshPool};
+	indirectScene.Init(static_cast<uint32_t>(objects.size()));
+	indirectScene.SetObjects(objects);
+
+	std::cout << "indirect draw count " << (indirectScene.IsDrawCountSupported() ? "supported, compacting draws" : "not supported, zeroing culled draws") << "\n";
+
+	context.pRenderer->SetDrawList({});
+	context.pRenderer->SetIndirectScene(&indirectScene);
+
+	while (!context.pRenderer->IsSceneReady())
+	{
+		context.pRenderer->DrawFrame();
+	}
+
+	const auto& gpuProfiler = context.pRenderer->GetGpuProfiler();
+	Renderer::GpuCuller& gpuCuller = context.pRenderer->GetGpuCuller();
+
+	// Everything drawn, as a baseline.
+	context.pRenderer->SetCullingEnabled(false);
+	DrawFrames(context, kCullingSettleFrames);
+
+	std::vector<double> unculledTimes;
+	for (uint32_t i = 0; i < context.iterations; ++i)
+	{
+		context.pRenderer->DrawFrame();
+		unculledTimes.push_back(GetScopeTime(gpuProfiler, "scene pass"));
+	}
+
+	// The frustum alone, which can be checked exactly against the CPU.
+	context.pRenderer->SetCullingEnabled(true);
+	gpuCuller.SetOcclusionEnabled(false);
+	DrawFrames(context, kCullingSettleFrames);
+
+	Renderer::CullStats frustumStats = context.pRenderer->GetCullStats();
+	FrustumReference reference = CountFrustumCulled(objects, meshPool, context.pRenderer->GetViewProjection());
+
+	ReportCullStats("frustum", frustumStats);
+
+	uint32_t difference = frustumStats.frustumCulled > reference.culled ? frustumStats.frustumCulled - reference.culled
+		: reference.culled - frustumStats.frustumCulled;
+	bool isMatch = frustumStats.tested == objects.size() && difference <= reference.borderline;
+	std::cout << "cpu reference frustum culled " << reference.culled << " (" << reference.borderline << " borderline), "
+		<< (isMatch ? "matches" : "MISMATCH") << "\n";
+
+	// Then the depth pyramid as well.
+	gpuCuller.SetOcclusionEnabled(true);
+	DrawFrames(context, kCullingSettleFrames);
+
+	std::vector<double> cullingTimes;
+	std::vector<double> culledTimes;
+	for (uint32_t i = 0; i < context.iterations; ++i)
+	{
+		context.pRenderer->DrawFrame();
+		cullingTimes.push_back(GetScopeTime(gpuProfiler, "culling"));
+		culledTimes.push_back(GetScopeTime(gpuProfiler, "scene pass"));
+	}
+
+	if (gpuCuller.IsOcclusionEnabled())
+	{
+		ReportCullStats("frustum and occlusion", context.pRenderer->GetCullStats());
+	}
+	else
+	{
+		std::cout << "depth attachment can't be sampled, occlusion culling unavailable\n";
+	}
+
+	if (gpuProfiler.IsSupported())
+	{
+		ReportTimings("gpu scene pass unculled", unculledTimes);
+		ReportTimings("gpu culling", cullingTimes);
+		ReportTimings("gpu scene pass culled", culledTimes);
+	}
+
+	// Put things back the way they were.
+	context.pRenderer->SetIndirectScene(nullptr);
+	context.pRenderer->SetModel(context.pModel);
+	context.pDeviceContext->WaitIdle();
+
+	indirectScene.Destroy();
+	meshPool.Destroy();
+
+	if (!isMatch)
+	{
+		throw std::runtime_error("GPU frustum culling disagrees with the CPU reference");
+	}
+}
+}
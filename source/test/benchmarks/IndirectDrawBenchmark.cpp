@@ -0,0 +1,134 @@
+#include "Benchmarks.h"
+
+#include <vulkan/IndirectScene.h>
+#include <vulkan/MeshPool.h>
+
+// STD.
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+
+namespace Jettison::Benchmarks
+{
+// From a handful of objects up to far more than can sensibly be drawn one call at a time.
+constexpr std::array<uint32_t, 5> kIndirectObjectCounts = {10, 100, 1000, 10000, 100000};
+
+// Each object only draws a few triangles, so the CPU cost dominates.
+constexpr uint32_t kTrianglesPerObject = 16;
+
+
+// Lay the objects out on a grid, nudged each frame so the draw data really does change.
+static std::vector<Renderer::SceneObject> MakeObjects(Renderer::MeshHandle mesh, uint32_t objectCount, uint32_t frame)
+{
+	std::vector<Renderer::SceneObject> objects(objectCount);
+	uint32_t gridSize = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(objectCount))));
+	float spacing = 2.0f / gridSize;
+	float offset = 0.001f * (frame % 100);
+
+	for (uint32_t i = 0; i < objectCount; ++i)
+	{
+		glm::vec3 position {-1.0f + spacing * (i % gridSize) + offset, -1.0f + spacing * (i / gridSize), 0.0f};
+
+		objects[i].mesh = mesh;
+		objects[i].transform = glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(spacing));
+	}
+
+	return objects;
+}
+
+
+void RunIndirectDrawBenchmark(const BenchmarkContext& context)
+{
+	uint32_t triangleCount = context.pModel->GetIndexCount() / 3;
+	if (triangleCount < kTrianglesPerObject)
+	{
+		throw std::runtime_error("the indirect draw benchmark needs a model");
+	}
+
+	uint32_t maxObjectCount = kIndirectObjectCounts.back();
+
+	// A small piece of the model, shared by every object.
+	std::vector<uint32_t> indices(context.pModel->m_indices.begin(), context.pModel->m_indices.begin() + kTrianglesPerObject * 3);
+
+	Renderer::MeshPool meshPool {context.pDeviceContext};
+	meshPool.Init(static_cast<uint32_t>(context.pModel->GetVertices().size()), static_cast<uint32_t>(indices.size()));
+	Renderer::MeshHandle mesh = meshPool.AddMesh(context.pModel->GetVertices(), indices);
+
+	Renderer::IndirectScene indirectScene {context.pDeviceContext, &meshPool};
+	indirectScene.Init(maxObjectCount);
+
+	std::cout << "indirect draw count " << (indirectScene.IsDrawCountSupported() ? "supported" : "not supported, drawing every slot") << "\n";
+
+	uint32_t frame = 0;
+
+	for (uint32_t objectCount : kIndirectObjectCounts)
+	{
+		// One draw call per object, recorded on a single thread.
+		uint32_t originalThreadCount = context.pRenderer->GetRecordingThreadCount();
+		context.pRenderer->SetRecordingThreadCount(1);
+		context.pRenderer->SetIndirectScene(nullptr);
+
+		std::vector<Renderer::DrawItem> drawList(objectCount, {context.pModel, 0, kTrianglesPerObject * 3});
+		context.pRenderer->SetDrawList(std::move(drawList));
+
+		while (!context.pRenderer->IsSceneReady())
+		{
+			context.pRenderer->DrawFrame();
+		}
+
+		std::vector<double> directTimes;
+
+		for (uint32_t i = 0; i < context.iterations; ++i)
+		{
+			// Moving anything means recording every draw again.
+			context.pRenderer->MarkSceneDirty();
+			context.pRenderer->DrawFrame();
+
+			directTimes.push_back(context.pRenderer->GetFrameStats().recordTime.count());
+		}
+
+		context.pRenderer->SetRecordingThreadCount(originalThreadCount);
+
+		// Every object in a single indirect call.
+		context.pRenderer->SetDrawList({});
+		context.pRenderer->SetIndirectScene(&indirectScene);
+		indirectScene.SetObjects(MakeObjects(mesh, objectCount, frame++));
+
+		while (!context.pRenderer->IsSceneReady())
+		{
+			context.pRenderer->DrawFrame();
+		}
+
+		std::vector<double> indirectTimes;
+
+		for (uint32_t i = 0; i < context.iterations; ++i)
+		{
+			// Re-record anyway, to show recording doesn't depend on the object count.
+			auto startTime = std::chrono::high_resolution_clock::now();
+			indirectScene.SetObjects(MakeObjects(mesh, objectCount, frame++));
+			std::chrono::duration<double, std::milli> setTime = std::chrono::high_resolution_clock::now() - startTime;
+
+			context.pRenderer->MarkSceneDirty();
+			context.pRenderer->DrawFrame();
+
+			const auto& frameStats = context.pRenderer->GetFrameStats();
+			indirectTimes.push_back(setTime.count() + frameStats.sceneUpdateTime.count() + frameStats.recordTime.count());
+		}
+
+		ReportTimings("direct submit " + std::to_string(objectCount) + " objects", directTimes);
+		ReportTimings("indirect submit " + std::to_string(objectCount) + " objects", indirectTimes);
+	}
+
+	// Put things back the way they were.
+	context.pRenderer->SetIndirectScene(nullptr);
+	context.pRenderer->SetModel(context.pModel);
+	context.pDeviceContext->WaitIdle();
+
+	indirectScene.Destroy();
+	meshPool.Destroy();
+}
+}
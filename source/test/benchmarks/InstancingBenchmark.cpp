@@ -0,0 +1,94 @@
+#include "Benchmarks.h"
+
+#include <vulkan/InstanceBuffer.h>
+
+// STD.
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <iostream>
+#include <stdexcept>
+
+
+namespace Jettison::Benchmarks
+{
+constexpr std::array<uint32_t, 4> kInstanceCounts = {10, 100, 1000, 10000};
+
+
+// Spin the instances around on a grid. Run as a job between frames, the way a game would animate its props.
+static void AnimateInstances(Renderer::InstanceBuffer& instanceBuffer, uint32_t frame)
+{
+	uint32_t instanceCount = instanceBuffer.GetInstanceCount();
+	uint32_t gridSize = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(instanceCount))));
+	float spacing = 2.0f / gridSize;
+
+	for (uint32_t i = 0; i < instanceCount; ++i)
+	{
+		glm::vec3 position {-1.0f + spacing * (i % gridSize), -1.0f + spacing * (i / gridSize), 0.0f};
+		glm::mat4 transform = glm::translate(glm::mat4(1.0f), position);
+		transform = glm::rotate(transform, 0.01f * (frame + i), glm::vec3(0.0f, 0.0f, 1.0f));
+
+		instanceBuffer.SetTransform(i, glm::scale(transform, glm::vec3(spacing * 0.5f)));
+	}
+}
+
+
+void RunInstancingBenchmark(const BenchmarkContext& context)
+{
+	if (context.pModel->m_indices.empty())
+	{
+		throw std::runtime_error("the instancing benchmark needs a model");
+	}
+
+	uint32_t indexCount = context.pModel->GetIndexCount();
+
+	Renderer::InstanceBuffer instanceBuffer {context.pDeviceContext};
+	instanceBuffer.Init(kInstanceCounts.back());
+
+	uint32_t frame = 0;
+
+	for (uint32_t instanceCount : kInstanceCounts)
+	{
+		instanceBuffer.Resize(instanceCount);
+		AnimateInstances(instanceBuffer, frame);
+
+		// One draw for every instance.
+		Renderer::DrawItem drawItem {context.pModel, 0, indexCount};
+		drawItem.pInstances = &instanceBuffer;
+		context.pRenderer->SetDrawList({drawItem});
+
+		while (!context.pRenderer->IsSceneReady())
+		{
+			context.pRenderer->DrawFrame();
+		}
+
+		std::vector<double> frameTimes;
+		std::vector<double> recordTimes;
+
+		for (uint32_t i = 0; i < context.iterations * 10; ++i)
+		{
+			auto startTime = std::chrono::high_resolution_clock::now();
+
+			// The transforms are written on another thread, and must be done before the next frame starts.
+			std::future<void> animateJob = std::async(std::launch::async, AnimateInstances, std::ref(instanceBuffer), ++frame);
+			animateJob.wait();
+
+			context.pRenderer->DrawFrame();
+
+			std::chrono::duration<double, std::milli> frameTime = std::chrono::high_resolution_clock::now() - startTime;
+			frameTimes.push_back(frameTime.count());
+			recordTimes.push_back(context.pRenderer->GetFrameStats().recordTime.count());
+		}
+
+		ReportTimings("animate and draw " + std::to_string(instanceCount) + " instances", frameTimes);
+		ReportTimings("record " + std::to_string(instanceCount) + " instances", recordTimes);
+	}
+
+	// Put things back the way they were.
+	context.pRenderer->SetModel(context.pModel);
+	context.pDeviceContext->WaitIdle();
+
+	instanceBuffer.Destroy();
+}
+}
@@ -0,0 +1,78 @@
+#include "Benchmarks.h"
+
+#include <vulkan/LatencyMode.h>
+
+// GLFW / Vulkan.
+#define GLFW_INCLUDE_VULKAN
+#include <../glfw/include/GLFW/glfw3.h>
+
+// STD.
+#include <chrono>
+#include <iostream>
+
+
+namespace Jettison::Benchmarks
+{
+// Frames drawn in each mode for every iteration. Enough to cover several trips round the swapchain.
+constexpr uint32_t kLatencyFramesPerIteration = 60;
+
+// Frames to let the queues fill up after switching mode, before measuring.
+constexpr uint32_t kLatencySettleFrames = 30;
+
+
+static void DrawLatencyFrame(const BenchmarkContext& context)
+{
+	context.pRenderer->BeginInputSampling();
+
+	if (context.pWindow)
+	{
+		glfwPollEvents();
+	}
+
+	context.pRenderer->DrawFrame();
+}
+
+
+void RunLatencyModesBenchmark(const BenchmarkContext& context)
+{
+	Renderer::LatencyMode originalMode = context.pRenderer->GetLatencyMode();
+
+	for (Renderer::LatencyMode mode : {Renderer::LatencyMode::Throughput, Renderer::LatencyMode::LowLatency, Renderer::LatencyMode::VsyncOff})
+	{
+		context.pRenderer->SetLatencyMode(mode);
+
+		for (uint32_t i = 0; i < kLatencySettleFrames; ++i)
+		{
+			DrawLatencyFrame(context);
+		}
+
+		std::vector<double> frameTimes;
+		std::vector<double> latencies;
+		uint64_t lastSampleCount = context.pRenderer->GetLatencyStats().sampleCount;
+
+		for (uint32_t i = 0; i < context.iterations * kLatencyFramesPerIteration; ++i)
+		{
+			auto frameStartTime = std::chrono::high_resolution_clock::now();
+			DrawLatencyFrame(context);
+			std::chrono::duration<double, std::milli> frameTime = std::chrono::high_resolution_clock::now() - frameStartTime;
+			frameTimes.push_back(frameTime.count());
+
+			// Only the most recent measurement is kept, so a frame which completes alongside another is not counted.
+			const auto& latencyStats = context.pRenderer->GetLatencyStats();
+			if (latencyStats.sampleCount != lastSampleCount)
+			{
+				latencies.push_back(latencyStats.lastLatency.count());
+				lastSampleCount = latencyStats.sampleCount;
+			}
+		}
+
+		std::string modeName = Renderer::GetLatencyModeName(mode);
+		ReportTimings(modeName + " frame", frameTimes);
+		ReportTimings(modeName + " input to present", latencies);
+		std::cout << "  present mode " << context.pSwapchain->GetPresentMode()
+			<< ", " << context.pSwapchain->GetImageCount() << " images\n";
+	}
+
+	context.pRenderer->SetLatencyMode(originalMode);
+}
+}
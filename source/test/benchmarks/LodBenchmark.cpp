@@ -0,0 +1,143 @@
+#include "Benchmarks.h"
+
+#include <vulkan/InstanceBuffer.h>
+#include <vulkan/MeshSimplifier.h>
+
+// STD.
+#include <array>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+
+
+namespace Jettison::Benchmarks
+{
+// Enough instances, far enough apart, that most of them are small on screen.
+constexpr uint32_t kLodGridSize = 64;
+constexpr float kLodGridExtent = 16.0f;
+
+// Level of detail off, then on at a few thresholds, in pixels.
+constexpr std::array<float, 3> kLodPixelErrors = {0.0f, 1.0f, 4.0f};
+
+
+static float GetScenePassTime(const Renderer::GpuProfiler& gpuProfiler)
+{
+	for (const auto& scope : gpuProfiler.GetScopeStats())
+	{
+		if (scope.name == "scene pass")
+		{
+			return scope.lastTime;
+		}
+	}
+
+	return 0.0f;
+}
+
+
+void RunLodBenchmark(const BenchmarkContext& context)
+{
+	const auto& lods = context.pModel->GetLods();
+	if (lods.empty())
+	{
+		throw std::runtime_error("the LOD benchmark needs a model");
+	}
+
+	// The chain the model loaded with, and what it costs to build.
+	for (uint32_t lod = 0; lod < lods.size(); ++lod)
+	{
+		std::cout << "lod " << lod << ": " << lods[lod].indexCount / 3 << " triangles, error " << lods[lod].error << "\n";
+	}
+
+	const auto& vertices = context.pModel->GetVertices();
+	std::vector<uint32_t> fullIndices(context.pModel->m_indices.begin(), context.pModel->m_indices.begin() + lods[0].indexCount);
+
+	std::vector<double> buildTimes;
+	for (uint32_t i = 0; i < context.iterations; ++i)
+	{
+		std::vector<uint32_t> indices = fullIndices;
+
+		auto startTime = std::chrono::high_resolution_clock::now();
+		Renderer::BuildLodChain(vertices, indices);
+		std::chrono::duration<double, std::milli> buildTime = std::chrono::high_resolution_clock::now() - startTime;
+
+		buildTimes.push_back(buildTime.count());
+	}
+
+	ReportTimings("build lod chain", buildTimes);
+
+	// A field of instances stretching away from the camera.
+	uint32_t instanceCount = kLodGridSize * kLodGridSize;
+	Renderer::InstanceBuffer instanceBuffer {context.pDeviceContext};
+	instanceBuffer.Init(instanceCount);
+	instanceBuffer.Resize(instanceCount);
+
+	float spacing = kLodGridExtent / kLodGridSize;
+	for (uint32_t i = 0; i < instanceCount; ++i)
+	{
+		glm::vec3 position {1.0f - spacing * (i % kLodGridSize), 1.0f - spacing * (i / kLodGridSize), 0.0f};
+		instanceBuffer.SetTransform(i, glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(spacing * 0.5f)));
+	}
+
+	Renderer::DrawItem drawItem {context.pModel, 0, context.pModel->GetIndexCount()};
+	drawItem.pInstances = &instanceBuffer;
+	context.pRenderer->SetDrawList({drawItem});
+
+	while (!context.pRenderer->IsSceneReady())
+	{
+		context.pRenderer->DrawFrame();
+	}
+
+	const auto& gpuProfiler = context.pRenderer->GetGpuProfiler();
+	bool wasLodEnabled = context.pRenderer->IsLodEnabled();
+	float previousPixelError = context.pRenderer->GetLodPixelError();
+
+	for (float pixelError : kLodPixelErrors)
+	{
+		bool isLodEnabled = pixelError > 0.0f;
+		context.pRenderer->SetLodEnabled(isLodEnabled);
+		context.pRenderer->SetLodPixelError(pixelError);
+
+		std::string label = isLodEnabled ? "lod " + std::to_string(pixelError).substr(0, 3) + " px" : "lod off";
+
+		std::vector<double> frameTimes;
+		std::vector<double> scenePassTimes;
+		uint64_t triangleCount = 0;
+		for (uint32_t i = 0; i < context.iterations * 10; ++i)
+		{
+			auto startTime = std::chrono::high_resolution_clock::now();
+			context.pRenderer->DrawFrame();
+			std::chrono::duration<double, std::milli> frameTime = std::chrono::high_resolution_clock::now() - startTime;
+
+			frameTimes.push_back(frameTime.count());
+			scenePassTimes.push_back(GetScenePassTime(gpuProfiler));
+			triangleCount = context.pRenderer->GetFrameStats().triangleCount;
+		}
+
+		std::cout << label << ": " << triangleCount << " triangles for " << instanceCount << " instances, per level";
+		const auto& lodInstanceCounts = instanceBuffer.GetLodInstanceCounts();
+		for (uint32_t lod = 0; lod < lods.size(); ++lod)
+		{
+			std::cout << " " << lodInstanceCounts[lod];
+		}
+		std::cout << "\n";
+
+		ReportTimings(label + " frame", frameTimes);
+		if (gpuProfiler.IsSupported())
+		{
+			ReportTimings(label + " gpu scene pass", scenePassTimes);
+		}
+	}
+
+	if (!gpuProfiler.IsSupported())
+	{
+		std::cout << "no GPU timestamps, so the scene pass isn't timed\n";
+	}
+
+	// The instance buffer must outlive the frames which drew it.
+	context.pRenderer->SetLodEnabled(wasLodEnabled);
+	context.pRenderer->SetLodPixelError(previousPixelError);
+	context.pRenderer->SetModel(context.pModel);
+	context.pDeviceContext->WaitIdle();
+	instanceBuffer.Destroy();
+}
+}
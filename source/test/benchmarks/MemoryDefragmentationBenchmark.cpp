@@ -0,0 +1,256 @@
+#include "Benchmarks.h"
+
+// STD.
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+
+
+namespace Jettison::Benchmarks
+{
+// Small enough that a block holds plenty of them, large enough that the copies aren't free.
+constexpr VkDeviceSize kDefragmentationBufferSize = 256 * 1024;
+
+// How many blocks' worth of buffers to allocate. The first half are left with every other buffer, the rest with one
+// in eight, which is sparse enough for the defragmenter to empty them.
+constexpr uint32_t kDefragmentationBlockCount = 4;
+constexpr uint32_t kSparseKeepInterval = 8;
+
+
+// Host visible, so the contents can be written and checked without a staging buffer.
+constexpr VkMemoryPropertyFlags kDefragmentationMemoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+
+static uint32_t CountBlocks(const Renderer::MemoryAllocator& allocator)
+{
+	uint32_t blockCount = 0;
+	for (const Renderer::HeapStats& heap : allocator.GetHeapStats())
+	{
+		blockCount += heap.blockCount;
+	}
+
+	return blockCount;
+}
+
+
+// Every buffer gets its own pattern, so a copy to the wrong place shows up as well as a missing one.
+static uint32_t GetPatternWord(size_t bufferIndex, size_t wordIndex)
+{
+	return static_cast<uint32_t>(bufferIndex * 2654435761u + wordIndex);
+}
+
+
+static void FillBuffer(const Renderer::Allocation& allocation, size_t bufferIndex)
+{
+	uint32_t* pWords = static_cast<uint32_t*>(allocation.pMapped);
+	for (size_t i = 0; i < kDefragmentationBufferSize / sizeof(uint32_t); ++i)
+	{
+		pWords[i] = GetPatternWord(bufferIndex, i);
+	}
+}
+
+
+static bool CheckBuffer(const Renderer::Allocation& allocation, size_t bufferIndex)
+{
+	const uint32_t* pWords = static_cast<const uint32_t*>(allocation.pMapped);
+	for (size_t i = 0; i < kDefragmentationBufferSize / sizeof(uint32_t); ++i)
+	{
+		if (pWords[i] != GetPatternWord(bufferIndex, i))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+void RunMemoryDefragmentationBenchmark(const BenchmarkContext& context)
+{
+	Renderer::DeviceContext& deviceContext = *context.pDeviceContext;
+	Renderer::MemoryAllocator& allocator = deviceContext.GetMemoryAllocator();
+	VkDevice device = deviceContext.GetLogicalDevice();
+
+	constexpr VkBufferUsageFlags kUsage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+	std::cout << "before:\n";
+	ReportHeapStats(allocator.GetHeapStats());
+
+	std::vector<double> defragmentationTimes;
+	uint32_t movedCount = 0;
+	uint32_t releasedBlockCount = 0;
+
+	for (uint32_t iteration = 0; iteration < context.iterations; ++iteration)
+	{
+		// The first buffer tells us how large the blocks are for this memory type.
+		std::vector<VkBuffer> buffers(1);
+		std::vector<Renderer::Allocation> allocations(1);
+		deviceContext.CreateBuffer(kDefragmentationBufferSize, kUsage, kDefragmentationMemoryProperties, buffers[0], allocations[0]);
+
+		size_t bufferCount = kDefragmentationBlockCount * allocations[0].pBlock->GetSize() / kDefragmentationBufferSize;
+
+		// The pointers handed to the defragmenter have to stay put.
+		buffers.resize(bufferCount);
+		allocations.resize(bufferCount);
+		for (size_t i = 1; i < bufferCount; ++i)
+		{
+			deviceContext.CreateBuffer(kDefragmentationBufferSize, kUsage, kDefragmentationMemoryProperties, buffers[i], allocations[i]);
+		}
+
+		for (size_t i = 0; i < bufferCount; ++i)
+		{
+			FillBuffer(allocations[i], i);
+		}
+
+		// The blocks in the order they were filled. The first may be shared with the renderer's own buffers, the rest
+		// are all ours.
+		std::vector<const Renderer::MemoryBlock*> blocks;
+		for (const Renderer::Allocation& allocation : allocations)
+		{
+			if (std::find(blocks.begin(), blocks.end(), allocation.pBlock) == blocks.end())
+			{
+				blocks.push_back(allocation.pBlock);
+			}
+		}
+
+		if (blocks.size() < 2)
+		{
+			throw std::runtime_error("the buffers should have spread over more than one block");
+		}
+
+		std::vector<const Renderer::MemoryBlock*> sparseBlocks(blocks.begin() + blocks.size() / 2, blocks.end());
+
+		// Punch holes in the first half, and nearly empty the rest.
+		std::vector<size_t> liveBuffers;
+		uint32_t blockBufferIndex = 0;
+		const Renderer::MemoryBlock* pCurrentBlock = nullptr;
+		for (size_t i = 0; i < bufferCount; ++i)
+		{
+			if (allocations[i].pBlock != pCurrentBlock)
+			{
+				pCurrentBlock = allocations[i].pBlock;
+				blockBufferIndex = 0;
+			}
+
+			bool isSparse = std::find(sparseBlocks.begin(), sparseBlocks.end(), pCurrentBlock) != sparseBlocks.end();
+			uint32_t keepInterval = isSparse ? kSparseKeepInterval : 2;
+
+			if (blockBufferIndex++ % keepInterval == 0)
+			{
+				liveBuffers.push_back(i);
+			}
+			else
+			{
+				deviceContext.DestroyBuffer(buffers[i], allocations[i]);
+			}
+		}
+
+		uint32_t blockCountBefore = CountBlocks(allocator);
+
+		if (iteration == 0)
+		{
+			std::cout << "fragmented:\n";
+			ReportHeapStats(allocator.GetHeapStats());
+		}
+
+		auto startTime = std::chrono::high_resolution_clock::now();
+
+		std::vector<Renderer::Allocation*> candidates;
+		for (size_t i : liveBuffers)
+		{
+			candidates.push_back(&allocations[i]);
+		}
+
+		std::vector<Renderer::DefragmentationMove> moves = allocator.BeginDefragmentation(candidates);
+
+		// Each move gets a new buffer bound to its destination, and the contents are copied across on the GPU.
+		std::vector<VkBuffer> newBuffers(moves.size());
+		VkCommandBuffer commandBuffer = deviceContext.BeginSingleTimeCommands();
+		for (size_t i = 0; i < moves.size(); ++i)
+		{
+			VkBufferCreateInfo bufferInfo {};
+			bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+			bufferInfo.size = kDefragmentationBufferSize;
+			bufferInfo.usage = kUsage;
+			bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+			if (vkCreateBuffer(device, &bufferInfo, nullptr, &newBuffers[i]) != VK_SUCCESS)
+			{
+				throw std::runtime_error("failed to create buffer");
+			}
+
+			const Renderer::Allocation& destination = moves[i].destination;
+			if (vkBindBufferMemory(device, newBuffers[i], destination.memory, destination.offset) != VK_SUCCESS)
+			{
+				throw std::runtime_error("failed to bind buffer memory");
+			}
+
+			size_t bufferIndex = moves[i].pAllocation - allocations.data();
+
+			VkBufferCopy region {};
+			region.size = kDefragmentationBufferSize;
+			vkCmdCopyBuffer(commandBuffer, buffers[bufferIndex], newBuffers[i], 1, &region);
+		}
+		deviceContext.EndSingleTimeCommands(commandBuffer);
+
+		// The old buffers are done with, so they can go before their memory does.
+		for (size_t i = 0; i < moves.size(); ++i)
+		{
+			size_t bufferIndex = moves[i].pAllocation - allocations.data();
+			vkDestroyBuffer(device, buffers[bufferIndex], nullptr);
+			buffers[bufferIndex] = newBuffers[i];
+		}
+
+		uint32_t moveCount = static_cast<uint32_t>(moves.size());
+		allocator.EndDefragmentation(moves);
+
+		std::chrono::duration<double, std::milli> defragmentationTime = std::chrono::high_resolution_clock::now() - startTime;
+		defragmentationTimes.push_back(defragmentationTime.count());
+
+		uint32_t blockCountAfter = CountBlocks(allocator);
+
+		if (iteration == 0)
+		{
+			std::cout << "defragmented:\n";
+			ReportHeapStats(allocator.GetHeapStats());
+		}
+
+		for (size_t i : liveBuffers)
+		{
+			if (std::find(sparseBlocks.begin(), sparseBlocks.end(), allocations[i].pBlock) != sparseBlocks.end())
+			{
+				throw std::runtime_error("the defragmenter left a buffer in a sparse block");
+			}
+
+			if (!CheckBuffer(allocations[i], i))
+			{
+				throw std::runtime_error("a buffer's contents didn't survive being moved");
+			}
+		}
+
+		// Any other empty blocks are released along with ours, so there may be more.
+		if (blockCountBefore - blockCountAfter < sparseBlocks.size())
+		{
+			throw std::runtime_error("the sparse blocks weren't given back to the driver");
+		}
+
+		movedCount += moveCount;
+		releasedBlockCount += blockCountBefore - blockCountAfter;
+
+		for (size_t i : liveBuffers)
+		{
+			deviceContext.DestroyBuffer(buffers[i], allocations[i]);
+		}
+		allocator.ReleaseEmptyBlocks();
+	}
+
+	ReportTimings("defragment, copy and rebind", defragmentationTimes);
+
+	std::cout << movedCount << " buffers moved and " << releasedBlockCount << " blocks released over " << context.iterations
+		<< " runs\n";
+
+	std::cout << "after:\n";
+	ReportHeapStats(allocator.GetHeapStats());
+}
+}
@@ -0,0 +1,128 @@
+#include "Benchmarks.h"
+
+#include <vulkan/MeshCache.h>
+
+// STD.
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+
+
+namespace Jettison::Benchmarks
+{
+// A rippled sheet of 708 x 708 quads, just over a million triangles.
+constexpr uint32_t kMeshCacheGridSize = 708;
+
+// Importing a model this size takes seconds, most of it building the levels of detail, so the cold loads are kept few.
+constexpr uint32_t kMaxColdLoadCount = 3;
+
+
+// Load the model, then wait for its upload and throw it away. Returns what the load cost.
+static Renderer::MeshLoadStats LoadAndDestroy(const BenchmarkContext& context, const std::string& path, const Renderer::VertexLayout& layout,
+	std::vector<Renderer::Vertex>* pVertices = nullptr, std::vector<uint32_t>* pIndices = nullptr)
+{
+	Renderer::Model model {context.pDeviceContext, layout};
+	model.LoadModel(path);
+
+	if (pVertices)
+	{
+		*pVertices = model.GetVertices();
+	}
+
+	if (pIndices)
+	{
+		*pIndices = model.m_indices;
+	}
+
+	Renderer::MeshLoadStats loadStats = model.GetLoadStats();
+
+	context.pDeviceContext->WaitIdle();
+	context.pDeviceContext->GetUploadManager().Update();
+	model.Destroy();
+
+	return loadStats;
+}
+
+
+void RunMeshCacheBenchmark(const BenchmarkContext& context)
+{
+	std::string objPath = (std::filesystem::temp_directory_path() / "jettison_mesh_cache_benchmark.obj").string();
+	WriteGridObj(objPath, kMeshCacheGridSize);
+
+	const Renderer::VertexLayout& layout = context.pModel->GetVertexLayout();
+	std::string cachePath = Renderer::GetMeshCachePath(objPath, layout);
+
+	std::cout << "source: " << std::filesystem::file_size(objPath) / (1024 * 1024) << " MB, "
+		<< 2 * kMeshCacheGridSize * kMeshCacheGridSize << " triangles\n";
+
+	// Cold loads parse the OBJ and build everything, then write the cache.
+	std::vector<double> parseTimes;
+	std::vector<double> processTimes;
+	std::vector<double> coldTotalTimes;
+	std::vector<Renderer::Vertex> importedVertices;
+	std::vector<uint32_t> importedIndices;
+
+	for (uint32_t i = 0; i < std::min(context.iterations, kMaxColdLoadCount); ++i)
+	{
+		std::error_code error;
+		std::filesystem::remove(cachePath, error);
+
+		Renderer::MeshLoadStats loadStats = LoadAndDestroy(context, objPath, layout, &importedVertices, &importedIndices);
+		if (loadStats.isCached)
+		{
+			throw std::runtime_error("the cold load came from the mesh cache");
+		}
+
+		parseTimes.push_back(loadStats.parseTime.count());
+		processTimes.push_back(loadStats.processTime.count());
+		coldTotalTimes.push_back(loadStats.totalTime.count());
+	}
+
+	std::cout << "cache: " << std::filesystem::file_size(cachePath) / (1024 * 1024) << " MB\n";
+
+	// Warm loads hash the OBJ and map the cache.
+	std::vector<double> hashTimes;
+	std::vector<double> cacheTimes;
+	std::vector<double> warmTotalTimes;
+	std::vector<Renderer::Vertex> cachedVertices;
+	std::vector<uint32_t> cachedIndices;
+
+	for (uint32_t i = 0; i < context.iterations; ++i)
+	{
+		Renderer::MeshLoadStats loadStats = LoadAndDestroy(context, objPath, layout, &cachedVertices, &cachedIndices);
+		if (!loadStats.isCached)
+		{
+			throw std::runtime_error("the warm load didn't come from the mesh cache");
+		}
+
+		hashTimes.push_back(loadStats.hashTime.count());
+		cacheTimes.push_back(loadStats.cacheTime.count());
+		warmTotalTimes.push_back(loadStats.totalTime.count());
+	}
+
+	ReportTimings("cold obj parse", parseTimes);
+	ReportTimings("cold process", processTimes);
+	ReportTimings("cold total", coldTotalTimes);
+	ReportTimings("warm hash", hashTimes);
+	ReportTimings("warm cache read", cacheTimes);
+	ReportTimings("warm total", warmTotalTimes);
+
+	std::sort(parseTimes.begin(), parseTimes.end());
+	std::sort(warmTotalTimes.begin(), warmTotalTimes.end());
+	std::cout << "cached load is " << parseTimes[parseTimes.size() / 2] / warmTotalTimes[warmTotalTimes.size() / 2]
+		<< "x faster than parsing the obj alone\n";
+
+	std::error_code error;
+	std::filesystem::remove(cachePath, error);
+	std::filesystem::remove(objPath, error);
+
+	// The cache has to give back exactly what the import made.
+	if (cachedVertices.size() != importedVertices.size() || cachedIndices != importedIndices
+		|| memcmp(cachedVertices.data(), importedVertices.data(), sizeof(Renderer::Vertex) * importedVertices.size()) != 0)
+	{
+		throw std::runtime_error("the cached mesh doesn't match the imported one");
+	}
+}
+}
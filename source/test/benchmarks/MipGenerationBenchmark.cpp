@@ -0,0 +1,386 @@
+#include "Benchmarks.h"
+
+#include <vulkan/MipGenerator.h>
+
+// STD.
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+namespace Jettison::Benchmarks
+{
+// Square powers of two, an odd size, and a strip long enough to need a second dispatch.
+const std::array<VkExtent2D, 5> kMipGenerationSizes {{{256, 256}, {1024, 1024}, {2048, 2048}, {1000, 600}, {8192, 128}}};
+
+// In 8 bit sRGB steps. The shader keeps the levels within a group as floats, so it only rounds where the reference
+// doesn't between dispatches, or when the last group reads back the sixth level.
+constexpr int32_t kMaxMipError = 3;
+
+
+struct MipImage
+{
+	VkImage image {VK_NULL_HANDLE};
+	Renderer::Allocation allocation {};
+	uint32_t width {0};
+	uint32_t height {0};
+	uint32_t mipLevels {0};
+};
+
+
+static float SrgbToLinear(float value)
+{
+	return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+
+static float LinearToSrgb(float value)
+{
+	return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+}
+
+
+// Smooth gradients with fine noise on top, so a filter which gets the weights or the sRGB curve wrong shows up.
+static std::vector<uint8_t> MakeMipPixels(uint32_t width, uint32_t height)
+{
+	std::vector<uint8_t> pixels(4 * static_cast<size_t>(width) * height);
+	for (uint32_t y = 0; y < height; ++y)
+	{
+		for (uint32_t x = 0; x < width; ++x)
+		{
+			uint32_t hash = (x * 73856093u) ^ (y * 19349663u);
+			hash = (hash ^ (hash >> 13)) * 0x5bd1e995u;
+
+			uint8_t* pPixel = &pixels[4 * (static_cast<size_t>(y) * width + x)];
+			pPixel[0] = static_cast<uint8_t>(x * 255 / width);
+			pPixel[1] = static_cast<uint8_t>(y * 255 / height);
+			pPixel[2] = static_cast<uint8_t>(hash >> 24);
+			pPixel[3] = static_cast<uint8_t>(128 + ((hash >> 16) & 127));
+		}
+	}
+
+	return pixels;
+}
+
+
+// The levels after the first, as the GPU should build them: a 2x2 box in linear light, alpha left linear.
+static std::vector<std::vector<uint8_t>> MakeReferenceLevels(const std::vector<uint8_t>& pixels, uint32_t width, uint32_t height, uint32_t mipLevels)
+{
+	std::vector<float> level(pixels.size());
+	for (size_t i = 0; i < pixels.size(); ++i)
+	{
+		float value = pixels[i] / 255.0f;
+		level[i] = i % 4 == 3 ? value : SrgbToLinear(value);
+	}
+
+	std::vector<std::vector<uint8_t>> levels;
+	for (uint32_t mipLevel = 1; mipLevel < mipLevels; ++mipLevel)
+	{
+		uint32_t levelWidth = std::max(1u, width / 2);
+		uint32_t levelHeight = std::max(1u, height / 2);
+
+		std::vector<float> reduced(4 * static_cast<size_t>(levelWidth) * levelHeight);
+		std::vector<uint8_t> encoded(reduced.size());
+		for (uint32_t y = 0; y < levelHeight; ++y)
+		{
+			for (uint32_t x = 0; x < levelWidth; ++x)
+			{
+				uint32_t x0 = std::min(2 * x, width - 1);
+				uint32_t x1 = std::min(2 * x + 1, width - 1);
+				uint32_t y0 = std::min(2 * y, height - 1);
+				uint32_t y1 = std::min(2 * y + 1, height - 1);
+
+				for (uint32_t c = 0; c < 4; ++c)
+				{
+					float value = 0.25f * (level[4 * (y0 * width + x0) + c] + level[4 * (y0 * width + x1) + c]
+						+ level[4 * (y1 * width + x0) + c] + level[4 * (y1 * width + x1) + c]);
+
+					size_t index = 4 * (static_cast<size_t>(y) * levelWidth + x) + c;
+					reduced[index] = value;
+					encoded[index] = static_cast<uint8_t>(std::lround(255.0f * (c == 3 ? value : LinearToSrgb(value))));
+				}
+			}
+		}
+
+		levels.push_back(std::move(encoded));
+		level = std::move(reduced);
+		width = levelWidth;
+		height = levelHeight;
+	}
+
+	return levels;
+}
+
+
+static MipImage CreateMipImage(const BenchmarkContext& context, uint32_t width, uint32_t height)
+{
+	MipImage image;
+	image.width = width;
+	image.height = height;
+	image.mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+
+	// Written through UNORM views, so it has to be mutable, and storage only needs supporting in the UNORM format.
+	context.pDeviceContext->CreateImage(width, height, image.mipLevels, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
+		VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image.image, image.allocation,
+		VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT | VK_IMAGE_CREATE_EXTENDED_USAGE_BIT);
+
+	return image;
+}
+
+
+static void TransitionLevels(VkCommandBuffer commandBuffer, const MipImage& image, uint32_t firstLevel, uint32_t levelCount,
+	VkImageLayout oldLayout, VkImageLayout newLayout, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask)
+{
+	VkImageMemoryBarrier barrier {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout = oldLayout;
+	barrier.newLayout = newLayout;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image.image;
+	barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, firstLevel, levelCount, 0, 1};
+	barrier.srcAccessMask = srcAccessMask;
+	barrier.dstAccessMask = dstAccessMask;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+		0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+
+// What the old texture path did: a blit from each level to the next, and a barrier either side.
+static void RecordBlitLevels(VkCommandBuffer commandBuffer, const MipImage& image)
+{
+	int32_t levelWidth = static_cast<int32_t>(image.width);
+	int32_t levelHeight = static_cast<int32_t>(image.height);
+
+	for (uint32_t level = 1; level < image.mipLevels; ++level)
+	{
+		TransitionLevels(commandBuffer, image, level - 1, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+
+		VkImageBlit blit {};
+		blit.srcOffsets[1] = {levelWidth, levelHeight, 1};
+		blit.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1};
+		levelWidth = std::max(1, levelWidth / 2);
+		levelHeight = std::max(1, levelHeight / 2);
+		blit.dstOffsets[1] = {levelWidth, levelHeight, 1};
+		blit.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1};
+
+		vkCmdBlitImage(commandBuffer, image.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			1, &blit, VK_FILTER_LINEAR);
+
+		TransitionLevels(commandBuffer, image, level - 1, 1, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+	}
+}
+
+
+// Record the commands between a pair of timestamps, run them, and return the GPU time in milliseconds.
+static double TimeCommands(const BenchmarkContext& context, VkQueryPool queryPool, double timestampPeriod,
+	const std::function<void(VkCommandBuffer)>& prepare, const std::function<void(VkCommandBuffer)>& record)
+{
+	VkCommandBuffer commandBuffer = context.pDeviceContext->BeginSingleTimeCommands();
+	vkCmdResetQueryPool(commandBuffer, queryPool, 0, 2);
+	prepare(commandBuffer);
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 0);
+	record(commandBuffer);
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 1);
+	context.pDeviceContext->EndSingleTimeCommands(commandBuffer);
+
+	std::array<uint64_t, 2> timestamps {};
+	vkGetQueryPoolResults(context.pDeviceContext->GetLogicalDevice(), queryPool, 0, 2, sizeof(timestamps), timestamps.data(),
+		sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+
+	return static_cast<double>(timestamps[1] - timestamps[0]) * timestampPeriod / 1.0e6;
+}
+
+
+// Copy every level after the first back, and return the largest difference from the reference.
+static int32_t CompareLevels(const BenchmarkContext& context, const MipImage& image, const std::vector<std::vector<uint8_t>>& referenceLevels)
+{
+	VkDeviceSize size = 0;
+	std::vector<VkBufferImageCopy> regions;
+	for (uint32_t level = 1; level < image.mipLevels; ++level)
+	{
+		VkBufferImageCopy region {};
+		region.bufferOffset = size;
+		region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1};
+		region.imageExtent = {std::max(1u, image.width >> level), std::max(1u, image.height >> level), 1};
+		regions.push_back(region);
+
+		size += referenceLevels[level - 1].size();
+	}
+
+	VkBuffer buffer;
+	Renderer::Allocation allocation;
+	context.pDeviceContext->CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		buffer, allocation);
+
+	VkCommandBuffer commandBuffer = context.pDeviceContext->BeginSingleTimeCommands();
+	vkCmdCopyImageToBuffer(commandBuffer, image.image, VK_IMAGE_LAYOUT_GENERAL, buffer, static_cast<uint32_t>(regions.size()), regions.data());
+	context.pDeviceContext->EndSingleTimeCommands(commandBuffer);
+
+	int32_t maxError = 0;
+	const uint8_t* pLevel = static_cast<const uint8_t*>(allocation.pMapped);
+	for (const auto& referenceLevel : referenceLevels)
+	{
+		for (size_t i = 0; i < referenceLevel.size(); ++i)
+		{
+			maxError = std::max(maxError, std::abs(static_cast<int32_t>(pLevel[i]) - static_cast<int32_t>(referenceLevel[i])));
+		}
+
+		pLevel += referenceLevel.size();
+	}
+
+	context.pDeviceContext->DestroyBuffer(buffer, allocation);
+
+	return maxError;
+}
+
+
+void RunMipGenerationBenchmark(const BenchmarkContext& context)
+{
+	Renderer::MipGenerator& mipGenerator = context.pPipeline->GetMipGenerator();
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(context.pDeviceContext->GetPhysicalDevice(), &properties);
+	bool isTimed = properties.limits.timestampComputeAndGraphics == VK_TRUE;
+	double timestampPeriod = properties.limits.timestampPeriod;
+
+	// Not every device can blit sRGB with a linear filter, which is one of the reasons for the compute path.
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(context.pDeviceContext->GetPhysicalDevice(), VK_FORMAT_R8G8B8A8_SRGB, &formatProperties);
+	VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+	bool isBlitSupported = (formatProperties.optimalTilingFeatures & blitFeatures) == blitFeatures;
+
+	VkQueryPool queryPool = VK_NULL_HANDLE;
+	if (isTimed)
+	{
+		VkQueryPoolCreateInfo queryPoolInfo {};
+		queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolInfo.queryCount = 2;
+
+		if (vkCreateQueryPool(context.pDeviceContext->GetLogicalDevice(), &queryPoolInfo, nullptr, &queryPool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create mip generation query pool");
+		}
+	}
+	else
+	{
+		std::cout << "timestamps unsupported, checking the levels without timing them\n";
+	}
+
+	int32_t worstError = 0;
+
+	for (const VkExtent2D& size : kMipGenerationSizes)
+	{
+		std::vector<uint8_t> pixels = MakeMipPixels(size.width, size.height);
+		MipImage image = CreateMipImage(context, size.width, size.height);
+
+		Renderer::UploadManager& uploadManager = context.pDeviceContext->GetUploadManager();
+		uploadManager.UploadImage(image.image, pixels.data(), pixels.size(), size.width, size.height, image.mipLevels);
+		uploadManager.Wait(uploadManager.Submit());
+
+		// The upload leaves every level a transfer destination. From here on the first is kept in the general layout.
+		VkCommandBuffer commandBuffer = context.pDeviceContext->BeginSingleTimeCommands();
+		TransitionLevels(commandBuffer, image, 0, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL,
+			VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+		context.pDeviceContext->EndSingleTimeCommands(commandBuffer);
+
+		Renderer::MipChain chain = mipGenerator.CreateChain(image.image, VK_FORMAT_R8G8B8A8_SRGB, size.width, size.height, image.mipLevels);
+
+		// The levels being built are thrown away each time, outside the timestamps.
+		auto prepareCompute = [&image](VkCommandBuffer commandBuffer)
+			{
+				TransitionLevels(commandBuffer, image, 1, image.mipLevels - 1, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+					0, VK_ACCESS_SHADER_WRITE_BIT);
+			};
+		auto recordCompute = [&mipGenerator, &chain](VkCommandBuffer commandBuffer)
+			{
+				mipGenerator.RecordGenerate(commandBuffer, chain);
+			};
+
+		std::vector<double> computeTimes;
+		for (uint32_t i = 0; i < context.iterations; ++i)
+		{
+			if (isTimed)
+			{
+				computeTimes.push_back(TimeCommands(context, queryPool, timestampPeriod, prepareCompute, recordCompute));
+			}
+			else
+			{
+				commandBuffer = context.pDeviceContext->BeginSingleTimeCommands();
+				prepareCompute(commandBuffer);
+				recordCompute(commandBuffer);
+				context.pDeviceContext->EndSingleTimeCommands(commandBuffer);
+			}
+		}
+
+		std::vector<std::vector<uint8_t>> referenceLevels = MakeReferenceLevels(pixels, size.width, size.height, image.mipLevels);
+		int32_t maxError = CompareLevels(context, image, referenceLevels);
+		worstError = std::max(worstError, maxError);
+
+		std::cout << size.width << " x " << size.height << ", " << image.mipLevels - 1 << " levels in " << chain.dispatches.size()
+			<< (chain.dispatches.size() == 1 ? " dispatch" : " dispatches") << ", largest error " << maxError << " of 255\n";
+
+		if (isTimed)
+		{
+			ReportTimings("gpu compute", computeTimes);
+		}
+
+		if (isTimed && isBlitSupported)
+		{
+			auto prepareBlit = [&image](VkCommandBuffer commandBuffer)
+				{
+					TransitionLevels(commandBuffer, image, 0, 1, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+						VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+					TransitionLevels(commandBuffer, image, 1, image.mipLevels - 1, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+						0, VK_ACCESS_TRANSFER_WRITE_BIT);
+				};
+			auto recordBlit = [&image](VkCommandBuffer commandBuffer)
+				{
+					RecordBlitLevels(commandBuffer, image);
+				};
+
+			std::vector<double> blitTimes;
+			for (uint32_t i = 0; i < context.iterations; ++i)
+			{
+				blitTimes.push_back(TimeCommands(context, queryPool, timestampPeriod, prepareBlit, recordBlit));
+
+				// Put the first level back the way the compute path wants it.
+				commandBuffer = context.pDeviceContext->BeginSingleTimeCommands();
+				TransitionLevels(commandBuffer, image, 0, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL,
+					VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT);
+				context.pDeviceContext->EndSingleTimeCommands(commandBuffer);
+			}
+
+			ReportTimings("gpu blit per level", blitTimes);
+		}
+
+		Renderer::MipGenerator::DestroyChain(context.pDeviceContext.get(), chain);
+		context.pDeviceContext->DestroyImage(image.image, image.allocation);
+	}
+
+	if (!isBlitSupported)
+	{
+		std::cout << "sRGB can't be blitted with a linear filter on this device, compute only\n";
+	}
+
+	if (queryPool != VK_NULL_HANDLE)
+	{
+		vkDestroyQueryPool(context.pDeviceContext->GetLogicalDevice(), queryPool, nullptr);
+	}
+
+	if (worstError > kMaxMipError)
+	{
+		throw std::runtime_error("generated levels differ from the reference by " + std::to_string(worstError));
+	}
+}
+}
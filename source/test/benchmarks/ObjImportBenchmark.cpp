@@ -0,0 +1,204 @@
+#include "Benchmarks.h"
+
+#include <vulkan/ObjImporter.h>
+
+// The importer the renderer used before, kept here to compare against.
+#define TINYOBJLOADER_IMPLEMENTATION
+#include <../tiny_obj_loader/include/tiny_obj_loader.h>
+
+// STD.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+
+
+namespace Jettison::Benchmarks
+{
+// A rippled sheet of 1000 x 1000 quads, two million triangles.
+constexpr uint32_t kObjImportGridSize = 1000;
+
+// Each import takes seconds with the old importer, so the repeats are kept few.
+constexpr uint32_t kMaxImportCount = 3;
+
+// Both parse the same text, but not necessarily with the same rounding.
+constexpr float kMaxImportError = 1e-6f;
+
+
+// Parse with tinyobj and weld through std::unordered_map, as Model::ImportObj used to.
+static void ImportWithTinyObj(const std::string& path, std::vector<Renderer::Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+	tinyobj::attrib_t attrib;
+	std::vector<tinyobj::shape_t> shapes;
+	std::vector<tinyobj::material_t> materials;
+	std::string warn;
+	std::string err;
+
+	if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path.c_str()))
+	{
+		throw std::runtime_error(warn + err);
+	}
+
+	std::unordered_map<Renderer::Vertex, uint32_t> uniqueVertices {};
+
+	for (const auto& shape : shapes)
+	{
+		for (const auto& index : shape.mesh.indices)
+		{
+			Renderer::Vertex vertex {};
+			vertex.pos = {attrib.vertices[3 * index.vertex_index + 0], attrib.vertices[3 * index.vertex_index + 1],
+				attrib.vertices[3 * index.vertex_index + 2]};
+			vertex.texCoord = {attrib.texcoords[2 * index.texcoord_index + 0], 1.0f - attrib.texcoords[2 * index.texcoord_index + 1]};
+			vertex.color = {1.0f, 1.0f, 1.0f};
+			vertex.normal = {attrib.normals[3 * index.normal_index + 0], attrib.normals[3 * index.normal_index + 1],
+				attrib.normals[3 * index.normal_index + 2]};
+
+			if (uniqueVertices.count(vertex) == 0)
+			{
+				uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
+				vertices.push_back(vertex);
+			}
+
+			indices.push_back(uniqueVertices[vertex]);
+		}
+	}
+}
+
+
+// The welded vertices may come out in any order, so the triangles are compared corner by corner.
+static float GetImportError(const Renderer::ObjMesh& mesh, const std::vector<Renderer::Vertex>& vertices, const std::vector<uint32_t>& indices)
+{
+	if (mesh.vertices.size() != vertices.size() || mesh.indices.size() != indices.size())
+	{
+		throw std::runtime_error("the imports welded a different number of vertices or triangles");
+	}
+
+	float maxError = 0.0f;
+	for (size_t i = 0; i < indices.size(); ++i)
+	{
+		const Renderer::Vertex& vertex = mesh.vertices[mesh.indices[i]];
+		const Renderer::Vertex& expected = vertices[indices[i]];
+
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			maxError = std::max(maxError, std::abs(vertex.pos[axis] - expected.pos[axis]));
+			maxError = std::max(maxError, std::abs(vertex.normal[axis] - expected.normal[axis]));
+		}
+
+		for (int axis = 0; axis < 2; ++axis)
+		{
+			maxError = std::max(maxError, std::abs(vertex.texCoord[axis] - expected.texCoord[axis]));
+		}
+	}
+
+	return maxError;
+}
+
+
+static double GetMedian(std::vector<double> samples)
+{
+	std::sort(samples.begin(), samples.end());
+	return samples[samples.size() / 2];
+}
+
+
+void RunObjImportBenchmark(const BenchmarkContext& context)
+{
+	std::string objPath = (std::filesystem::temp_directory_path() / "jettison_obj_import_benchmark.obj").string();
+	WriteGridObj(objPath, kObjImportGridSize);
+
+	std::cout << "source: " << std::filesystem::file_size(objPath) / (1024 * 1024) << " MB, "
+		<< 2 * kObjImportGridSize * kObjImportGridSize << " triangles\n";
+
+	uint32_t importCount = std::min(context.iterations, kMaxImportCount);
+
+	std::vector<Renderer::Vertex> expectedVertices;
+	std::vector<uint32_t> expectedIndices;
+	std::vector<double> baselineTimes;
+
+	for (uint32_t i = 0; i < importCount; ++i)
+	{
+		expectedVertices.clear();
+		expectedIndices.clear();
+
+		auto startTime = std::chrono::high_resolution_clock::now();
+		ImportWithTinyObj(objPath, expectedVertices, expectedIndices);
+		baselineTimes.push_back(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count());
+	}
+
+	ReportTimings("tinyobj + unordered_map", baselineTimes);
+	std::cout << expectedVertices.size() << " unique vertices\n";
+
+	// One thread, then twice as many each time, finishing on one per core.
+	uint32_t coreCount = std::max(std::thread::hardware_concurrency(), 1u);
+	std::vector<uint32_t> threadCounts;
+	for (uint32_t threadCount = 1; threadCount < coreCount; threadCount *= 2)
+	{
+		threadCounts.push_back(threadCount);
+	}
+
+	threadCounts.push_back(coreCount);
+
+	Renderer::ObjMesh firstMesh;
+	double singleThreadTime = 0.0;
+
+	for (uint32_t threadCount : threadCounts)
+	{
+		std::vector<double> parseTimes;
+		std::vector<double> weldTimes;
+		std::vector<double> totalTimes;
+		Renderer::ObjMesh mesh;
+
+		for (uint32_t i = 0; i < importCount; ++i)
+		{
+			Renderer::ObjImportStats importStats;
+
+			auto startTime = std::chrono::high_resolution_clock::now();
+			mesh = Renderer::ImportObjMesh(objPath, threadCount, &importStats);
+			totalTimes.push_back(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count());
+
+			parseTimes.push_back(importStats.parseTime.count());
+			weldTimes.push_back(importStats.weldTime.count());
+		}
+
+		std::string label = std::to_string(threadCount) + (threadCount == 1 ? " thread" : " threads");
+		ReportTimings(label + " parse", parseTimes);
+		ReportTimings(label + " weld", weldTimes);
+		ReportTimings(label + " total", totalTimes);
+
+		double medianTime = GetMedian(totalTimes);
+		if (threadCount == 1)
+		{
+			singleThreadTime = medianTime;
+		}
+
+		std::cout << label << ": " << GetMedian(baselineTimes) / medianTime << "x faster than tinyobj, "
+			<< singleThreadTime / medianTime << "x faster than one thread\n";
+
+		float maxError = GetImportError(mesh, expectedVertices, expectedIndices);
+		if (maxError > kMaxImportError)
+		{
+			throw std::runtime_error("the import differs from tinyobj's by " + std::to_string(maxError));
+		}
+
+		// However the work is shared out, the mesh has to come out the same.
+		if (threadCount == 1)
+		{
+			firstMesh = std::move(mesh);
+		}
+		else if (mesh.indices != firstMesh.indices
+			|| memcmp(mesh.vertices.data(), firstMesh.vertices.data(), sizeof(Renderer::Vertex) * mesh.vertices.size()) != 0)
+		{
+			throw std::runtime_error("the import with " + label + " differs from the import with one");
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::remove(objPath, error);
+}
+}
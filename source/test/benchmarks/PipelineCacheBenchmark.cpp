@@ -0,0 +1,61 @@
+#include "Benchmarks.h"
+
+// STD.
+#include <chrono>
+#include <iostream>
+
+
+namespace Jettison::Benchmarks
+{
+// Time to recreate the pipelines, and how much of that was spent compiling them.
+static void MeasurePipelineCreation(const BenchmarkContext& context, std::vector<double>& createTimes, std::vector<double>& pipelineTimes)
+{
+	Renderer::PipelineCache& pipelineCache = context.pDeviceContext->GetPipelineCache();
+	double pipelineTimeBefore = pipelineCache.GetStats().creationTime.count();
+
+	// The pipelines from the last iteration may still be in use.
+	context.pDeviceContext->WaitIdle();
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+	context.pPipeline->RecreatePipelines();
+	std::chrono::duration<double, std::milli> createTime = std::chrono::high_resolution_clock::now() - startTime;
+
+	createTimes.push_back(createTime.count());
+	pipelineTimes.push_back(pipelineCache.GetStats().creationTime.count() - pipelineTimeBefore);
+}
+
+
+void RunPipelineCacheBenchmark(const BenchmarkContext& context)
+{
+	Renderer::PipelineCache& pipelineCache = context.pDeviceContext->GetPipelineCache();
+
+	std::cout << "pipeline cache: loaded from disk " << (pipelineCache.GetStats().isWarm ? "warm" : "cold")
+		<< ", first start up took " << pipelineCache.GetStats().creationTime.count() << " ms in pipeline creation\n";
+
+	// Cold, the cache is emptied before each creation.
+	std::vector<double> coldCreateTimes;
+	std::vector<double> coldPipelineTimes;
+	for (uint32_t i = 0; i < context.iterations; ++i)
+	{
+		pipelineCache.Reset();
+		MeasurePipelineCreation(context, coldCreateTimes, coldPipelineTimes);
+	}
+
+	// Warm, the cache is left holding the last pipelines which were created. This is the state it is in after being
+	// saved and loaded again on the next run.
+	std::vector<double> warmCreateTimes;
+	std::vector<double> warmPipelineTimes;
+	for (uint32_t i = 0; i < context.iterations; ++i)
+	{
+		MeasurePipelineCreation(context, warmCreateTimes, warmPipelineTimes);
+	}
+
+	ReportTimings("cold pipeline creation", coldPipelineTimes);
+	ReportTimings("warm pipeline creation", warmPipelineTimes);
+	ReportTimings("cold Pipeline::RecreatePipelines", coldCreateTimes);
+	ReportTimings("warm Pipeline::RecreatePipelines", warmCreateTimes);
+
+	// The model was recorded against the old pipelines.
+	context.pRenderer->MarkSceneDirty();
+}
+}
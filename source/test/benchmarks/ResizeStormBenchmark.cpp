@@ -0,0 +1,90 @@
+#include "Benchmarks.h"
+
+// GLFW / Vulkan.
+#define GLFW_INCLUDE_VULKAN
+#include <../glfw/include/GLFW/glfw3.h>
+
+// STD.
+#include <array>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+
+
+namespace Jettison::Benchmarks
+{
+// Window sizes to cycle through, as if the user were dragging the corner of the window about.
+constexpr std::array<std::pair<int, int>, 4> kStormSizes = {{
+	{1280, 720},
+	{1600, 900},
+	{1024, 768},
+	{1920, 1080},
+}};
+
+constexpr uint32_t kResizesPerStorm = 32;
+
+
+void RunResizeStormBenchmark(const BenchmarkContext& context)
+{
+	if (context.pWindow == nullptr)
+	{
+		throw std::runtime_error("the resize storm benchmark needs a window");
+	}
+
+	GLFWwindow* pGLFWWindow = context.pWindow->GetGLFWWindow();
+
+	int originalWidth;
+	int originalHeight;
+	glfwGetWindowSize(pGLFWWindow, &originalWidth, &originalHeight);
+
+	// Settle, so the first measurements don't include the initial uploads.
+	for (uint32_t i = 0; i < 10; ++i)
+	{
+		glfwPollEvents();
+		context.pRenderer->DrawFrame();
+	}
+
+	uint32_t recreateCountBefore = context.pRenderer->GetSwapchainRecreateCount();
+	uint32_t memoryAllocationsBefore = context.pDeviceContext->GetMemoryAllocator().GetDeviceMemoryAllocationCount();
+
+	std::vector<double> resizeFrameTimes;
+	std::vector<double> stormTimes;
+
+	for (uint32_t storm = 0; storm < context.iterations; ++storm)
+	{
+		auto stormStartTime = std::chrono::high_resolution_clock::now();
+
+		// One frame between each resize, which is about as fast as a window manager delivers them.
+		for (uint32_t i = 0; i < kResizesPerStorm; ++i)
+		{
+			const auto& size = kStormSizes[i % kStormSizes.size()];
+			glfwSetWindowSize(pGLFWWindow, size.first, size.second);
+
+			auto frameStartTime = std::chrono::high_resolution_clock::now();
+			glfwPollEvents();
+			context.pRenderer->DrawFrame();
+			std::chrono::duration<double, std::milli> frameTime = std::chrono::high_resolution_clock::now() - frameStartTime;
+
+			resizeFrameTimes.push_back(frameTime.count());
+		}
+
+		std::chrono::duration<double, std::milli> stormTime = std::chrono::high_resolution_clock::now() - stormStartTime;
+		stormTimes.push_back(stormTime.count());
+	}
+
+	// Put things back the way they were, and give the retired resources a chance to be released.
+	glfwSetWindowSize(pGLFWWindow, originalWidth, originalHeight);
+	for (uint32_t i = 0; i < 10; ++i)
+	{
+		glfwPollEvents();
+		context.pRenderer->DrawFrame();
+	}
+
+	ReportTimings("frame with resize", resizeFrameTimes);
+	ReportTimings("storm of " + std::to_string(kResizesPerStorm) + " resizes", stormTimes);
+
+	std::cout << "swapchain recreated " << context.pRenderer->GetSwapchainRecreateCount() - recreateCountBefore << " times"
+		<< ", device memory allocations " << memoryAllocationsBefore
+		<< " before and " << context.pDeviceContext->GetMemoryAllocator().GetDeviceMemoryAllocationCount() << " after\n";
+}
+}
@@ -0,0 +1,174 @@
+#include "Benchmarks.h"
+
+#include <vulkan/MeshCache.h>
+#include <vulkan/TextureCooker.h>
+
+#include <../stb/include/stb_image.h>
+
+// STD.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+
+
+namespace Jettison::Benchmarks
+{
+// The texture the pipeline loads.
+const std::string kTextureCompressionSourcePath = "assets/textures/viking_room.png";
+
+// Cooking a large texture to BC7 takes seconds, so the cooks are kept few.
+constexpr uint32_t kMaxCookCount = 3;
+
+
+struct TextureCompressionCase
+{
+	const char* pLabel;
+	Renderer::TextureCookSettings settings;
+
+	// The lowest acceptable peak signal to noise ratio for the largest level, in dB. Anything under 30 dB shows
+	// obvious blocking.
+	double minPsnr;
+};
+
+
+// The peak signal to noise ratio of a decompressed level against its source, over the channels the format keeps.
+static double GetPsnr(const uint8_t* pSource, const uint8_t* pTexels, uint32_t width, uint32_t height, uint32_t channelCount)
+{
+	double squaredError = 0.0;
+	for (uint64_t i = 0; i < uint64_t {width} * height; ++i)
+	{
+		for (uint32_t channel = 0; channel < channelCount; ++channel)
+		{
+			double difference = static_cast<int>(pSource[4 * i + channel]) - static_cast<int>(pTexels[4 * i + channel]);
+			squaredError += difference * difference;
+		}
+	}
+
+	double meanSquaredError = squaredError / (static_cast<double>(width) * height * channelCount);
+	if (meanSquaredError == 0.0)
+	{
+		return 100.0;
+	}
+
+	return 10.0 * std::log10(255.0 * 255.0 / meanSquaredError);
+}
+
+
+void RunTextureCompressionBenchmark(const BenchmarkContext& context)
+{
+	int width;
+	int height;
+	int channels;
+	stbi_uc* pSource = stbi_load(kTextureCompressionSourcePath.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+	if (!pSource)
+	{
+		throw std::runtime_error("failed to load texture image");
+	}
+
+	std::vector<uint8_t> source(pSource, pSource + 4 * uint64_t {static_cast<uint32_t>(width)} * static_cast<uint32_t>(height));
+	stbi_image_free(pSource);
+
+	std::cout << "source: " << width << " x " << height << ", " << std::filesystem::file_size(kTextureCompressionSourcePath) / 1024
+		<< " KB on disk\n";
+
+	// BC5 keeps the colour texture's red and green. It isn't a normal map, but only the encoder is being measured, and
+	// that doesn't need the texels to be unit length.
+	const TextureCompressionCase cases[] = {
+		{"rgba8", {Renderer::TextureFormat::Rgba8, true, false}, 100.0},
+		{"bc1", {Renderer::TextureFormat::Bc1, true, false}, 30.0},
+		{"bc3", {Renderer::TextureFormat::Bc3, true, false}, 30.0},
+		{"bc5", {Renderer::TextureFormat::Bc5, false, false}, 36.0},
+		{"bc7", {Renderer::TextureFormat::Bc7, true, false}, 38.0},
+	};
+
+	uint64_t uncompressedSize = 0;
+	uint32_t cookCount = std::min(context.iterations, kMaxCookCount);
+
+	for (const TextureCompressionCase& textureCase : cases)
+	{
+		std::vector<double> cookTimes;
+		Renderer::CookedTexture cooked;
+
+		for (uint32_t i = 0; i < cookCount; ++i)
+		{
+			auto startTime = std::chrono::high_resolution_clock::now();
+			cooked = Renderer::CookTexture(source.data(), width, height, textureCase.settings);
+			cookTimes.push_back(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count());
+		}
+
+		if (textureCase.settings.format == Renderer::TextureFormat::Rgba8)
+		{
+			uncompressedSize = cooked.data.size();
+		}
+
+		// Only the largest level is compared, the others are filtered from it and have no source of their own.
+		const Renderer::TextureLevel& level = cooked.levels.front();
+		std::vector<uint8_t> texels(4 * uint64_t {level.width} * level.height);
+		Renderer::DecompressTextureLevel(textureCase.settings.format, cooked.data.data() + level.offset, level.width, level.height,
+			texels.data());
+
+		uint32_t channelCount = textureCase.settings.format == Renderer::TextureFormat::Bc5 ? 2 : (channels == 4 ? 4 : 3);
+		double psnr = GetPsnr(source.data(), texels.data(), level.width, level.height, channelCount);
+
+		ReportTimings(std::string(textureCase.pLabel) + " cook", cookTimes);
+		std::cout << textureCase.pLabel << ": " << cooked.levels.size() << " levels, " << cooked.data.size() / 1024 << " KB, "
+			<< static_cast<double>(uncompressedSize) / cooked.data.size() << "x smaller than rgba8, " << psnr << " dB\n";
+
+		if (psnr < textureCase.minPsnr)
+		{
+			throw std::runtime_error(std::string(textureCase.pLabel) + " lost too much quality, " + std::to_string(psnr) + " dB");
+		}
+	}
+
+	// What the pipeline did at start up: decoding the source and building the levels, against mapping them.
+	Renderer::TextureCookSettings settings;
+	std::string cachePath = (std::filesystem::temp_directory_path() / "jettison_texture_compression_benchmark.tex").string();
+	uint64_t sourceHash = Renderer::HashFileContents(kTextureCompressionSourcePath);
+
+	Renderer::CookedTexture cooked = Renderer::CookTexture(source.data(), width, height, settings);
+	Renderer::WriteTextureFile(cachePath, sourceHash, cooked.GetView());
+
+	std::vector<double> decodeTimes;
+	std::vector<double> mapTimes;
+	volatile uint64_t pageSum = 0;
+
+	for (uint32_t i = 0; i < context.iterations; ++i)
+	{
+		auto startTime = std::chrono::high_resolution_clock::now();
+		stbi_uc* pPixels = stbi_load(kTextureCompressionSourcePath.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+		decodeTimes.push_back(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count());
+		stbi_image_free(pPixels);
+
+		startTime = std::chrono::high_resolution_clock::now();
+		Renderer::TextureFile textureFile;
+		if (!textureFile.Open(cachePath, sourceHash, settings))
+		{
+			throw std::runtime_error("failed to open the cooked texture");
+		}
+
+		// Touch every page, as copying to staging would.
+		const Renderer::TextureView& texture = textureFile.GetTexture();
+		for (uint64_t offset = 0; offset < texture.dataSize; offset += 4096)
+		{
+			pageSum += texture.pData[offset];
+		}
+
+		mapTimes.push_back(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count());
+		textureFile.Close();
+	}
+
+	ReportTimings("png decode, one level", decodeTimes);
+	ReportTimings("cooked map, every level", mapTimes);
+
+	const Renderer::TextureLoadStats& loadStats = context.pPipeline->GetTextureLoadStats();
+	std::cout << "pipeline: " << Renderer::GetTextureFormatName(loadStats.format) << (Renderer::IsBlockCompressed(loadStats.format) && !loadStats.isCompressed ? " decompressed to rgba8" : "")
+		<< ", " << loadStats.levelCount << " levels, " << loadStats.size / 1024 << " KB on the device, "
+		<< (loadStats.isCached ? "loaded from the texture cache" : "cooked") << " in " << loadStats.totalTime.count() << " ms\n";
+
+	std::error_code error;
+	std::filesystem::remove(cachePath, error);
+}
+}
@@ -0,0 +1,170 @@
+#include "Benchmarks.h"
+
+#include <vulkan/TextureStreamer.h>
+
+// STD.
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+
+namespace Jettison::Benchmarks
+{
+// The texture the pipeline loads, loaded again for each of the extra textures.
+const std::string kTextureStreamingSourcePath = "assets/textures/viking_room.png";
+
+// Competing for a budget which only fits two of them at full detail.
+constexpr uint32_t kStreamedTextureCount = 4;
+
+// Streaming should settle within a few frames, this is only so a bug can't hang the benchmark.
+constexpr uint32_t kMaxSettleFrameCount = 1000;
+
+
+static bool IsSettled(const Renderer::TextureStreamer& textureStreamer, Renderer::StreamedTextureId texture)
+{
+	Renderer::TextureResidencyStats stats = textureStreamer.GetResidencyStats(texture);
+	return !stats.isStreaming && stats.residentLevel == stats.targetLevel;
+}
+
+
+// Draw frames, asking for the textures at full detail each time, until every texture has what the budget allows.
+// Returns the frame times.
+static std::vector<double> DrawUntilSettled(const BenchmarkContext& context, const std::vector<Renderer::StreamedTextureId>& requestedTextures,
+	const std::vector<Renderer::StreamedTextureId>& textures)
+{
+	Renderer::TextureStreamer& textureStreamer = context.pPipeline->GetTextureStreamer();
+	std::vector<double> frameTimes;
+
+	// The first frame takes the requests, so nothing can have settled before it.
+	do
+	{
+		if (frameTimes.size() == kMaxSettleFrameCount)
+		{
+			throw std::runtime_error("the textures didn't settle");
+		}
+
+		for (Renderer::StreamedTextureId texture : requestedTextures)
+		{
+			textureStreamer.RequestLevel(texture, 0);
+		}
+
+		auto startTime = std::chrono::high_resolution_clock::now();
+		context.pRenderer->DrawFrame();
+		frameTimes.push_back(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count());
+	}
+	while (frameTimes.size() < 2 || !std::all_of(textures.begin(), textures.end(),
+		[&textureStreamer](Renderer::StreamedTextureId texture) { return IsSettled(textureStreamer, texture); }));
+
+	return frameTimes;
+}
+
+
+static void ReportResidency(const Renderer::TextureStreamer& textureStreamer, const std::vector<Renderer::StreamedTextureId>& textures)
+{
+	for (Renderer::StreamedTextureId texture : textures)
+	{
+		Renderer::TextureResidencyStats stats = textureStreamer.GetResidencyStats(texture);
+		std::cout << "  texture " << texture << ": level " << stats.residentLevel << " resident, " << stats.requestedLevel << " requested, "
+			<< stats.residentSize / 1024 << " of " << stats.fullSize / 1024 << " KB, " << stats.streamInCount << " streamed in, "
+			<< stats.evictionCount << " evicted\n";
+	}
+
+	const Renderer::TextureStreamingStats& stats = textureStreamer.GetStats();
+	std::cout << "  " << stats.residentSize / 1024 << " KB resident of a " << stats.budget / 1024 << " KB budget, "
+		<< stats.requestedSize / 1024 << " KB requested\n";
+}
+
+
+void RunTextureStreamingBenchmark(const BenchmarkContext& context)
+{
+	Renderer::TextureStreamer& textureStreamer = context.pPipeline->GetTextureStreamer();
+	Renderer::StreamedTextureId defaultTexture = context.pPipeline->GetDefaultStreamedTexture();
+	VkDeviceSize previousBudget = textureStreamer.GetBudget();
+
+	context.pRenderer->SetModel(context.pModel);
+	while (!context.pRenderer->IsSceneReady())
+	{
+		context.pRenderer->DrawFrame();
+	}
+
+	// Squeeze the default texture down to its tail, then let it stream back in at the level the model needs.
+	textureStreamer.SetBudget(0);
+	DrawUntilSettled(context, {}, {defaultTexture});
+
+	Renderer::TextureResidencyStats tailStats = textureStreamer.GetResidencyStats(defaultTexture);
+	if (tailStats.residentLevel != tailStats.tailLevel)
+	{
+		throw std::runtime_error("the default texture wasn't evicted down to its tail");
+	}
+
+	textureStreamer.SetBudget(previousBudget);
+
+	VkDeviceSize uploadedSize = textureStreamer.GetStats().uploadedSize;
+	std::vector<double> streamInTimes = DrawUntilSettled(context, {}, {defaultTexture});
+
+	Renderer::TextureResidencyStats streamedStats = textureStreamer.GetResidencyStats(defaultTexture);
+	std::cout << "default texture: level " << streamedStats.tailLevel << " to " << streamedStats.residentLevel << " of "
+		<< streamedStats.levelCount << " in " << streamInTimes.size() << " frames, "
+		<< (textureStreamer.GetStats().uploadedSize - uploadedSize) / 1024 << " KB uploaded, "
+		<< streamedStats.residentSize / 1024 << " of " << streamedStats.fullSize / 1024 << " KB resident\n";
+	ReportTimings("frame while streaming in", streamInTimes);
+
+	// More textures than fit, asked for two at a time. The pair asked for most recently should be fully resident,
+	// and the pair before evicted to make room.
+	std::vector<Renderer::StreamedTextureId> textures;
+	VkDeviceSize tailSize = 0;
+	for (uint32_t i = 0; i < kStreamedTextureCount; ++i)
+	{
+		textures.push_back(textureStreamer.LoadTexture(kTextureStreamingSourcePath));
+		tailSize += textureStreamer.GetResidencyStats(textures.back()).residentSize;
+	}
+
+	VkDeviceSize fullSize = textureStreamer.GetResidencyStats(textures[0]).fullSize;
+	VkDeviceSize budget = streamedStats.residentSize + tailSize + 2 * (fullSize - tailSize / kStreamedTextureCount);
+	textureStreamer.SetBudget(budget);
+
+	std::vector<Renderer::StreamedTextureId> allTextures = textures;
+	allTextures.push_back(defaultTexture);
+
+	for (uint32_t pair = 0; pair < 2; ++pair)
+	{
+		std::vector<Renderer::StreamedTextureId> requestedTextures {textures[2 * pair], textures[2 * pair + 1]};
+		std::vector<double> frameTimes = DrawUntilSettled(context, requestedTextures, allTextures);
+
+		std::cout << "textures " << requestedTextures[0] << " and " << requestedTextures[1] << " asked for, settled in "
+			<< frameTimes.size() << " frames\n";
+		ReportResidency(textureStreamer, allTextures);
+		ReportTimings("frame while swapping", frameTimes);
+
+		if (textureStreamer.GetStats().residentSize > budget)
+		{
+			throw std::runtime_error("the textures settled over the budget");
+		}
+
+		// Before the second pair is asked for, it is still at its tail.
+		for (uint32_t i = 0; i < kStreamedTextureCount; ++i)
+		{
+			bool isRequested = i / 2 == pair;
+			bool isFullyResident = textureStreamer.GetResidencyStats(textures[i]).residentLevel == 0;
+			if (isRequested != isFullyResident)
+			{
+				throw std::runtime_error("texture " + std::to_string(textures[i]) + (isRequested ? " wasn't streamed in" : " wasn't evicted"));
+			}
+		}
+	}
+
+	const Renderer::TextureStreamingStats& stats = textureStreamer.GetStats();
+	std::cout << stats.streamInCount << " streamed in, " << stats.evictionCount << " evicted, " << stats.uploadedSize / (1024 * 1024)
+		<< " MB uploaded in all\n";
+
+	for (Renderer::StreamedTextureId texture : textures)
+	{
+		textureStreamer.ReleaseTexture(texture);
+	}
+
+	textureStreamer.SetBudget(previousBudget);
+	context.pDeviceContext->WaitIdle();
+}
+}
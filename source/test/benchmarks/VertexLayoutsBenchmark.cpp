@@ -0,0 +1,187 @@
+#include "Benchmarks.h"
+
+#include <vulkan/InstanceBuffer.h>
+#include <vulkan/VertexLayout.h>
+
+// STD.
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+
+namespace Jettison::Benchmarks
+{
+constexpr std::array<Renderer::VertexLayoutPreset, 4> kVertexLayoutPresets = {Renderer::VertexLayoutPreset::Float,
+	Renderer::VertexLayoutPreset::Half, Renderer::VertexLayoutPreset::Compact, Renderer::VertexLayoutPreset::CompactLit};
+
+// Enough copies of the model that fetching the vertices is a real part of the frame.
+constexpr uint32_t kVertexLayoutInstanceCount = 1000;
+
+// The worst acceptable errors. Positions are relative to the size of the mesh, texture coordinates to their range.
+constexpr float kMaxPositionError = 1.0e-3f;
+constexpr float kMaxTexCoordError = 1.0e-4f;
+constexpr float kMaxNormalErrorDegrees = 0.1f;
+
+
+struct PackingErrors
+{
+	float position {0.0f};
+	float texCoord {0.0f};
+	float normalDegrees {0.0f};
+};
+
+
+static PackingErrors MeasurePackingErrors(const std::vector<Renderer::Vertex>& vertices, const Renderer::PackedVertices& packed)
+{
+	glm::vec3 positionMinimum {vertices[0].pos};
+	glm::vec3 positionMaximum {vertices[0].pos};
+	glm::vec2 texCoordMinimum {vertices[0].texCoord};
+	glm::vec2 texCoordMaximum {vertices[0].texCoord};
+	for (const auto& vertex : vertices)
+	{
+		positionMinimum = glm::min(positionMinimum, vertex.pos);
+		positionMaximum = glm::max(positionMaximum, vertex.pos);
+		texCoordMinimum = glm::min(texCoordMinimum, vertex.texCoord);
+		texCoordMaximum = glm::max(texCoordMaximum, vertex.texCoord);
+	}
+
+	float positionRange = std::max(glm::length(positionMaximum - positionMinimum), 1.0e-6f);
+	float texCoordRange = std::max(glm::length(texCoordMaximum - texCoordMinimum), 1.0e-6f);
+
+	PackingErrors errors;
+	for (uint32_t i = 0; i < packed.vertexCount; ++i)
+	{
+		Renderer::Vertex unpacked = Renderer::UnpackVertex(packed, i);
+
+		errors.position = std::max(errors.position, glm::length(unpacked.pos - vertices[i].pos) / positionRange);
+		errors.texCoord = std::max(errors.texCoord, glm::length(unpacked.texCoord - vertices[i].texCoord) / texCoordRange);
+
+		if (packed.layout.normal != Renderer::NormalFormat::None)
+		{
+			float cosine = glm::clamp(glm::dot(unpacked.normal, vertices[i].normal), -1.0f, 1.0f);
+			errors.normalDegrees = std::max(errors.normalDegrees, glm::degrees(std::acos(cosine)));
+		}
+	}
+
+	return errors;
+}
+
+
+static float GetScenePassTime(const Renderer::GpuProfiler& gpuProfiler)
+{
+	for (const auto& scope : gpuProfiler.GetScopeStats())
+	{
+		if (scope.name == "scene pass")
+		{
+			return scope.lastTime;
+		}
+	}
+
+	return 0.0f;
+}
+
+
+void RunVertexLayoutsBenchmark(const BenchmarkContext& context)
+{
+	const auto& vertices = context.pModel->GetVertices();
+	if (vertices.empty())
+	{
+		throw std::runtime_error("the vertex layouts benchmark needs a model");
+	}
+
+	uint32_t floatStride = Renderer::GetVertexLayout(Renderer::VertexLayoutPreset::Float).GetStride();
+	bool isPrecise = true;
+
+	// Packing on the CPU, and what it costs in precision.
+	for (auto preset : kVertexLayoutPresets)
+	{
+		Renderer::VertexLayout layout = Renderer::GetVertexLayout(preset);
+		std::string name = Renderer::GetVertexLayoutPresetName(preset);
+
+		std::vector<double> packTimes;
+		Renderer::PackedVertices packed;
+		for (uint32_t i = 0; i < context.iterations; ++i)
+		{
+			auto startTime = std::chrono::high_resolution_clock::now();
+			packed = Renderer::PackVertices(vertices, layout);
+			std::chrono::duration<double, std::milli> packTime = std::chrono::high_resolution_clock::now() - startTime;
+
+			packTimes.push_back(packTime.count());
+		}
+
+		PackingErrors errors = MeasurePackingErrors(vertices, packed);
+
+		std::cout << name << ": " << layout.GetStride() << " bytes a vertex, " << packed.data.size() / 1024 << " KB, "
+			<< static_cast<float>(floatStride) / layout.GetStride() << "x smaller than float. Worst error: position "
+			<< errors.position << ", texture coordinate " << errors.texCoord << ", normal " << errors.normalDegrees << " degrees\n";
+		ReportTimings("pack " + name, packTimes);
+
+		if (errors.position > kMaxPositionError || errors.texCoord > kMaxTexCoordError || errors.normalDegrees > kMaxNormalErrorDegrees)
+		{
+			std::cout << name << " loses too much precision\n";
+			isPrecise = false;
+		}
+	}
+
+	// Drawing many copies of the model in each layout, to see what the smaller vertices save in fetch bandwidth.
+	const auto& gpuProfiler = context.pRenderer->GetGpuProfiler();
+	if (gpuProfiler.IsSupported())
+	{
+		Renderer::InstanceBuffer instanceBuffer {context.pDeviceContext};
+		instanceBuffer.Init(kVertexLayoutInstanceCount);
+		instanceBuffer.Resize(kVertexLayoutInstanceCount);
+
+		uint32_t gridSize = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(kVertexLayoutInstanceCount))));
+		float spacing = 2.0f / gridSize;
+		for (uint32_t i = 0; i < kVertexLayoutInstanceCount; ++i)
+		{
+			glm::vec3 position {-1.0f + spacing * (i % gridSize), -1.0f + spacing * (i / gridSize), 0.0f};
+			instanceBuffer.SetTransform(i, glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(spacing * 0.5f)));
+		}
+
+		for (auto preset : kVertexLayoutPresets)
+		{
+			Renderer::Model model {context.pDeviceContext, Renderer::GetVertexLayout(preset)};
+			model.LoadModel();
+
+			Renderer::DrawItem drawItem {&model, 0, model.GetIndexCount()};
+			drawItem.pInstances = &instanceBuffer;
+			context.pRenderer->SetDrawList({drawItem});
+
+			while (!context.pRenderer->IsSceneReady())
+			{
+				context.pRenderer->DrawFrame();
+			}
+
+			std::vector<double> scenePassTimes;
+			for (uint32_t i = 0; i < context.iterations * 10; ++i)
+			{
+				context.pRenderer->DrawFrame();
+				scenePassTimes.push_back(GetScenePassTime(gpuProfiler));
+			}
+
+			ReportTimings(std::string("gpu scene pass ") + Renderer::GetVertexLayoutPresetName(preset) + " "
+				+ std::to_string(kVertexLayoutInstanceCount) + " instances", scenePassTimes);
+
+			// The model's buffers must outlive the frames which drew it.
+			context.pRenderer->SetModel(context.pModel);
+			context.pDeviceContext->WaitIdle();
+			model.Destroy();
+		}
+
+		instanceBuffer.Destroy();
+	}
+	else
+	{
+		std::cout << "no GPU timestamps, so the layouts aren't drawn\n";
+	}
+
+	if (!isPrecise)
+	{
+		throw std::runtime_error("a vertex layout loses too much precision");
+	}
+}
+}
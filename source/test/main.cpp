@@ -8,56 +8,306 @@
 #define GLFW_INCLUDE_VULKAN
 #include <../glfw/include/GLFW/glfw3.h>
 
+#include <chrono>
+#include <cstring>
+#include <functional>
 #include <iostream>
+#include <map>
 #include <stdexcept>
+#include <string>
+#include <vector>
 
+#include "benchmarks/Benchmarks.h"
 
-int main()
+
+// How often to report the per frame statistics.
+constexpr uint64_t kFrameStatsInterval = 10000;
+
+// How long a headless run lasts when "--frames" isn't given.
+constexpr uint64_t kDefaultHeadlessFrameCount = 1000;
+
+
+// Benchmarks which can be chosen with "--bench <name>".
+const std::map<std::string, std::function<void(const Jettison::Benchmarks::BenchmarkContext&)>> kBenchmarks = {
+	{"asset-loading", Jettison::Benchmarks::RunAssetLoadingBenchmark},
+	{"command-recording", Jettison::Benchmarks::RunCommandRecordingBenchmark},
+	{"cpu-culling", Jettison::Benchmarks::RunCpuCullingBenchmark},
+	{"gpu-culling", Jettison::Benchmarks::RunGpuCullingBenchmark},
+	{"indirect-draw", Jettison::Benchmarks::RunIndirectDrawBenchmark},
+	{"instancing", Jettison::Benchmarks::RunInstancingBenchmark},
+	{"latency-modes", Jettison::Benchmarks::RunLatencyModesBenchmark},
+	{"lod", Jettison::Benchmarks::RunLodBenchmark},
+	{"memory-defragmentation", Jettison::Benchmarks::RunMemoryDefragmentationBenchmark},
+	{"mesh-cache", Jettison::Benchmarks::RunMeshCacheBenchmark},
+	{"mip-generation", Jettison::Benchmarks::RunMipGenerationBenchmark},
+	{"obj-import", Jettison::Benchmarks::RunObjImportBenchmark},
+	{"pipeline-cache", Jettison::Benchmarks::RunPipelineCacheBenchmark},
+	{"render-graph", Jettison::Benchmarks::RunRenderGraphBenchmark},
+	{"resize-storm", Jettison::Benchmarks::RunResizeStormBenchmark},
+	{"texture-compression", Jettison::Benchmarks::RunTextureCompressionBenchmark},
+	{"texture-streaming", Jettison::Benchmarks::RunTextureStreamingBenchmark},
+	{"vertex-layouts", Jettison::Benchmarks::RunVertexLayoutsBenchmark},
+};
+
+
+int main(int argc, char* argv[])
 {
 	try
 	{
-		std::shared_ptr<Jettison::Renderer::Window> pWindow = std::make_shared<Jettison::Renderer::Window>();
+		// Command line.
+		std::string benchmarkName;
+		uint32_t iterations = 10;
+		bool isHeadless = false;
+		Jettison::Renderer::HeadlessSettings headlessSettings;
+		uint64_t frameCount = 0;
+		std::string screenshotPath;
+		std::string latencyModeName;
+		std::string vertexLayoutName;
+		uint64_t textureBudget = 0;
+
+		for (int i = 1; i < argc; ++i)
+		{
+			if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc)
+			{
+				benchmarkName = argv[++i];
+			}
+			else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc)
+			{
+				iterations = static_cast<uint32_t>(std::stoul(argv[++i]));
+			}
+			else if (strcmp(argv[i], "--headless") == 0)
+			{
+				isHeadless = true;
+			}
+			else if (strcmp(argv[i], "--images") == 0 && i + 1 < argc)
+			{
+				headlessSettings.imageCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+			}
+			else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+			{
+				frameCount = std::stoull(argv[++i]);
+			}
+			else if (strcmp(argv[i], "--screenshot") == 0 && i + 1 < argc)
+			{
+				screenshotPath = argv[++i];
+			}
+			else if (strcmp(argv[i], "--latency") == 0 && i + 1 < argc)
+			{
+				latencyModeName = argv[++i];
+			}
+			else if (strcmp(argv[i], "--vertex-layout") == 0 && i + 1 < argc)
+			{
+				vertexLayoutName = argv[++i];
+			}
+			else if (strcmp(argv[i], "--texture-budget") == 0 && i + 1 < argc)
+			{
+				// In megabytes.
+				textureBudget = std::stoull(argv[++i]) * 1024 * 1024;
+			}
+			else
+			{
+				throw std::runtime_error(std::string("unknown argument ") + argv[i]);
+			}
+		}
+
+		if (!benchmarkName.empty() && kBenchmarks.find(benchmarkName) == kBenchmarks.end())
+		{
+			throw std::runtime_error("unknown benchmark " + benchmarkName);
+		}
+
+		// Without a window there's nothing to close, so a headless run always has a fixed length.
+		if (isHeadless && frameCount == 0)
+		{
+			frameCount = kDefaultHeadlessFrameCount;
+		}
+
+		std::shared_ptr<Jettison::Renderer::Window> pWindow = isHeadless ? nullptr : std::make_shared<Jettison::Renderer::Window>();
 		std::shared_ptr<Jettison::Renderer::DeviceContext> pDeviceContext = std::make_shared<Jettison::Renderer::DeviceContext>(pWindow);
-		std::shared_ptr<Jettison::Renderer::Swapchain> pSwapchain = std::make_shared<Jettison::Renderer::Swapchain>(pDeviceContext);
+		std::shared_ptr<Jettison::Renderer::Swapchain> pSwapchain = std::make_shared<Jettison::Renderer::Swapchain>(pDeviceContext, headlessSettings);
 		std::shared_ptr<Jettison::Renderer::Pipeline> pPipeline = std::make_shared<Jettison::Renderer::Pipeline>(pDeviceContext, pSwapchain);
 		std::shared_ptr<Jettison::Renderer::Renderer> pRenderer = std::make_shared<Jettison::Renderer::Renderer>(pDeviceContext, pWindow, pSwapchain, pPipeline);
 
-		pWindow->Init();
+		if (pWindow)
+		{
+			pWindow->Init();
+		}
 		pDeviceContext->Init();
 		pSwapchain->Init();
 		pPipeline->Init();
 		pRenderer->Init();
 
-		Jettison::Renderer::Model model {pDeviceContext};
-		model.LoadModel();
+		if (!latencyModeName.empty())
+		{
+			pRenderer->SetLatencyMode(Jettison::Renderer::ParseLatencyMode(latencyModeName));
+		}
+
+		if (textureBudget > 0)
+		{
+			pPipeline->GetTextureStreamer().SetBudget(textureBudget);
+		}
+
+		Jettison::Renderer::VertexLayoutPreset vertexLayoutPreset = vertexLayoutName.empty() ? Jettison::Renderer::VertexLayoutPreset::Float
+			: Jettison::Renderer::ParseVertexLayoutPreset(vertexLayoutName);
+
+		// The model loads in the background while the render loop runs, with nothing to draw yet.
+		Jettison::Renderer::AssetManager& assetManager = pPipeline->GetAssetManager();
+		Jettison::Renderer::AssetHandle modelAsset = assetManager.LoadModel(Jettison::Renderer::kModelPath,
+			Jettison::Renderer::GetVertexLayout(vertexLayoutPreset));
+
+		uint32_t loadingFrameCount = 0;
+		while (assetManager.GetState(modelAsset) != Jettison::Renderer::AssetState::Ready
+			&& assetManager.GetState(modelAsset) != Jettison::Renderer::AssetState::Failed)
+		{
+			if (pWindow)
+			{
+				glfwPollEvents();
+			}
+
+			pRenderer->DrawFrame();
+			loadingFrameCount++;
+		}
+
+		// Throws if the model failed to load.
+		Jettison::Renderer::Model& model = assetManager.GetModel(modelAsset);
+
+		const auto& optimisationStats = model.GetOptimisationStats();
+		std::cout << "model: " << optimisationStats.vertexCount << " vertices, " << optimisationStats.triangleCount << " triangles, ACMR "
+			<< optimisationStats.before.acmr << " -> " << optimisationStats.after.acmr << ", ATVR " << optimisationStats.before.atvr
+			<< " -> " << optimisationStats.after.atvr << ", " << Jettison::Renderer::GetVertexLayoutPresetName(vertexLayoutPreset)
+			<< " vertices " << model.GetVertexBufferSize() / 1024 << " KB, " << model.GetLods().size() << " levels of detail\n";
+
+		const auto& loadStats = model.GetLoadStats();
+		std::cout << "model " << (loadStats.isCached ? "loaded from the mesh cache" : "imported") << " in " << loadStats.totalTime.count() << " ms, "
+			<< loadingFrameCount << " frames drawn meanwhile\n";
+
+		const auto& textureStats = pPipeline->GetTextureLoadStats();
+		std::cout << "texture: " << textureStats.width << " x " << textureStats.height << " " << Jettison::Renderer::GetTextureFormatName(textureStats.format)
+			<< ", " << textureStats.levelCount << " levels, " << textureStats.size / 1024 << " KB (" << textureStats.uncompressedSize / 1024
+			<< " KB as rgba8), " << (textureStats.isCached ? "loaded from the texture cache" : "cooked") << " in " << textureStats.totalTime.count() << " ms\n";
 
-		// HACK: We need to add the model command buffers to the pipeline.
-		//pPipeline->CreateCommandBuffers(model);
+		// The command buffers are recorded once, and only re-recorded when the scene changes.
+		pRenderer->SetModel(&model);
 
 		// TODO: InitImGui();
 
-		while (!glfwWindowShouldClose(pWindow->GetGLFWWindow()))
+		if (!benchmarkName.empty())
 		{
-			glfwPollEvents();
+			Jettison::Benchmarks::BenchmarkContext context;
+			context.pWindow = pWindow;
+			context.pDeviceContext = pDeviceContext;
+			context.pSwapchain = pSwapchain;
+			context.pPipeline = pPipeline;
+			context.pRenderer = pRenderer;
+			context.pModel = &model;
+			context.iterations = iterations;
 
-			// TODO: ImGui before.
+			kBenchmarks.at(benchmarkName)(context);
+		}
 
-			// HACK: We need to add the model command buffers to the pipeline.
-			pPipeline->CreateCommandBuffers(model);
+		// When running for a fixed number of frames, wait for the uploads first so every timed frame draws the same thing.
+		if (benchmarkName.empty() && frameCount > 0)
+		{
+			while (!pRenderer->IsSceneReady())
+			{
+				pRenderer->DrawFrame();
+			}
+		}
+
+		std::vector<double> frameTimes;
+		auto runStartTime = std::chrono::high_resolution_clock::now();
+
+		for (uint64_t frame = 0; benchmarkName.empty() && (frameCount == 0 || frame < frameCount); ++frame)
+		{
+			if (pWindow && glfwWindowShouldClose(pWindow->GetGLFWWindow()))
+			{
+				break;
+			}
+
+			// May wait on the previous frame, so it comes before the frame timer starts.
+			pRenderer->BeginInputSampling();
+
+			if (pWindow)
+			{
+				glfwPollEvents();
+			}
+
+			// TODO: ImGui before.
 
+			auto frameStartTime = std::chrono::high_resolution_clock::now();
 			pRenderer->DrawFrame();
 
+			if (frameCount > 0)
+			{
+				std::chrono::duration<double, std::milli> frameTime = std::chrono::high_resolution_clock::now() - frameStartTime;
+				frameTimes.push_back(frameTime.count());
+			}
+
 			// TODO: ImGui after.
+
+			// Keep an eye on the command buffer allocations, they should stay flat during a long soak run.
+			const auto& frameStats = pRenderer->GetFrameStats();
+			if (frameStats.frameNumber % kFrameStatsInterval == 0)
+			{
+				std::cout << "frame " << frameStats.frameNumber
+					<< ": command buffers allocated " << frameStats.commandBuffersAllocated
+					<< " (total " << frameStats.totalCommandBuffersAllocated << ")\n";
+			}
+		}
+
+		if (!frameTimes.empty())
+		{
+			std::chrono::duration<double> runTime = std::chrono::high_resolution_clock::now() - runStartTime;
+			Jettison::Benchmarks::ReportTimings("frame", frameTimes);
+			std::cout << frameTimes.size() << " frames in " << runTime.count() << " s, "
+				<< frameTimes.size() / runTime.count() << " frames per second\n";
+
+			const auto& latencyStats = pRenderer->GetLatencyStats();
+			if (latencyStats.sampleCount > 0)
+			{
+				std::cout << Jettison::Renderer::GetLatencyModeName(pRenderer->GetLatencyMode())
+					<< " input to present: min " << latencyStats.minLatency.count()
+					<< " ms, avg " << latencyStats.totalLatency.count() / latencyStats.sampleCount
+					<< " ms, max " << latencyStats.maxLatency.count() << " ms\n";
+			}
+
+			for (const auto& scope : pRenderer->GetGpuProfiler().GetScopeStats())
+			{
+				std::cout << "gpu " << scope.name << ": min " << scope.minTime << " ms, avg " << scope.avgTime
+					<< " ms, max " << scope.maxTime << " ms\n";
+			}
+
+			Jettison::Renderer::TextureStreamer& textureStreamer = pPipeline->GetTextureStreamer();
+			for (Jettison::Renderer::StreamedTextureId texture : textureStreamer.GetTextures())
+			{
+				Jettison::Renderer::TextureResidencyStats residencyStats = textureStreamer.GetResidencyStats(texture);
+				std::cout << "texture " << residencyStats.path << ": level " << residencyStats.residentLevel << " of " << residencyStats.levelCount
+					<< " resident, " << residencyStats.requestedLevel << " requested, " << residencyStats.residentSize / 1024 << " of "
+					<< residencyStats.fullSize / 1024 << " KB\n";
+			}
+
+			const auto& streamingStats = textureStreamer.GetStats();
+			std::cout << "textures: " << streamingStats.residentSize / 1024 << " KB resident of a " << streamingStats.budget / 1024
+				<< " KB budget, " << streamingStats.streamInCount << " streamed in, " << streamingStats.evictionCount << " evicted\n";
+
+			Jettison::Benchmarks::ReportHeapStats(pDeviceContext->GetMemoryAllocator().GetHeapStats());
+		}
+
+		if (!screenshotPath.empty())
+		{
+			pRenderer->SaveScreenshot(screenshotPath);
 		}
 
 		pDeviceContext->WaitIdle();
 
-		model.Destroy();
+		assetManager.Release(modelAsset);
 		pRenderer->Destroy();
 		pPipeline->Destroy();
 		pSwapchain->Destroy();
 		pDeviceContext->Destroy();
-		pWindow->Destroy();
+		if (pWindow)
+		{
+			pWindow->Destroy();
+		}
 
 	}
 	catch (const std::exception& e)